@@ -0,0 +1,220 @@
+#ifndef ADAPTIVE_BATCHER_H
+#define ADAPTIVE_BATCHER_H
+
+#include "LatencyHistogram.h"
+#include "Queue.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+struct AdaptiveBatchOptions {
+    // Items handed to the handler at most at once.
+    size_t maxBatch = 256;
+    // How long the oldest item of a batch may wait for company.
+    std::chrono::nanoseconds latencyBudget = std::chrono::microseconds(100);
+    // Weight of the newest sample in the arrival rate's moving average.
+    double rateSmoothing = 0.125;
+};
+
+// Batch sizes, exact up to 256 and within 1% above.
+using BatchSizeHistogram = LatencyHistogram<7, 32>;
+
+struct AdaptiveBatchStats {
+    std::uint64_t items = 0;
+    std::uint64_t batches = 0;
+    // Why each batch went out.
+    std::uint64_t full = 0;
+    std::uint64_t expired = 0;
+    std::uint64_t backlogged = 0;
+    std::uint64_t idle = 0;
+    std::uint64_t forced = 0;
+    // Items per microsecond, as the batcher last estimated it.
+    double arrivalRate = 0;
+};
+
+// Age of an item counted from the moment the batcher dequeued it. Give
+// AdaptiveBatcher a functor of the same shape returning the TscClock ticks
+// an item carries to count from when it was produced instead.
+struct DequeueTimestamp {
+    template<typename T>
+    std::uint64_t operator()(const T&, std::uint64_t now) const {
+        return now;
+    }
+};
+
+// Consumer-side batching over a ring, for consumers such as a database
+// writer for which every hand-off costs a round trip. poll() pulls with
+// dequeue_bulk until the ring runs dry, the batch is full or its oldest item
+// has waited out the latency budget, and then either hands the batch on or
+// holds it for more:
+//
+//   - a full batch, or one whose oldest item is out of budget, goes out;
+//   - a batch that drained the ring goes out unless, at the arrival rate
+//     measured from the ring so far, at least one more item is due before
+//     the oldest runs out of budget;
+//   - a batch never waits if the ring was more than half full when the poll
+//     began, as the consumer is behind.
+//
+// So at a trickle each item goes out on its own, as soon as it arrives, and
+// under load batches grow towards maxBatch, without a timer adding latency
+// to the first case or per-item hand-offs costing throughput in the second.
+// Call poll() in the consumer's loop; it never blocks. Not thread-safe: one
+// batcher per consumer, as the ring has.
+template<typename T, typename Queue = SPSCQueue<T>, typename Timestamp = DequeueTimestamp>
+class AdaptiveBatcher {
+public:
+    explicit AdaptiveBatcher(Queue& queue, AdaptiveBatchOptions options = AdaptiveBatchOptions(),
+                             Timestamp timestamp = Timestamp())
+        : queue_(queue), options_(options), timestamp_(std::move(timestamp)), batch_(options.maxBatch) {
+        if (options.maxBatch == 0) {
+            throw std::invalid_argument("AdaptiveBatcher needs a maxBatch of at least one.");
+        }
+        if (options.latencyBudget.count() < 0 || !(options.rateSmoothing > 0 && options.rateSmoothing <= 1)) {
+            throw std::invalid_argument("AdaptiveBatcher needs a non-negative budget and a smoothing in (0, 1].");
+        }
+        budgetTicks_ = static_cast<std::uint64_t>(static_cast<double>(options.latencyBudget.count()) * TscClock::ticks_per_nanosecond());
+        windowTicks_ = std::max<std::uint64_t>(budgetTicks_ / 4, 1000);
+        windowStart_ = TscClock::ticks();
+    }
+
+    AdaptiveBatcher(const AdaptiveBatcher&) = delete;
+    AdaptiveBatcher& operator=(const AdaptiveBatcher&) = delete;
+
+    // Pulls what the ring has and calls handler(T* items, size_t count) if
+    // the batch should go out. Returns the number of items handed over.
+    template<typename Handler>
+    size_t poll(Handler&& handler) {
+        // More than half full: the consumer is behind.
+        const bool backlogged = queue_.size() * 2 > queue_.capacity();
+        std::uint64_t now = TscClock::ticks();
+        size_t pulled = 0;
+        while (count_ < batch_.size() && !(count_ != 0 && age(now) >= budgetTicks_)) {
+            const size_t n = queue_.dequeue_bulk(batch_.begin() + static_cast<std::ptrdiff_t>(count_), batch_.size() - count_);
+            if (n == 0) {
+                break;
+            }
+            if (count_ == 0) {
+                oldest_ = timestamp_(static_cast<const T&>(batch_[0]), now);
+            }
+            count_ += n;
+            pulled += n;
+            now = TscClock::ticks();
+        }
+        observe(pulled, now);
+        if (count_ == 0) {
+            return 0;
+        }
+        if (count_ == batch_.size()) {
+            return deliver(handler, stats_.full);
+        }
+        const std::uint64_t waited = age(now);
+        if (waited >= budgetTicks_) {
+            return deliver(handler, stats_.expired);
+        }
+        if (backlogged) {
+            return deliver(handler, stats_.backlogged);
+        }
+        // Items expected in the budget the oldest has left.
+        const double expected = rate(now) * static_cast<double>(budgetTicks_ - waited);
+        if (expected < 1.0) {
+            return deliver(handler, stats_.idle);
+        }
+        return 0;
+    }
+
+    // Hands over whatever is held, e.g. before shutting down.
+    template<typename Handler>
+    size_t flush(Handler&& handler) {
+        return count_ == 0 ? 0 : deliver(handler, stats_.forced);
+    }
+
+    // Items held for the next batch.
+    size_t pending() const {
+        return count_;
+    }
+
+    AdaptiveBatchStats stats() const {
+        AdaptiveBatchStats stats = stats_;
+        stats.arrivalRate = rate(TscClock::ticks()) * TscClock::ticks_per_nanosecond() * 1000.0;
+        return stats;
+    }
+
+    // Sizes of the batches handed over so far.
+    const BatchSizeHistogram& sizes() const {
+        return sizes_;
+    }
+
+    void resetStats() {
+        stats_ = AdaptiveBatchStats();
+        sizes_.reset();
+    }
+
+private:
+    std::uint64_t age(std::uint64_t now) const {
+        // A producer's timestamp may be a little ahead of our clock.
+        return now > oldest_ ? now - oldest_ : 0;
+    }
+
+    // The arrival rate in items per tick with the open window folded in,
+    // weighted by how much of a window it spans. So a burst counts before
+    // its first window closes, and a lone item in a fresh window counts for
+    // no more than it would at the end of one.
+    double rate(std::uint64_t now) const {
+        const std::uint64_t elapsed = now - windowStart_;
+        if (elapsed == 0 || (windowItems_ == 0 && rate_ == 0)) {
+            return rate_;
+        }
+        const double span = static_cast<double>(elapsed);
+        const double sample = static_cast<double>(windowItems_) / span;
+        const double weight = options_.rateSmoothing * std::min(1.0, span / static_cast<double>(windowTicks_));
+        return rate_ + weight * (sample - rate_);
+    }
+
+    // Counts pulled items and, once per window of a quarter of the budget,
+    // folds the window's items per tick into the arrival rate. Windowing
+    // keeps the many empty polls of a spinning consumer from each counting
+    // as a sample.
+    void observe(size_t pulled, std::uint64_t now) {
+        windowItems_ += pulled;
+        const std::uint64_t elapsed = now - windowStart_;
+        if (elapsed < windowTicks_) {
+            return;
+        }
+        const double sample = static_cast<double>(windowItems_) / static_cast<double>(elapsed);
+        rate_ += options_.rateSmoothing * (sample - rate_);
+        windowItems_ = 0;
+        windowStart_ = now;
+    }
+
+    template<typename Handler>
+    size_t deliver(Handler& handler, std::uint64_t& reason) {
+        const size_t count = count_;
+        count_ = 0;
+        handler(batch_.data(), count);
+        ++reason;
+        ++stats_.batches;
+        stats_.items += count;
+        sizes_.record(count);
+        return count;
+    }
+
+    Queue& queue_;
+    AdaptiveBatchOptions options_;
+    Timestamp timestamp_;
+    std::vector<T> batch_;
+    size_t count_ = 0;
+    std::uint64_t oldest_ = 0;
+    std::uint64_t budgetTicks_ = 0;
+    std::uint64_t windowTicks_ = 0;
+    std::uint64_t windowStart_ = 0;
+    std::uint64_t windowItems_ = 0;
+    double rate_ = 0;
+    AdaptiveBatchStats stats_;
+    BatchSizeHistogram sizes_;
+};
+
+#endif // ADAPTIVE_BATCHER_H
@@ -0,0 +1,659 @@
+#ifndef ASYNC_LOGGER_H
+#define ASYNC_LOGGER_H
+
+#include "BipBuffer.h"
+#include "LatencyHistogram.h"
+#include "StringIntern.h"
+#include "ThreadRings.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <unistd.h>
+#include <vector>
+
+#if defined(__has_include)
+#if __has_include(<charconv>)
+#include <charconv>
+#endif
+#endif
+
+// Asynchronous logger for hot paths. A log call does no formatting and no
+// I/O: it writes the StringPool symbol id of its format string, a TSC
+// timestamp and its arguments in binary into a BipBuffer owned by the
+// calling thread. A writer thread merges the rings in timestamp order,
+// formats the lines, and hands them to the sink in batches of up to
+// LogOptions::batchBytes, so a busy service makes one write() per batch
+// rather than one per line.
+//
+// Format strings are literals with {} placeholders, interned once per use
+// site by the CPPUTILS_LOG_* macros, which also check at compile time that
+// there is an argument for every placeholder and skip evaluating the
+// arguments of a filtered-out level. Arguments may be integers, floating
+// point numbers, bools, chars, strings (copied into the record) and
+// StringHandle, StringRef and StringPtr (just the handle id when the string
+// has one in the process-wide pool, copied otherwise).
+//
+// A full ring either drops the record and counts it (LogOverflow::Drop) or
+// makes the caller wait for the writer (LogOverflow::Block). Anything still
+// in the rings when stop() returns is discarded at the next start().
+
+enum class LogLevel : std::uint8_t {
+    Debug,
+    Info,
+    Warning,
+    Error,
+    // As a threshold, filters out everything.
+    Off
+};
+
+enum class LogOverflow {
+    Drop,
+    Block
+};
+
+// Receives formatted lines, many at a time, always ending in a newline.
+using LogSink = std::function<void(const char* data, size_t size)>;
+
+struct LogOptions {
+    LogLevel level = LogLevel::Info;
+    LogOverflow overflow = LogOverflow::Drop;
+    // Bytes per thread; a power of two.
+    size_t ringCapacity = size_t(1) << 16;
+    // How often the writer looks at the rings.
+    std::chrono::milliseconds flushPeriod{1};
+    // The writer calls the sink when it has this many bytes, and at the end
+    // of each pass.
+    size_t batchBytes = size_t(1) << 16;
+};
+
+struct LogStats {
+    std::uint64_t written = 0;
+    std::uint64_t dropped = 0;
+    // Sink calls.
+    std::uint64_t batches = 0;
+};
+
+// The symbol id of a format string with N placeholders.
+template<size_t N>
+struct LogFormat {
+    std::uint32_t id;
+};
+
+namespace detail {
+
+// The {} pairs in a format string.
+constexpr size_t logPlaceholders(std::string_view format) {
+    size_t count = 0;
+    for (size_t i = 0; i + 1 < format.size(); ++i) {
+        if (format[i] == '{' && format[i + 1] == '}') {
+            ++count;
+            ++i;
+        }
+    }
+    return count;
+}
+
+enum class LogArg : std::uint8_t {
+    Signed,
+    Unsigned,
+    Floating,
+    Boolean,
+    Character,
+    // A handle id in the process-wide StringPool.
+    Handle,
+    // A length and the characters.
+    Text
+};
+
+// One argument of a log call, before it is encoded.
+struct LogArgument {
+    LogArg type;
+    std::uint64_t bits;
+    std::string_view text;
+
+    size_t encodedSize() const {
+        switch (type) {
+        case LogArg::Boolean:
+        case LogArg::Character:
+            return 2;
+        case LogArg::Handle:
+            return 5;
+        case LogArg::Text:
+            return 5 + text.size();
+        default:
+            return 9;
+        }
+    }
+
+    std::byte* encode(std::byte* out) const {
+        *out++ = static_cast<std::byte>(type);
+        switch (type) {
+        case LogArg::Boolean:
+        case LogArg::Character:
+            *out++ = static_cast<std::byte>(bits);
+            return out;
+        case LogArg::Handle: {
+            const std::uint32_t handle = static_cast<std::uint32_t>(bits);
+            std::memcpy(out, &handle, sizeof(handle));
+            return out + sizeof(handle);
+        }
+        case LogArg::Text: {
+            const std::uint32_t length = static_cast<std::uint32_t>(text.size());
+            std::memcpy(out, &length, sizeof(length));
+            std::memcpy(out + sizeof(length), text.data(), text.size());
+            return out + sizeof(length) + text.size();
+        }
+        default:
+            std::memcpy(out, &bits, sizeof(bits));
+            return out + sizeof(bits);
+        }
+    }
+};
+
+inline LogArgument logString(const String* string) {
+    if (string == nullptr) {
+        return LogArgument{LogArg::Text, 0, std::string_view()};
+    }
+    if (string->pool() == &StringPool::instance()) {
+        // A string with a handle is pinned, so the id outlives the record.
+        if (const StringHandle handle = StringHandle::existing(string)) {
+            return LogArgument{LogArg::Handle, handle.id(), std::string_view()};
+        }
+    }
+    return LogArgument{LogArg::Text, 0, string->view()};
+}
+
+template<typename T>
+struct LogUnsupported : std::false_type {};
+
+template<typename T>
+LogArgument logArgument(const T& value) {
+    if constexpr (std::is_same<T, bool>::value) {
+        return LogArgument{LogArg::Boolean, value ? 1u : 0u, std::string_view()};
+    } else if constexpr (std::is_same<T, char>::value) {
+        return LogArgument{LogArg::Character, static_cast<unsigned char>(value), std::string_view()};
+    } else if constexpr (std::is_enum<T>::value) {
+        return logArgument(static_cast<std::underlying_type_t<T>>(value));
+    } else if constexpr (std::is_integral<T>::value && std::is_signed<T>::value) {
+        return LogArgument{LogArg::Signed, static_cast<std::uint64_t>(static_cast<std::int64_t>(value)), std::string_view()};
+    } else if constexpr (std::is_integral<T>::value) {
+        return LogArgument{LogArg::Unsigned, static_cast<std::uint64_t>(value), std::string_view()};
+    } else if constexpr (std::is_floating_point<T>::value) {
+        const double floating = static_cast<double>(value);
+        std::uint64_t bits;
+        std::memcpy(&bits, &floating, sizeof(bits));
+        return LogArgument{LogArg::Floating, bits, std::string_view()};
+    } else if constexpr (std::is_same<T, StringHandle>::value) {
+        return LogArgument{LogArg::Handle, value.id(), std::string_view()};
+    } else if constexpr (std::is_same<T, StringRef>::value) {
+        return logString(value.getRawPointer());
+    } else if constexpr (std::is_same<T, StringPtr>::value) {
+        return logString(value.get());
+    } else if constexpr (std::is_same<T, const char*>::value || std::is_same<T, char*>::value) {
+        return LogArgument{LogArg::Text, 0, value == nullptr ? std::string_view() : std::string_view(value)};
+    } else if constexpr (std::is_convertible<const T&, std::string_view>::value) {
+        return LogArgument{LogArg::Text, 0, std::string_view(value)};
+    } else {
+        static_assert(LogUnsupported<T>::value, "AsyncLogger cannot encode this argument type.");
+        return LogArgument{};
+    }
+}
+
+// Fixed part of each record.
+struct LogRecordHeader {
+    std::uint64_t ticks;
+    std::uint32_t format;
+    LogLevel level;
+    std::uint8_t arguments;
+};
+
+// Appends "YYYY-MM-DD HH:MM:SS.nnnnnnnnn" for nanoseconds since the Unix
+// epoch, in UTC, without going through gmtime and the C locale.
+inline void appendLogTime(std::string& out, std::int64_t nanoseconds) {
+    std::int64_t seconds = nanoseconds / 1000000000;
+    std::int64_t fraction = nanoseconds % 1000000000;
+    if (fraction < 0) {
+        fraction += 1000000000;
+        --seconds;
+    }
+    std::int64_t days = seconds / 86400;
+    std::int64_t second = seconds % 86400;
+    if (second < 0) {
+        second += 86400;
+        --days;
+    }
+    // Howard Hinnant's civil_from_days.
+    days += 719468;
+    const std::int64_t era = (days >= 0 ? days : days - 146096) / 146097;
+    const std::int64_t dayOfEra = days - era * 146097;
+    const std::int64_t yearOfEra = (dayOfEra - dayOfEra / 1460 + dayOfEra / 36524 - dayOfEra / 146096) / 365;
+    const std::int64_t dayOfYear = dayOfEra - (365 * yearOfEra + yearOfEra / 4 - yearOfEra / 100);
+    const std::int64_t shifted = (5 * dayOfYear + 2) / 153;
+    const std::int64_t day = dayOfYear - (153 * shifted + 2) / 5 + 1;
+    const std::int64_t month = shifted < 10 ? shifted + 3 : shifted - 9;
+    const std::int64_t year = yearOfEra + era * 400 + (month <= 2);
+    char text[48];
+    const int length = std::snprintf(text, sizeof(text), "%04lld-%02lld-%02lld %02lld:%02lld:%02lld.%09lld",
+                                     static_cast<long long>(year), static_cast<long long>(month),
+                                     static_cast<long long>(day), static_cast<long long>(second / 3600),
+                                     static_cast<long long>(second / 60 % 60), static_cast<long long>(second % 60),
+                                     static_cast<long long>(fraction));
+    out.append(text, static_cast<size_t>(length));
+}
+
+inline void appendLogNumber(std::string& out, std::uint64_t value, bool negative) {
+    char text[24];
+    char* end = text + sizeof(text);
+    char* begin = end;
+    do {
+        *--begin = static_cast<char>('0' + value % 10);
+        value /= 10;
+    } while (value != 0);
+    if (negative) {
+        *--begin = '-';
+    }
+    out.append(begin, end);
+}
+
+inline void appendLogFloating(std::string& out, double value) {
+    char text[32];
+#if defined(__cpp_lib_to_chars) && __cpp_lib_to_chars >= 201611L
+    const auto result = std::to_chars(text, text + sizeof(text), value);
+    out.append(text, result.ptr);
+#else
+    const int length = std::snprintf(text, sizeof(text), "%.17g", value);
+    out.append(text, static_cast<size_t>(length));
+#endif
+}
+
+} // namespace detail
+
+// The process-wide logger. Log through the CPPUTILS_LOG_* macros from any
+// thread; start(), stop() and flush() are for one controlling thread.
+class AsyncLogger {
+public:
+    // Never destroyed, so threads may log during static destruction.
+    static AsyncLogger& instance() {
+        static AsyncLogger* const logger = new AsyncLogger();
+        return *logger;
+    }
+
+    // A sink that write()s each batch to fd, retrying partial writes.
+    static LogSink fdSink(int fd) {
+        return [fd](const char* data, size_t size) {
+            while (size != 0) {
+                const ssize_t written = ::write(fd, data, size);
+                if (written < 0) {
+                    if (errno == EINTR) {
+                        continue;
+                    }
+                    return;
+                }
+                data += written;
+                size -= static_cast<size_t>(written);
+            }
+        };
+    }
+
+    static const char* levelName(LogLevel level) {
+        static const char* const names[] = {"DEBUG", "INFO", "WARN", "ERROR", "OFF"};
+        return names[static_cast<std::uint8_t>(level)];
+    }
+
+    // Starts a session writing to sink, after stopping any earlier one.
+    // Threads that have not logged yet get rings of options.ringCapacity
+    // bytes.
+    void start(LogSink sink, LogOptions options = LogOptions()) {
+        if (!sink) {
+            throw std::invalid_argument("AsyncLogger needs a sink.");
+        }
+        checkCapacity(options.ringCapacity, DynamicCapacity);
+        if (options.level == LogLevel::Off) {
+            throw std::invalid_argument("AsyncLogger needs a level below Off.");
+        }
+        stop();
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            for (const auto& ring : rings_) {
+                while (!ring->buffer.read().empty()) {
+                    ring->buffer.consume();
+                }
+                ring->dropped.store(0, std::memory_order_relaxed);
+            }
+            sink_ = std::move(sink);
+            options_ = options;
+            stats_ = LogStats();
+            startTicks_ = TscClock::ticks();
+            startTime_ = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                             std::chrono::system_clock::now().time_since_epoch()).count();
+            ticksPerNanosecond_ = TscClock::ticks_per_nanosecond();
+            stopping_ = false;
+        }
+        overflow_.store(options.overflow, std::memory_order_relaxed);
+        threshold_.store(options.level, std::memory_order_release);
+        writer_ = std::thread([this] { run(); });
+    }
+
+    // Writes out everything logged so far and ends the session.
+    void stop() {
+        threshold_.store(LogLevel::Off, std::memory_order_release);
+        if (writer_.joinable()) {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                stopping_ = true;
+            }
+            wake_.notify_one();
+            writer_.join();
+            std::lock_guard<std::mutex> lock(mutex_);
+            sink_ = nullptr;
+        }
+    }
+
+    // Formats and writes out everything logged so far, on the calling thread.
+    void flush() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (sink_) {
+            while (drainLocked()) {
+            }
+        }
+    }
+
+    // Records below level are filtered out from now on.
+    void setLevel(LogLevel level) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (writer_.joinable() && level != LogLevel::Off) {
+            options_.level = level;
+            threshold_.store(level, std::memory_order_release);
+        }
+    }
+
+    // False when no session runs or level is filtered out.
+    bool enabled(LogLevel level) const {
+        return level >= threshold_.load(std::memory_order_relaxed);
+    }
+
+    LogStats stats() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        LogStats stats = stats_;
+        for (const auto& ring : rings_) {
+            stats.dropped += ring->dropped.load(std::memory_order_relaxed);
+        }
+        return stats;
+    }
+
+    // Use the CPPUTILS_LOG_* macros, which pass the format twice: interned,
+    // and as the literal for the placeholder check.
+    template<size_t N, size_t M, typename... Args>
+    void log(LogLevel level, LogFormat<N> format, const char (&)[M], const Args&... args) {
+        static_assert(sizeof...(Args) == N, "The format string needs one argument per {} placeholder.");
+        if (!enabled(level)) {
+            return;
+        }
+        const detail::LogArgument arguments[] = {detail::logArgument(args)..., detail::LogArgument{}};
+        write(level, format.id, arguments, sizeof...(Args));
+    }
+
+private:
+    struct Ring : detail::ThreadRing {
+        Ring(size_t capacity, std::uint32_t thread) : ThreadRing(thread), buffer(capacity) {}
+
+        BipBuffer<> buffer;
+        // The stamp of the record being written, Stamping while it is taken,
+        // 0 outside write(); bounds what the writer may merge.
+        std::atomic<std::uint64_t> writing{0};
+    };
+
+    static constexpr std::uint64_t Stamping = ~std::uint64_t(0);
+
+    static constexpr size_t MaxArguments = 255;
+    // Records written out per pass before the writer lets go of the lock.
+    static constexpr size_t PassRecords = 4096;
+
+    void write(LogLevel level, std::uint32_t format, const detail::LogArgument* arguments, size_t count) {
+        Ring* ring = rings_.local(mutex_, [this](std::uint32_t thread) { return new Ring(options_.ringCapacity, thread); });
+        if (ring == nullptr) {
+            // Logging from a thread-local destructor after ours ran.
+            return;
+        }
+        static_assert(sizeof(detail::LogRecordHeader) == 16, "LogRecordHeader is expected to be 16 bytes.");
+        size_t size = sizeof(detail::LogRecordHeader);
+        for (size_t i = 0; i < count; ++i) {
+            size += arguments[i].encodedSize();
+        }
+        ByteSpan span = ring->buffer.write(size);
+        if (span.empty()) {
+            if (size > ring->buffer.max_record() || count > MaxArguments ||
+                overflow_.load(std::memory_order_relaxed) == LogOverflow::Drop) {
+                ring->drop();
+                return;
+            }
+            while ((span = ring->buffer.write(size)).empty()) {
+                if (!enabled(level)) {
+                    ring->drop();
+                    return;
+                }
+                wake_.notify_one();
+                std::this_thread::yield();
+            }
+        }
+        // Announced before the stamp is taken; see drainLocked().
+        ring->writing.store(Stamping, std::memory_order_seq_cst);
+        const std::uint64_t ticks = TscClock::ticks();
+        ring->writing.store(ticks, std::memory_order_relaxed);
+        const detail::LogRecordHeader header{ticks, format, level, static_cast<std::uint8_t>(count)};
+        std::memcpy(span.data(), &header, sizeof(header));
+        std::byte* out = span.data() + sizeof(header);
+        for (size_t i = 0; i < count; ++i) {
+            out = arguments[i].encode(out);
+        }
+        ring->buffer.commit();
+        ring->writing.store(0, std::memory_order_release);
+    }
+
+    void run() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (!stopping_) {
+            // A pass cut short goes again at once.
+            if (!drainLocked()) {
+                wake_.wait_for(lock, options_.flushPeriod);
+            }
+        }
+        while (drainLocked()) {
+        }
+    }
+
+    // One pass: formats up to PassRecords records, oldest first across the
+    // rings, and hands them to the sink. True if records were left over.
+    //
+    // Only records stamped before a horizon go out: the pass's start, or the
+    // stamp of a record some thread is still writing if that is earlier.
+    // Everything stamped before it is committed already, so a thread cut
+    // off between taking its stamp and committing cannot have later records
+    // of other threads written out ahead of its own.
+    bool drainLocked() {
+        const std::vector<bool> finished = rings_.finished();
+        std::uint64_t horizon = TscClock::ticks();
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        bool writing = false;
+        for (const auto& ring : rings_) {
+            std::uint64_t stamp;
+            while ((stamp = ring->writing.load(std::memory_order_seq_cst)) == Stamping) {
+                std::this_thread::yield();
+            }
+            if (stamp != 0 && stamp < horizon) {
+                horizon = stamp;
+                writing = true;
+            }
+        }
+        size_t records = 0;
+        bool more = false;
+        for (;;) {
+            Ring* oldest = nullptr;
+            ByteSpan record;
+            std::uint64_t oldestTicks = 0;
+            for (const auto& ring : rings_) {
+                const ByteSpan span = ring->buffer.read();
+                if (!span.empty()) {
+                    std::uint64_t ticks;
+                    std::memcpy(&ticks, span.data(), sizeof(ticks));
+                    if (oldest == nullptr || ticks < oldestTicks) {
+                        oldest = ring.get();
+                        record = span;
+                        oldestTicks = ticks;
+                    }
+                }
+            }
+            if (oldest == nullptr) {
+                break;
+            }
+            if (oldestTicks >= horizon) {
+                // Left for the next pass, which comes at once.
+                more = true;
+                if (writing) {
+                    std::this_thread::yield();
+                }
+                break;
+            }
+            if (records == PassRecords) {
+                more = true;
+                break;
+            }
+            format(*oldest, record);
+            oldest->buffer.consume();
+            ++records;
+            if (batch_.size() >= options_.batchBytes) {
+                flushBatch();
+            }
+        }
+        flushBatch();
+        stats_.written += records;
+        stats_.dropped += rings_.reap(finished, [](const Ring& ring) { return ring.buffer.empty(); });
+        return more;
+    }
+
+    void flushBatch() {
+        if (!batch_.empty()) {
+            sink_(batch_.data(), batch_.size());
+            batch_.clear();
+            ++stats_.batches;
+        }
+    }
+
+    void format(const Ring& ring, ByteSpan record) {
+        detail::LogRecordHeader header;
+        std::memcpy(&header, record.data(), sizeof(header));
+        const std::byte* in = record.data() + sizeof(header);
+        StringPool& pool = StringPool::instance();
+
+        const double elapsed = static_cast<double>(static_cast<std::int64_t>(header.ticks - startTicks_)) / ticksPerNanosecond_;
+        detail::appendLogTime(batch_, startTime_ + static_cast<std::int64_t>(elapsed));
+        batch_ += ' ';
+        batch_ += levelName(header.level);
+        batch_ += " [";
+        detail::appendLogNumber(batch_, ring.thread, false);
+        batch_ += "] ";
+
+        const std::string_view text = pool.symbolView(header.format);
+        size_t next = 0;
+        for (std::uint8_t i = 0; i < header.arguments; ++i) {
+            const size_t placeholder = std::min(text.find("{}", next), text.size());
+            batch_.append(text.data() + next, placeholder - next);
+            next = std::min(placeholder + 2, text.size());
+            const auto type = static_cast<detail::LogArg>(*in++);
+            switch (type) {
+            case detail::LogArg::Boolean:
+                batch_ += *in++ != std::byte(0) ? "true" : "false";
+                break;
+            case detail::LogArg::Character:
+                batch_ += static_cast<char>(*in++);
+                break;
+            case detail::LogArg::Handle: {
+                std::uint32_t handle;
+                std::memcpy(&handle, in, sizeof(handle));
+                in += sizeof(handle);
+                if (handle != 0) {
+                    batch_ += pool.symbolView(handle - 1);
+                }
+                break;
+            }
+            case detail::LogArg::Text: {
+                std::uint32_t length;
+                std::memcpy(&length, in, sizeof(length));
+                batch_.append(reinterpret_cast<const char*>(in + sizeof(length)), length);
+                in += sizeof(length) + length;
+                break;
+            }
+            default: {
+                std::uint64_t bits;
+                std::memcpy(&bits, in, sizeof(bits));
+                in += sizeof(bits);
+                if (type == detail::LogArg::Floating) {
+                    double value;
+                    std::memcpy(&value, &bits, sizeof(value));
+                    detail::appendLogFloating(batch_, value);
+                } else if (type == detail::LogArg::Signed && static_cast<std::int64_t>(bits) < 0) {
+                    detail::appendLogNumber(batch_, ~bits + 1, true);
+                } else {
+                    detail::appendLogNumber(batch_, bits, false);
+                }
+            }
+            }
+        }
+        batch_.append(text.data() + next, text.size() - next);
+        batch_ += '\n';
+    }
+
+    AsyncLogger() = default;
+
+    std::atomic<LogLevel> threshold_{LogLevel::Off};
+    std::atomic<LogOverflow> overflow_{LogOverflow::Drop};
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    bool stopping_ = false;
+    std::thread writer_;
+    LogSink sink_;
+    LogOptions options_;
+    LogStats stats_;
+    detail::ThreadRings<Ring> rings_;
+    std::string batch_;
+    std::uint64_t startTicks_ = 0;
+    std::int64_t startTime_ = 0;
+    double ticksPerNanosecond_ = 1.0;
+};
+
+// The interned format of a literal, once per use site, typed with its
+// number of placeholders.
+#define CPPUTILS_LOG_FORMAT(literal)                                                         \
+    ([]() {                                                                                  \
+        constexpr size_t cpputils_placeholders = detail::logPlaceholders(literal);           \
+        static const std::uint32_t cpputils_format = StringPool::instance().symbolId(literal); \
+        return LogFormat<cpputils_placeholders>{cpputils_format};                             \
+    }())
+#define CPPUTILS_LOG_FIRST_(first, ...) first
+
+// CPPUTILS_LOG(LogLevel::Info, "filled {} @ {}", quantity, price). The
+// arguments are only evaluated if the level is enabled.
+#define CPPUTILS_LOG(level, ...)                                                                    \
+    (AsyncLogger::instance().enabled(level)                                                         \
+         ? AsyncLogger::instance().log((level), CPPUTILS_LOG_FORMAT(CPPUTILS_LOG_FIRST_(__VA_ARGS__, 0)), \
+                                       __VA_ARGS__)                                                 \
+         : static_cast<void>(0))
+#define CPPUTILS_LOG_DEBUG(...) CPPUTILS_LOG(LogLevel::Debug, __VA_ARGS__)
+#define CPPUTILS_LOG_INFO(...) CPPUTILS_LOG(LogLevel::Info, __VA_ARGS__)
+#define CPPUTILS_LOG_WARNING(...) CPPUTILS_LOG(LogLevel::Warning, __VA_ARGS__)
+#define CPPUTILS_LOG_ERROR(...) CPPUTILS_LOG(LogLevel::Error, __VA_ARGS__)
+
+#endif // ASYNC_LOGGER_H
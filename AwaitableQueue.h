@@ -0,0 +1,161 @@
+#ifndef AWAITABLE_QUEUE_H
+#define AWAITABLE_QUEUE_H
+
+// Coroutine front-end for SPSCQueue. Needs C++20; configure with
+// -DCPPUTILS_CXX20=ON. Under older standards this header is empty.
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+
+#include "Queue.h"
+
+#include <atomic>
+#include <coroutine>
+#include <optional>
+#include <utility>
+
+// SPSCQueue whose consumer can `T v = co_await q.pop();` and whose producer
+// can `co_await q.push(v);` while the ring is full. A side that has to wait
+// parks its coroutine handle in the queue; the other side resumes it inline,
+// on its own thread, right after the operation that made progress possible.
+// Resumption is not per item: a resumed consumer keeps popping without
+// suspending until the ring is empty again, and while nobody is parked each
+// operation only pays a fence and one load.
+//
+// try_push/try_pop are for a side that is not a coroutine (e.g. a feed
+// thread) and resume a parked peer the same way.
+template<typename T, size_t Capacity = DynamicCapacity, typename Traits = QueueTraits>
+class AwaitableSPSCQueue {
+public:
+    using queue_type = SPSCQueue<T, Capacity, Traits>;
+
+    explicit AwaitableSPSCQueue(size_t capacity = Capacity) : queue(capacity) {}
+
+    AwaitableSPSCQueue(const AwaitableSPSCQueue&) = delete;
+    AwaitableSPSCQueue& operator=(const AwaitableSPSCQueue&) = delete;
+
+    class PopAwaiter {
+    public:
+        bool await_ready() {
+            result = owner.queue.try_pop();
+            return result.has_value();
+        }
+
+        bool await_suspend(std::coroutine_handle<> handle) {
+            return owner.park(owner.consumer, handle, [this] {
+                result = owner.queue.try_pop();
+                return result.has_value();
+            });
+        }
+
+        // Only the producer resumes a parked consumer, and only after an
+        // enqueue, so the ring cannot be empty here.
+        T await_resume() {
+            if (!result) {
+                result = owner.queue.try_pop();
+            }
+            owner.resume(owner.producer);
+            return std::move(*result);
+        }
+
+    private:
+        friend class AwaitableSPSCQueue;
+        explicit PopAwaiter(AwaitableSPSCQueue& owner) : owner(owner) {}
+
+        AwaitableSPSCQueue& owner;
+        std::optional<T> result;
+    };
+
+    class PushAwaiter {
+    public:
+        bool await_ready() {
+            done = owner.queue.enqueue(std::move(value));
+            return done;
+        }
+
+        bool await_suspend(std::coroutine_handle<> handle) {
+            return owner.park(owner.producer, handle, [this] { return done = owner.queue.enqueue(std::move(value)); });
+        }
+
+        // Mirror of PopAwaiter::await_resume: a parked producer is only
+        // resumed after a dequeue freed a slot.
+        void await_resume() {
+            if (!done) {
+                owner.queue.enqueue(std::move(value));
+            }
+            owner.resume(owner.consumer);
+        }
+
+    private:
+        friend class AwaitableSPSCQueue;
+        PushAwaiter(AwaitableSPSCQueue& owner, T value) : owner(owner), value(std::move(value)) {}
+
+        AwaitableSPSCQueue& owner;
+        T value;
+        bool done = false;
+    };
+
+    PopAwaiter pop() {
+        return PopAwaiter(*this);
+    }
+
+    PushAwaiter push(T value) {
+        return PushAwaiter(*this, std::move(value));
+    }
+
+    bool try_push(T value) {
+        if (!queue.enqueue(std::move(value))) {
+            return false;
+        }
+        resume(consumer);
+        return true;
+    }
+
+    std::optional<T> try_pop() {
+        std::optional<T> result = queue.try_pop();
+        if (result) {
+            resume(producer);
+        }
+        return result;
+    }
+
+    bool empty() const {
+        return queue.empty();
+    }
+
+    size_t capacity() const {
+        return queue.capacity();
+    }
+
+private:
+    // Publishes handle, then retries once: either the retry succeeds, or the
+    // other side's resume() is guaranteed to see the handle. Returns whether
+    // the coroutine stays suspended.
+    template<typename Attempt>
+    static bool park(std::atomic<void*>& slot, std::coroutine_handle<> handle, Attempt&& attempt) {
+        slot.store(handle.address(), std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (!attempt()) {
+            return true;
+        }
+        // Made progress after all. If the other side already took the
+        // handle it is resuming us, so stay suspended and let it.
+        return slot.exchange(nullptr, std::memory_order_acq_rel) == nullptr;
+    }
+
+    static void resume(std::atomic<void*>& slot) {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (slot.load(std::memory_order_relaxed) == nullptr) {
+            return;
+        }
+        if (void* address = slot.exchange(nullptr, std::memory_order_acq_rel)) {
+            std::coroutine_handle<>::from_address(address).resume();
+        }
+    }
+
+    queue_type queue;
+    alignas(CACHE_LINE_SIZE) std::atomic<void*> consumer{nullptr};
+    alignas(CACHE_LINE_SIZE) std::atomic<void*> producer{nullptr};
+};
+
+#endif // __cpp_impl_coroutine
+
+#endif // AWAITABLE_QUEUE_H
@@ -0,0 +1,58 @@
+#ifndef BACKOFF_H
+#define BACKOFF_H
+
+#include "WaitStrategy.h"
+
+#include <algorithm>
+#include <thread>
+
+// Backoff policies decide what a CAS loop does after losing a race, before
+// it reloads and tries again. A fresh policy object is made for each
+// operation and provides:
+//
+//   void pause();
+//
+// called once per failed compare_exchange. Losing means another thread just
+// wrote the line; retrying at once only adds to the traffic on it, so under
+// heavy contention backing off lets the winners get through.
+
+// Retries immediately: the cheapest choice without contention, and what the
+// queues did before the policy existed.
+struct NoBackoff {
+    void pause() {}
+};
+
+// One PAUSE (YIELD on ARM) per lost race.
+struct SpinBackoff {
+    void pause() {
+        cpuRelax();
+    }
+};
+
+// Doubles the number of pauses after every lost race, from MinSpins up to
+// MaxSpins, so the retries of many contending threads spread out in time.
+template<unsigned MinSpins = 1, unsigned MaxSpins = 1024>
+struct BasicExponentialBackoff {
+    static_assert(MinSpins >= 1 && MinSpins <= MaxSpins, "ExponentialBackoff needs 1 <= MinSpins <= MaxSpins.");
+
+    void pause() {
+        for (unsigned i = 0; i < spins; ++i) {
+            cpuRelax();
+        }
+        spins = std::min(spins * 2, MaxSpins);
+    }
+
+    unsigned spins = MinSpins;
+};
+
+using ExponentialBackoff = BasicExponentialBackoff<>;
+
+// Gives the core away after each lost race; for oversubscribed machines,
+// where the winner may be waiting for our core.
+struct YieldBackoff {
+    void pause() {
+        std::this_thread::yield();
+    }
+};
+
+#endif // BACKOFF_H
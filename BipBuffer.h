@@ -0,0 +1,199 @@
+#ifndef BIP_BUFFER_H
+#define BIP_BUFFER_H
+
+#include "Queue.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+
+// A contiguous run of bytes inside a BipBuffer. Empty (data() == nullptr)
+// when the operation that produced it could not be satisfied.
+class ByteSpan {
+public:
+    ByteSpan() = default;
+    ByteSpan(std::byte* data, size_t size) : ptr(data), len(size) {}
+
+    std::byte* data() const { return ptr; }
+    size_t size() const { return len; }
+    bool empty() const { return len == 0; }
+    std::byte* begin() const { return ptr; }
+    std::byte* end() const { return ptr + len; }
+
+private:
+    std::byte* ptr = nullptr;
+    size_t len = 0;
+};
+
+// Single-producer/single-consumer ring of variable-length records. Each
+// record is an 8-byte length header followed by its payload, padded to a
+// multiple of 8 so headers and payloads stay aligned. A record never straddles
+// the end of the buffer: when it does not fit in the space left before the
+// end, the producer leaves a padding marker and starts at offset zero
+// instead, so both sides always get one contiguous span.
+//
+// Positions are free-running byte counters, as in SPMCQueue; offsets are
+// taken with the mask. Capacity is in bytes and must be a power of two.
+template<typename Traits = QueueTraits>
+class BipBuffer {
+public:
+    using allocator_type = typename Traits::allocator;
+
+    static constexpr size_t HeaderSize = 8;
+    static constexpr size_t RecordAlignment = 8;
+
+    explicit BipBuffer(size_t capacity, const allocator_type& allocator = allocator_type())
+        : allocator(allocator), mask(capacity - 1) {
+        checkCapacity(capacity, DynamicCapacity);
+        if (capacity < 2 * HeaderSize) {
+            throw std::invalid_argument("BipBuffer capacity must be at least 16 bytes.");
+        }
+        data = static_cast<std::byte*>(this->allocator.allocate(capacity, CACHE_LINE_SIZE));
+        head.store(0, std::memory_order_relaxed);
+        tail.store(0, std::memory_order_relaxed);
+    }
+
+    ~BipBuffer() {
+        allocator.deallocate(data, mask + 1, CACHE_LINE_SIZE);
+    }
+
+    BipBuffer(const BipBuffer&) = delete;
+    BipBuffer& operator=(const BipBuffer&) = delete;
+
+    // Producer: reserves room for a record of len bytes and returns its
+    // payload, or an empty span when there is not enough contiguous space
+    // right now. Serialise into the span, then commit().
+    ByteSpan write(size_t len) {
+        const size_t need = recordSize(len);
+        if (len == 0 || len > MaxLength || need > mask + 1) {
+            return ByteSpan();
+        }
+        const std::uint64_t currentTail = tail.load(std::memory_order_relaxed);
+        const size_t offset = static_cast<size_t>(currentTail & mask);
+        const size_t skip = offset + need > mask + 1 ? mask + 1 - offset : 0;
+        if (!fits(currentTail, skip + need)) {
+            cachedHead = head.load(std::memory_order_acquire);
+            if (!fits(currentTail, skip + need)) {
+                return ByteSpan();
+            }
+        }
+        pendingSkip = skip;
+        pendingLength = len;
+        return ByteSpan(data + ((offset + skip) & mask) + HeaderSize, len);
+    }
+
+    // Publishes the record from the last write(). used may be smaller than
+    // the length reserved, for encoders that reserve their worst case, but
+    // must not be zero.
+    void commit(size_t used) {
+        const std::uint64_t currentTail = tail.load(std::memory_order_relaxed);
+        if (pendingSkip != 0) {
+            storeHeader(static_cast<size_t>(currentTail & mask), WrapMarker);
+        }
+        const std::uint64_t start = currentTail + pendingSkip;
+        storeHeader(static_cast<size_t>(start & mask), static_cast<std::uint32_t>(used));
+        tail.store(start + recordSize(used), std::memory_order_release);
+        pendingSkip = 0;
+    }
+
+    void commit() {
+        commit(pendingLength);
+    }
+
+    // Copies a whole record in; returns false when it does not fit.
+    bool push(const void* payload, size_t len) {
+        ByteSpan span = write(len);
+        if (span.empty()) {
+            return false;
+        }
+        std::memcpy(span.data(), payload, len);
+        commit();
+        return true;
+    }
+
+    // Consumer: returns the oldest record's payload in place, or an empty
+    // span when there is none. consume() hands its bytes back.
+    ByteSpan read() {
+        std::uint64_t currentHead = head.load(std::memory_order_relaxed);
+        if (currentHead == cachedTail) {
+            cachedTail = tail.load(std::memory_order_acquire);
+            if (currentHead == cachedTail) {
+                return ByteSpan();
+            }
+        }
+        size_t offset = static_cast<size_t>(currentHead & mask);
+        std::uint32_t len = loadHeader(offset);
+        if (len == WrapMarker) {
+            currentHead += mask + 1 - offset;
+            head.store(currentHead, std::memory_order_release);
+            offset = 0;
+            len = loadHeader(0);
+        }
+        return ByteSpan(data + offset + HeaderSize, len);
+    }
+
+    // Releases the record returned by the last read().
+    void consume() {
+        const std::uint64_t currentHead = head.load(std::memory_order_relaxed);
+        const std::uint32_t len = loadHeader(static_cast<size_t>(currentHead & mask));
+        head.store(currentHead + recordSize(len), std::memory_order_release);
+    }
+
+    bool empty() const {
+        return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire);
+    }
+
+    // Bytes in use, including headers and padding.
+    size_t size() const {
+        const std::uint64_t currentHead = head.load(std::memory_order_acquire);
+        const std::uint64_t currentTail = tail.load(std::memory_order_acquire);
+        return static_cast<size_t>(currentTail - currentHead);
+    }
+
+    size_t capacity() const {
+        return mask + 1;
+    }
+
+    // The largest record that can ever be written.
+    size_t max_record() const {
+        return mask + 1 - HeaderSize;
+    }
+
+private:
+    static constexpr std::uint32_t WrapMarker = 0xffffffffu;
+    static constexpr size_t MaxLength = WrapMarker - 1;
+
+    static size_t recordSize(size_t len) {
+        return (HeaderSize + len + RecordAlignment - 1) & ~(RecordAlignment - 1);
+    }
+
+    bool fits(std::uint64_t currentTail, size_t bytes) const {
+        return currentTail - cachedHead + bytes <= mask + 1;
+    }
+
+    void storeHeader(size_t offset, std::uint32_t len) {
+        std::memcpy(data + offset, &len, sizeof(len));
+    }
+
+    std::uint32_t loadHeader(size_t offset) const {
+        std::uint32_t len;
+        std::memcpy(&len, data + offset, sizeof(len));
+        return len;
+    }
+
+    allocator_type allocator;
+    std::byte* data;
+    size_t mask;
+
+    alignas(CACHE_LINE_SIZE) std::atomic<std::uint64_t> head;
+    std::uint64_t cachedTail = 0;
+
+    alignas(CACHE_LINE_SIZE) std::atomic<std::uint64_t> tail;
+    std::uint64_t cachedHead = 0;
+    size_t pendingSkip = 0;
+    size_t pendingLength = 0;
+};
+
+#endif // BIP_BUFFER_H
@@ -0,0 +1,219 @@
+#ifndef BROADCAST_RING_H
+#define BROADCAST_RING_H
+
+#include "Queue.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <initializer_list>
+#include <limits>
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+
+// Single-producer ring in which every reader sees every element, after the
+// LMAX disruptor. Entries are constructed once up front and overwritten in
+// place; each reader has its own sequence cursor and the producer only
+// reuses an entry once every reader has moved past it. Readers can be
+// chained: a reader subscribed with dependencies only sees what all of them
+// have already processed, so e.g. persistence can run strictly behind risk
+// checks without a second copy of the stream.
+//
+// Subscribe every reader before the producer starts publishing. T must be
+// default constructible and assignable.
+template<typename T, size_t Capacity = DynamicCapacity, typename Traits = QueueTraits>
+class BroadcastRing {
+public:
+    using allocator_type = typename Traits::allocator;
+
+    class Reader {
+    public:
+        Reader(const Reader&) = delete;
+        Reader& operator=(const Reader&) = delete;
+
+        // Calls handler(const T&) for up to max available elements and then
+        // releases them all with one store. Returns how many were handled.
+        template<typename Handler>
+        size_t poll(Handler&& handler, size_t max = std::numeric_limits<size_t>::max()) {
+            const std::uint64_t current = cursor.load(std::memory_order_relaxed);
+            const size_t count = static_cast<size_t>(std::min<std::uint64_t>(available(current), max));
+            for (size_t i = 0; i < count; ++i) {
+                handler(static_cast<const T&>(ring.entries[(current + i) & ring.mask]));
+            }
+            if (count != 0) {
+                advance(current + count);
+            }
+            return count;
+        }
+
+        bool try_read(T& result) {
+            return poll([&result](const T& value) { result = value; }, 1) == 1;
+        }
+
+        void read(T& result) {
+            ring.waiter.wait([&] { return try_read(result); });
+        }
+
+        template<typename Rep, typename Period>
+        bool try_read_for(T& result, const std::chrono::duration<Rep, Period>& timeout) {
+            return ring.waiter.waitUntil([&] { return try_read(result); }, std::chrono::steady_clock::now() + timeout);
+        }
+
+        // Sequence number of the next element this reader will see.
+        std::uint64_t position() const {
+            return cursor.load(std::memory_order_acquire);
+        }
+
+    private:
+        friend class BroadcastRing;
+
+        Reader(BroadcastRing& ring, std::vector<const Reader*> dependencies, std::uint64_t start)
+            : ring(ring), dependencies(std::move(dependencies)), cachedLimit(start) {
+            cursor.store(start, std::memory_order_relaxed);
+        }
+
+        std::uint64_t available(std::uint64_t current) {
+            if (current == cachedLimit) {
+                cachedLimit = limit();
+            }
+            return cachedLimit - current;
+        }
+
+        // The producer's published sequence, or the slowest dependency.
+        std::uint64_t limit() const {
+            std::uint64_t bound = ring.tail.load(std::memory_order_acquire);
+            for (const Reader* dependency : dependencies) {
+                bound = std::min(bound, dependency->cursor.load(std::memory_order_acquire));
+            }
+            return bound;
+        }
+
+        void advance(std::uint64_t next) {
+            cursor.store(next, std::memory_order_release);
+            // Wakes a producer waiting for room and readers chained behind
+            // this one.
+            ring.waiter.notify(std::numeric_limits<size_t>::max());
+        }
+
+        BroadcastRing& ring;
+        const std::vector<const Reader*> dependencies;
+        std::uint64_t cachedLimit;
+        alignas(CACHE_LINE_SIZE) std::atomic<std::uint64_t> cursor;
+    };
+
+    explicit BroadcastRing(const allocator_type& allocator = allocator_type())
+        : BroadcastRing(Capacity, allocator) {}
+
+    explicit BroadcastRing(size_t capacity, const allocator_type& allocator = allocator_type())
+        : allocator(allocator), mask(capacity - 1) {
+        checkCapacity(capacity, Capacity);
+        entries = allocateSlots<T>(this->allocator, capacity);
+        size_t constructed = 0;
+        try {
+            for (; constructed < capacity; ++constructed) {
+                new (entries + constructed) T();
+            }
+        } catch (...) {
+            std::destroy(entries, entries + constructed);
+            deallocateSlots(this->allocator, entries, capacity);
+            throw;
+        }
+        tail.store(0, std::memory_order_relaxed);
+    }
+
+    ~BroadcastRing() {
+        std::destroy(entries, entries + mask + 1);
+        deallocateSlots(allocator, entries, mask + 1);
+    }
+
+    BroadcastRing(const BroadcastRing&) = delete;
+    BroadcastRing& operator=(const BroadcastRing&) = delete;
+
+    // Adds a reader that sees every element published from now on, once all
+    // of dependencies have processed it. The ring owns the reader.
+    Reader& subscribe(std::initializer_list<const Reader*> dependencies = {}) {
+        readers.emplace_back(new Reader(*this, std::vector<const Reader*>(dependencies),
+                                        tail.load(std::memory_order_relaxed)));
+        Reader* reader = readers.back().get();
+        // A dependency is never ahead of its dependents, so the producer only
+        // needs to gate on the ends of the chains.
+        for (const Reader* dependency : dependencies) {
+            gating.erase(std::remove(gating.begin(), gating.end(), dependency), gating.end());
+        }
+        gating.push_back(reader);
+        cachedMin = tail.load(std::memory_order_relaxed);
+        return *reader;
+    }
+
+    // Zero-copy producer side: returns the next entry to overwrite in place,
+    // or nullptr while the slowest reader is a full ring behind. publish()
+    // makes it visible.
+    T* try_claim() {
+        const std::uint64_t current = tail.load(std::memory_order_relaxed);
+        if (current - cachedMin > mask) {
+            cachedMin = slowest(current);
+            if (current - cachedMin > mask) {
+                return nullptr;
+            }
+        }
+        return entries + (current & mask);
+    }
+
+    void publish() {
+        tail.store(tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+        waiter.notify(std::numeric_limits<size_t>::max());
+    }
+
+    template<typename U>
+    bool try_publish(U&& value) {
+        T* entry = try_claim();
+        if (entry == nullptr) {
+            return false;
+        }
+        *entry = std::forward<U>(value);
+        publish();
+        return true;
+    }
+
+    // Blocks while the slowest reader is a full ring behind.
+    template<typename U>
+    void publish(U&& value) {
+        T* entry = nullptr;
+        waiter.wait([&] { return (entry = try_claim()) != nullptr; });
+        *entry = std::forward<U>(value);
+        publish();
+    }
+
+    // Sequence number the next published element will get.
+    std::uint64_t position() const {
+        return tail.load(std::memory_order_acquire);
+    }
+
+    size_t capacity() const {
+        return mask + 1;
+    }
+
+private:
+    std::uint64_t slowest(std::uint64_t current) const {
+        std::uint64_t bound = current;
+        for (const Reader* reader : gating) {
+            bound = std::min(bound, reader->cursor.load(std::memory_order_acquire));
+        }
+        return bound;
+    }
+
+    allocator_type allocator;
+    T* entries;
+    size_t mask;
+    std::vector<std::unique_ptr<Reader>> readers;
+    std::vector<const Reader*> gating;
+
+    alignas(CACHE_LINE_SIZE) std::atomic<std::uint64_t> tail;
+    std::uint64_t cachedMin = 0;
+    alignas(CACHE_LINE_SIZE) typename Traits::wait_strategy waiter;
+};
+
+#endif // BROADCAST_RING_H
@@ -0,0 +1,88 @@
+#ifndef CONCURRENCY_H
+#define CONCURRENCY_H
+
+#include <atomic>
+
+// Concurrency policies pick the type the rings keep their indices and slot
+// flags in. Each one provides
+//
+//   template<typename V> using atomic = ...;
+//
+// with the subset of the std::atomic interface the queues use.
+
+// The default: real atomics, safe across threads.
+struct ThreadSafe {
+    template<typename V>
+    using atomic = std::atomic<V>;
+};
+
+// Drop-in for std::atomic that is an ordinary variable: memory orders are
+// ignored and nothing is fenced, so the optimiser may keep values in
+// registers and merge accesses. Only for objects that a single thread uses.
+template<typename V>
+class PlainAtomic {
+public:
+    PlainAtomic() = default;
+    constexpr PlainAtomic(V value) : value(value) {}
+
+    PlainAtomic(const PlainAtomic&) = delete;
+    PlainAtomic& operator=(const PlainAtomic&) = delete;
+
+    V load(std::memory_order = std::memory_order_seq_cst) const {
+        return value;
+    }
+
+    void store(V desired, std::memory_order = std::memory_order_seq_cst) {
+        value = desired;
+    }
+
+    V exchange(V desired, std::memory_order = std::memory_order_seq_cst) {
+        const V previous = value;
+        value = desired;
+        return previous;
+    }
+
+    bool compare_exchange_strong(V& expected, V desired, std::memory_order = std::memory_order_seq_cst,
+                                 std::memory_order = std::memory_order_seq_cst) {
+        if (value == expected) {
+            value = desired;
+            return true;
+        }
+        expected = value;
+        return false;
+    }
+
+    bool compare_exchange_weak(V& expected, V desired, std::memory_order success = std::memory_order_seq_cst,
+                               std::memory_order failure = std::memory_order_seq_cst) {
+        return compare_exchange_strong(expected, desired, success, failure);
+    }
+
+    V fetch_add(V delta, std::memory_order = std::memory_order_seq_cst) {
+        const V previous = value;
+        value += delta;
+        return previous;
+    }
+
+    V fetch_sub(V delta, std::memory_order = std::memory_order_seq_cst) {
+        const V previous = value;
+        value -= delta;
+        return previous;
+    }
+
+    operator V() const {
+        return value;
+    }
+
+private:
+    V value;
+};
+
+// For deterministic single-threaded runs (backtest replay) of code written
+// against the concurrent queues: the same templates compile to a plain ring
+// buffer. Producer and consumer must then be the same thread.
+struct SingleThreaded {
+    template<typename V>
+    using atomic = PlainAtomic<V>;
+};
+
+#endif // CONCURRENCY_H
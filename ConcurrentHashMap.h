@@ -0,0 +1,458 @@
+#ifndef CONCURRENT_HASH_MAP_H
+#define CONCURRENT_HASH_MAP_H
+
+#include "Reclaim.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <stdexcept>
+#include <utility>
+
+namespace detail {
+
+// Murmur3's finaliser: std::hash of an integer is often the integer itself,
+// and the map takes slots from the low bits and shards from the high ones.
+inline std::uint64_t concurrentMapMix(std::uint64_t h) {
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdull;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ull;
+    h ^= h >> 33;
+    return h;
+}
+
+} // namespace detail
+
+// Concurrent hash map built like StringPool's tables: Shards independent
+// open-addressing tables picked by the hash's high bits, each with a mutex
+// its writers take, and readers that take no lock at all. Slots hold
+// pointers to immutable entries; a write publishes a new entry with one
+// store and retires the one it replaced through an EpochDomain, and a
+// reader probes inside an epoch guard, so it always sees a whole entry.
+//
+// Growing a shard does not stop it. Its writer allocates a table twice the
+// live size and makes it current, and every later write to the shard first
+// moves a few slots from the old table across, leaving tombstones behind.
+// Meanwhile reads and writes look in the old table before the new one. The
+// new table is sized so that the move always ends before it fills up.
+//
+// find() copies the value out and visit() runs a callback on it inside the
+// guard; neither hands out references, which would outlive the entry. V
+// must be copy constructible.
+template<typename K, typename V, typename Hash = std::hash<K>, size_t Shards = 16>
+class ConcurrentHashMap {
+    static_assert(Shards > 0 && (Shards & (Shards - 1)) == 0, "ConcurrentHashMap needs a power-of-two shard count.");
+
+public:
+    using key_type = K;
+    using mapped_type = V;
+
+    explicit ConcurrentHashMap(size_t expected = 0, const Hash& hash = Hash()) : hash_(hash) {
+        size_t capacity = InitialCapacity;
+        while (capacity * 3 < expected * 4 / Shards) {
+            capacity <<= 1;
+        }
+        for (Shard& shard : shards_) {
+            shard.current.store(new Table(capacity), std::memory_order_relaxed);
+        }
+    }
+
+    // No other thread may still be using the map.
+    ~ConcurrentHashMap() {
+        for (Shard& shard : shards_) {
+            if (Table* old = shard.migrating.load(std::memory_order_relaxed)) {
+                deleteEntries(*old);
+                delete old;
+            }
+            Table* current = shard.current.load(std::memory_order_relaxed);
+            deleteEntries(*current);
+            delete current;
+        }
+    }
+
+    ConcurrentHashMap(const ConcurrentHashMap&) = delete;
+    ConcurrentHashMap& operator=(const ConcurrentHashMap&) = delete;
+
+    // Copies key's value to out; false if key is absent. Lock-free.
+    bool find(const K& key, V& out) const {
+        return visit(key, [&out](const V& value) { out = value; });
+    }
+
+    bool contains(const K& key) const {
+        return visit(key, [](const V&) {});
+    }
+
+    // Calls f(const V&) with key's value and returns true, or returns false
+    // if key is absent. f runs inside an epoch guard: keep it short, and do
+    // not write to this map from it.
+    template<typename F>
+    bool visit(const K& key, F&& f) const {
+        const std::uint64_t hash = hashOf(key);
+        const Shard& shard = shardFor(hash);
+        EpochDomain::Guard guard(epoch_);
+        if (!guard) {
+            // More threads than the domain has reader slots.
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            return visitEntry(findLocked(shard, hash, key).entry, f);
+        }
+        return visitEntry(findShared(shard, hash, key), f);
+    }
+
+    // Maps key to value; true if key was new.
+    bool insert_or_assign(const K& key, V value) {
+        return write(key, std::move(value), true);
+    }
+
+    // Maps key to value unless it already has one; true if key was new.
+    bool insert(const K& key, V value) {
+        return write(key, std::move(value), false);
+    }
+
+    // True if key was present.
+    bool erase(const K& key) {
+        const std::uint64_t hash = hashOf(key);
+        Shard& shard = shardFor(hash);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        migrateStep(shard);
+        const Slot found = findLocked(shard, hash, key);
+        if (found.entry == nullptr) {
+            return false;
+        }
+        found.table->slots[found.index].store(Tombstone, std::memory_order_release);
+        --found.table->live;
+        shard.size.store(shard.size.load(std::memory_order_relaxed) - 1, std::memory_order_relaxed);
+        epoch_.retire(found.entry);
+        return true;
+    }
+
+    // Erases every entry for which pred(const K&, const V&) is true, one
+    // shard at a time with its lock held; returns how many it erased.
+    template<typename Pred>
+    size_t erase_if(Pred pred) {
+        size_t erased = 0;
+        for (Shard& shard : shards_) {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            Table* tables[] = {shard.migrating.load(std::memory_order_relaxed), shard.current.load(std::memory_order_relaxed)};
+            for (Table* table : tables) {
+                if (table == nullptr) {
+                    continue;
+                }
+                for (size_t i = 0; i <= table->mask; ++i) {
+                    Entry* entry = entryOf(table->slots[i].load(std::memory_order_relaxed));
+                    if (entry != nullptr && pred(static_cast<const K&>(entry->key), static_cast<const V&>(entry->value))) {
+                        table->slots[i].store(Tombstone, std::memory_order_release);
+                        --table->live;
+                        shard.size.store(shard.size.load(std::memory_order_relaxed) - 1, std::memory_order_relaxed);
+                        epoch_.retire(entry);
+                        ++erased;
+                    }
+                }
+            }
+        }
+        return erased;
+    }
+
+    // Calls f(const K&, const V&) for every entry, one shard at a time with
+    // its lock held.
+    template<typename F>
+    void for_each(F&& f) const {
+        for (const Shard& shard : shards_) {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            const Table* tables[] = {shard.migrating.load(std::memory_order_relaxed), shard.current.load(std::memory_order_relaxed)};
+            for (const Table* table : tables) {
+                if (table == nullptr) {
+                    continue;
+                }
+                for (size_t i = 0; i <= table->mask; ++i) {
+                    if (const Entry* entry = entryOf(table->slots[i].load(std::memory_order_relaxed))) {
+                        f(static_cast<const K&>(entry->key), static_cast<const V&>(entry->value));
+                    }
+                }
+            }
+        }
+    }
+
+    void clear() {
+        erase_if([](const K&, const V&) { return true; });
+    }
+
+    // Exact when no writer is running.
+    size_t size() const {
+        size_t total = 0;
+        for (const Shard& shard : shards_) {
+            total += shard.size.load(std::memory_order_relaxed);
+        }
+        return total;
+    }
+
+    bool empty() const {
+        return size() == 0;
+    }
+
+    // Shards with a move to a bigger table in progress; for tests and
+    // monitoring.
+    size_t resizing() const {
+        size_t count = 0;
+        for (const Shard& shard : shards_) {
+            count += shard.migrating.load(std::memory_order_relaxed) != nullptr;
+        }
+        return count;
+    }
+
+private:
+    struct Entry {
+        std::uint64_t hash;
+        K key;
+        V value;
+    };
+
+    // A slot holds 0 when empty, an Entry pointer, or Tombstone once its
+    // entry was erased or moved to the next table. Probes pass over a
+    // tombstone without looking at what it replaced, whose entry may by now
+    // have been replaced in the next table and freed.
+    static constexpr std::uintptr_t Tombstone = 1;
+
+    static constexpr size_t InitialCapacity = 16;
+    // Old-table slots each write moves across while a shard grows.
+    static constexpr size_t MigrateStep = 16;
+
+    struct Table {
+        explicit Table(size_t capacity) : mask(capacity - 1), slots(new std::atomic<std::uintptr_t>[capacity]) {
+            for (size_t i = 0; i < capacity; ++i) {
+                slots[i].store(0, std::memory_order_relaxed);
+            }
+        }
+
+        ~Table() {
+            delete[] slots;
+        }
+
+        Table(const Table&) = delete;
+        Table& operator=(const Table&) = delete;
+
+        const size_t mask;
+        std::atomic<std::uintptr_t>* const slots;
+        // The table that replaced this one, set before it became current.
+        std::atomic<Table*> next{nullptr};
+        // Writer-side counts: live entries, and live plus tombstones.
+        size_t live = 0;
+        size_t used = 0;
+    };
+
+    struct alignas(64) Shard {
+        mutable std::mutex mutex;
+        std::atomic<Table*> current{nullptr};
+        // The table being moved out of, or nullptr.
+        std::atomic<Table*> migrating{nullptr};
+        // Next slot of migrating to move.
+        size_t cursor = 0;
+        std::atomic<size_t> size{0};
+    };
+
+    // Where findLocked() found a key.
+    struct Slot {
+        Table* table;
+        size_t index;
+        Entry* entry;
+    };
+
+    static Entry* entryOf(std::uintptr_t slot) {
+        return slot == Tombstone ? nullptr : reinterpret_cast<Entry*>(slot);
+    }
+
+    static std::uintptr_t slotOf(Entry* entry) {
+        return reinterpret_cast<std::uintptr_t>(entry);
+    }
+
+    template<typename F>
+    static bool visitEntry(const Entry* entry, F& f) {
+        if (entry == nullptr) {
+            return false;
+        }
+        f(static_cast<const V&>(entry->value));
+        return true;
+    }
+
+    static void deleteEntries(Table& table) {
+        for (size_t i = 0; i <= table.mask; ++i) {
+            delete entryOf(table.slots[i].load(std::memory_order_relaxed));
+        }
+    }
+
+    std::uint64_t hashOf(const K& key) const {
+        return detail::concurrentMapMix(static_cast<std::uint64_t>(hash_(key)));
+    }
+
+    // Slots come from the low bits, so the shard takes the high ones.
+    static size_t shardIndex(std::uint64_t hash) {
+        return Shards == 1 ? 0 : static_cast<size_t>(hash >> (64 - ShardBits));
+    }
+
+    Shard& shardFor(std::uint64_t hash) {
+        return shards_[shardIndex(hash)];
+    }
+
+    const Shard& shardFor(std::uint64_t hash) const {
+        return shards_[shardIndex(hash)];
+    }
+
+    // The index and entry of key in table, or {npos, nullptr} if key is not
+    // there.
+    static std::pair<size_t, Entry*> probe(const Table& table, std::uint64_t hash, const K& key) {
+        for (size_t i = hash & table.mask, n = 0; n <= table.mask; i = (i + 1) & table.mask, ++n) {
+            const std::uintptr_t slot = table.slots[i].load(std::memory_order_acquire);
+            if (slot == 0) {
+                break;
+            }
+            if (slot == Tombstone) {
+                continue;
+            }
+            Entry* entry = reinterpret_cast<Entry*>(slot);
+            if (entry->hash == hash && entry->key == key) {
+                return {i, entry};
+            }
+        }
+        return {static_cast<size_t>(-1), nullptr};
+    }
+
+    // Inside an epoch guard. Starts from the oldest table the key can be in
+    // and follows next: a key that is not in a table when we probe it,
+    // because it was never there or has moved on, can only be in a later
+    // one. A move places the entry in the next table before it leaves the
+    // tombstone we pass over.
+    const Entry* findShared(const Shard& shard, std::uint64_t hash, const K& key) const {
+        // current first: grow() publishes migrating before current, so the
+        // table being moved out of is either seen here or fully moved.
+        const Table* table = shard.current.load(std::memory_order_acquire);
+        const Table* old = shard.migrating.load(std::memory_order_acquire);
+        if (old != nullptr && old->next.load(std::memory_order_relaxed) == table) {
+            table = old;
+        }
+        while (table != nullptr) {
+            if (const Entry* entry = probe(*table, hash, key).second) {
+                return entry;
+            }
+            table = table->next.load(std::memory_order_acquire);
+        }
+        return nullptr;
+    }
+
+    // With the shard lock held: where key lives, the old table first.
+    static Slot findLocked(const Shard& shard, std::uint64_t hash, const K& key) {
+        Table* tables[] = {shard.migrating.load(std::memory_order_relaxed), shard.current.load(std::memory_order_relaxed)};
+        for (Table* table : tables) {
+            if (table == nullptr) {
+                continue;
+            }
+            const auto found = probe(*table, hash, key);
+            if (found.second != nullptr) {
+                return Slot{table, found.first, found.second};
+            }
+        }
+        return Slot{nullptr, 0, nullptr};
+    }
+
+    bool write(const K& key, V&& value, bool assign) {
+        const std::uint64_t hash = hashOf(key);
+        Shard& shard = shardFor(hash);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        migrateStep(shard);
+        const Slot found = findLocked(shard, hash, key);
+        if (found.entry != nullptr) {
+            if (assign) {
+                found.table->slots[found.index].store(slotOf(new Entry{hash, key, std::move(value)}), std::memory_order_release);
+                epoch_.retire(found.entry);
+            }
+            return false;
+        }
+        Table* current = shard.current.load(std::memory_order_relaxed);
+        if ((current->used + 1) * 4 > (current->mask + 1) * 3) {
+            current = grow(shard);
+        }
+        place(*current, new Entry{hash, key, std::move(value)});
+        shard.size.store(shard.size.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        return true;
+    }
+
+    // Writer: puts entry, whose key is in no table, into table.
+    static void place(Table& table, Entry* entry) {
+        for (size_t i = entry->hash & table.mask;; i = (i + 1) & table.mask) {
+            const std::uintptr_t slot = table.slots[i].load(std::memory_order_relaxed);
+            if (slot == 0 || slot == Tombstone) {
+                table.slots[i].store(slotOf(entry), std::memory_order_release);
+                ++table.live;
+                if (slot == 0) {
+                    ++table.used;
+                }
+                return;
+            }
+        }
+    }
+
+    // Writer: starts moving the shard into a table twice its live size.
+    // A move still in progress is finished first, which the table sizes
+    // make a safeguard rather than something that happens. Returns the new
+    // table.
+    Table* grow(Shard& shard) {
+        while (shard.migrating.load(std::memory_order_relaxed) != nullptr) {
+            migrateStep(shard);
+        }
+        Table* old = shard.current.load(std::memory_order_relaxed);
+        // At least half the old size as well: the move then ends, MigrateStep
+        // slots per write, before new keys can fill the table it moves into.
+        size_t capacity = std::max(InitialCapacity, (old->mask + 1) / 2);
+        while (capacity < (old->live + 1) * 2) {
+            capacity <<= 1;
+        }
+        Table* fresh = new Table(capacity);
+        old->next.store(fresh, std::memory_order_release);
+        shard.cursor = 0;
+        shard.migrating.store(old, std::memory_order_release);
+        shard.current.store(fresh, std::memory_order_release);
+        return fresh;
+    }
+
+    // Writer: moves up to MigrateStep slots of the old table, and retires it
+    // once all have moved.
+    void migrateStep(Shard& shard) {
+        Table* old = shard.migrating.load(std::memory_order_relaxed);
+        if (old == nullptr) {
+            return;
+        }
+        Table* current = shard.current.load(std::memory_order_relaxed);
+        const size_t end = std::min(shard.cursor + MigrateStep, old->mask + 1);
+        for (; shard.cursor < end; ++shard.cursor) {
+            if (Entry* entry = entryOf(old->slots[shard.cursor].load(std::memory_order_relaxed))) {
+                // Published in the new table before it leaves this one, so a
+                // reader that misses it here finds it there.
+                place(*current, entry);
+                old->slots[shard.cursor].store(Tombstone, std::memory_order_release);
+                --old->live;
+            }
+        }
+        if (shard.cursor > old->mask) {
+            shard.migrating.store(nullptr, std::memory_order_release);
+            epoch_.retire(old);
+        }
+    }
+
+    static constexpr unsigned shardBits() {
+        unsigned bits = 0;
+        while ((size_t(1) << bits) < Shards) {
+            ++bits;
+        }
+        return bits;
+    }
+
+    static constexpr unsigned ShardBits = shardBits();
+
+    Hash hash_;
+    mutable EpochDomain epoch_;
+    Shard shards_[Shards];
+};
+
+#endif // CONCURRENT_HASH_MAP_H
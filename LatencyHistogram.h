@@ -0,0 +1,180 @@
+#ifndef LATENCY_HISTOGRAM_H
+#define LATENCY_HISTOGRAM_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <limits>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#include <x86intrin.h>
+#define CPPUTILS_HAVE_RDTSC 1
+#endif
+
+// Cheap timestamps for latency recording: the TSC where available, otherwise
+// steady_clock nanoseconds. ticks() is a single rdtsc, so timing a hot path
+// costs a few nanoseconds; convert tick deltas to nanoseconds with
+// nanoseconds() when reporting, not on the path being measured. The
+// tick rate is calibrated against steady_clock once, on first use.
+//
+// Assumes an invariant TSC (constant_tsc/nonstop_tsc on every x86 CPU of the
+// last decade); deltas are only meaningful when both ends ran on cores with
+// synchronised TSCs, which holds on single-socket machines.
+class TscClock {
+public:
+    static std::uint64_t ticks() {
+#if defined(CPPUTILS_HAVE_RDTSC)
+        return __rdtsc();
+#else
+        return static_cast<std::uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+#endif
+    }
+
+    static double ticks_per_nanosecond() {
+        static const double rate = calibrate();
+        return rate;
+    }
+
+    static double nanoseconds(std::uint64_t ticks) {
+        return static_cast<double>(ticks) / ticks_per_nanosecond();
+    }
+
+private:
+    static double calibrate() {
+#if defined(CPPUTILS_HAVE_RDTSC)
+        using clock = std::chrono::steady_clock;
+        const auto start = clock::now();
+        const std::uint64_t first = ticks();
+        while (clock::now() - start < std::chrono::milliseconds(10)) {
+        }
+        const std::uint64_t last = ticks();
+        const double elapsed = std::chrono::duration<double, std::nano>(clock::now() - start).count();
+        return elapsed > 0 && last > first ? static_cast<double>(last - first) / elapsed : 1.0;
+#else
+        return 1.0;
+#endif
+    }
+};
+
+// Fixed-memory log-linear histogram in the style of HdrHistogram. Every
+// power-of-two range [2^k, 2^(k+1)) is split into 2^SubBucketBits equal
+// buckets, so a recorded value is off by at most 2^-SubBucketBits of itself
+// (under 1% for the default 7), and values below 2^(SubBucketBits + 1) are
+// exact. Values above 2^MaxValueBits - 1 are clamped to it. record() is a
+// count-leading-zeros and an increment, with no allocation.
+//
+// Instances are not thread-safe: keep one per thread and merge() them when
+// reporting. Units are whatever is recorded (TSC ticks, nanoseconds).
+template<unsigned SubBucketBits = 7, unsigned MaxValueBits = 40>
+class LatencyHistogram {
+    static_assert(SubBucketBits >= 1 && SubBucketBits < MaxValueBits && MaxValueBits <= 63,
+                  "LatencyHistogram needs 1 <= SubBucketBits < MaxValueBits <= 63.");
+
+public:
+    static constexpr std::uint64_t SubBuckets = std::uint64_t(1) << SubBucketBits;
+    static constexpr std::uint64_t MaxValue = (std::uint64_t(1) << MaxValueBits) - 1;
+    static constexpr size_t BucketCount = static_cast<size_t>((MaxValueBits - SubBucketBits + 1) * SubBuckets);
+
+    void record(std::uint64_t value, std::uint64_t count = 1) {
+        value = std::min(value, MaxValue);
+        counts[indexOf(value)] += count;
+        total += count;
+        minimum = std::min(minimum, value);
+        maximum = std::max(maximum, value);
+        sum += static_cast<double>(value) * static_cast<double>(count);
+    }
+
+    void merge(const LatencyHistogram& other) {
+        for (size_t i = 0; i < BucketCount; ++i) {
+            counts[i] += other.counts[i];
+        }
+        total += other.total;
+        minimum = std::min(minimum, other.minimum);
+        maximum = std::max(maximum, other.maximum);
+        sum += other.sum;
+    }
+
+    void reset() {
+        *this = LatencyHistogram();
+    }
+
+    // Smallest recorded value v such that at least percentile% of the
+    // recorded values are <= v, to the histogram's precision; exact at 0
+    // and 100. Returns 0 when empty.
+    std::uint64_t percentile(double percentile) const {
+        if (total == 0) {
+            return 0;
+        }
+        if (percentile <= 0) {
+            return minimum;
+        }
+        const double wanted = std::min(percentile, 100.0) / 100.0 * static_cast<double>(total);
+        const std::uint64_t rank = std::max<std::uint64_t>(1, static_cast<std::uint64_t>(wanted + 0.5));
+        std::uint64_t seen = 0;
+        for (size_t i = 0; i < BucketCount; ++i) {
+            seen += counts[i];
+            if (seen >= rank) {
+                return std::clamp(highestEquivalent(i), minimum, maximum);
+            }
+        }
+        return maximum;
+    }
+
+    std::uint64_t count() const {
+        return total;
+    }
+
+    std::uint64_t min() const {
+        return total == 0 ? 0 : minimum;
+    }
+
+    std::uint64_t max() const {
+        return maximum;
+    }
+
+    double mean() const {
+        return total == 0 ? 0.0 : sum / static_cast<double>(total);
+    }
+
+private:
+    static unsigned highestBit(std::uint64_t value) {
+#if defined(__GNUC__) || defined(__clang__)
+        return 63u - static_cast<unsigned>(__builtin_clzll(value));
+#else
+        unsigned bit = 0;
+        while (value >>= 1) {
+            ++bit;
+        }
+        return bit;
+#endif
+    }
+
+    // Values below 2 * SubBuckets map to themselves; above that, the
+    // exponent selects a group of SubBuckets buckets and the top
+    // SubBucketBits + 1 bits of the value select the bucket in it.
+    static size_t indexOf(std::uint64_t value) {
+        if (value < 2 * SubBuckets) {
+            return static_cast<size_t>(value);
+        }
+        const unsigned shift = highestBit(value) - SubBucketBits;
+        return static_cast<size_t>(shift * SubBuckets + (value >> shift));
+    }
+
+    static std::uint64_t highestEquivalent(size_t index) {
+        if (index < 2 * SubBuckets) {
+            return index;
+        }
+        const unsigned shift = static_cast<unsigned>(index / SubBuckets - 1);
+        const std::uint64_t low = (index - shift * SubBuckets) << shift;
+        return low + (std::uint64_t(1) << shift) - 1;
+    }
+
+    std::uint64_t counts[BucketCount] = {};
+    std::uint64_t total = 0;
+    std::uint64_t minimum = std::numeric_limits<std::uint64_t>::max();
+    std::uint64_t maximum = 0;
+    double sum = 0;
+};
+
+#endif // LATENCY_HISTOGRAM_H
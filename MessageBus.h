@@ -0,0 +1,244 @@
+#ifndef MESSAGE_BUS_H
+#define MESSAGE_BUS_H
+
+#include "Queue.h"
+#include "Reclaim.h"
+#include "StringIntern.h"
+#include "StringRefMap.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+// A message as a subscriber receives it: the topic it was published on and
+// the payload.
+template<typename T>
+struct BusMessage {
+    StringHandle topic;
+    T value;
+};
+
+// Topic-based publish/subscribe over interned topics. Each subscriber owns a
+// ring; publishing looks the topic up once in a StringRefMap, whose keys are
+// StringHandle ids, so matching a topic is an integer compare rather than a
+// string compare, and then enqueues a copy of the message on the ring of
+// every subscriber to it.
+//
+// The routing table is immutable once published. subscribe() and
+// unsubscribe() copy it under a mutex, change the copy and swap it in, and
+// retire the old table through an EpochDomain, so publishers read it inside
+// an epoch guard and never take the lock. Changing subscriptions is
+// therefore O(topics); they are meant to change rarely next to how often
+// messages are published.
+//
+// With the default SPSCQueue rings, one thread may publish and each
+// subscriber's ring is drained by one thread. Pass MPMCQueue as Ring for
+// several publishing threads. A message that finds a subscriber's ring full
+// is dropped for that subscriber and counted in its dropped().
+template<typename T, template<typename, size_t, typename> class Ring = SPSCQueue>
+class MessageBus {
+public:
+    using message_type = BusMessage<T>;
+
+    static constexpr size_t DefaultCapacity = 1024;
+
+    class Subscriber {
+    public:
+        explicit Subscriber(size_t capacity) : ring_(capacity) {}
+
+        Subscriber(const Subscriber&) = delete;
+        Subscriber& operator=(const Subscriber&) = delete;
+
+        bool receive(message_type& message) {
+            return ring_.dequeue(message);
+        }
+
+        // Calls handler(const message_type&) for up to max waiting messages;
+        // returns how many it handled.
+        template<typename Handler>
+        size_t drain(Handler&& handler, size_t max = static_cast<size_t>(-1)) {
+            size_t count = 0;
+            message_type message;
+            while (count < max && ring_.dequeue(message)) {
+                handler(static_cast<const message_type&>(message));
+                ++count;
+            }
+            return count;
+        }
+
+        size_t size() const {
+            return ring_.size();
+        }
+
+        bool empty() const {
+            return ring_.empty();
+        }
+
+        // Messages lost to a full ring.
+        std::uint64_t dropped() const {
+            return dropped_.load(std::memory_order_relaxed);
+        }
+
+    private:
+        friend class MessageBus;
+
+        bool deliver(const message_type& message) {
+            if (ring_.enqueue(message)) {
+                return true;
+            }
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+
+        Ring<message_type, DynamicCapacity, QueueTraits> ring_;
+        std::atomic<std::uint64_t> dropped_{0};
+    };
+
+    using SubscriberPtr = std::shared_ptr<Subscriber>;
+
+    MessageBus() : routes_(new Routes()) {}
+
+    ~MessageBus() {
+        delete routes_.load(std::memory_order_relaxed);
+    }
+
+    MessageBus(const MessageBus&) = delete;
+    MessageBus& operator=(const MessageBus&) = delete;
+
+    // A new subscriber to topic with a ring of capacity messages, a power
+    // of two.
+    SubscriberPtr subscribe(const StringRef& topic, size_t capacity = DefaultCapacity) {
+        SubscriberPtr subscriber = std::make_shared<Subscriber>(capacity);
+        subscribe(subscriber, topic);
+        return subscriber;
+    }
+
+    // Adds topic to subscriber's topics; false if it already had it.
+    // Subscribing gives topic a StringHandle, which pins it.
+    bool subscribe(const SubscriberPtr& subscriber, const StringRef& topic) {
+        if (!subscriber) {
+            throw std::invalid_argument("MessageBus cannot subscribe a null subscriber.");
+        }
+        std::lock_guard<std::mutex> lock(mutex_);
+        const Routes& current = *routes_.load(std::memory_order_relaxed);
+        const auto it = current.find(topic);
+        if (it != current.end() &&
+            std::find(it->second.begin(), it->second.end(), subscriber) != it->second.end()) {
+            return false;
+        }
+        std::unique_ptr<Routes> next(new Routes(current));
+        (*next)[topic].push_back(subscriber);
+        publishLocked(next.release());
+        return true;
+    }
+
+    // Removes topic from subscriber's topics; false if it did not have it.
+    // Messages already in its ring stay there.
+    bool unsubscribe(const SubscriberPtr& subscriber, const StringRef& topic) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        const Routes& current = *routes_.load(std::memory_order_relaxed);
+        const auto it = current.find(topic);
+        if (it == current.end() ||
+            std::find(it->second.begin(), it->second.end(), subscriber) == it->second.end()) {
+            return false;
+        }
+        std::unique_ptr<Routes> next(new Routes(current));
+        removeFrom(*next, next->find(topic), subscriber);
+        publishLocked(next.release());
+        return true;
+    }
+
+    // Removes subscriber from every topic; returns how many it had.
+    size_t unsubscribe(const SubscriberPtr& subscriber) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::unique_ptr<Routes> next(new Routes(*routes_.load(std::memory_order_relaxed)));
+        size_t removed = 0;
+        for (auto it = next->begin(); it != next->end();) {
+            if (std::find(it->second.begin(), it->second.end(), subscriber) != it->second.end()) {
+                ++removed;
+                it = removeFrom(*next, it, subscriber);
+            } else {
+                ++it;
+            }
+        }
+        if (removed == 0) {
+            return 0;
+        }
+        publishLocked(next.release());
+        return removed;
+    }
+
+    // Hands value to every subscriber of topic; returns how many took it.
+    size_t publish(const StringRef& topic, const T& value) {
+        return publish(StringHandle::existing(topic.getRawPointer()), value);
+    }
+
+    size_t publish(StringHandle topic, const T& value) {
+        if (!topic) {
+            // No handle, so nobody ever subscribed to it.
+            return 0;
+        }
+        EpochDomain::Guard guard(epoch_);
+        if (!guard) {
+            // More threads than the domain has reader slots.
+            std::lock_guard<std::mutex> lock(mutex_);
+            return deliver(*routes_.load(std::memory_order_relaxed), topic, value);
+        }
+        return deliver(*routes_.load(std::memory_order_acquire), topic, value);
+    }
+
+    // Subscribers to topic right now.
+    size_t subscribers(const StringRef& topic) const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        const Routes& current = *routes_.load(std::memory_order_relaxed);
+        const auto it = current.find(topic);
+        return it == current.end() ? 0 : it->second.size();
+    }
+
+    // Topics with at least one subscriber.
+    size_t topics() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return routes_.load(std::memory_order_relaxed)->size();
+    }
+
+private:
+    using Routes = StringRefMap<std::vector<SubscriberPtr>>;
+
+    static typename Routes::iterator removeFrom(Routes& routes, typename Routes::iterator it, const SubscriberPtr& subscriber) {
+        std::vector<SubscriberPtr>& list = it->second;
+        list.erase(std::find(list.begin(), list.end(), subscriber));
+        if (list.empty()) {
+            return routes.erase(typename Routes::const_iterator(it));
+        }
+        return ++it;
+    }
+
+    static size_t deliver(const Routes& routes, StringHandle topic, const T& value) {
+        const auto it = routes.find(topic);
+        if (it == routes.end()) {
+            return 0;
+        }
+        const message_type message{topic, value};
+        size_t delivered = 0;
+        for (const SubscriberPtr& subscriber : it->second) {
+            delivered += subscriber->deliver(message);
+        }
+        return delivered;
+    }
+
+    void publishLocked(Routes* next) {
+        Routes* previous = routes_.exchange(next, std::memory_order_acq_rel);
+        epoch_.retire(previous);
+    }
+
+    EpochDomain epoch_;
+    mutable std::mutex mutex_;
+    std::atomic<Routes*> routes_;
+};
+
+#endif // MESSAGE_BUS_H
@@ -0,0 +1,182 @@
+#ifndef MULTI_QUEUE_H
+#define MULTI_QUEUE_H
+
+#include "Queue.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Relaxed concurrent priority queue after Rihani, Sanders and Dementiev's
+// MultiQueue: factor * threads binary heaps, each behind its own try-lock.
+// push() goes to a random heap; try_pop() looks at the tops of two random
+// heaps and pops from the better one. Nothing is globally ordered, but the
+// expected rank of a popped element is O(number of heaps), and with no lock
+// shared by every thread throughput scales with the core count.
+//
+// Each heap publishes its top key as a hint for try_pop's comparison, so Key
+// must be trivially copyable (a deadline, a priority level, a sequence
+// number); the hint is only advice and is re-checked under the lock.
+template<typename Key, typename Value, typename Compare = std::less<Key>>
+class MultiQueue {
+    static_assert(std::is_trivially_copyable<Key>::value, "MultiQueue keys are published as atomics.");
+
+public:
+    explicit MultiQueue(size_t threads = std::thread::hardware_concurrency(), size_t factor = 2,
+                        const Compare& compare = Compare())
+        : compare(compare) {
+        const size_t count = std::max<size_t>(1, threads) * std::max<size_t>(1, factor);
+        for (size_t i = 0; i < count; ++i) {
+            heaps.emplace_back(new Heap());
+        }
+    }
+
+    MultiQueue(const MultiQueue&) = delete;
+    MultiQueue& operator=(const MultiQueue&) = delete;
+
+    void push(const Key& key, Value value) {
+        while (true) {
+            Heap& heap = *heaps[nextRandom() % heaps.size()];
+            if (!heap.tryLock()) {
+                continue;
+            }
+            heap.entries.push_back(Entry{key, std::move(value)});
+            std::push_heap(heap.entries.begin(), heap.entries.end(), EntryCompare{compare});
+            heap.publishTop();
+            heap.unlock();
+            return;
+        }
+    }
+
+    // Pops an element whose key is close to the minimum. Returns false once
+    // every heap has been seen empty.
+    bool try_pop(Key& key, Value& value) {
+        for (unsigned attempt = 0;; ++attempt) {
+            Heap* heap = pick();
+            if (heap == nullptr) {
+                // Two empty picks in a row: the queue may be nearly empty, so
+                // fall back to a sweep before giving up.
+                if (attempt < 2) {
+                    continue;
+                }
+                heap = firstNonEmpty();
+                if (heap == nullptr) {
+                    return false;
+                }
+            }
+            if (!heap->tryLock()) {
+                continue;
+            }
+            if (heap->entries.empty()) {
+                heap->unlock();
+                continue;
+            }
+            std::pop_heap(heap->entries.begin(), heap->entries.end(), EntryCompare{compare});
+            Entry& top = heap->entries.back();
+            key = top.key;
+            value = std::move(top.value);
+            heap->entries.pop_back();
+            heap->publishTop();
+            heap->unlock();
+            return true;
+        }
+    }
+
+    // A snapshot; other threads may push or pop at any moment.
+    bool empty() const {
+        for (const auto& heap : heaps) {
+            if (heap->nonEmpty.load(std::memory_order_acquire)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    size_t heap_count() const {
+        return heaps.size();
+    }
+
+private:
+    struct Entry {
+        Key key;
+        Value value;
+    };
+
+    // std::*_heap build max-heaps; inverting the order yields a min-heap.
+    struct EntryCompare {
+        const Compare& compare;
+        bool operator()(const Entry& a, const Entry& b) const { return compare(b.key, a.key); }
+    };
+
+    struct alignas(CACHE_LINE_SIZE) Heap {
+        bool tryLock() {
+            return !locked.load(std::memory_order_relaxed) && !locked.exchange(true, std::memory_order_acquire);
+        }
+
+        void unlock() {
+            locked.store(false, std::memory_order_release);
+        }
+
+        // Called with the lock held.
+        void publishTop() {
+            if (entries.empty()) {
+                nonEmpty.store(false, std::memory_order_release);
+            } else {
+                top.store(entries.front().key, std::memory_order_relaxed);
+                nonEmpty.store(true, std::memory_order_release);
+            }
+        }
+
+        std::atomic<bool> locked{false};
+        std::atomic<bool> nonEmpty{false};
+        std::atomic<Key> top{};
+        std::vector<Entry> entries;
+    };
+
+    // The better of two random heaps by their published tops, or nullptr if
+    // both look empty.
+    Heap* pick() {
+        const size_t count = heaps.size();
+        Heap* a = heaps[nextRandom() % count].get();
+        Heap* b = heaps[nextRandom() % count].get();
+        const bool aFull = a->nonEmpty.load(std::memory_order_acquire);
+        const bool bFull = b->nonEmpty.load(std::memory_order_acquire);
+        if (!aFull || !bFull) {
+            return aFull ? a : bFull ? b : nullptr;
+        }
+        return compare(b->top.load(std::memory_order_relaxed), a->top.load(std::memory_order_relaxed)) ? b : a;
+    }
+
+    Heap* firstNonEmpty() {
+        const size_t count = heaps.size();
+        const size_t start = static_cast<size_t>(nextRandom() % count);
+        for (size_t i = 0; i < count; ++i) {
+            Heap* heap = heaps[(start + i) % count].get();
+            if (heap->nonEmpty.load(std::memory_order_acquire)) {
+                return heap;
+            }
+        }
+        return nullptr;
+    }
+
+    // xorshift64 with per-thread state.
+    static std::uint64_t nextRandom() {
+        static std::atomic<std::uint64_t> seeds{0x9e3779b97f4a7c15ull};
+        static thread_local std::uint64_t x = seeds.fetch_add(0x9e3779b97f4a7c15ull, std::memory_order_relaxed) | 1;
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+        return x;
+    }
+
+    Compare compare;
+    std::vector<std::unique_ptr<Heap>> heaps;
+};
+
+#endif // MULTI_QUEUE_H
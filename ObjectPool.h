@@ -0,0 +1,118 @@
+#ifndef OBJECT_POOL_H
+#define OBJECT_POOL_H
+
+#include "Queue.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <utility>
+
+// Fixed-capacity pool for objects that are created on one thread (the owner)
+// and destroyed on another (the releaser), e.g. messages passed by pointer
+// through an SPSCQueue<Msg*>. Storage is one contiguous block allocated up
+// front; freed objects travel back to the owner through a reverse SPSC ring,
+// so acquire() and release() never touch the global allocator and never
+// free memory on a thread other than the one that allocated it.
+//
+// acquire() and recycle() are owner-only; release() is for one releasing
+// thread. Every object must be released before the pool is destroyed.
+template<typename T, typename Traits = QueueTraits>
+class ObjectPool {
+public:
+    using allocator_type = typename Traits::allocator;
+
+    explicit ObjectPool(size_t capacity, const allocator_type& allocator = allocator_type())
+        : allocator(allocator), count(capacity), returns(ringCapacity(capacity), allocator) {
+        if (capacity == 0) {
+            throw std::invalid_argument("ObjectPool capacity must be positive.");
+        }
+        freeStack.reset(new T*[capacity]);
+        storage = allocateSlots<Storage>(this->allocator, capacity);
+        // Hand out low addresses first so a lightly used pool stays dense.
+        for (size_t i = 0; i < capacity; ++i) {
+            freeStack[i] = reinterpret_cast<T*>(storage + (capacity - 1 - i));
+        }
+        freeCount = capacity;
+    }
+
+    ~ObjectPool() {
+        deallocateSlots(allocator, storage, count);
+    }
+
+    ObjectPool(const ObjectPool&) = delete;
+    ObjectPool& operator=(const ObjectPool&) = delete;
+
+    // Owner: constructs a T in a free slot, or returns nullptr when every
+    // object is in use. Refills from the return ring only when the local free
+    // stack runs dry, so the ring's head is touched once per batch.
+    template<typename... Args>
+    T* acquire(Args&&... args) {
+        if (freeCount == 0) {
+            freeCount = returns.dequeue_bulk(freeStack.get(), count);
+            if (freeCount == 0) {
+                return nullptr;
+            }
+        }
+        T* slot = freeStack[freeCount - 1];
+        T* object = new (slot) T(std::forward<Args>(args)...);
+        --freeCount;
+        return object;
+    }
+
+    // Releasing thread: destroys object and sends its slot home.
+    void release(T* object) {
+        object->~T();
+        // The ring holds at least capacity slots and each object is released
+        // once, so this cannot fail.
+        returns.enqueue(object);
+    }
+
+    // Owner: frees an object without a trip through the ring.
+    void recycle(T* object) {
+        object->~T();
+        freeStack[freeCount++] = object;
+    }
+
+    bool owns(const T* object) const {
+        const auto* p = reinterpret_cast<const Storage*>(object);
+        return p >= storage && p < storage + count;
+    }
+
+    size_t capacity() const {
+        return count;
+    }
+
+    // Owner: objects acquire() can hand out right now, counting those
+    // already released but still in the return ring.
+    size_t available() const {
+        return freeCount + returns.size();
+    }
+
+private:
+    struct alignas(T) Storage {
+        unsigned char bytes[sizeof(T)];
+    };
+
+    static size_t ringCapacity(size_t capacity) {
+        size_t ring = 1;
+        while (ring < capacity) {
+            ring <<= 1;
+        }
+        return ring;
+    }
+
+    allocator_type allocator;
+    size_t count;
+    Storage* storage = nullptr;
+
+    // Owner-only free list; sized for every object so it never grows.
+    std::unique_ptr<T*[]> freeStack;
+    size_t freeCount = 0;
+
+    SPSCQueue<T*, DynamicCapacity, Traits> returns;
+};
+
+#endif // OBJECT_POOL_H
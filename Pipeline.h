@@ -0,0 +1,430 @@
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include "Queue.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+struct PipelineOptions {
+    // Slots in each ring between two threads; a power of two.
+    size_t capacity = 1024;
+    // Elements a thread collects before handing them downstream with one
+    // enqueue_bulk, and the most it takes from its input per dequeue_bulk.
+    size_t batch = 64;
+};
+
+struct PipelineStageStats {
+    std::string name;
+    // Elements the stage has taken in (for a source: produced).
+    std::uint64_t items = 0;
+    double items_per_second = 0;
+    // Occupancy of the ring feeding the stage; 0 and 0 for stages that share
+    // a thread with the one before them.
+    size_t queued = 0;
+    size_t capacity = 0;
+};
+
+// Tag for map/filter/sink (as Pipeline::fused) that runs the stage on the
+// previous stage's thread, skipping a ring hop for stages too cheap to be
+// worth one.
+struct PipelineFuse {};
+
+template<typename T, typename Driver, typename Chain>
+class PipelineStage;
+
+// Linear chain of stages, each on its own thread and connected by
+// SPSCQueues:
+//
+//   Pipeline pipeline;
+//   pipeline.source<Order>([&]() -> std::optional<Order> { ... })
+//       .map([](Order o) { return price(o); })
+//       .filter([](const Quote& q) { return q.valid; }, Pipeline::fused)
+//       .sink([](Quote q) { publish(q); });
+//   pipeline.start();
+//   ...
+//   pipeline.wait();
+//
+// A stage thread batches its output and hands it on with enqueue_bulk; when
+// a downstream ring is full it waits, so a slow stage throttles everything
+// before it instead of growing memory. The source ends the run by returning
+// std::nullopt (or stop() asks it to); each thread then flushes, marks its
+// output ring finished, and the next thread drains that ring and follows.
+//
+// Types carried between threads must be default constructible, since
+// receivers dequeue into a reusable batch buffer. Stage functions must not
+// throw. A source flushes its batch only when it is full or ends, so give
+// sources that block between elements a batch of 1.
+class Pipeline {
+public:
+    using clock = std::chrono::steady_clock;
+
+    static constexpr PipelineFuse fused{};
+
+    explicit Pipeline(PipelineOptions options = PipelineOptions()) : options(options) {
+        checkCapacity(options.capacity, DynamicCapacity);
+        if (options.batch == 0) {
+            throw std::invalid_argument("Pipeline batch must be positive.");
+        }
+    }
+
+    // Stops the source and waits for everything in flight to reach the sink.
+    ~Pipeline() {
+        stop();
+        wait();
+    }
+
+    Pipeline(const Pipeline&) = delete;
+    Pipeline& operator=(const Pipeline&) = delete;
+
+    template<typename T, typename Source>
+    auto source(Source source);
+
+    void start() {
+        if (!complete) {
+            throw std::logic_error("Pipeline needs a source and a sink before start().");
+        }
+        if (started) {
+            throw std::logic_error("Pipeline already started.");
+        }
+        started = true;
+        startTime = clock::now();
+        for (auto& runner : runners) {
+            Runner* r = runner.get();
+            threads.emplace_back([r] { r->run(); });
+        }
+    }
+
+    // Asks the source to stop after its current element; whatever was
+    // produced still flows through to the sink.
+    void stop() {
+        stopping.store(true, std::memory_order_relaxed);
+    }
+
+    void wait() {
+        for (auto& thread : threads) {
+            if (thread.joinable()) {
+                thread.join();
+            }
+        }
+        if (started && !finished) {
+            finished = true;
+            finishTime = clock::now();
+        }
+    }
+
+    std::vector<PipelineStageStats> stats() const {
+        const double elapsed =
+            started ? std::chrono::duration<double>((finished ? finishTime : clock::now()) - startTime).count() : 0;
+        std::vector<PipelineStageStats> result;
+        for (const Counter& counter : counters) {
+            PipelineStageStats stage;
+            stage.name = counter.name;
+            stage.items = counter.items.load(std::memory_order_relaxed);
+            stage.items_per_second = elapsed > 0 ? static_cast<double>(stage.items) / elapsed : 0;
+            if (counter.queued) {
+                stage.queued = counter.queued();
+                stage.capacity = options.capacity;
+            }
+            result.push_back(stage);
+        }
+        return result;
+    }
+
+    // Threads the pipeline runs on once started.
+    size_t thread_count() const {
+        return runners.size();
+    }
+
+private:
+    template<typename, typename, typename>
+    friend class PipelineStage;
+
+    struct Counter {
+        explicit Counter(std::string name) : name(std::move(name)) {}
+
+        // One writer, the stage's thread, so no read-modify-write.
+        void add() {
+            items.store(items.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        }
+
+        std::string name;
+        std::atomic<std::uint64_t> items{0};
+        std::function<size_t()> queued;
+    };
+
+    // The ring between two threads, plus the upstream's end-of-stream flag.
+    template<typename T>
+    struct Link {
+        explicit Link(size_t capacity) : queue(capacity) {}
+
+        SPSCQueue<T> queue;
+        std::atomic<bool> done{false};
+    };
+
+    struct Runner {
+        virtual ~Runner() = default;
+        virtual void run() = 0;
+    };
+
+    template<typename F>
+    struct RunnerImpl : Runner {
+        explicit RunnerImpl(F fn) : fn(std::move(fn)) {}
+        void run() override { fn(); }
+        F fn;
+    };
+
+    template<typename F>
+    void addRunner(F fn) {
+        runners.emplace_back(new RunnerImpl<F>(std::move(fn)));
+    }
+
+    Counter* addCounter(const char* kind) {
+        counters.emplace_back(std::to_string(counters.size()) + ":" + kind);
+        return &counters.back();
+    }
+
+    template<typename T>
+    Link<T>* addLink() {
+        auto link = std::make_shared<Link<T>>(options.capacity);
+        Link<T>* raw = link.get();
+        links.push_back(std::move(link));
+        return raw;
+    }
+
+    // Collects a thread's output and hands it on in batches, waiting while
+    // the ring is full.
+    template<typename T>
+    class Emitter {
+    public:
+        Emitter(Link<T>* out, size_t batch) : out(out), batch(batch) {
+            buffer.reserve(batch);
+        }
+
+        void push(T&& value) {
+            buffer.push_back(std::move(value));
+            if (buffer.size() >= batch) {
+                flush();
+            }
+        }
+
+        void flush() {
+            size_t done = 0;
+            while (done < buffer.size()) {
+                const size_t n = out->queue.enqueue_bulk(std::make_move_iterator(buffer.begin() + done), buffer.size() - done);
+                if (n == 0) {
+                    std::this_thread::yield();
+                }
+                done += n;
+            }
+            buffer.clear();
+        }
+
+    private:
+        Link<T>* out;
+        size_t batch;
+        std::vector<T> buffer;
+    };
+
+    template<typename T, typename Source>
+    struct SourceDriver {
+        template<typename Head, typename Flush>
+        void run(Pipeline& pipeline, Head& head, Flush&&) {
+            while (!pipeline.stopping.load(std::memory_order_relaxed)) {
+                std::optional<T> value = source();
+                if (!value) {
+                    return;
+                }
+                counter->add();
+                head(std::move(*value));
+            }
+        }
+
+        Source source;
+        Counter* counter;
+    };
+
+    template<typename T>
+    struct LinkDriver {
+        template<typename Head, typename Flush>
+        void run(Pipeline& pipeline, Head& head, Flush&& flush) {
+            std::vector<T> batch(pipeline.options.batch);
+            while (true) {
+                const size_t n = in->queue.dequeue_bulk(batch.begin(), batch.size());
+                for (size_t i = 0; i < n; ++i) {
+                    head(std::move(batch[i]));
+                }
+                if (n != 0) {
+                    // Input ran dry or a batch is done: pass on what we have
+                    // rather than sit on it.
+                    flush();
+                    continue;
+                }
+                if (in->done.load(std::memory_order_acquire)) {
+                    // Upstream has flushed for the last time; one more look
+                    // catches anything published just before the flag.
+                    if (in->queue.empty()) {
+                        return;
+                    }
+                    continue;
+                }
+                T value;
+                if (in->queue.try_pop_for(value, std::chrono::milliseconds(1))) {
+                    head(std::move(value));
+                    flush();
+                }
+            }
+        }
+
+        Link<T>* in;
+    };
+
+    PipelineOptions options;
+    std::deque<Counter> counters;
+    std::vector<std::unique_ptr<Runner>> runners;
+    std::vector<std::shared_ptr<void>> links;
+    std::vector<std::thread> threads;
+    std::atomic<bool> stopping{false};
+    bool complete = false;
+    bool started = false;
+    bool finished = false;
+    clock::time_point startTime;
+    clock::time_point finishTime;
+};
+
+// Builder for the stages after a source. T is the element type at this
+// point; Driver feeds the current thread (a source or an input ring) and
+// Chain holds the stages fused onto that thread so far.
+template<typename T, typename Driver, typename Chain>
+class PipelineStage {
+public:
+    PipelineStage(Pipeline& pipeline, Driver driver, Chain chain)
+        : pipeline(pipeline), driver(std::move(driver)), chain(std::move(chain)) {}
+
+    template<typename F>
+    auto map(F fn) {
+        return fresh().map(std::move(fn), PipelineFuse());
+    }
+
+    template<typename F>
+    auto map(F fn, PipelineFuse) {
+        using R = std::decay_t<std::invoke_result_t<F&, T&&>>;
+        Pipeline::Counter* counter = addCounter("map");
+        return extend<R>([fn = std::move(fn), counter](auto next) mutable {
+            return [fn = std::move(fn), counter, next = std::move(next)](T&& value) mutable {
+                counter->add();
+                next(R(fn(std::move(value))));
+            };
+        });
+    }
+
+    template<typename P>
+    auto filter(P predicate) {
+        return fresh().filter(std::move(predicate), PipelineFuse());
+    }
+
+    template<typename P>
+    auto filter(P predicate, PipelineFuse) {
+        Pipeline::Counter* counter = addCounter("filter");
+        return extend<T>([predicate = std::move(predicate), counter](auto next) mutable {
+            return [predicate = std::move(predicate), counter, next = std::move(next)](T&& value) mutable {
+                counter->add();
+                if (predicate(static_cast<const T&>(value))) {
+                    next(std::move(value));
+                }
+            };
+        });
+    }
+
+    // Completes the pipeline.
+    template<typename F>
+    void sink(F fn) {
+        fresh().sink(std::move(fn), PipelineFuse());
+    }
+
+    template<typename F>
+    void sink(F fn, PipelineFuse) {
+        Pipeline::Counter* counter = addCounter("sink");
+        Pipeline& owner = pipeline;
+        owner.addRunner([&owner, driver = std::move(driver), chain = std::move(chain), fn = std::move(fn), counter]() mutable {
+            auto head = chain([&fn, counter](T&& value) {
+                counter->add();
+                fn(std::move(value));
+            });
+            driver.run(owner, head, [] {});
+        });
+        owner.complete = true;
+    }
+
+private:
+    template<typename, typename, typename>
+    friend class PipelineStage;
+
+    PipelineStage(Pipeline& pipeline, Driver driver, Chain chain, std::function<size_t()> inputQueued)
+        : pipeline(pipeline), driver(std::move(driver)), chain(std::move(chain)), inputQueued(std::move(inputQueued)) {}
+
+    // The first stage on a new thread reports its input ring's occupancy.
+    Pipeline::Counter* addCounter(const char* kind) {
+        Pipeline::Counter* counter = pipeline.addCounter(kind);
+        counter->queued = std::move(inputQueued);
+        inputQueued = nullptr;
+        return counter;
+    }
+
+    template<typename R, typename Op>
+    auto extend(Op op) {
+        auto composed = [chain = std::move(chain), op = std::move(op)](auto next) mutable {
+            return chain(op(std::move(next)));
+        };
+        return PipelineStage<R, Driver, decltype(composed)>(pipeline, std::move(driver), std::move(composed));
+    }
+
+    // Closes this thread with a ring carrying T and starts a new thread
+    // reading from it.
+    auto fresh() {
+        using LinkDriver = Pipeline::LinkDriver<T>;
+        Pipeline::Link<T>* link = pipeline.template addLink<T>();
+        Pipeline& owner = pipeline;
+        const size_t batch = owner.options.batch;
+        owner.addRunner([&owner, driver = std::move(driver), chain = std::move(chain), link, batch]() mutable {
+            Pipeline::Emitter<T> emitter(link, batch);
+            auto head = chain([&emitter](T&& value) { emitter.push(std::move(value)); });
+            driver.run(owner, head, [&emitter] { emitter.flush(); });
+            emitter.flush();
+            link->done.store(true, std::memory_order_release);
+        });
+        auto identity = [](auto next) { return next; };
+        return PipelineStage<T, LinkDriver, decltype(identity)>(owner, LinkDriver{link}, identity,
+                                                                [link] { return link->queue.size(); });
+    }
+
+    Pipeline& pipeline;
+    Driver driver;
+    Chain chain;
+    std::function<size_t()> inputQueued;
+};
+
+template<typename T, typename Source>
+auto Pipeline::source(Source source) {
+    if (!counters.empty()) {
+        throw std::logic_error("Pipeline already has a source.");
+    }
+    Counter* counter = addCounter("source");
+    auto identity = [](auto next) { return next; };
+    return PipelineStage<T, SourceDriver<T, Source>, decltype(identity)>(*this, SourceDriver<T, Source>{std::move(source), counter},
+                                                                         identity);
+}
+
+#endif // PIPELINE_H
@@ -1,170 +1,979 @@
 #ifndef QUEUE_H
 #define QUEUE_H
 
-#include <vector>
 #include <atomic>
 #include <stdexcept>
+#include <cstddef>
+#include <algorithm>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <utility>
+#include <optional>
+#include <vector>
+#include <cstdint>
+#include <type_traits>
+#include <chrono>
+
+#include "Backoff.h"
+#include "Concurrency.h"
+#include "QueueStats.h"
+#include "SlotAllocator.h"
+#include "WaitStrategy.h"
+
+// Fixed rather than std::hardware_destructive_interference_size, whose value
+// is allowed to differ between translation units.
+constexpr size_t CACHE_LINE_SIZE = 64;
+
+// Passed as Capacity to size a ring at construction time instead:
+// SPSCQueue<Msg> q(config.ringSize). One instantiation then serves every size.
+constexpr size_t DynamicCapacity = 0;
+
+// Policies for the ring templates. Derive from it and override what you need:
+//
+//   struct ParkingTraits : QueueTraits { using wait_strategy = SpinParkWait; };
+//   SPSCQueue<Msg, 1024, ParkingTraits> q;
+struct QueueTraits {
+    // What pop() and try_pop_for() do while the ring is empty; see
+    // WaitStrategy.h.
+    using wait_strategy = SpinYieldWait;
+
+    // Where slot storage comes from; see SlotAllocator.h.
+    using allocator = HeapSlotAllocator;
+
+    // Counters for SPSCQueue and SPMCQueue; set to QueueStats to turn them
+    // on. See QueueStats.h.
+    using stats = NullQueueStats;
+
+    // What the SPMCQueue and MPMCQueue CAS loops do after losing a race;
+    // see Backoff.h.
+    using backoff = NoBackoff;
+
+    // What the rings keep their indices in; SingleThreaded swaps the atomics
+    // for plain variables. See Concurrency.h.
+    using concurrency = ThreadSafe;
+};
+
+// Every ring as plain single-threaded ring-buffer code, for deterministic
+// replay: SPSCQueue<Msg, 1024, SingleThreadedTraits>.
+struct SingleThreadedTraits : QueueTraits {
+    using concurrency = SingleThreaded;
+};
+
+#if defined(__cpp_lib_memory_resource)
+// Slots from a std::pmr::memory_resource passed at construction:
+// SPSCQueue<Msg, DynamicCapacity, ResourceQueueTraits> q(1024, ResourceSlotAllocator(&arena)).
+struct ResourceQueueTraits : QueueTraits {
+    using allocator = ResourceSlotAllocator;
+};
+#endif
+
+// Set as Traits::allocator to keep the slots in the queue object itself, on
+// cache-line-aligned lines of their own, instead of a separate allocation:
+// SPSCQueue<Msg, 64, InlineQueueTraits> q. Needs a fixed Capacity. Such a
+// queue holds no pointers, so it can sit in static storage or, with
+// Traits whose members hold none either, be placement-constructed in shared
+// memory.
+struct InlineSlots {};
+
+struct InlineQueueTraits : QueueTraits {
+    using allocator = InlineSlots;
+};
+
+// Raw storage for the ring slots. Elements are constructed in place when
+// enqueued and destroyed when dequeued, so T need not be default-constructible.
+template<typename T, typename Allocator>
+T* allocateSlots(Allocator& allocator, size_t count) {
+    return static_cast<T*>(allocator.allocate(count * sizeof(T), alignof(T)));
+}
+
+template<typename T, typename Allocator>
+void deallocateSlots(Allocator& allocator, T* slots, size_t count) noexcept {
+    allocator.deallocate(slots, count * sizeof(T), alignof(T));
+}
+
+// A fixed Capacity queue only accepts its own capacity at run time.
+inline size_t checkCapacity(size_t capacity, size_t fixedCapacity) {
+    if (fixedCapacity != DynamicCapacity && capacity != fixedCapacity) {
+        throw std::invalid_argument("Capacity does not match the queue's fixed Capacity.");
+    }
+    if (capacity == 0 || (capacity & (capacity - 1))) {
+        throw std::invalid_argument("Capacity must be a power of two.");
+    }
+    return capacity;
+}
+
+// The rings' slot array, used as a plain T*: count slots from Allocator.
+template<typename T, size_t Capacity, typename Allocator>
+class SlotStorage {
+public:
+    SlotStorage(size_t count, const Allocator& allocator)
+        : allocator(allocator), slots(allocateSlots<T>(this->allocator, count)), count(count) {}
+
+    SlotStorage(const SlotStorage&) = delete;
+    SlotStorage& operator=(const SlotStorage&) = delete;
 
+    ~SlotStorage() {
+        deallocateSlots(allocator, slots, count);
+    }
+
+    operator T*() const {
+        return slots;
+    }
+
+private:
+    Allocator allocator;
+    T* slots;
+    size_t count;
+};
+
+// Inline: the slots are a member array, so reaching one is an offset from
+// the queue's own address with no pointer to load first.
 template<typename T, size_t Capacity>
+class SlotStorage<T, Capacity, InlineSlots> {
+    static_assert(Capacity != DynamicCapacity, "Inline slots need a compile-time Capacity.");
+
+public:
+    SlotStorage(size_t, const InlineSlots&) {}
+
+    SlotStorage(const SlotStorage&) = delete;
+    SlotStorage& operator=(const SlotStorage&) = delete;
+
+    operator T*() const {
+        return std::launder(reinterpret_cast<T*>(const_cast<unsigned char*>(bytes)));
+    }
+
+private:
+    alignas(std::max(CACHE_LINE_SIZE, alignof(T))) unsigned char bytes[Capacity * sizeof(T)];
+};
+
+// Single-producer/multi-consumer ring. head and tail are free-running 64-bit
+// sequence numbers (masked only on slot access), so a consumer's CAS on head
+// cannot succeed against a position that has since wrapped around, and all
+// capacity slots are usable. Consumers claim a slot first and move out of it
+// afterwards; the per-slot busy flag tells the producer when that move has
+// finished and the slot may be reused.
+template<typename T, size_t Capacity = DynamicCapacity, typename Traits = QueueTraits>
 class SPMCQueue {
 public:
-    SPMCQueue() : mask(Capacity - 1) {
-        if (Capacity & mask) {
-            throw std::invalid_argument("Capacity must be a power of two.");
+    using allocator_type = typename Traits::allocator;
+    template<typename V>
+    using atomic_type = typename Traits::concurrency::template atomic<V>;
+    using stats_type = typename Traits::stats;
+
+    explicit SPMCQueue(const allocator_type& allocator = allocator_type())
+        : SPMCQueue(Capacity, allocator) {}
+
+    explicit SPMCQueue(size_t capacity, const allocator_type& allocator = allocator_type())
+        : data(checkCapacity(capacity, Capacity), allocator), busy(capacity, allocator), mask(capacity - 1) {
+        for (size_t i = 0; i < capacity; ++i) {
+            new (busy + i) atomic_type<bool>(false);
         }
-        data.resize(Capacity);
         head.store(0, std::memory_order_relaxed);
         tail.store(0, std::memory_order_relaxed);
     }
 
-    bool enqueue(const T& value) {
-        size_t currentTail = tail.load(std::memory_order_acquire);
-        while (true) {
-            size_t nextTail = (currentTail + 1) & mask;
-            if (nextTail == head.load(std::memory_order_acquire)) {
-                return false;
-            }
-            data[currentTail] = value;
-            if (tail.compare_exchange_weak(currentTail, nextTail, std::memory_order_release, std::memory_order_acquire)) {
-                return true;
-            }
+    ~SPMCQueue() {
+        const std::uint64_t currentTail = tail.load(std::memory_order_relaxed);
+        for (std::uint64_t i = head.load(std::memory_order_relaxed); i != currentTail; ++i) {
+            data[i & mask].~T();
         }
     }
 
+    bool enqueue(const T& value) {
+        return emplace(value);
+    }
+
+    bool enqueue(T&& value) {
+        return emplace(std::move(value));
+    }
+
     template<typename... Args>
     bool emplace(Args&&... args) {
-        T value(std::forward<Args>(args)...);
-        return enqueue(std::move(value));
+        const std::uint64_t currentTail = tail.load(std::memory_order_relaxed);
+        const size_t index = static_cast<size_t>(currentTail & mask);
+        if (currentTail - head.load(std::memory_order_acquire) > mask ||
+            busy[index].load(std::memory_order_acquire)) {
+            statistics.onEnqueueFull();
+            return false;
+        }
+        new (data + index) T(std::forward<Args>(args)...);
+        busy[index].store(true, std::memory_order_relaxed);
+        tail.store(currentTail + 1, std::memory_order_release);
+        recordEnqueue(currentTail + 1, 1);
+        waiter.notify(1);
+        return true;
     }
 
     bool dequeue(T& result) {
-        size_t currentHead = head.load(std::memory_order_acquire);
+        std::uint64_t position;
+        if (!claim(position)) {
+            return false;
+        }
+        const size_t index = static_cast<size_t>(position & mask);
+        result = std::move(data[index]);
+        release(index);
+        return true;
+    }
+
+    // Blocks until an element is available, in the manner chosen by
+    // Traits::wait_strategy.
+    void pop(T& result) {
+        waiter.wait([&] { return dequeue(result); });
+    }
+
+    template<typename Rep, typename Period>
+    bool try_pop_for(T& result, const std::chrono::duration<Rep, Period>& timeout) {
+        const auto deadline = std::chrono::steady_clock::now() + timeout;
+        return waiter.waitUntil([&] { return dequeue(result); }, deadline);
+    }
+
+    std::optional<T> try_pop() {
+        std::uint64_t position;
+        if (!claim(position)) {
+            return std::nullopt;
+        }
+        const size_t index = static_cast<size_t>(position & mask);
+        std::optional<T> result(std::move(data[index]));
+        release(index);
+        return result;
+    }
+
+    // Enqueues up to n items starting at first with a single tail update and
+    // returns how many fitted.
+    template<typename ForwardIt>
+    size_t enqueue_bulk(ForwardIt first, size_t n) {
+        const std::uint64_t currentTail = tail.load(std::memory_order_relaxed);
+        const size_t count = std::min(n, mask + 1 - static_cast<size_t>(currentTail - head.load(std::memory_order_acquire)));
+        size_t done = 0;
+        try {
+            for (; done < count; ++done, ++first) {
+                const size_t index = static_cast<size_t>((currentTail + done) & mask);
+                if (busy[index].load(std::memory_order_acquire)) {
+                    break;
+                }
+                new (data + index) T(*first);
+                busy[index].store(true, std::memory_order_relaxed);
+            }
+        } catch (...) {
+            tail.store(currentTail + done, std::memory_order_release);
+            recordEnqueue(currentTail + done, done);
+            waiter.notify(done);
+            throw;
+        }
+        if (done != 0) {
+            tail.store(currentTail + done, std::memory_order_release);
+            recordEnqueue(currentTail + done, done);
+            waiter.notify(done);
+        } else if (n != 0) {
+            statistics.onEnqueueFull();
+        }
+        return done;
+    }
+
+    template<typename ForwardIt>
+    size_t enqueue_bulk(ForwardIt first, ForwardIt last) {
+        return enqueue_bulk(first, static_cast<size_t>(std::distance(first, last)));
+    }
+
+    // Dequeues up to max items into out, claiming the whole run with one CAS
+    // on head, and returns how many were taken.
+    template<typename OutputIt>
+    size_t dequeue_bulk(OutputIt out, size_t max) {
+        std::uint64_t currentHead = head.load(std::memory_order_relaxed);
+        size_t count;
+        typename Traits::backoff backoff;
         while (true) {
-            size_t currentTail = tail.load(std::memory_order_acquire);
-            if (currentHead == currentTail) {
-                return false;
+            count = static_cast<size_t>(std::min<std::uint64_t>(max, tail.load(std::memory_order_acquire) - currentHead));
+            if (count == 0) {
+                statistics.onDequeueEmpty();
+                return 0;
             }
-            result = data[currentHead];
-            size_t nextHead = (currentHead + 1) & mask;
-            if (head.compare_exchange_weak(currentHead, nextHead, std::memory_order_release, std::memory_order_acquire)) {
-                return true;
+            if (head.compare_exchange_weak(currentHead, currentHead + count, std::memory_order_acq_rel, std::memory_order_relaxed)) {
+                break;
             }
+            statistics.onCasRetry();
+            backoff.pause();
         }
+        statistics.onDequeue(count);
+        for (size_t i = 0; i < count; ++i, ++out) {
+            const size_t index = static_cast<size_t>((currentHead + i) & mask);
+            *out = std::move(data[index]);
+            release(index);
+        }
+        return count;
     }
 
+    // Takes from the same end as dequeue; WorkStealingDeque gives the owner a
+    // separate LIFO end for work-stealing schedulers.
     bool steal(T& result) {
-        size_t currentHead = head.load(std::memory_order_acquire);
+        return dequeue(result);
+    }
+
+    bool empty() const {
+        return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire);
+    }
+
+    bool full() const {
+        return size() > mask;
+    }
+
+    // head is read first, so the snapshot never goes negative.
+    size_t size() const {
+        const std::uint64_t currentHead = head.load(std::memory_order_acquire);
+        const std::uint64_t currentTail = tail.load(std::memory_order_acquire);
+        return static_cast<size_t>(std::min<std::uint64_t>(currentTail - currentHead, mask + 1));
+    }
+
+    size_t capacity() const {
+        return mask + 1;
+    }
+
+    // How many elements have been claimed by consumers so far.
+    std::uint64_t read_sequence() const {
+        return head.load(std::memory_order_acquire);
+    }
+
+    // Sequence number the next enqueued element will get. Exact on the
+    // producer thread.
+    std::uint64_t write_sequence() const {
+        return tail.load(std::memory_order_acquire);
+    }
+
+    const stats_type& stats() const {
+        return statistics;
+    }
+
+private:
+    // Claims the slot at head for this consumer.
+    bool claim(std::uint64_t& position) {
+        position = head.load(std::memory_order_relaxed);
+        typename Traits::backoff backoff;
         while (true) {
-            size_t currentTail = tail.load(std::memory_order_acquire);
-            if (currentHead == currentTail) {
+            if (position == tail.load(std::memory_order_acquire)) {
+                statistics.onDequeueEmpty();
                 return false;
             }
-            result = data[currentHead];
-            size_t nextHead = (currentHead + 1) & mask;
-            if (head.compare_exchange_weak(currentHead, nextHead, std::memory_order_release, std::memory_order_acquire)) {
+            if (head.compare_exchange_weak(position, position + 1, std::memory_order_acq_rel, std::memory_order_relaxed)) {
+                statistics.onDequeue(1);
                 return true;
             }
+            statistics.onCasRetry();
+            backoff.pause();
+        }
+    }
+
+    // Occupancy is only read back when statistics are enabled.
+    void recordEnqueue(std::uint64_t newTail, size_t count) {
+        if constexpr (stats_type::enabled) {
+            statistics.onEnqueue(count, static_cast<size_t>(newTail - head.load(std::memory_order_relaxed)));
+        }
+    }
+
+    // Destroys a claimed slot that has been moved from and hands it back to
+    // the producer.
+    void release(size_t index) {
+        data[index].~T();
+        busy[index].store(false, std::memory_order_release);
+    }
+
+    SlotStorage<T, Capacity, allocator_type> data;
+    SlotStorage<atomic_type<bool>, Capacity, allocator_type> busy;
+    size_t mask;
+
+    alignas(CACHE_LINE_SIZE) atomic_type<std::uint64_t> head;
+    alignas(CACHE_LINE_SIZE) atomic_type<std::uint64_t> tail;
+    alignas(CACHE_LINE_SIZE) typename Traits::wait_strategy waiter;
+    stats_type statistics;
+};
+
+// Single-producer/single-consumer ring. Each position is written by exactly
+// one thread, so publishing is a plain store-release. Both sides keep a
+// private copy of the other side's position and only reload it when the ring
+// looks full (producer) or empty (consumer).
+//
+// head and tail are free-running 64-bit sequence numbers, masked only on slot
+// access, so every one of the capacity slots is usable and tail - head is the
+// exact occupancy. read_sequence()/write_sequence() expose them to callers.
+template<typename T, size_t Capacity = DynamicCapacity, typename Traits = QueueTraits>
+class SPSCQueue {
+public:
+    using allocator_type = typename Traits::allocator;
+    template<typename V>
+    using atomic_type = typename Traits::concurrency::template atomic<V>;
+    using stats_type = typename Traits::stats;
+
+    explicit SPSCQueue(const allocator_type& allocator = allocator_type())
+        : SPSCQueue(Capacity, allocator) {}
+
+    explicit SPSCQueue(size_t capacity, const allocator_type& allocator = allocator_type())
+        : data(checkCapacity(capacity, Capacity), allocator), mask(capacity - 1) {
+        head.store(0, std::memory_order_relaxed);
+        tail.store(0, std::memory_order_relaxed);
+    }
+
+    ~SPSCQueue() {
+        const std::uint64_t currentTail = tail.load(std::memory_order_relaxed);
+        for (std::uint64_t i = head.load(std::memory_order_relaxed); i != currentTail; ++i) {
+            slot(i).~T();
+        }
+    }
+
+    bool enqueue(const T& value) {
+        return emplace(value);
+    }
+
+    bool enqueue(T&& value) {
+        return emplace(std::move(value));
+    }
+
+    template<typename... Args>
+    bool emplace(Args&&... args) {
+        const std::uint64_t currentTail = tail.load(std::memory_order_relaxed);
+        if (currentTail - cachedHead > mask) {
+            cachedHead = head.load(std::memory_order_acquire);
+            if (currentTail - cachedHead > mask) {
+                statistics.onEnqueueFull();
+                return false;
+            }
+        }
+        new (&slot(currentTail)) T(std::forward<Args>(args)...);
+        tail.store(currentTail + 1, std::memory_order_release);
+        recordEnqueue(currentTail + 1, 1);
+        waiter.notify(1);
+        return true;
+    }
+
+    bool dequeue(T& result) {
+        const std::uint64_t currentHead = head.load(std::memory_order_relaxed);
+        if (!readable(currentHead)) {
+            return false;
+        }
+        T& value = slot(currentHead);
+        result = std::move(value);
+        value.~T();
+        head.store(currentHead + 1, std::memory_order_release);
+        statistics.onDequeue(1);
+        return true;
+    }
+
+    // Blocks until an element is available, in the manner chosen by
+    // Traits::wait_strategy.
+    void pop(T& result) {
+        waiter.wait([&] { return dequeue(result); });
+    }
+
+    template<typename Rep, typename Period>
+    bool try_pop_for(T& result, const std::chrono::duration<Rep, Period>& timeout) {
+        const auto deadline = std::chrono::steady_clock::now() + timeout;
+        return waiter.waitUntil([&] { return dequeue(result); }, deadline);
+    }
+
+    std::optional<T> try_pop() {
+        const std::uint64_t currentHead = head.load(std::memory_order_relaxed);
+        if (!readable(currentHead)) {
+            return std::nullopt;
+        }
+        T& value = slot(currentHead);
+        std::optional<T> result(std::move(value));
+        value.~T();
+        head.store(currentHead + 1, std::memory_order_release);
+        statistics.onDequeue(1);
+        return result;
+    }
+
+    // Enqueues up to n items starting at first with a single tail publish and
+    // returns how many fitted. The run is copied in at most two pieces, split
+    // at the wrap point.
+    template<typename ForwardIt>
+    size_t enqueue_bulk(ForwardIt first, size_t n) {
+        const std::uint64_t currentTail = tail.load(std::memory_order_relaxed);
+        size_t free = freeSlots(currentTail);
+        if (free < n) {
+            cachedHead = head.load(std::memory_order_acquire);
+            free = freeSlots(currentTail);
+        }
+        const size_t count = std::min(n, free);
+        if (count == 0) {
+            if (n != 0) {
+                statistics.onEnqueueFull();
+            }
+            return 0;
+        }
+        const size_t offset = static_cast<size_t>(currentTail & mask);
+        const size_t firstRun = std::min(count, mask + 1 - offset);
+        ForwardIt rest = std::next(first, firstRun);
+        std::uninitialized_copy(first, rest, data + offset);
+        try {
+            std::uninitialized_copy_n(rest, count - firstRun, &data[0]);
+        } catch (...) {
+            tail.store(currentTail + firstRun, std::memory_order_release);
+            recordEnqueue(currentTail + firstRun, firstRun);
+            waiter.notify(firstRun);
+            throw;
+        }
+        tail.store(currentTail + count, std::memory_order_release);
+        recordEnqueue(currentTail + count, count);
+        waiter.notify(count);
+        return count;
+    }
+
+    template<typename ForwardIt>
+    size_t enqueue_bulk(ForwardIt first, ForwardIt last) {
+        return enqueue_bulk(first, static_cast<size_t>(std::distance(first, last)));
+    }
+
+    // Dequeues up to max items into out with a single head publish and
+    // returns how many were taken.
+    template<typename OutputIt>
+    size_t dequeue_bulk(OutputIt out, size_t max) {
+        const std::uint64_t currentHead = head.load(std::memory_order_relaxed);
+        size_t available = static_cast<size_t>(cachedTail - currentHead);
+        if (available < max) {
+            cachedTail = tail.load(std::memory_order_acquire);
+            available = static_cast<size_t>(cachedTail - currentHead);
+        }
+        const size_t count = std::min(max, available);
+        if (count == 0) {
+            statistics.onDequeueEmpty();
+            return 0;
         }
+        const size_t offset = static_cast<size_t>(currentHead & mask);
+        const size_t firstRun = std::min(count, mask + 1 - offset);
+        out = std::move(data + offset, data + offset + firstRun, out);
+        std::move(&data[0], data + (count - firstRun), out);
+        std::destroy(data + offset, data + offset + firstRun);
+        std::destroy(&data[0], data + (count - firstRun));
+        head.store(currentHead + count, std::memory_order_release);
+        statistics.onDequeue(count);
+        return count;
+    }
+
+    // Zero-copy producer side: returns the next run of free slots and sets n
+    // to its length, which may be less than asked for when the ring is nearly
+    // full or the run reaches the wrap point (call again after commit for the
+    // rest). Fill the slots in place, e.g. recv() straight into them, then
+    // commit() how many were filled. Returns nullptr when nothing is free.
+    //
+    // The slots are raw storage, so this is only offered for trivially
+    // copyable, trivially destructible T.
+    T* reserve(size_t& n) {
+        static_assert(std::is_trivially_copyable<T>::value && std::is_trivially_destructible<T>::value,
+                      "reserve/commit hands out raw slots; use emplace for non-trivial types.");
+        const std::uint64_t currentTail = tail.load(std::memory_order_relaxed);
+        size_t free = freeSlots(currentTail);
+        if (free < n) {
+            cachedHead = head.load(std::memory_order_acquire);
+            free = freeSlots(currentTail);
+        }
+        const size_t offset = static_cast<size_t>(currentTail & mask);
+        n = std::min({n, free, mask + 1 - offset});
+        if (n == 0) {
+            statistics.onEnqueueFull();
+            return nullptr;
+        }
+        return data + offset;
+    }
+
+    // Publishes the first n slots of the last reserve().
+    void commit(size_t n) {
+        const std::uint64_t nextTail = tail.load(std::memory_order_relaxed) + n;
+        tail.store(nextTail, std::memory_order_release);
+        recordEnqueue(nextTail, n);
+        waiter.notify(n);
+    }
+
+    // Zero-copy consumer side: returns the oldest run of elements, in place,
+    // and sets n to its length (bounded by the wrap point like reserve). Call
+    // release() with how many were processed to hand the slots back.
+    T* peek(size_t& n) {
+        static_assert(std::is_trivially_copyable<T>::value && std::is_trivially_destructible<T>::value,
+                      "peek/release is only offered for trivially copyable types.");
+        const std::uint64_t currentHead = head.load(std::memory_order_relaxed);
+        size_t available = static_cast<size_t>(cachedTail - currentHead);
+        if (available < n) {
+            cachedTail = tail.load(std::memory_order_acquire);
+            available = static_cast<size_t>(cachedTail - currentHead);
+        }
+        const size_t offset = static_cast<size_t>(currentHead & mask);
+        n = std::min({n, available, mask + 1 - offset});
+        if (n == 0) {
+            statistics.onDequeueEmpty();
+            return nullptr;
+        }
+        return data + offset;
+    }
+
+    void release(size_t n) {
+        head.store(head.load(std::memory_order_relaxed) + n, std::memory_order_release);
+        statistics.onDequeue(n);
     }
 
     bool empty() const {
-        return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire);
+        return size() == 0;
     }
 
     bool full() const {
-        size_t currentTail = tail.load(std::memory_order_acquire);
-        size_t nextTail = (currentTail + 1) & mask;
-        return nextTail == head.load(std::memory_order_acquire);
+        return size() > mask;
     }
 
+    // Exact from either end; a snapshot from any other thread. head is read
+    // first so the result never goes negative.
     size_t size() const {
-        size_t currentHead = head.load(std::memory_order_acquire);
-        size_t currentTail = tail.load(std::memory_order_acquire);
-        return (currentTail - currentHead + Capacity) & mask;
+        const std::uint64_t currentHead = head.load(std::memory_order_acquire);
+        const std::uint64_t currentTail = tail.load(std::memory_order_acquire);
+        return static_cast<size_t>(std::min<std::uint64_t>(currentTail - currentHead, mask + 1));
     }
 
     size_t capacity() const {
-        return Capacity;
+        return mask + 1;
+    }
+
+    // Sequence number of the next element dequeue() will return, i.e. how
+    // many have been dequeued so far. Exact on the consumer thread.
+    std::uint64_t read_sequence() const {
+        return head.load(std::memory_order_acquire);
+    }
+
+    // Sequence number the next enqueued element will get, i.e. how many have
+    // been enqueued so far. Exact on the producer thread.
+    std::uint64_t write_sequence() const {
+        return tail.load(std::memory_order_acquire);
+    }
+
+    const stats_type& stats() const {
+        return statistics;
     }
 
 private:
-    std::vector<T> data;
-    std::atomic<size_t> head, tail;
+    T& slot(std::uint64_t position) {
+        return data[position & mask];
+    }
+
+    size_t freeSlots(std::uint64_t currentTail) const {
+        return mask + 1 - static_cast<size_t>(currentTail - cachedHead);
+    }
+
+    bool readable(std::uint64_t currentHead) {
+        if (currentHead == cachedTail) {
+            cachedTail = tail.load(std::memory_order_acquire);
+            if (currentHead == cachedTail) {
+                statistics.onDequeueEmpty();
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Occupancy is only read back when statistics are enabled.
+    void recordEnqueue(std::uint64_t newTail, size_t count) {
+        if constexpr (stats_type::enabled) {
+            statistics.onEnqueue(count, static_cast<size_t>(newTail - head.load(std::memory_order_relaxed)));
+        }
+    }
+
+    SlotStorage<T, Capacity, allocator_type> data;
     size_t mask;
+
+    // Consumer-owned line: head plus the consumer's view of tail.
+    alignas(CACHE_LINE_SIZE) atomic_type<std::uint64_t> head;
+    std::uint64_t cachedTail = 0;
+
+    // Producer-owned line: tail plus the producer's view of head.
+    alignas(CACHE_LINE_SIZE) atomic_type<std::uint64_t> tail;
+    std::uint64_t cachedHead = 0;
+
+    alignas(CACHE_LINE_SIZE) typename Traits::wait_strategy waiter;
+    stats_type statistics;
 };
 
-template<typename T, size_t Capacity>
-class SPSCQueue {
+// Bounded multi-producer/multi-consumer ring after Dmitry Vyukov's design.
+// Every slot carries a sequence number: a slot at position p is free for the
+// producer that claims p when its sequence equals p, and holds an element for
+// the consumer that claims p when its sequence equals p + 1. Producers and
+// consumers each CAS only their own index, so neither side takes a lock and
+// all slots are usable. Once a position is claimed the element
+// constructor must not throw, as the slot cannot be handed back.
+template<typename T, size_t Capacity = DynamicCapacity, typename Traits = QueueTraits>
+class MPMCQueue {
 public:
-    SPSCQueue() : mask(Capacity - 1) {
-        if (Capacity & mask) {
-            throw std::invalid_argument("Capacity must be a power of two.");
+    using allocator_type = typename Traits::allocator;
+    template<typename V>
+    using atomic_type = typename Traits::concurrency::template atomic<V>;
+
+    explicit MPMCQueue(const allocator_type& allocator = allocator_type())
+        : MPMCQueue(Capacity, allocator) {}
+
+    explicit MPMCQueue(size_t capacity, const allocator_type& allocator = allocator_type())
+        : slots(checkCapacity(capacity, Capacity), allocator), mask(capacity - 1) {
+        for (size_t i = 0; i < capacity; ++i) {
+            new (slots + i) Slot();
+            slots[i].sequence.store(i, std::memory_order_relaxed);
         }
-        data.resize(Capacity);
         head.store(0, std::memory_order_relaxed);
         tail.store(0, std::memory_order_relaxed);
     }
 
+    ~MPMCQueue() {
+        const size_t currentTail = tail.load(std::memory_order_relaxed);
+        for (size_t i = head.load(std::memory_order_relaxed); i != currentTail; ++i) {
+            slots[i & mask].value()->~T();
+        }
+    }
+
     bool enqueue(const T& value) {
-        size_t currentTail = tail.load(std::memory_order_acquire);
+        return emplace(value);
+    }
+
+    bool enqueue(T&& value) {
+        return emplace(std::move(value));
+    }
+
+    template<typename... Args>
+    bool emplace(Args&&... args) {
+        size_t position = tail.load(std::memory_order_relaxed);
+        Slot* slot;
+        typename Traits::backoff backoff;
         while (true) {
-            size_t nextTail = (currentTail + 1) & mask;
-            if (nextTail == head.load(std::memory_order_acquire)) {
+            slot = &slots[position & mask];
+            const size_t sequence = slot->sequence.load(std::memory_order_acquire);
+            const std::ptrdiff_t diff = static_cast<std::ptrdiff_t>(sequence - position);
+            if (diff == 0) {
+                if (tail.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+                backoff.pause();
+            } else if (diff < 0) {
                 return false;
-            }
-            data[currentTail] = value;
-            if (tail.compare_exchange_weak(currentTail, nextTail, std::memory_order_release, std::memory_order_acquire)) {
-                return true;
+            } else {
+                // Another thread claimed this position first.
+                backoff.pause();
+                position = tail.load(std::memory_order_relaxed);
             }
         }
+        new (slot->storage) T(std::forward<Args>(args)...);
+        slot->sequence.store(position + 1, std::memory_order_release);
+        waiter.notify(1);
+        return true;
     }
 
-    template<typename... Args>
-    bool emplace(Args&&... args) {
-        T value(std::forward<Args>(args)...);
-        return enqueue(std::move(value));
+    bool dequeue(T& result) {
+        size_t position;
+        Slot* slot = claim(position);
+        if (slot == nullptr) {
+            return false;
+        }
+        result = std::move(*slot->value());
+        release(slot, position);
+        return true;
     }
 
-    bool dequeue(T& result) {
-        size_t currentHead = head.load(std::memory_order_acquire);
-        while (true) {
-            size_t currentTail = tail.load(std::memory_order_acquire);
-            if (currentHead == currentTail) {
-                return false;
-            }
-            result = data[currentHead];
-            size_t nextHead = (currentHead + 1) & mask;
-            if (head.compare_exchange_weak(currentHead, nextHead, std::memory_order_release, std::memory_order_acquire)) {
-                return true;
-            }
+    // Blocks until an element is available, in the manner chosen by
+    // Traits::wait_strategy.
+    void pop(T& result) {
+        waiter.wait([&] { return dequeue(result); });
+    }
+
+    template<typename Rep, typename Period>
+    bool try_pop_for(T& result, const std::chrono::duration<Rep, Period>& timeout) {
+        const auto deadline = std::chrono::steady_clock::now() + timeout;
+        return waiter.waitUntil([&] { return dequeue(result); }, deadline);
+    }
+
+    std::optional<T> try_pop() {
+        size_t position;
+        Slot* slot = claim(position);
+        if (slot == nullptr) {
+            return std::nullopt;
         }
+        std::optional<T> result(std::move(*slot->value()));
+        release(slot, position);
+        return result;
     }
 
     bool empty() const {
-        return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire);
+        return size() == 0;
     }
 
     bool full() const {
-        size_t currentTail = tail.load(std::memory_order_acquire);
-        size_t nextTail = (currentTail + 1) & mask;
-        return nextTail == head.load(std::memory_order_acquire);
+        return size() > mask;
     }
 
+    // Only a snapshot while other threads are active; the two indices are
+    // read separately and a claimed position may not be filled yet.
     size_t size() const {
-        size_t currentHead = head.load(std::memory_order_acquire);
-        size_t currentTail = tail.load(std::memory_order_acquire);
-        return (currentTail - currentHead + Capacity) & mask;
+        const size_t currentHead = head.load(std::memory_order_acquire);
+        const size_t currentTail = tail.load(std::memory_order_acquire);
+        return currentTail > currentHead ? currentTail - currentHead : 0;
     }
 
     size_t capacity() const {
-        return Capacity;
+        return mask + 1;
     }
 
 private:
-    //std::vector<T, std::aligned_storage_t<sizeof(T), alignof(T)>> data;
-    std::vector<T> data;
-    std::atomic<size_t> head, tail;
+    struct Slot {
+        atomic_type<size_t> sequence;
+        alignas(T) unsigned char storage[sizeof(T)];
+
+        T* value() { return std::launder(reinterpret_cast<T*>(storage)); }
+    };
+
+    Slot* claim(size_t& position) {
+        position = head.load(std::memory_order_relaxed);
+        typename Traits::backoff backoff;
+        while (true) {
+            Slot* slot = &slots[position & mask];
+            const size_t sequence = slot->sequence.load(std::memory_order_acquire);
+            const std::ptrdiff_t diff = static_cast<std::ptrdiff_t>(sequence - (position + 1));
+            if (diff == 0) {
+                if (head.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                    return slot;
+                }
+                backoff.pause();
+            } else if (diff < 0) {
+                return nullptr;
+            } else {
+                // Another thread claimed this position first.
+                backoff.pause();
+                position = head.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // Destroys the moved-from element and frees the slot for the producer
+    // that will claim it one lap later.
+    void release(Slot* slot, size_t position) {
+        slot->value()->~T();
+        slot->sequence.store(position + mask + 1, std::memory_order_release);
+    }
+
+    SlotStorage<Slot, Capacity, allocator_type> slots;
     size_t mask;
+
+    alignas(CACHE_LINE_SIZE) atomic_type<size_t> head;
+    alignas(CACHE_LINE_SIZE) atomic_type<size_t> tail;
+    alignas(CACHE_LINE_SIZE) typename Traits::wait_strategy waiter;
+};
+
+// Chase-Lev work-stealing deque (with the memory orderings of Le et al.,
+// "Correct and Efficient Work-Stealing for Weak Memory Models"). The owner
+// thread pushes and pops LIFO at the bottom and only CASes when it races a
+// thief for the last element; any number of thieves steal FIFO from the top
+// with one CAS each. The ring doubles when full. Readers may still be looking
+// at a retired ring, so those are kept until the deque is destroyed.
+//
+// Thieves read an element before their CAS decides whether they own it, so T
+// must be trivially copyable (task pointers, indices, small handles).
+template<typename T>
+class WorkStealingDeque {
+    static_assert(std::is_trivially_copyable<T>::value, "WorkStealingDeque requires a trivially copyable T.");
+
+public:
+    explicit WorkStealingDeque(size_t initialCapacity = 1024) {
+        if (initialCapacity == 0 || (initialCapacity & (initialCapacity - 1))) {
+            throw std::invalid_argument("Capacity must be a power of two.");
+        }
+        rings.emplace_back(new Ring(initialCapacity));
+        ring.store(rings.back().get(), std::memory_order_relaxed);
+        top.store(0, std::memory_order_relaxed);
+        bottom.store(0, std::memory_order_relaxed);
+    }
+
+    // Owner only.
+    void push(const T& value) {
+        const std::int64_t b = bottom.load(std::memory_order_relaxed);
+        const std::int64_t t = top.load(std::memory_order_acquire);
+        Ring* r = ring.load(std::memory_order_relaxed);
+        if (b - t > static_cast<std::int64_t>(r->mask)) {
+            r = grow(r, t, b);
+        }
+        r->store(b, value);
+        bottom.store(b + 1, std::memory_order_release);
+    }
+
+    // Owner only. Takes the most recently pushed element.
+    bool pop(T& result) {
+        const std::int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+        Ring* r = ring.load(std::memory_order_relaxed);
+        bottom.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        std::int64_t t = top.load(std::memory_order_relaxed);
+        if (t > b) {
+            bottom.store(b + 1, std::memory_order_relaxed);
+            return false;
+        }
+        const T value = r->load(b);
+        if (t == b) {
+            // Last element: thieves may be after it too.
+            const bool won = top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+            bottom.store(b + 1, std::memory_order_relaxed);
+            if (!won) {
+                return false;
+            }
+        }
+        result = value;
+        return true;
+    }
+
+    // Any thread. Takes the oldest element; fails when empty or when another
+    // thread got there first.
+    bool steal(T& result) {
+        std::int64_t t = top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        const std::int64_t b = bottom.load(std::memory_order_acquire);
+        if (t >= b) {
+            return false;
+        }
+        const T value = ring.load(std::memory_order_acquire)->load(t);
+        if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+            return false;
+        }
+        result = value;
+        return true;
+    }
+
+    bool empty() const {
+        return size() == 0;
+    }
+
+    size_t size() const {
+        const std::int64_t b = bottom.load(std::memory_order_acquire);
+        const std::int64_t t = top.load(std::memory_order_acquire);
+        return b > t ? static_cast<size_t>(b - t) : 0;
+    }
+
+    size_t capacity() const {
+        return ring.load(std::memory_order_acquire)->mask + 1;
+    }
+
+private:
+    struct Ring {
+        explicit Ring(size_t capacity) : mask(capacity - 1), slots(new std::atomic<T>[capacity]) {}
+
+        T load(std::int64_t i) const { return slots[static_cast<size_t>(i) & mask].load(std::memory_order_relaxed); }
+        void store(std::int64_t i, const T& value) { slots[static_cast<size_t>(i) & mask].store(value, std::memory_order_relaxed); }
+
+        size_t mask;
+        std::unique_ptr<std::atomic<T>[]> slots;
+    };
+
+    Ring* grow(Ring* old, std::int64_t t, std::int64_t b) {
+        rings.emplace_back(new Ring((old->mask + 1) * 2));
+        Ring* bigger = rings.back().get();
+        for (std::int64_t i = t; i < b; ++i) {
+            bigger->store(i, old->load(i));
+        }
+        ring.store(bigger, std::memory_order_release);
+        return bigger;
+    }
+
+    // Touched by the owner only; the current ring is always rings.back().
+    std::vector<std::unique_ptr<Ring>> rings;
+
+    alignas(CACHE_LINE_SIZE) std::atomic<std::int64_t> top;
+    alignas(CACHE_LINE_SIZE) std::atomic<std::int64_t> bottom;
+    std::atomic<Ring*> ring;
 };
 
 #endif // QUEUE_H
@@ -0,0 +1,200 @@
+#ifndef QUEUE_SET_H
+#define QUEUE_SET_H
+
+#include "Queue.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#if defined(__linux__)
+#include <cerrno>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#endif
+
+// A fixed set of SPSCQueues drained by one consumer. Producers mark their
+// queue in a shared ready bitmap when they publish into it, so the consumer
+// only reads the bitmap and the queues that actually have data instead of
+// polling empty() on every ring.
+//
+// The bitmap is spread over up to MaxShards cache lines (queue i lives in
+// shard i % shards) so producers of different queues rarely write the same
+// line. A producer only does the read-modify-write when its bit is clear,
+// i.e. on the queue's empty -> non-empty transition as the consumer sees it.
+//
+// On Linux the set can also signal an eventfd whenever a bit goes up while
+// the consumer is not already due to look, so the consumer can wait in
+// epoll alongside its sockets.
+template<typename T, size_t Capacity = DynamicCapacity, typename Traits = QueueTraits>
+class QueueSet {
+public:
+    using queue_type = SPSCQueue<T, Capacity, Traits>;
+
+    static constexpr size_t MaxShards = 8;
+
+    explicit QueueSet(size_t count, size_t capacity = Capacity, bool useEventFd = false)
+        : shardCount(std::max((count + 63) / 64, std::min(count, MaxShards))) {
+        if (count == 0) {
+            throw std::invalid_argument("QueueSet needs at least one queue.");
+        }
+        for (size_t i = 0; i < count; ++i) {
+            queues.emplace_back(new queue_type(capacity));
+        }
+        shards.reset(new Shard[shardCount]);
+        if (useEventFd) {
+#if defined(__linux__)
+            eventFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+            if (eventFd < 0) {
+                const int error = errno;
+                throw std::system_error(error, std::generic_category(), "eventfd");
+            }
+#else
+            throw std::invalid_argument("eventfd signalling is only available on Linux.");
+#endif
+        }
+    }
+
+    ~QueueSet() {
+#if defined(__linux__)
+        if (eventFd >= 0) {
+            close(eventFd);
+        }
+#endif
+    }
+
+    QueueSet(const QueueSet&) = delete;
+    QueueSet& operator=(const QueueSet&) = delete;
+
+    // Producer of queue index only.
+    template<typename... Args>
+    bool emplace(size_t index, Args&&... args) {
+        if (!queues[index]->emplace(std::forward<Args>(args)...)) {
+            return false;
+        }
+        markReady(index);
+        return true;
+    }
+
+    bool enqueue(size_t index, const T& value) {
+        return emplace(index, value);
+    }
+
+    bool enqueue(size_t index, T&& value) {
+        return emplace(index, std::move(value));
+    }
+
+    // Consumer: takes up to batch elements from every ready queue, calling
+    // handler(index, T&) for each, and returns how many were handled. The
+    // scan starts one shard further along on every call, and queues that
+    // still hold data after their batch stay marked, so one busy session
+    // cannot starve the others.
+    template<typename Handler>
+    size_t drain(Handler&& handler, size_t batch = 16) {
+#if defined(__linux__)
+        if (eventFd >= 0 && signalled.exchange(false, std::memory_order_seq_cst)) {
+            std::uint64_t ignored;
+            (void)!read(eventFd, &ignored, sizeof(ignored));
+        }
+#endif
+        size_t handled = 0;
+        bool leftover = false;
+        const size_t start = nextShard;
+        nextShard = (nextShard + 1) % shardCount;
+        for (size_t s = 0; s < shardCount; ++s) {
+            const size_t shard = (start + s) % shardCount;
+            std::uint64_t ready = shards[shard].bits.exchange(0, std::memory_order_seq_cst);
+            while (ready != 0) {
+                const unsigned bit = lowestBit(ready);
+                ready &= ready - 1;
+                const size_t index = bit * shardCount + shard;
+                queue_type& queue = *queues[index];
+                size_t taken = 0;
+                for (; taken < batch; ++taken) {
+                    std::optional<T> value = queue.try_pop();
+                    if (!value) {
+                        break;
+                    }
+                    handler(index, *value);
+                }
+                handled += taken;
+                if (taken == batch && !queue.empty()) {
+                    shards[shard].bits.fetch_or(std::uint64_t(1) << bit, std::memory_order_relaxed);
+                    leftover = true;
+                }
+            }
+        }
+        // Queues cut off by the batch limit need another round even if the
+        // caller goes back to epoll first.
+        if (leftover) {
+            signal();
+        }
+        return handled;
+    }
+
+    size_t size() const {
+        return queues.size();
+    }
+
+    // Readable whenever drain() has something to do; -1 unless the set
+    // was built with useEventFd.
+    int event_fd() const {
+        return eventFd;
+    }
+
+private:
+    struct alignas(CACHE_LINE_SIZE) Shard {
+        std::atomic<std::uint64_t> bits{0};
+    };
+
+    void markReady(size_t index) {
+        Shard& shard = shards[index % shardCount];
+        const std::uint64_t bit = std::uint64_t(1) << (index / shardCount);
+        // Pairs with the exchange in drain(): either the consumer's dequeue
+        // sees the element, or we see our bit cleared and set it again.
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (shard.bits.load(std::memory_order_relaxed) & bit) {
+            return;
+        }
+        shard.bits.fetch_or(bit, std::memory_order_seq_cst);
+        signal();
+    }
+
+    // Writes the eventfd unless a wakeup is already pending.
+    void signal() {
+#if defined(__linux__)
+        if (eventFd >= 0 && !signalled.exchange(true, std::memory_order_seq_cst)) {
+            const std::uint64_t one = 1;
+            (void)!write(eventFd, &one, sizeof(one));
+        }
+#endif
+    }
+
+    static unsigned lowestBit(std::uint64_t word) {
+#if defined(__GNUC__) || defined(__clang__)
+        return static_cast<unsigned>(__builtin_ctzll(word));
+#else
+        unsigned bit = 0;
+        while ((word & 1) == 0) {
+            word >>= 1;
+            ++bit;
+        }
+        return bit;
+#endif
+    }
+
+    std::vector<std::unique_ptr<queue_type>> queues;
+    size_t shardCount;
+    std::unique_ptr<Shard[]> shards;
+    int eventFd = -1;
+    alignas(CACHE_LINE_SIZE) std::atomic<bool> signalled{false};
+    size_t nextShard = 0;
+};
+
+#endif // QUEUE_SET_H
@@ -0,0 +1,108 @@
+#ifndef QUEUE_STATS_H
+#define QUEUE_STATS_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include "ShardedCounter.h"
+
+// Statistics policies for the rings, chosen through QueueTraits::stats. The
+// queue calls these hooks:
+//
+//   void onEnqueue(size_t count, size_t occupancy);  // producer only
+//   void onEnqueueFull();
+//   void onDequeue(size_t count);
+//   void onDequeueEmpty();
+//   void onCasRetry();
+//
+// and only computes occupancy when `enabled` is true, so NullQueueStats
+// compiles to nothing. pop() and try_pop_for() go through dequeue(), so every
+// empty attempt they make while waiting is counted as well.
+
+struct QueueStatsSnapshot {
+    std::uint64_t enqueued = 0;
+    std::uint64_t dequeued = 0;
+    std::uint64_t enqueueFull = 0;
+    std::uint64_t dequeueEmpty = 0;
+    std::uint64_t casRetries = 0;
+    size_t highWater = 0;
+};
+
+struct NullQueueStats {
+    static constexpr bool enabled = false;
+
+    void onEnqueue(size_t, size_t) {}
+    void onEnqueueFull() {}
+    void onDequeue(size_t) {}
+    void onDequeueEmpty() {}
+    void onCasRetry() {}
+
+    QueueStatsSnapshot snapshot() const { return {}; }
+    void reset() {}
+};
+
+// Counters on a ShardedCounters, so each thread updates its own cache line
+// and snapshot() sums the lanes.
+class QueueStats {
+public:
+    static constexpr bool enabled = true;
+    static constexpr size_t Lanes = ShardedDefaultLanes;
+
+    void onEnqueue(size_t count, size_t occupancy) {
+        counters.add(Enqueued, count);
+        // Only the producer calls this, so a plain compare is enough.
+        if (occupancy > highWater.load(std::memory_order_relaxed)) {
+            highWater.store(occupancy, std::memory_order_relaxed);
+        }
+    }
+
+    void onEnqueueFull() {
+        counters.add(EnqueueFull, 1);
+    }
+
+    void onDequeue(size_t count) {
+        counters.add(Dequeued, count);
+    }
+
+    void onDequeueEmpty() {
+        counters.add(DequeueEmpty, 1);
+    }
+
+    void onCasRetry() {
+        counters.add(CasRetries, 1);
+    }
+
+    // Approximate while the queue is in use: lanes are read one at a time.
+    QueueStatsSnapshot snapshot() const {
+        const auto sums = counters.snapshot();
+        QueueStatsSnapshot result;
+        result.enqueued = sums[Enqueued];
+        result.dequeued = sums[Dequeued];
+        result.enqueueFull = sums[EnqueueFull];
+        result.dequeueEmpty = sums[DequeueEmpty];
+        result.casRetries = sums[CasRetries];
+        result.highWater = highWater.load(std::memory_order_relaxed);
+        return result;
+    }
+
+    void reset() {
+        counters.reset();
+        highWater.store(0, std::memory_order_relaxed);
+    }
+
+private:
+    enum Counter : size_t {
+        Enqueued,
+        Dequeued,
+        EnqueueFull,
+        DequeueEmpty,
+        CasRetries,
+        CounterCount
+    };
+
+    ShardedCounters<std::uint64_t, CounterCount, Lanes> counters;
+    alignas(64) std::atomic<size_t> highWater{0};
+};
+
+#endif // QUEUE_STATS_H
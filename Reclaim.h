@@ -0,0 +1,528 @@
+#ifndef RECLAIM_H
+#define RECLAIM_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Deferred freeing for lock-free structures: a writer that unlinks an object
+// other threads may still be reading hands it to retire() instead of
+// deleting it, and the domain runs its deleter once no reader can hold it.
+//
+// EpochDomain: readers bracket each operation with a Guard, which costs a
+// store and a fence. A retired object waits for every reader that was inside
+// a guard when it was retired, so one stalled reader holds back all garbage.
+//
+// HazardDomain: readers publish each pointer they are about to dereference
+// in a Hazard. Only objects currently published are held back, so garbage
+// stays bounded by the collect threshold plus the number of hazards, at the
+// cost of a fence per protected load.
+//
+// Retired objects are batched: retire() pushes onto a lock-free list, and
+// every so many retires (collectThreshold, growing with whatever the last
+// pass could not free, so the cost per retire stays constant) the retiring
+// thread runs a collection pass. With a threshold of 0 nothing is collected
+// inline, and a BackgroundReclaimer, or explicit collect() calls, do it.
+// Deleters run on whichever thread collects, outside any lock.
+//
+// Each thread claims a reader record per domain on first use and gives it
+// back at thread exit. With more than MaxReaders (MaxThreads) threads at
+// once, a Guard (Hazard) reports failure and the caller falls back to a
+// locked path.
+
+namespace detail {
+
+// One retired object; the deleter lives in the derived RetiredHolder.
+struct RetiredNode {
+    RetiredNode* next = nullptr;
+    void* object = nullptr;
+    void (*reclaim)(RetiredNode*) = nullptr;
+    std::uint64_t epoch = 0;
+};
+
+template<typename T, typename Deleter>
+struct RetiredHolder final : RetiredNode {
+    RetiredHolder(T* p, Deleter&& d) : deleter(std::move(d)) {
+        object = p;
+        reclaim = &run;
+    }
+
+    static void run(RetiredNode* node) {
+        RetiredHolder* holder = static_cast<RetiredHolder*>(node);
+        holder->deleter(static_cast<T*>(holder->object));
+        delete holder;
+    }
+
+    Deleter deleter;
+};
+
+// Lock-free list of retired objects with amortised collection.
+class RetiredList {
+public:
+    explicit RetiredList(size_t collectThreshold)
+        : threshold_(collectThreshold), collectAt_(collectThreshold) {}
+
+    // Frees everything; no reader may remain.
+    ~RetiredList() {
+        sweep([](const RetiredNode*) { return false; });
+    }
+
+    RetiredList(const RetiredList&) = delete;
+    RetiredList& operator=(const RetiredList&) = delete;
+
+    // True when the caller should run a collection pass now.
+    bool push(RetiredNode* node) {
+        node->next = head_.load(std::memory_order_relaxed);
+        while (!head_.compare_exchange_weak(node->next, node, std::memory_order_release, std::memory_order_relaxed)) {
+        }
+        pending_.fetch_add(1, std::memory_order_relaxed);
+        if (threshold_ == 0 || sinceCollect_.fetch_add(1, std::memory_order_relaxed) + 1 < collectAt_.load(std::memory_order_relaxed)) {
+            return false;
+        }
+        sinceCollect_.store(0, std::memory_order_relaxed);
+        return true;
+    }
+
+    // Runs the deleter of every node keep() rejects and puts the rest back.
+    // Returns how many were freed.
+    template<typename Keep>
+    size_t sweep(Keep&& keep) {
+        RetiredNode* node = head_.exchange(nullptr, std::memory_order_acquire);
+        RetiredNode* keptHead = nullptr;
+        RetiredNode* keptTail = nullptr;
+        size_t freed = 0;
+        while (node != nullptr) {
+            RetiredNode* next = node->next;
+            if (keep(node)) {
+                node->next = keptHead;
+                keptHead = node;
+                if (keptTail == nullptr) {
+                    keptTail = node;
+                }
+            } else {
+                node->reclaim(node);
+                ++freed;
+            }
+            node = next;
+        }
+        if (keptHead != nullptr) {
+            keptTail->next = head_.load(std::memory_order_relaxed);
+            while (!head_.compare_exchange_weak(keptTail->next, keptHead, std::memory_order_release, std::memory_order_relaxed)) {
+            }
+        }
+        const size_t left = pending_.fetch_sub(freed, std::memory_order_relaxed) - freed;
+        collectAt_.store(std::max(threshold_, left), std::memory_order_relaxed);
+        return freed;
+    }
+
+    size_t pending() const {
+        return pending_.load(std::memory_order_relaxed);
+    }
+
+private:
+    const size_t threshold_;
+    std::atomic<RetiredNode*> head_{nullptr};
+    std::atomic<size_t> pending_{0};
+    std::atomic<size_t> sinceCollect_{0};
+    std::atomic<size_t> collectAt_;
+};
+
+template<typename T, typename Deleter>
+RetiredNode* makeRetired(T* p, Deleter&& d) {
+    return new RetiredHolder<T, std::decay_t<Deleter>>(p, std::decay_t<Deleter>(std::forward<Deleter>(d)));
+}
+
+// Which domains are alive, so that a thread exiting after a domain was
+// destroyed does not touch the domain's records.
+class ReclaimRegistry {
+public:
+    static ReclaimRegistry& instance() {
+        static ReclaimRegistry registry;
+        return registry;
+    }
+
+    std::uint64_t add() {
+        std::lock_guard<std::mutex> lock(mutex);
+        live.push_back(++lastId);
+        return lastId;
+    }
+
+    void remove(std::uint64_t id) {
+        std::lock_guard<std::mutex> lock(mutex);
+        live.erase(std::find(live.begin(), live.end(), id));
+    }
+
+    // Drops the entries whose id names a domain destroyed since.
+    template<typename Entry>
+    void prune(std::vector<Entry>& entries, std::uint64_t Entry::*id) {
+        std::lock_guard<std::mutex> lock(mutex);
+        // Ids only grow, so live stays sorted.
+        entries.erase(std::remove_if(entries.begin(), entries.end(),
+                                     [this, id](const Entry& entry) {
+                                         return !std::binary_search(live.begin(), live.end(), entry.*id);
+                                     }),
+                      entries.end());
+    }
+
+    std::mutex mutex;
+    std::vector<std::uint64_t> live;
+    std::uint64_t lastId = 0;
+};
+
+// The records this thread has claimed, one per domain.
+struct ReclaimClaims {
+    struct Claim {
+        std::uint64_t domain;
+        void* record;
+        std::atomic<bool>* owned;
+    };
+
+    ~ReclaimClaims() {
+        ReclaimRegistry& registry = ReclaimRegistry::instance();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        for (const Claim& claim : claims) {
+            if (std::binary_search(registry.live.begin(), registry.live.end(), claim.domain)) {
+                claim.owned->store(false, std::memory_order_release);
+            }
+        }
+    }
+
+    static ReclaimClaims& local() {
+        static thread_local ReclaimClaims claims;
+        return claims;
+    }
+
+    // The record this thread holds in domain, claimed from records on first
+    // use; nullptr while they are all taken, so a later call tries again.
+    template<typename Record, size_t N>
+    Record* claim(std::uint64_t domain, Record (&records)[N]) {
+        for (const Claim& c : claims) {
+            if (c.domain == domain) {
+                return static_cast<Record*>(c.record);
+            }
+        }
+        for (Record& record : records) {
+            if (!record.owned.load(std::memory_order_relaxed) && !record.owned.exchange(true, std::memory_order_acquire)) {
+                ReclaimRegistry::instance().prune(claims, &Claim::domain);
+                claims.push_back(Claim{domain, &record, &record.owned});
+                return &record;
+            }
+        }
+        return nullptr;
+    }
+
+    std::vector<Claim> claims;
+};
+
+} // namespace detail
+
+// Epoch-based reclamation. A reader announces the current epoch for the
+// duration of its read; retire() stamps an object with the epoch at that
+// time, and it is freed once every announced epoch is newer.
+class EpochDomain {
+public:
+    static constexpr size_t MaxReaders = 256;
+
+    class Guard {
+    public:
+        explicit Guard(EpochDomain& domain) : slot_(domain.localSlot()) {
+            if (slot_ == nullptr) {
+                return;
+            }
+            if (slot_->load(std::memory_order_relaxed) != 0) {
+                // Already inside a read on this thread; the outer guard covers us.
+                slot_ = nullptr;
+                nested_ = true;
+                return;
+            }
+            slot_->store(domain.epoch_.load(std::memory_order_seq_cst), std::memory_order_relaxed);
+            // Pairs with the fence in safeBefore(): either the writer sees this
+            // announcement, or our reads see what it unlinked first.
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+        }
+
+        ~Guard() {
+            if (slot_ != nullptr) {
+                slot_->store(0, std::memory_order_release);
+            }
+        }
+
+        Guard(const Guard&) = delete;
+        Guard& operator=(const Guard&) = delete;
+
+        // Whether the caller may read without its lock.
+        explicit operator bool() const {
+            return slot_ != nullptr || nested_;
+        }
+
+    private:
+        std::atomic<std::uint64_t>* slot_;
+        bool nested_ = false;
+    };
+
+    explicit EpochDomain(size_t collectThreshold = 64)
+        : id_(detail::ReclaimRegistry::instance().add()), retired_(collectThreshold) {}
+
+    // Frees whatever is still retired; no reader may remain.
+    ~EpochDomain() {
+        detail::ReclaimRegistry::instance().remove(id_);
+    }
+
+    EpochDomain(const EpochDomain&) = delete;
+    EpochDomain& operator=(const EpochDomain&) = delete;
+
+    // Frees p with deleter(p) once no guard that might have seen it is
+    // still open. p must already be unreachable for new readers.
+    template<typename T, typename Deleter = std::default_delete<T>>
+    void retire(T* p, Deleter deleter = Deleter()) {
+        detail::RetiredNode* node = detail::makeRetired(p, std::move(deleter));
+        node->epoch = retireEpoch();
+        if (retired_.push(node)) {
+            collect();
+        }
+    }
+
+    // Frees every retired object no reader can reach; returns how many.
+    size_t collect() {
+        const std::uint64_t safe = safeBefore();
+        return retired_.sweep([safe](const detail::RetiredNode* node) { return node->epoch >= safe; });
+    }
+
+    // Retired and not yet freed.
+    size_t pending() const {
+        return retired_.pending();
+    }
+
+    // Stamp for an object just unlinked, for callers that keep their own
+    // retired lists.
+    std::uint64_t retireEpoch() const {
+        // The unlink may have been a plain release store, which the load
+        // below could otherwise pass; then a reader announcing the next
+        // epoch could still reach the object after it is freed. Pairs with
+        // the fence in Guard.
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        return epoch_.load(std::memory_order_seq_cst);
+    }
+
+    // Advances the epoch and returns the oldest epoch a reader may still be
+    // in; objects retired strictly before it are unreachable.
+    std::uint64_t safeBefore() {
+        const std::uint64_t current = epoch_.fetch_add(1, std::memory_order_seq_cst) + 1;
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        std::uint64_t oldest = current;
+        for (const Slot& slot : slots_) {
+            const std::uint64_t announced = slot.epoch.load(std::memory_order_seq_cst);
+            if (announced != 0 && announced < oldest) {
+                oldest = announced;
+            }
+        }
+        return oldest;
+    }
+
+private:
+    struct alignas(64) Slot {
+        std::atomic<std::uint64_t> epoch{0};
+        std::atomic<bool> owned{false};
+    };
+
+    std::atomic<std::uint64_t>* localSlot() {
+        Slot* slot = detail::ReclaimClaims::local().claim(id_, slots_);
+        return slot != nullptr ? &slot->epoch : nullptr;
+    }
+
+    const std::uint64_t id_;
+    alignas(64) std::atomic<std::uint64_t> epoch_{1};
+    Slot slots_[MaxReaders];
+    detail::RetiredList retired_;
+};
+
+// Hazard-pointer reclamation. A reader publishes the pointer it is about to
+// dereference in a Hazard; retired objects are freed as soon as no hazard
+// holds them.
+class HazardDomain {
+    struct Record;
+
+public:
+    static constexpr size_t MaxThreads = 256;
+    static constexpr size_t HazardsPerThread = 4;
+
+    // One published pointer. A thread can hold HazardsPerThread of them per
+    // domain at once.
+    class Hazard {
+    public:
+        explicit Hazard(HazardDomain& domain) {
+            Record* record = domain.localRecord();
+            if (record == nullptr) {
+                return;
+            }
+            for (size_t i = 0; i < HazardsPerThread; ++i) {
+                if ((record->inUse & (1u << i)) == 0) {
+                    record->inUse |= 1u << i;
+                    record_ = record;
+                    index_ = i;
+                    return;
+                }
+            }
+        }
+
+        ~Hazard() {
+            if (record_ != nullptr) {
+                reset();
+                record_->inUse &= ~(1u << index_);
+            }
+        }
+
+        Hazard(const Hazard&) = delete;
+        Hazard& operator=(const Hazard&) = delete;
+
+        // Whether a slot was available; without one protect() must not be
+        // relied on and the caller falls back to its locked path.
+        explicit operator bool() const {
+            return record_ != nullptr;
+        }
+
+        // Loads source and keeps the object it points to from being freed
+        // until the next protect(), reset() or the end of the Hazard.
+        template<typename T>
+        T* protect(const std::atomic<T*>& source) {
+            T* p = source.load(std::memory_order_relaxed);
+            while (true) {
+                slot().store(p, std::memory_order_seq_cst);
+                // Pairs with the fence in collect(): either the collector sees
+                // the hazard, or the reload sees that p was unlinked.
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                T* again = source.load(std::memory_order_acquire);
+                if (again == p) {
+                    return p;
+                }
+                p = again;
+            }
+        }
+
+        void reset() {
+            slot().store(nullptr, std::memory_order_release);
+        }
+
+    private:
+        std::atomic<const void*>& slot() {
+            return record_->hazards[index_];
+        }
+
+        Record* record_ = nullptr;
+        size_t index_ = 0;
+    };
+
+    explicit HazardDomain(size_t collectThreshold = 64)
+        : id_(detail::ReclaimRegistry::instance().add()), retired_(collectThreshold) {}
+
+    // Frees whatever is still retired; no reader may remain.
+    ~HazardDomain() {
+        detail::ReclaimRegistry::instance().remove(id_);
+    }
+
+    HazardDomain(const HazardDomain&) = delete;
+    HazardDomain& operator=(const HazardDomain&) = delete;
+
+    // Frees p with deleter(p) once no hazard holds it. p must already be
+    // unreachable for new readers.
+    template<typename T, typename Deleter = std::default_delete<T>>
+    void retire(T* p, Deleter deleter = Deleter()) {
+        if (retired_.push(detail::makeRetired(p, std::move(deleter)))) {
+            collect();
+        }
+    }
+
+    // Frees every retired object no hazard holds; returns how many.
+    size_t collect() {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        std::vector<const void*> held;
+        for (const Record& record : records_) {
+            for (const auto& hazard : record.hazards) {
+                if (const void* p = hazard.load(std::memory_order_seq_cst)) {
+                    held.push_back(p);
+                }
+            }
+        }
+        std::sort(held.begin(), held.end());
+        return retired_.sweep([&held](const detail::RetiredNode* node) {
+            return std::binary_search(held.begin(), held.end(), static_cast<const void*>(node->object));
+        });
+    }
+
+    // Retired and not yet freed.
+    size_t pending() const {
+        return retired_.pending();
+    }
+
+private:
+    struct alignas(64) Record {
+        std::atomic<const void*> hazards[HazardsPerThread] = {};
+        std::atomic<bool> owned{false};
+        // Which hazards the owning thread has handed out; only it touches this.
+        unsigned inUse = 0;
+    };
+
+    Record* localRecord() {
+        return detail::ReclaimClaims::local().claim(id_, records_);
+    }
+
+    const std::uint64_t id_;
+    Record records_[MaxThreads];
+    detail::RetiredList retired_;
+};
+
+// Calls domain.collect() every period on a thread of its own, for domains
+// built with a collect threshold of 0 (or to keep garbage low between
+// retires). Stopping runs one last pass.
+template<typename Domain>
+class BackgroundReclaimer {
+public:
+    explicit BackgroundReclaimer(Domain& domain, std::chrono::milliseconds period = std::chrono::milliseconds(10))
+        : domain_(domain), period_(period), thread_([this] { run(); }) {}
+
+    ~BackgroundReclaimer() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        wake_.notify_one();
+        thread_.join();
+        domain_.collect();
+    }
+
+    BackgroundReclaimer(const BackgroundReclaimer&) = delete;
+    BackgroundReclaimer& operator=(const BackgroundReclaimer&) = delete;
+
+    // Collects now rather than at the end of the period.
+    void wake() {
+        wake_.notify_one();
+    }
+
+private:
+    void run() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (!stop_) {
+            wake_.wait_for(lock, period_);
+            lock.unlock();
+            domain_.collect();
+            lock.lock();
+        }
+    }
+
+    Domain& domain_;
+    const std::chrono::milliseconds period_;
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    bool stop_ = false;
+    std::thread thread_;
+};
+
+#endif // RECLAIM_H
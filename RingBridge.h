@@ -0,0 +1,376 @@
+#ifndef RING_BRIDGE_H
+#define RING_BRIDGE_H
+
+#include "Queue.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <system_error>
+#include <type_traits>
+
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+// Extends an SPSCQueue stage across a stream socket, e.g. TCP between two
+// machines: a RingBridgeSender drains the local ring into the socket and a
+// RingBridgeReceiver on the other end refills a remote ring from it, so the
+// producer and consumer keep the semantics of one ring, order included.
+//
+// Items travel as frames, a RingBridgeFrame header followed by the items'
+// bytes, in place: the sender writes each frame with one sendmsg() gathering
+// the header and the run of slots returned by peek(), and the receiver
+// recv()s payload straight into slots from reserve(). Items are sent in
+// native layout, so both ends must agree on T's layout and byte order; the
+// header carries sizeof(T) to catch the plainest mismatch.
+//
+// Backpressure is credit based. The receiver grants the sender items for
+// which its ring has room, and the sender never has more in flight than it
+// was granted, so the remote ring can never overflow and a slow remote
+// consumer stalls the local ring instead, just as a full ring would. Grants
+// flow back over the same socket as the running total granted.
+//
+// Both ends are driven by pump(), which makes every call MSG_DONTWAIT and so
+// never blocks, whether the socket is blocking or not; call it in the loop
+// of the thread that is the ring's consumer (sender) or producer (receiver).
+// Socket errors throw std::system_error; a peer that closed the connection
+// makes closed() true.
+struct RingBridgeFrame {
+    std::uint32_t items;
+    std::uint32_t itemSize;
+};
+
+struct RingBridgeOptions {
+    // Sender: items per frame at most.
+    size_t maxBatch = 4096;
+    // Receiver: fewest items worth a credit message, unless the sender has
+    // run out. 0 means a quarter of the ring.
+    size_t creditBatch = 0;
+};
+
+struct RingBridgeStats {
+    std::uint64_t items = 0;
+    std::uint64_t frames = 0;
+    // sendmsg() or recv() calls that moved data.
+    std::uint64_t calls = 0;
+    // Credit messages sent (receiver) or received (sender).
+    std::uint64_t credits = 0;
+    // Sender pumps that found items waiting but no credit.
+    std::uint64_t stalls = 0;
+};
+
+namespace detail {
+
+// The result of a non-blocking socket call: bytes moved, 0 for the peer
+// having closed, or -1 when the call would have blocked.
+inline ssize_t bridgeResult(ssize_t result, const char* call) {
+    if (result >= 0) {
+        return result;
+    }
+    const int error = errno;
+    if (error == EAGAIN || error == EWOULDBLOCK || error == EINTR) {
+        return -1;
+    }
+    throw std::system_error(error, std::generic_category(), call);
+}
+
+} // namespace detail
+
+template<typename T, typename Ring = SPSCQueue<T>>
+class RingBridgeSender {
+    static_assert(std::is_trivially_copyable<T>::value, "RingBridge sends items as their bytes.");
+
+public:
+    RingBridgeSender(Ring& ring, int fd, RingBridgeOptions options = RingBridgeOptions())
+        : ring_(ring), fd_(fd), maxBatch_(std::min<size_t>(options.maxBatch, UINT32_MAX)) {
+        if (fd < 0) {
+            throw std::invalid_argument("RingBridgeSender needs an open socket.");
+        }
+        if (options.maxBatch == 0) {
+            throw std::invalid_argument("RingBridgeSender needs a maxBatch of at least one.");
+        }
+    }
+
+    RingBridgeSender(const RingBridgeSender&) = delete;
+    RingBridgeSender& operator=(const RingBridgeSender&) = delete;
+
+    // Takes any new credit and sends frames while there is credit, items
+    // and room in the socket. Returns the items whose frames went out
+    // completely; they have been released from the ring.
+    size_t pump() {
+        readCredit();
+        size_t sent = 0;
+        while (!closed_) {
+            if (inFlight_ == 0 && !nextFrame()) {
+                break;
+            }
+            if (!sendFrame()) {
+                break;
+            }
+            ring_.release(inFlight_);
+            sent += inFlight_;
+            sent_ += inFlight_;
+            stats_.items += inFlight_;
+            ++stats_.frames;
+            inFlight_ = 0;
+        }
+        return sent;
+    }
+
+    // Items the receiver has room for that have not been sent yet.
+    std::uint64_t credit() const {
+        return granted_ - sent_ - inFlight_;
+    }
+
+    // Whether a frame is partly written; its items are still in the ring.
+    bool busy() const {
+        return inFlight_ != 0;
+    }
+
+    bool closed() const {
+        return closed_;
+    }
+
+    const RingBridgeStats& stats() const {
+        return stats_;
+    }
+
+private:
+    void readCredit() {
+        while (!closed_) {
+            const ssize_t got = detail::bridgeResult(
+                ::recv(fd_, creditBytes_ + creditOffset_, sizeof(creditBytes_) - creditOffset_, MSG_DONTWAIT), "recv");
+            if (got < 0) {
+                return;
+            }
+            if (got == 0) {
+                closed_ = true;
+                return;
+            }
+            creditOffset_ += static_cast<size_t>(got);
+            if (creditOffset_ == sizeof(creditBytes_)) {
+                std::memcpy(&granted_, creditBytes_, sizeof(granted_));
+                creditOffset_ = 0;
+                ++stats_.credits;
+            }
+        }
+    }
+
+    // Peeks the next run of items the credit allows and points the frame's
+    // two iovecs at its header and at the run, in place in the ring.
+    bool nextFrame() {
+        const std::uint64_t available = credit();
+        size_t n = static_cast<size_t>(std::min<std::uint64_t>(available, maxBatch_));
+        if (n == 0) {
+            if (!ring_.empty()) {
+                ++stats_.stalls;
+            }
+            return false;
+        }
+        T* items = ring_.peek(n);
+        if (items == nullptr) {
+            return false;
+        }
+        inFlight_ = n;
+        header_ = RingBridgeFrame{static_cast<std::uint32_t>(n), static_cast<std::uint32_t>(sizeof(T))};
+        iov_[0].iov_base = &header_;
+        iov_[0].iov_len = sizeof(header_);
+        iov_[1].iov_base = items;
+        iov_[1].iov_len = n * sizeof(T);
+        firstIov_ = 0;
+        return true;
+    }
+
+    // Writes what is left of the frame; true once all of it is out.
+    bool sendFrame() {
+        while (firstIov_ < 2) {
+            msghdr message{};
+            message.msg_iov = iov_ + firstIov_;
+            message.msg_iovlen = 2 - firstIov_;
+            const ssize_t written = detail::bridgeResult(::sendmsg(fd_, &message, MSG_DONTWAIT | MSG_NOSIGNAL), "sendmsg");
+            if (written < 0) {
+                return false;
+            }
+            ++stats_.calls;
+            size_t left = static_cast<size_t>(written);
+            while (firstIov_ < 2 && left >= iov_[firstIov_].iov_len) {
+                left -= iov_[firstIov_].iov_len;
+                ++firstIov_;
+            }
+            if (firstIov_ < 2) {
+                iov_[firstIov_].iov_base = static_cast<char*>(iov_[firstIov_].iov_base) + left;
+                iov_[firstIov_].iov_len -= left;
+            }
+        }
+        return true;
+    }
+
+    Ring& ring_;
+    int fd_;
+    size_t maxBatch_;
+    bool closed_ = false;
+    std::uint64_t granted_ = 0;
+    std::uint64_t sent_ = 0;
+    size_t inFlight_ = 0;
+    RingBridgeFrame header_{};
+    iovec iov_[2] = {};
+    size_t firstIov_ = 0;
+    char creditBytes_[sizeof(std::uint64_t)] = {};
+    size_t creditOffset_ = 0;
+    RingBridgeStats stats_;
+};
+
+template<typename T, typename Ring = SPSCQueue<T>>
+class RingBridgeReceiver {
+    static_assert(std::is_trivially_copyable<T>::value, "RingBridge receives items as their bytes.");
+
+public:
+    RingBridgeReceiver(Ring& ring, int fd, RingBridgeOptions options = RingBridgeOptions())
+        : ring_(ring), fd_(fd),
+          creditBatch_(options.creditBatch == 0 ? std::max<size_t>(ring.capacity() / 4, 1) : options.creditBatch) {
+        if (fd < 0) {
+            throw std::invalid_argument("RingBridgeReceiver needs an open socket.");
+        }
+        if (creditBatch_ > ring.capacity()) {
+            throw std::invalid_argument("RingBridgeReceiver cannot wait for more credit than its ring holds.");
+        }
+    }
+
+    RingBridgeReceiver(const RingBridgeReceiver&) = delete;
+    RingBridgeReceiver& operator=(const RingBridgeReceiver&) = delete;
+
+    // Grants credit for the room the ring's consumer has made, then
+    // receives whatever has arrived. Returns the items committed to the
+    // ring.
+    size_t pump() {
+        grantCredit();
+        size_t received = 0;
+        while (!closed_) {
+            if (frameLeft_ == 0 && !readHeader()) {
+                break;
+            }
+            const size_t got = readItems();
+            if (got == 0) {
+                break;
+            }
+            received += got;
+        }
+        return received;
+    }
+
+    bool closed() const {
+        return closed_;
+    }
+
+    const RingBridgeStats& stats() const {
+        return stats_;
+    }
+
+private:
+    // Only this end fills the ring, so the room there can only grow under
+    // us; room not yet promised to the sender is safe to grant.
+    void grantCredit() {
+        if (closed_) {
+            return;
+        }
+        if (pendingLeft_ == 0) {
+            const std::uint64_t outstanding = granted_ - stats_.items;
+            const std::uint64_t room = ring_.capacity() - ring_.size();
+            const std::uint64_t grant = room > outstanding ? room - outstanding : 0;
+            if (grant == 0 || (grant < creditBatch_ && outstanding != 0)) {
+                return;
+            }
+            granted_ += grant;
+            std::memcpy(pending_, &granted_, sizeof(granted_));
+            pendingLeft_ = sizeof(pending_);
+            ++stats_.credits;
+        }
+        // A credit message cut short must still go out before any newer one.
+        const size_t done = sizeof(pending_) - pendingLeft_;
+        const ssize_t written = detail::bridgeResult(
+            ::send(fd_, pending_ + done, pendingLeft_, MSG_DONTWAIT | MSG_NOSIGNAL), "send");
+        if (written > 0) {
+            pendingLeft_ -= static_cast<size_t>(written);
+        }
+    }
+
+    bool readHeader() {
+        char* bytes = reinterpret_cast<char*>(&header_);
+        const ssize_t got = receive(bytes + headerOffset_, sizeof(header_) - headerOffset_);
+        if (got <= 0) {
+            return false;
+        }
+        headerOffset_ += static_cast<size_t>(got);
+        if (headerOffset_ < sizeof(header_)) {
+            return false;
+        }
+        headerOffset_ = 0;
+        if (header_.itemSize != sizeof(T)) {
+            throw std::runtime_error("RingBridgeReceiver got items of a different size than it holds.");
+        }
+        if (stats_.items + header_.items > granted_) {
+            throw std::runtime_error("RingBridgeReceiver got more items than it granted credit for.");
+        }
+        frameLeft_ = header_.items;
+        if (frameLeft_ == 0) {
+            ++stats_.frames;
+        }
+        return frameLeft_ != 0;
+    }
+
+    // Receives payload into the ring's free slots and commits the whole
+    // items; the bytes of an item cut short wait in its slot, which stays
+    // uncommitted, for the next call.
+    size_t readItems() {
+        size_t n = frameLeft_;
+        T* slots = ring_.reserve(n);
+        if (slots == nullptr) {
+            return 0;
+        }
+        const ssize_t got = receive(reinterpret_cast<char*>(slots) + partialBytes_, n * sizeof(T) - partialBytes_);
+        if (got <= 0) {
+            return 0;
+        }
+        const size_t bytes = partialBytes_ + static_cast<size_t>(got);
+        const size_t whole = bytes / sizeof(T);
+        partialBytes_ = bytes % sizeof(T);
+        if (whole == 0) {
+            return 0;
+        }
+        ring_.commit(whole);
+        frameLeft_ -= whole;
+        stats_.items += whole;
+        if (frameLeft_ == 0) {
+            ++stats_.frames;
+        }
+        return whole;
+    }
+
+    ssize_t receive(char* buffer, size_t size) {
+        const ssize_t got = detail::bridgeResult(::recv(fd_, buffer, size, MSG_DONTWAIT), "recv");
+        if (got == 0) {
+            closed_ = true;
+        } else if (got > 0) {
+            ++stats_.calls;
+        }
+        return got;
+    }
+
+    Ring& ring_;
+    int fd_;
+    size_t creditBatch_;
+    bool closed_ = false;
+    std::uint64_t granted_ = 0;
+    char pending_[sizeof(std::uint64_t)] = {};
+    size_t pendingLeft_ = 0;
+    RingBridgeFrame header_{};
+    size_t headerOffset_ = 0;
+    size_t frameLeft_ = 0;
+    size_t partialBytes_ = 0;
+    RingBridgeStats stats_;
+};
+
+#endif // RING_BRIDGE_H
@@ -0,0 +1,187 @@
+#ifndef SEQ_LOCK_H
+#define SEQ_LOCK_H
+
+#include "Backoff.h"
+#include "Queue.h"
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+// Latest-value state with one writer: readers want the newest snapshot,
+// not the history a queue would make them drain to reach it.
+
+// A sequence lock. The writer makes the sequence odd, stores the value and
+// makes it even again, never waiting for anyone; a reader copies the value
+// out between two reads of the sequence and retries if the writer was
+// inside. Readers write nothing shared, so any number of them scale, but a
+// reader can starve under a writer that never pauses.
+//
+// The value is kept as relaxed atomic words rather than a plain T, so the
+// copy a reader may take mid-write is a race the memory model allows and
+// not undefined behaviour; T must be trivially copyable.
+template<typename T>
+class SeqLock {
+    static_assert(std::is_trivially_copyable<T>::value, "SeqLock holds trivially copyable values.");
+
+public:
+    SeqLock() : SeqLock(T()) {}
+
+    explicit SeqLock(const T& initial) {
+        Words words;
+        toWords(initial, words);
+        for (size_t i = 0; i < WordCount; ++i) {
+            words_[i].store(words.values[i], std::memory_order_relaxed);
+        }
+    }
+
+    SeqLock(const SeqLock&) = delete;
+    SeqLock& operator=(const SeqLock&) = delete;
+
+    // Writer only. Wait-free.
+    void store(const T& value) {
+        Words words;
+        toWords(value, words);
+        const std::uint64_t sequence = sequence_.load(std::memory_order_relaxed);
+        sequence_.store(sequence + 1, std::memory_order_relaxed);
+        // Keeps the words below from being seen before the odd sequence.
+        std::atomic_thread_fence(std::memory_order_release);
+        for (size_t i = 0; i < WordCount; ++i) {
+            words_[i].store(words.values[i], std::memory_order_relaxed);
+        }
+        sequence_.store(sequence + 2, std::memory_order_release);
+    }
+
+    // A consistent copy, or false if a store was in progress.
+    bool try_load(T& out) const {
+        const std::uint64_t before = sequence_.load(std::memory_order_acquire);
+        if ((before & 1) != 0) {
+            return false;
+        }
+        Words words;
+        for (size_t i = 0; i < WordCount; ++i) {
+            words.values[i] = words_[i].load(std::memory_order_relaxed);
+        }
+        // Keeps the words above from being read after the second sequence.
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (sequence_.load(std::memory_order_relaxed) != before) {
+            return false;
+        }
+        std::memcpy(&out, words.values, sizeof(T));
+        return true;
+    }
+
+    // Retries try_load() until it gets a consistent copy.
+    template<typename Backoff = ExponentialBackoff>
+    T load() const {
+        T value;
+        Backoff backoff;
+        while (!try_load(value)) {
+            backoff.pause();
+        }
+        return value;
+    }
+
+    // Completed stores so far; for a reader to tell whether anything changed
+    // since it last looked.
+    std::uint64_t version() const {
+        return sequence_.load(std::memory_order_acquire) / 2;
+    }
+
+private:
+    static constexpr size_t WordCount = (sizeof(T) + sizeof(std::uint64_t) - 1) / sizeof(std::uint64_t);
+
+    struct Words {
+        std::uint64_t values[WordCount] = {};
+    };
+
+    static void toWords(const T& value, Words& words) {
+        std::memcpy(words.values, &value, sizeof(T));
+    }
+
+    alignas(CACHE_LINE_SIZE) std::atomic<std::uint64_t> sequence_{0};
+    std::atomic<std::uint64_t> words_[WordCount];
+};
+
+// Wait-free single-producer/single-consumer latest-value exchange. Three
+// slots: the writer owns one, the reader owns one, and the third is the
+// hand-over point. Publishing swaps the writer's slot with the middle one
+// and marks it fresh; the reader takes the middle slot in exchange for its
+// own only when it is fresh. Neither side ever waits or copies the other's
+// data, and the reader always sees the newest complete value, with skipped
+// values never read at all.
+//
+// T must be default constructible. Writes go through back() and publish(),
+// or store(); reads through update() and front(), or load().
+template<typename T>
+class TripleBuffer {
+public:
+    TripleBuffer() = default;
+
+    explicit TripleBuffer(const T& initial) {
+        for (Slot& slot : slots_) {
+            slot.value = initial;
+        }
+    }
+
+    TripleBuffer(const TripleBuffer&) = delete;
+    TripleBuffer& operator=(const TripleBuffer&) = delete;
+
+    // Writer: the slot to build the next value in. It holds whatever an
+    // earlier publish() left there, not necessarily the latest value.
+    T& back() {
+        return slots_[back_].value;
+    }
+
+    // Writer: makes back() the newest value.
+    void publish() {
+        back_ = middle_.exchange(static_cast<std::uint8_t>(back_ | Fresh), std::memory_order_acq_rel) & IndexMask;
+    }
+
+    void store(const T& value) {
+        back() = value;
+        publish();
+    }
+
+    // Reader: takes the newest value if there is one; false if front() is
+    // already the latest.
+    bool update() {
+        if ((middle_.load(std::memory_order_relaxed) & Fresh) == 0) {
+            return false;
+        }
+        front_ = middle_.exchange(front_, std::memory_order_acq_rel) & IndexMask;
+        return true;
+    }
+
+    // Reader: the value taken by the last update().
+    const T& front() const {
+        return slots_[front_].value;
+    }
+
+    // Reader: update() and front().
+    const T& load() {
+        update();
+        return front();
+    }
+
+    // Reader: whether there is a value newer than front().
+    bool fresh() const {
+        return (middle_.load(std::memory_order_relaxed) & Fresh) != 0;
+    }
+
+private:
+    static constexpr std::uint8_t IndexMask = 3;
+    static constexpr std::uint8_t Fresh = 4;
+
+    struct alignas(CACHE_LINE_SIZE) Slot {
+        T value{};
+    };
+
+    Slot slots_[3];
+    alignas(CACHE_LINE_SIZE) std::atomic<std::uint8_t> middle_{1};
+    alignas(CACHE_LINE_SIZE) std::uint8_t back_ = 0;
+    alignas(CACHE_LINE_SIZE) std::uint8_t front_ = 2;
+};
+
+#endif // SEQ_LOCK_H
@@ -0,0 +1,240 @@
+#ifndef SHARDED_COUNTER_H
+#define SHARDED_COUNTER_H
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <type_traits>
+
+// Counters for values that many threads update and few read: the value is
+// split over cache-line-aligned lanes, each thread is dealt one lane
+// round-robin the first time it touches any sharded counter, and reads
+// combine the lanes. An update is one relaxed read-modify-write on a line no
+// other thread is likely to write, instead of every thread bouncing the line
+// of a single std::atomic; a read costs one load per lane. This is doctest's
+// MultiLaneAtomic with the lane count as a parameter, relaxed ordering by
+// default, and max/min aggregation.
+//
+// Reads are not atomic across lanes: while updates are in flight, load() and
+// snapshot() return a value the counter could have had at some point during
+// the read, not necessarily at one instant. Use them for statistics, not for
+// synchronisation.
+
+constexpr size_t ShardedDefaultLanes = 16;
+
+// The calling thread's lane sequence number, shared by every sharded type so
+// that threads spread over lanes evenly whatever they touch first.
+inline size_t shardedLaneSeed() {
+    static std::atomic<size_t> next{0};
+    static thread_local const size_t seed = next.fetch_add(1, std::memory_order_relaxed);
+    return seed;
+}
+
+// N counters that share each lane, so a thread updating several of them
+// touches one cache line. snapshot() reads all N in one pass over the lanes.
+template<typename T = std::uint64_t, size_t N = 1, size_t Lanes = ShardedDefaultLanes>
+class ShardedCounters {
+    static_assert(std::is_integral<T>::value, "ShardedCounters holds integers.");
+    static_assert(N > 0 && Lanes > 0, "ShardedCounters needs at least one counter and one lane.");
+
+public:
+    static constexpr size_t Count = N;
+    static constexpr size_t LaneCount = Lanes;
+
+    // The counters of one lane. Hold on to lane() to update several counters
+    // for the price of one lane lookup.
+    struct alignas(64) Lane {
+        std::atomic<T> values[N] = {};
+
+        void add(size_t counter, T delta, std::memory_order order = std::memory_order_relaxed) {
+            values[counter].fetch_add(delta, order);
+        }
+
+        void sub(size_t counter, T delta, std::memory_order order = std::memory_order_relaxed) {
+            values[counter].fetch_sub(delta, order);
+        }
+    };
+
+    ShardedCounters() = default;
+    ShardedCounters(const ShardedCounters&) = delete;
+    ShardedCounters& operator=(const ShardedCounters&) = delete;
+
+    // The calling thread's lane.
+    Lane& lane() {
+        return lanes_[shardedLaneSeed() % Lanes];
+    }
+
+    void add(size_t counter, T delta, std::memory_order order = std::memory_order_relaxed) {
+        lane().add(counter, delta, order);
+    }
+
+    void sub(size_t counter, T delta, std::memory_order order = std::memory_order_relaxed) {
+        lane().sub(counter, delta, order);
+    }
+
+    // Sum of counter over all lanes.
+    T load(size_t counter, std::memory_order order = std::memory_order_relaxed) const {
+        T sum = T();
+        for (const Lane& l : lanes_) {
+            sum += l.values[counter].load(order);
+        }
+        return sum;
+    }
+
+    // Every counter, summed over the lanes.
+    std::array<T, N> snapshot(std::memory_order order = std::memory_order_relaxed) const {
+        std::array<T, N> sums{};
+        for (const Lane& l : lanes_) {
+            for (size_t i = 0; i < N; ++i) {
+                sums[i] += l.values[i].load(order);
+            }
+        }
+        return sums;
+    }
+
+    // Zeroes every counter. Updates racing with it may survive.
+    void reset(std::memory_order order = std::memory_order_relaxed) {
+        for (Lane& l : lanes_) {
+            for (std::atomic<T>& value : l.values) {
+                value.store(T(), order);
+            }
+        }
+    }
+
+private:
+    Lane lanes_[Lanes];
+};
+
+// A single sharded sum, usable where a std::atomic counter was.
+template<typename T = std::uint64_t, size_t Lanes = ShardedDefaultLanes>
+class ShardedCounter {
+public:
+    ShardedCounter() = default;
+    explicit ShardedCounter(T initial) {
+        store(initial);
+    }
+
+    void add(T delta, std::memory_order order = std::memory_order_relaxed) {
+        counters_.add(0, delta, order);
+    }
+
+    void sub(T delta, std::memory_order order = std::memory_order_relaxed) {
+        counters_.sub(0, delta, order);
+    }
+
+    ShardedCounter& operator++() {
+        add(1);
+        return *this;
+    }
+
+    ShardedCounter& operator--() {
+        sub(1);
+        return *this;
+    }
+
+    ShardedCounter& operator+=(T delta) {
+        add(delta);
+        return *this;
+    }
+
+    ShardedCounter& operator-=(T delta) {
+        sub(delta);
+        return *this;
+    }
+
+    T load(std::memory_order order = std::memory_order_relaxed) const {
+        return counters_.load(0, order);
+    }
+
+    operator T() const {
+        return load();
+    }
+
+    // Puts the whole value in the first lane and zeroes the rest. Updates
+    // racing with it may survive.
+    void store(T desired, std::memory_order order = std::memory_order_relaxed) {
+        counters_.reset(order);
+        counters_.add(0, desired, order);
+    }
+
+    void reset(std::memory_order order = std::memory_order_relaxed) {
+        counters_.reset(order);
+    }
+
+private:
+    ShardedCounters<T, 1, Lanes> counters_;
+};
+
+// The largest (IsMax) or smallest value any thread has offered. Each lane
+// keeps its own extreme, updated with a compare-exchange only when the
+// offered value beats it, so once the extreme settles an update is a load
+// and a compare.
+template<typename T, bool IsMax, size_t Lanes = ShardedDefaultLanes>
+class ShardedExtremum {
+    static_assert(std::is_arithmetic<T>::value, "ShardedExtremum holds numbers.");
+    static_assert(Lanes > 0, "ShardedExtremum needs at least one lane.");
+
+public:
+    ShardedExtremum() {
+        reset();
+    }
+
+    ShardedExtremum(const ShardedExtremum&) = delete;
+    ShardedExtremum& operator=(const ShardedExtremum&) = delete;
+
+    // What load() returns before any update: lowest() for a maximum, max()
+    // for a minimum.
+    static constexpr T identity() {
+        return IsMax ? std::numeric_limits<T>::lowest() : std::numeric_limits<T>::max();
+    }
+
+    void update(T value, std::memory_order order = std::memory_order_relaxed) {
+        std::atomic<T>& slot = lanes_[shardedLaneSeed() % Lanes].value;
+        T current = slot.load(std::memory_order_relaxed);
+        while (better(value, current) &&
+               !slot.compare_exchange_weak(current, value, order, std::memory_order_relaxed)) {
+        }
+    }
+
+    T load(std::memory_order order = std::memory_order_relaxed) const {
+        T result = identity();
+        for (const Lane& l : lanes_) {
+            const T value = l.value.load(order);
+            if (better(value, result)) {
+                result = value;
+            }
+        }
+        return result;
+    }
+
+    operator T() const {
+        return load();
+    }
+
+    void reset(std::memory_order order = std::memory_order_relaxed) {
+        for (Lane& l : lanes_) {
+            l.value.store(identity(), order);
+        }
+    }
+
+private:
+    struct alignas(64) Lane {
+        std::atomic<T> value;
+    };
+
+    static bool better(T a, T b) {
+        return IsMax ? a > b : a < b;
+    }
+
+    Lane lanes_[Lanes];
+};
+
+template<typename T = std::uint64_t, size_t Lanes = ShardedDefaultLanes>
+using ShardedMax = ShardedExtremum<T, true, Lanes>;
+
+template<typename T = std::uint64_t, size_t Lanes = ShardedDefaultLanes>
+using ShardedMin = ShardedExtremum<T, false, Lanes>;
+
+#endif // SHARDED_COUNTER_H
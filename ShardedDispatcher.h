@@ -0,0 +1,142 @@
+#ifndef SHARDED_DISPATCHER_H
+#define SHARDED_DISPATCHER_H
+
+#include "Queue.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Routes items to one of N SPSCQueues by a hash of their key, each drained by
+// a dedicated worker thread. Every key always lands on the same shard, so
+// items with equal keys are handled in dispatch order while different keys
+// run in parallel, with no lock per key and no shared queue head.
+//
+// dispatch() and dispatch_bulk() must be called from one producer thread.
+// The handler runs on the shard's worker and must not throw. T must be
+// default constructible; workers dequeue into a reusable batch buffer.
+template<typename K, typename T, typename Hash = std::hash<K>, typename Traits = QueueTraits>
+class ShardedDispatcher {
+public:
+    using queue_type = SPSCQueue<T, DynamicCapacity, Traits>;
+    using handler_type = std::function<void(T&)>;
+
+    static constexpr size_t BatchSize = 64;
+
+    ShardedDispatcher(size_t shards, size_t capacity, handler_type handler, const Hash& hash = Hash())
+        : hash(hash), handler(std::move(handler)) {
+        if (shards == 0) {
+            throw std::invalid_argument("ShardedDispatcher needs at least one shard.");
+        }
+        for (size_t i = 0; i < shards; ++i) {
+            workers.emplace_back(new Worker(capacity));
+        }
+        pending.resize(shards);
+        for (size_t i = 0; i < shards; ++i) {
+            workers[i]->thread = std::thread([this, i] { workerLoop(*workers[i]); });
+        }
+    }
+
+    // Handles everything already dispatched, then joins the workers.
+    ~ShardedDispatcher() {
+        stopping.store(true, std::memory_order_release);
+        for (auto& worker : workers) {
+            worker->thread.join();
+        }
+    }
+
+    ShardedDispatcher(const ShardedDispatcher&) = delete;
+    ShardedDispatcher& operator=(const ShardedDispatcher&) = delete;
+
+    size_t shard_of(const K& key) const {
+        // Fibonacci hashing spreads std::hash's identity mapping for
+        // integers over the shards.
+        const std::uint64_t mixed = static_cast<std::uint64_t>(hash(key)) * 0x9e3779b97f4a7c15ull;
+        return static_cast<size_t>((mixed >> 32) % workers.size());
+    }
+
+    // Blocks (yielding) while the key's shard is full.
+    template<typename U>
+    void dispatch(const K& key, U&& value) {
+        queue_type& queue = workers[shard_of(key)]->queue;
+        while (!queue.enqueue(std::forward<U>(value))) {
+            std::this_thread::yield();
+        }
+    }
+
+    // Dispatches [first, last), keyOf(item) giving each item's key. Items
+    // are grouped by shard first, so each shard takes one enqueue_bulk (per
+    // ring's worth) instead of one enqueue per item; order within a shard is
+    // preserved.
+    template<typename ForwardIt, typename KeyOf>
+    void dispatch_bulk(ForwardIt first, ForwardIt last, KeyOf&& keyOf) {
+        for (; first != last; ++first) {
+            pending[shard_of(keyOf(*first))].push_back(*first);
+        }
+        for (size_t shard = 0; shard < workers.size(); ++shard) {
+            std::vector<T>& batch = pending[shard];
+            queue_type& queue = workers[shard]->queue;
+            size_t done = 0;
+            while (done < batch.size()) {
+                const size_t n = queue.enqueue_bulk(batch.begin() + done, batch.size() - done);
+                if (n == 0) {
+                    std::this_thread::yield();
+                }
+                done += n;
+            }
+            batch.clear();
+        }
+    }
+
+    size_t shards() const {
+        return workers.size();
+    }
+
+private:
+    struct Worker {
+        explicit Worker(size_t capacity) : queue(capacity) {}
+
+        queue_type queue;
+        std::thread thread;
+    };
+
+    void workerLoop(Worker& worker) {
+        std::vector<T> batch(BatchSize);
+        while (true) {
+            const size_t n = worker.queue.dequeue_bulk(batch.begin(), BatchSize);
+            for (size_t i = 0; i < n; ++i) {
+                handler(batch[i]);
+            }
+            if (n != 0) {
+                continue;
+            }
+            if (stopping.load(std::memory_order_acquire)) {
+                // The producer has stopped; one last look catches anything
+                // published just before the flag.
+                if (worker.queue.empty()) {
+                    return;
+                }
+                continue;
+            }
+            T value;
+            if (worker.queue.try_pop_for(value, std::chrono::milliseconds(1))) {
+                handler(value);
+            }
+        }
+    }
+
+    Hash hash;
+    handler_type handler;
+    std::vector<std::unique_ptr<Worker>> workers;
+    // Producer-side scratch for dispatch_bulk, one buffer per shard.
+    std::vector<std::vector<T>> pending;
+    std::atomic<bool> stopping{false};
+};
+
+#endif // SHARDED_DISPATCHER_H
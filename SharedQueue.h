@@ -0,0 +1,242 @@
+#ifndef SHARED_QUEUE_H
+#define SHARED_QUEUE_H
+
+#include "Queue.h"
+
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <type_traits>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// SPSCQueue's index design in a named POSIX shared-memory region, so a
+// producer and a consumer in different processes can exchange elements
+// without a system call per message. The region starts with a header
+// carrying a magic number, a layout version, the element size and the
+// capacity; attaching checks all of them. Positions are free-running 64-bit
+// counters, so all capacity slots are usable and the layout does not depend
+// on the build's size_t.
+//
+// T is copied bytewise between address spaces, so it must be trivially
+// copyable (and must not contain pointers that only mean something in the
+// writer's process).
+template<typename T>
+class SharedSPSCQueue {
+    static_assert(std::is_trivially_copyable<T>::value, "SharedSPSCQueue requires a trivially copyable T.");
+    static_assert(std::atomic<std::uint64_t>::is_always_lock_free, "Shared indices must be lock-free atomics.");
+
+public:
+    static constexpr std::uint64_t Magic = 0x43505055514d4853ull; // "SHMQUPPC"
+    static constexpr std::uint32_t LayoutVersion = 1;
+
+    // Creates (or truncates and re-initialises) the named region. Names
+    // follow shm_open: a leading slash and no others, e.g. "/md.feed".
+    static SharedSPSCQueue create(const std::string& name, size_t capacity) {
+        checkCapacity(capacity, DynamicCapacity);
+        const int fd = shm_open(name.c_str(), O_CREAT | O_RDWR, 0600);
+        if (fd < 0) {
+            const int error = errno;
+            throw std::system_error(error, std::generic_category(), "shm_open " + name);
+        }
+        const size_t bytes = regionSize(capacity);
+        if (ftruncate(fd, static_cast<off_t>(bytes)) != 0) {
+            const int error = errno;
+            close(fd);
+            throw std::system_error(error, std::generic_category(), "ftruncate " + name);
+        }
+        SharedSPSCQueue queue(name, fd, bytes);
+        Header* header = queue.header;
+        header->layoutVersion = LayoutVersion;
+        header->elementSize = static_cast<std::uint32_t>(sizeof(T));
+        header->elementAlign = static_cast<std::uint32_t>(alignof(T));
+        header->capacity = capacity;
+        header->head.store(0, std::memory_order_relaxed);
+        header->tail.store(0, std::memory_order_relaxed);
+        // Written last: an attacher that sees the magic sees the rest.
+        header->magic.store(Magic, std::memory_order_release);
+        queue.mask = capacity - 1;
+        return queue;
+    }
+
+    // Attaches to a region made by create(), possibly in another process.
+    static SharedSPSCQueue open(const std::string& name) {
+        const int fd = shm_open(name.c_str(), O_RDWR, 0600);
+        if (fd < 0) {
+            const int error = errno;
+            throw std::system_error(error, std::generic_category(), "shm_open " + name);
+        }
+        struct stat st;
+        if (fstat(fd, &st) != 0) {
+            const int error = errno;
+            close(fd);
+            throw std::system_error(error, std::generic_category(), "fstat " + name);
+        }
+        if (static_cast<size_t>(st.st_size) < sizeof(Header)) {
+            close(fd);
+            throw std::runtime_error("Shared queue " + name + " is not initialised.");
+        }
+        SharedSPSCQueue queue(name, fd, static_cast<size_t>(st.st_size));
+        const Header* header = queue.header;
+        if (header->magic.load(std::memory_order_acquire) != Magic) {
+            throw std::runtime_error("Shared queue " + name + " is not initialised.");
+        }
+        if (header->layoutVersion != LayoutVersion) {
+            throw std::runtime_error("Shared queue " + name + " has an incompatible layout version.");
+        }
+        if (header->elementSize != sizeof(T) || header->elementAlign != alignof(T)) {
+            throw std::runtime_error("Shared queue " + name + " holds a different element type.");
+        }
+        if (regionSize(header->capacity) > queue.bytes) {
+            throw std::runtime_error("Shared queue " + name + " is truncated.");
+        }
+        queue.mask = header->capacity - 1;
+        return queue;
+    }
+
+    // Removes the name; mapped handles stay valid until they are destroyed.
+    static void unlink(const std::string& name) {
+        shm_unlink(name.c_str());
+    }
+
+    SharedSPSCQueue(SharedSPSCQueue&& other) noexcept
+        : name(std::move(other.name)), bytes(other.bytes), header(other.header), slots(other.slots),
+          mask(other.mask), cachedHead(other.cachedHead), cachedTail(other.cachedTail) {
+        other.header = nullptr;
+    }
+
+    SharedSPSCQueue& operator=(SharedSPSCQueue&& other) noexcept {
+        if (this != &other) {
+            unmap();
+            name = std::move(other.name);
+            bytes = other.bytes;
+            header = other.header;
+            slots = other.slots;
+            mask = other.mask;
+            cachedHead = other.cachedHead;
+            cachedTail = other.cachedTail;
+            other.header = nullptr;
+        }
+        return *this;
+    }
+
+    ~SharedSPSCQueue() {
+        unmap();
+    }
+
+    bool enqueue(const T& value) {
+        const std::uint64_t currentTail = header->tail.load(std::memory_order_relaxed);
+        if (currentTail - cachedHead > mask) {
+            cachedHead = header->head.load(std::memory_order_acquire);
+            if (currentTail - cachedHead > mask) {
+                return false;
+            }
+        }
+        std::memcpy(static_cast<void*>(slots + (currentTail & mask)), &value, sizeof(T));
+        header->tail.store(currentTail + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool dequeue(T& result) {
+        const std::uint64_t currentHead = header->head.load(std::memory_order_relaxed);
+        if (currentHead == cachedTail) {
+            cachedTail = header->tail.load(std::memory_order_acquire);
+            if (currentHead == cachedTail) {
+                return false;
+            }
+        }
+        std::memcpy(static_cast<void*>(&result), slots + (currentHead & mask), sizeof(T));
+        header->head.store(currentHead + 1, std::memory_order_release);
+        return true;
+    }
+
+    std::optional<T> try_pop() {
+        T result;
+        if (!dequeue(result)) {
+            return std::nullopt;
+        }
+        return result;
+    }
+
+    bool empty() const {
+        return size() == 0;
+    }
+
+    bool full() const {
+        return size() > mask;
+    }
+
+    size_t size() const {
+        const std::uint64_t currentHead = header->head.load(std::memory_order_acquire);
+        const std::uint64_t currentTail = header->tail.load(std::memory_order_acquire);
+        return static_cast<size_t>(currentTail - currentHead);
+    }
+
+    size_t capacity() const {
+        return mask + 1;
+    }
+
+    const std::string& getName() const {
+        return name;
+    }
+
+private:
+    struct Header {
+        std::atomic<std::uint64_t> magic;
+        std::uint32_t layoutVersion;
+        std::uint32_t elementSize;
+        std::uint32_t elementAlign;
+        std::uint64_t capacity;
+        alignas(CACHE_LINE_SIZE) std::atomic<std::uint64_t> head;
+        alignas(CACHE_LINE_SIZE) std::atomic<std::uint64_t> tail;
+    };
+
+    static_assert(alignof(T) <= CACHE_LINE_SIZE, "Element alignment beyond a cache line is not supported.");
+
+    static constexpr size_t slotsOffset() {
+        return (sizeof(Header) + CACHE_LINE_SIZE - 1) / CACHE_LINE_SIZE * CACHE_LINE_SIZE;
+    }
+
+    static size_t regionSize(size_t capacity) {
+        return slotsOffset() + capacity * sizeof(T);
+    }
+
+    SharedSPSCQueue(std::string name, int fd, size_t bytes) : name(std::move(name)), bytes(bytes) {
+        void* region = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        const int error = errno;
+        close(fd);
+        if (region == MAP_FAILED) {
+            throw std::system_error(error, std::generic_category(), "mmap " + this->name);
+        }
+        header = static_cast<Header*>(region);
+        slots = reinterpret_cast<T*>(static_cast<char*>(region) + slotsOffset());
+    }
+
+    void unmap() {
+        if (header != nullptr) {
+            munmap(header, bytes);
+            header = nullptr;
+        }
+    }
+
+    std::string name;
+    size_t bytes = 0;
+    Header* header = nullptr;
+    T* slots = nullptr;
+    size_t mask = 0;
+
+    // Process-local views of the other side's index.
+    std::uint64_t cachedHead = 0;
+    std::uint64_t cachedTail = 0;
+};
+
+#endif // SHARED_QUEUE_H
@@ -0,0 +1,594 @@
+#ifndef SLAB_ALLOCATOR_H
+#define SLAB_ALLOCATOR_H
+
+#include "Reclaim.h"
+#include "ShardedCounter.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <stdexcept>
+#include <vector>
+#if defined(__has_include)
+#if __has_include(<memory_resource>)
+#include <memory_resource>
+#endif
+#endif
+
+// Small-object allocator: requests of up to MaxSize bytes are rounded up to
+// one of ClassCount size classes and carved out of 64 KiB slabs holding
+// objects of that class only, so objects of a kind sit densely together.
+//
+// Each thread has a heap per allocator with a magazine (a small stack of
+// free objects) per class. allocate() pops from the magazine and
+// deallocate() of an object from one of the thread's own slabs pushes onto
+// it, with no lock and no atomic read-modify-write. A magazine that runs dry
+// is refilled in a batch from the thread's slabs; one that overflows hands
+// half back to them.
+//
+// An object freed by another thread goes back to its slab through the
+// slab's lock-free MPSC list, and the owning thread collects the whole list
+// when it next needs objects of that class. A thread that exits leaves its
+// slabs to the allocator, and other threads adopt them before asking for new
+// ones. Slabs are kept until the allocator is destroyed, so memory is
+// bounded by peak use.
+//
+// Larger or more than 64-byte-aligned requests go straight to the upstream
+// (aligned operator new, or a std::pmr::memory_resource). The interface
+// matches the slot allocators (see SlotAllocator.h); SlabResource wraps one
+// as a std::pmr::memory_resource for StringPool and the queues.
+//
+// Thread-safe. Every object must be freed with the size and alignment it
+// was allocated with, and before the allocator is destroyed.
+
+struct SlabClassStats {
+    size_t objectSize = 0;
+    size_t slabs = 0;
+    // Objects the slabs can hold, and how many are allocated.
+    size_t capacity = 0;
+    size_t inUse = 0;
+
+    double occupancy() const {
+        return capacity == 0 ? 0.0 : double(inUse) / double(capacity);
+    }
+};
+
+struct SlabStats {
+    std::vector<SlabClassStats> classes;
+    size_t slabs = 0;
+    // Slabs plus live large allocations, and the part of it allocated.
+    size_t reservedBytes = 0;
+    size_t inUseBytes = 0;
+    size_t largeAllocations = 0;
+    size_t largeBytes = 0;
+};
+
+class SlabAllocator;
+
+namespace detail {
+
+// The heaps this thread has in each allocator.
+struct SlabThreadCache {
+    struct Entry {
+        std::uint64_t id;
+        SlabAllocator* allocator;
+        void* heap;
+    };
+
+    ~SlabThreadCache();
+
+    static SlabThreadCache& local() {
+        static thread_local SlabThreadCache cache;
+        return cache;
+    }
+
+    // The last heap used, in trivially constructed storage, so the common
+    // case skips the lazy initialisation of local(). Ids are never reused,
+    // so an entry for a destroyed allocator cannot match.
+    static Entry& last() {
+        static thread_local Entry entry = {0, nullptr, nullptr};
+        return entry;
+    }
+
+    // Set once local() is destroyed; calls from later thread-local
+    // destructors then allocate and free as if from another thread.
+    static bool& exited() {
+        static thread_local bool flag = false;
+        return flag;
+    }
+
+    // The calling thread's heap in allocator id, or nullptr.
+    static void* find(std::uint64_t id) {
+        Entry& cached = last();
+        if (cached.id == id) {
+            return cached.heap;
+        }
+        if (exited()) {
+            return nullptr;
+        }
+        for (const Entry& entry : local().entries) {
+            if (entry.id == id) {
+                cached = entry;
+                return entry.heap;
+            }
+        }
+        return nullptr;
+    }
+
+    std::vector<Entry> entries;
+};
+
+} // namespace detail
+
+class SlabAllocator {
+public:
+    static constexpr size_t SlabSize = size_t(64) << 10;
+    static constexpr size_t MaxSize = 2048;
+    static constexpr size_t MaxAlignment = 64;
+    static constexpr size_t ClassCount = 20;
+    static constexpr size_t MagazineSize = 64;
+
+    SlabAllocator() : id_(detail::ReclaimRegistry::instance().add()) {}
+
+#if defined(__cpp_lib_memory_resource)
+    // Throws std::invalid_argument if upstream is null.
+    explicit SlabAllocator(std::pmr::memory_resource* upstream) : SlabAllocator() {
+        if (upstream == nullptr) {
+            // The delegated constructor has finished, so the destructor
+            // unregisters us.
+            throw std::invalid_argument("SlabAllocator needs an upstream memory resource.");
+        }
+        upstream_ = upstream;
+    }
+#endif
+
+    ~SlabAllocator() {
+        // Threads still holding a heap leave it alone from here on.
+        detail::ReclaimRegistry::instance().remove(id_);
+        for (const auto& heap : heaps_) {
+            for (Heap::Class& cls : heap->classes) {
+                for (Slab* slab : cls.owned) {
+                    releaseSlab(slab);
+                }
+            }
+        }
+        for (std::vector<Slab*>& abandoned : abandoned_) {
+            for (Slab* slab : abandoned) {
+                releaseSlab(slab);
+            }
+        }
+    }
+
+    SlabAllocator(const SlabAllocator&) = delete;
+    SlabAllocator& operator=(const SlabAllocator&) = delete;
+
+    void* allocate(size_t bytes, size_t alignment = alignof(std::max_align_t)) {
+        const size_t index = classIndex(bytes, alignment);
+        if (index == ClassCount) {
+            return allocateLarge(bytes, alignment);
+        }
+        Heap* local = localHeap();
+        if (local == nullptr) {
+            return allocateDetached(index);
+        }
+        Heap& heap = *local;
+        Heap::Class& cls = heap.classes[index];
+        if (cls.count == 0) {
+            refill(heap, index);
+        }
+        increment(cls.allocated);
+        return cls.magazine[--cls.count];
+    }
+
+    void deallocate(void* p, size_t bytes, size_t alignment = alignof(std::max_align_t)) noexcept {
+        if (classIndex(bytes, alignment) == ClassCount) {
+            deallocateLarge(p, bytes, alignment);
+            return;
+        }
+        Slab* slab = slabOf(p);
+        Heap* heap = static_cast<Heap*>(detail::SlabThreadCache::find(id_));
+        if (heap != nullptr && slab->owner.load(std::memory_order_relaxed) == heap) {
+            Heap::Class& cls = heap->classes[slab->index];
+            if (cls.count == MagazineSize) {
+                flush(cls, MagazineSize / 2);
+            }
+            cls.magazine[cls.count++] = p;
+            increment(cls.freed);
+            return;
+        }
+        FreeNode* node = static_cast<FreeNode*>(p);
+        node->next = slab->remote.load(std::memory_order_relaxed);
+        while (!slab->remote.compare_exchange_weak(node->next, node, std::memory_order_release, std::memory_order_relaxed)) {
+        }
+        remoteFrees_.add(slab->index, 1);
+        if (Heap* owner = slab->owner.load(std::memory_order_relaxed)) {
+            owner->hints[slab->index].pending.store(true, std::memory_order_relaxed);
+        }
+    }
+
+    // Object size of class index.
+    static constexpr size_t classSize(size_t index) {
+        return index < 8 ? (index + 1) * 16 : index < 14 ? 128 + (index - 7) * 64 : 512 + (index - 13) * 256;
+    }
+
+    // The class a request is served from, or ClassCount if it goes upstream.
+    static size_t classIndex(size_t bytes, size_t alignment) {
+        if (alignment > MaxAlignment || bytes > MaxSize) {
+            return ClassCount;
+        }
+        bytes = std::max<size_t>({bytes, alignment, 1});
+        size_t index;
+        if (bytes <= 128) {
+            index = (bytes + 15) / 16 - 1;
+        } else if (bytes <= 512) {
+            index = 8 + (bytes - 128 + 63) / 64 - 1;
+        } else {
+            index = 14 + (bytes - 512 + 255) / 256 - 1;
+        }
+        while (index < ClassCount && classSize(index) % alignment != 0) {
+            ++index;
+        }
+        return index;
+    }
+
+    // Approximate while other threads allocate.
+    SlabStats stats() const {
+        SlabStats result;
+        result.classes.resize(ClassCount);
+        const auto remote = remoteFrees_.snapshot();
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (size_t i = 0; i < ClassCount; ++i) {
+            SlabClassStats& cls = result.classes[i];
+            cls.objectSize = classSize(i);
+            cls.slabs = slabCount_[i].load(std::memory_order_relaxed);
+            cls.capacity = cls.slabs * objectsPerSlab(i);
+            std::uint64_t allocated = 0;
+            std::uint64_t freed = remote[i];
+            for (const auto& heap : heaps_) {
+                allocated += heap->classes[i].allocated.load(std::memory_order_relaxed);
+                freed += heap->classes[i].freed.load(std::memory_order_relaxed);
+            }
+            cls.inUse = allocated > freed ? static_cast<size_t>(allocated - freed) : 0;
+            result.slabs += cls.slabs;
+            result.inUseBytes += cls.inUse * cls.objectSize;
+        }
+        result.largeAllocations = largeCount_.load(std::memory_order_relaxed);
+        result.largeBytes = largeBytes_.load(std::memory_order_relaxed);
+        result.reservedBytes = result.slabs * SlabSize + result.largeBytes;
+        result.inUseBytes += result.largeBytes;
+        return result;
+    }
+
+private:
+    struct FreeNode {
+        FreeNode* next;
+    };
+
+    struct Heap;
+
+    // The header at the start of each slab; objects follow it.
+    struct Slab {
+        // Read by every thread that frees into the slab.
+        alignas(64) std::atomic<Heap*> owner{nullptr};
+        std::uint32_t index = 0;
+        // Pushed to by other threads.
+        alignas(64) std::atomic<FreeNode*> remote{nullptr};
+        // The owner's alone.
+        alignas(64) FreeNode* local = nullptr;
+        char* bump = nullptr;
+        char* end = nullptr;
+        bool partial = false;
+    };
+
+    struct Heap {
+        struct Class {
+            void* magazine[MagazineSize];
+            std::uint32_t count = 0;
+            Slab* current = nullptr;
+            // Owned slabs with objects on their local list.
+            std::vector<Slab*> partial;
+            std::vector<Slab*> owned;
+            // Written by the heap's thread only.
+            std::atomic<std::uint64_t> allocated{0};
+            std::atomic<std::uint64_t> freed{0};
+        };
+
+        // Set by remote frees, so the owner knows to look at its slabs.
+        struct alignas(64) Hint {
+            std::atomic<bool> pending{false};
+        };
+
+        Class classes[ClassCount];
+        Hint hints[ClassCount];
+    };
+
+    static constexpr size_t HeaderSize = sizeof(Slab);
+    static_assert(HeaderSize % MaxAlignment == 0, "objects start aligned");
+
+    static constexpr size_t objectsPerSlab(size_t index) {
+        return (SlabSize - HeaderSize) / classSize(index);
+    }
+
+    static Slab* slabOf(void* p) {
+        return reinterpret_cast<Slab*>(reinterpret_cast<std::uintptr_t>(p) & ~(std::uintptr_t(SlabSize) - 1));
+    }
+
+    // Single-writer counter: a plain load and store, no locked instruction.
+    static void increment(std::atomic<std::uint64_t>& counter) {
+        counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+
+    // The calling thread's heap, or nullptr once its cache is gone.
+    Heap* localHeap() {
+        if (void* heap = detail::SlabThreadCache::find(id_)) {
+            return static_cast<Heap*>(heap);
+        }
+        if (detail::SlabThreadCache::exited()) {
+            return nullptr;
+        }
+        Heap* heap = takeHeap();
+        std::vector<detail::SlabThreadCache::Entry>& entries = detail::SlabThreadCache::local().entries;
+        detail::ReclaimRegistry::instance().prune(entries, &detail::SlabThreadCache::Entry::id);
+        entries.push_back({id_, this, heap});
+        return heap;
+    }
+
+    Heap* takeHeap() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!freeHeaps_.empty()) {
+            Heap* heap = freeHeaps_.back();
+            freeHeaps_.pop_back();
+            return heap;
+        }
+        heaps_.emplace_back(new Heap());
+        return heaps_.back().get();
+    }
+
+    // For a thread whose cache is gone: borrows a heap for one object and
+    // gives it straight back.
+    void* allocateDetached(size_t index) {
+        Heap* heap = takeHeap();
+        Heap::Class& cls = heap->classes[index];
+        try {
+            refill(*heap, index);
+        } catch (...) {
+            detach(heap);
+            throw;
+        }
+        increment(cls.allocated);
+        void* p = cls.magazine[--cls.count];
+        detach(heap);
+        return p;
+    }
+
+    friend struct detail::SlabThreadCache;
+
+    // At thread exit: empties the magazines and leaves the slabs to the
+    // allocator for other threads to adopt.
+    void detach(void* opaque) {
+        Heap& heap = *static_cast<Heap*>(opaque);
+        for (size_t i = 0; i < ClassCount; ++i) {
+            Heap::Class& cls = heap.classes[i];
+            flush(cls, cls.count);
+            for (Slab* slab : cls.owned) {
+                slab->partial = false;
+                slab->owner.store(nullptr, std::memory_order_release);
+            }
+            std::lock_guard<std::mutex> lock(mutex_);
+            abandoned_[i].insert(abandoned_[i].end(), cls.owned.begin(), cls.owned.end());
+            cls.owned.clear();
+            cls.partial.clear();
+            cls.current = nullptr;
+        }
+        std::lock_guard<std::mutex> lock(mutex_);
+        freeHeaps_.push_back(&heap);
+    }
+
+    // Hands the oldest count magazine objects back to their slabs.
+    void flush(Heap::Class& cls, size_t count) {
+        for (size_t i = 0; i < count; ++i) {
+            Slab* slab = slabOf(cls.magazine[i]);
+            FreeNode* node = static_cast<FreeNode*>(cls.magazine[i]);
+            node->next = slab->local;
+            slab->local = node;
+            if (!slab->partial && slab != cls.current) {
+                slab->partial = true;
+                cls.partial.push_back(slab);
+            }
+        }
+        std::memmove(cls.magazine, cls.magazine + count, (cls.count - count) * sizeof(void*));
+        cls.count -= static_cast<std::uint32_t>(count);
+    }
+
+    // Moves the slab's remote frees to its local list; false if there were none.
+    static bool drainRemote(Slab& slab) {
+        FreeNode* list = slab.remote.exchange(nullptr, std::memory_order_acquire);
+        if (list == nullptr) {
+            return false;
+        }
+        FreeNode* last = list;
+        while (last->next != nullptr) {
+            last = last->next;
+        }
+        last->next = slab.local;
+        slab.local = list;
+        return true;
+    }
+
+    // Fills half the magazine from slab; false if it had nothing left.
+    bool takeFrom(Heap::Class& cls, Slab& slab, size_t size) {
+        while (cls.count < MagazineSize / 2) {
+            void* p;
+            if (slab.local != nullptr) {
+                p = slab.local;
+                slab.local = slab.local->next;
+            } else if (slab.bump != slab.end) {
+                p = slab.bump;
+                slab.bump += size;
+            } else if (drainRemote(slab)) {
+                continue;
+            } else {
+                break;
+            }
+            cls.magazine[cls.count++] = p;
+        }
+        return cls.count != 0;
+    }
+
+    void refill(Heap& heap, size_t index) {
+        Heap::Class& cls = heap.classes[index];
+        const size_t size = classSize(index);
+        while (true) {
+            if (cls.current != nullptr && takeFrom(cls, *cls.current, size)) {
+                return;
+            }
+            if (heap.hints[index].pending.exchange(false, std::memory_order_relaxed)) {
+                for (Slab* slab : cls.owned) {
+                    if (slab != cls.current && drainRemote(*slab) && !slab->partial) {
+                        slab->partial = true;
+                        cls.partial.push_back(slab);
+                    }
+                }
+            }
+            if (!cls.partial.empty()) {
+                cls.current = cls.partial.back();
+                cls.partial.pop_back();
+                cls.current->partial = false;
+                continue;
+            }
+            Slab* slab = adopt(index);
+            if (slab == nullptr) {
+                slab = newSlab(index);
+            }
+            slab->owner.store(&heap, std::memory_order_relaxed);
+            cls.owned.push_back(slab);
+            cls.current = slab;
+        }
+    }
+
+    Slab* adopt(size_t index) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (abandoned_[index].empty()) {
+            return nullptr;
+        }
+        Slab* slab = abandoned_[index].back();
+        abandoned_[index].pop_back();
+        return slab;
+    }
+
+    Slab* newSlab(size_t index) {
+        void* memory = upstreamAllocate(SlabSize, SlabSize);
+        Slab* slab = new (memory) Slab();
+        slab->index = static_cast<std::uint32_t>(index);
+        slab->bump = static_cast<char*>(memory) + HeaderSize;
+        slab->end = slab->bump + objectsPerSlab(index) * classSize(index);
+        slabCount_[index].fetch_add(1, std::memory_order_relaxed);
+        return slab;
+    }
+
+    void releaseSlab(Slab* slab) {
+        slab->~Slab();
+        upstreamDeallocate(slab, SlabSize, SlabSize);
+    }
+
+    void* allocateLarge(size_t bytes, size_t alignment) {
+        void* p = upstreamAllocate(bytes, alignment);
+        largeCount_.fetch_add(1, std::memory_order_relaxed);
+        largeBytes_.fetch_add(bytes, std::memory_order_relaxed);
+        return p;
+    }
+
+    void deallocateLarge(void* p, size_t bytes, size_t alignment) noexcept {
+        upstreamDeallocate(p, bytes, alignment);
+        largeCount_.fetch_sub(1, std::memory_order_relaxed);
+        largeBytes_.fetch_sub(bytes, std::memory_order_relaxed);
+    }
+
+    void* upstreamAllocate(size_t bytes, size_t alignment) {
+#if defined(__cpp_lib_memory_resource)
+        if (upstream_ != nullptr) {
+            return upstream_->allocate(bytes, alignment);
+        }
+#endif
+        return ::operator new(bytes, std::align_val_t(alignment));
+    }
+
+    void upstreamDeallocate(void* p, size_t bytes, size_t alignment) noexcept {
+#if defined(__cpp_lib_memory_resource)
+        if (upstream_ != nullptr) {
+            upstream_->deallocate(p, bytes, alignment);
+            return;
+        }
+#endif
+        ::operator delete(p, std::align_val_t(alignment));
+    }
+
+    const std::uint64_t id_;
+#if defined(__cpp_lib_memory_resource)
+    std::pmr::memory_resource* upstream_ = nullptr;
+#endif
+    mutable std::mutex mutex_;
+    std::vector<std::unique_ptr<Heap>> heaps_;
+    std::vector<Heap*> freeHeaps_;
+    std::vector<Slab*> abandoned_[ClassCount];
+    std::atomic<size_t> slabCount_[ClassCount] = {};
+    ShardedCounters<std::uint64_t, ClassCount> remoteFrees_;
+    std::atomic<size_t> largeCount_{0};
+    std::atomic<size_t> largeBytes_{0};
+};
+
+inline detail::SlabThreadCache::~SlabThreadCache() {
+    last() = Entry{0, nullptr, nullptr};
+    exited() = true;
+    ReclaimRegistry& registry = ReclaimRegistry::instance();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    for (const Entry& entry : entries) {
+        if (std::find(registry.live.begin(), registry.live.end(), entry.id) != registry.live.end()) {
+            entry.allocator->detach(entry.heap);
+        }
+    }
+}
+
+#if defined(__cpp_lib_memory_resource)
+
+// A SlabAllocator as a std::pmr::memory_resource, e.g. for
+// StringPool(lifetime, &resource) or ResourceSlotAllocator.
+class SlabResource : public std::pmr::memory_resource {
+public:
+    SlabResource() = default;
+
+    // Throws std::invalid_argument if upstream is null.
+    explicit SlabResource(std::pmr::memory_resource* upstream) : slabs_(upstream) {}
+
+    SlabAllocator& allocator() {
+        return slabs_;
+    }
+
+    SlabStats stats() const {
+        return slabs_.stats();
+    }
+
+private:
+    void* do_allocate(size_t bytes, size_t alignment) override {
+        return slabs_.allocate(bytes, alignment);
+    }
+
+    void do_deallocate(void* p, size_t bytes, size_t alignment) override {
+        slabs_.deallocate(p, bytes, alignment);
+    }
+
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+        return this == &other;
+    }
+
+    SlabAllocator slabs_;
+};
+
+#endif // __cpp_lib_memory_resource
+
+#endif // SLAB_ALLOCATOR_H
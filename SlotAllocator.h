@@ -0,0 +1,172 @@
+#ifndef SLOT_ALLOCATOR_H
+#define SLOT_ALLOCATOR_H
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <stdexcept>
+#if defined(__has_include)
+#if __has_include(<memory_resource>)
+#include <memory_resource>
+#endif
+#endif
+
+#if defined(__linux__)
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+// Allocators for ring slot storage. The queues only need raw bytes, so the
+// interface mirrors std::pmr::memory_resource rather than std::allocator:
+//
+//   void* allocate(size_t bytes, size_t alignment);
+//   void deallocate(void* p, size_t bytes, size_t alignment) noexcept;
+//
+// Allocators are held by value inside the queue and may carry state (a NUMA
+// node, for instance).
+
+// Plain aligned operator new.
+struct HeapSlotAllocator {
+    void* allocate(size_t bytes, size_t alignment) {
+        return ::operator new(bytes, std::align_val_t(alignment));
+    }
+
+    void deallocate(void* p, size_t, size_t alignment) noexcept {
+        ::operator delete(p, std::align_val_t(alignment));
+    }
+};
+
+#if defined(__cpp_lib_memory_resource)
+
+// Forwards to a std::pmr::memory_resource, so a ring can live in a
+// monotonic buffer, a shared-memory arena or a per-subsystem accounting
+// resource. The resource must outlive the queue.
+class ResourceSlotAllocator {
+public:
+    ResourceSlotAllocator() : ResourceSlotAllocator(std::pmr::get_default_resource()) {}
+
+    // Throws std::invalid_argument if resource is null.
+    explicit ResourceSlotAllocator(std::pmr::memory_resource* resource) : resource_(resource) {
+        if (resource_ == nullptr) {
+            throw std::invalid_argument("ResourceSlotAllocator needs a memory resource.");
+        }
+    }
+
+    void* allocate(size_t bytes, size_t alignment) {
+        return resource_->allocate(bytes, alignment);
+    }
+
+    void deallocate(void* p, size_t bytes, size_t alignment) noexcept {
+        resource_->deallocate(p, bytes, alignment);
+    }
+
+    std::pmr::memory_resource* resource() const {
+        return resource_;
+    }
+
+private:
+    std::pmr::memory_resource* resource_;
+};
+
+#endif // __cpp_lib_memory_resource
+
+#if defined(__linux__)
+
+// Anonymous mmap with optional 2 MB huge pages and NUMA binding. Large rings
+// touch one TLB entry per 2 MB instead of per 4 KB, and binding keeps the
+// ring on the socket of the thread that reads it.
+class MappedSlotAllocator {
+public:
+    static constexpr size_t HugePageSize = size_t(2) << 20;
+    static constexpr int AnyNode = -1;
+
+    explicit MappedSlotAllocator(bool hugePages = true, int numaNode = AnyNode)
+        : hugePages(hugePages), numaNode(numaNode) {}
+
+    void* allocate(size_t bytes, size_t alignment) {
+        if (alignment > pageSize()) {
+            throw std::invalid_argument("MappedSlotAllocator cannot align beyond a huge page.");
+        }
+        const size_t length = mappedLength(bytes);
+        void* p = MAP_FAILED;
+        if (hugePages) {
+            // Explicit huge pages need a reserved pool; fall back to
+            // transparent huge pages below when there is none.
+            p = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        }
+        if (p == MAP_FAILED) {
+            p = mapAligned(length);
+            if (hugePages) {
+                madvise(p, length, MADV_HUGEPAGE);
+            }
+        }
+        if (numaNode != AnyNode && !bind(p, length)) {
+            munmap(p, length);
+            throw std::runtime_error("mbind to the requested NUMA node failed.");
+        }
+        return p;
+    }
+
+    void deallocate(void* p, size_t bytes, size_t) noexcept {
+        munmap(p, mappedLength(bytes));
+    }
+
+    int node() const {
+        return numaNode;
+    }
+
+private:
+    size_t pageSize() const {
+        return hugePages ? HugePageSize : static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    }
+
+    size_t mappedLength(size_t bytes) const {
+        const size_t page = pageSize();
+        return (bytes + page - 1) / page * page;
+    }
+
+    // Maps length bytes aligned to pageSize(), so transparent huge pages can
+    // back the whole range, by over-mapping and trimming both ends.
+    void* mapAligned(size_t length) {
+        const size_t page = pageSize();
+        const size_t span = hugePages ? length + page : length;
+        void* raw = mmap(nullptr, span, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (raw == MAP_FAILED) {
+            throw std::bad_alloc();
+        }
+        if (!hugePages) {
+            return raw;
+        }
+        const std::uintptr_t start = reinterpret_cast<std::uintptr_t>(raw);
+        const std::uintptr_t aligned = (start + page - 1) & ~(static_cast<std::uintptr_t>(page) - 1);
+        if (aligned != start) {
+            munmap(raw, aligned - start);
+        }
+        const std::uintptr_t end = start + span;
+        if (end != aligned + length) {
+            munmap(reinterpret_cast<void*>(aligned + length), end - (aligned + length));
+        }
+        return reinterpret_cast<void*>(aligned);
+    }
+
+    // mbind(2) through the raw system call, so there is no libnuma dependency.
+    bool bind(void* p, size_t length) const {
+        const int MpolBind = 2;
+        const size_t bitsPerWord = sizeof(unsigned long) * 8;
+        // The kernel reads one bit fewer than maxnode says.
+        if (numaNode < 0 || static_cast<size_t>(numaNode) >= bitsPerWord * 16 - 1) {
+            return false;
+        }
+        unsigned long mask[16] = {};
+        mask[numaNode / bitsPerWord] = 1UL << (numaNode % bitsPerWord);
+        return syscall(SYS_mbind, p, length, MpolBind, mask, bitsPerWord * 16, 0) == 0;
+    }
+
+    bool hugePages;
+    int numaNode;
+};
+
+#endif // __linux__
+
+#endif // SLOT_ALLOCATOR_H
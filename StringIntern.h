@@ -1,16 +1,44 @@
 #ifndef STRING_INTERN_H
 #define STRING_INTERN_H
 
+#include <algorithm>
+#include <functional>
 #include <iostream>
 #include <string>
 #include <memory>
 #include <stdexcept>
 #include <mutex>
-#include <unordered_map>
+#include <cstring>
+#include <new>
 #include <string_view>
+#include <type_traits>
 #include <cstddef>
 #include <cassert>
 #include <atomic>
+#include <chrono>
+#include <vector>
+#include <fstream>
+#include <utility>
+
+#include "Reclaim.h"
+#include "ShardedCounter.h"
+#if __cplusplus >= 202002L && defined(__has_include)
+#if __has_include(<span>)
+#include <span>
+#endif
+#endif
+#if defined(__has_include)
+#if __has_include(<memory_resource>)
+#include <memory_resource>
+#endif
+#endif
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 // FNV-1a hash function
 constexpr inline uint32_t fnv1a(const char* str, std::size_t length) {
@@ -31,6 +59,180 @@ inline uint32_t fnv1a_runtime(const char* str, std::size_t length) {
     return hash;
 }
 
+// True while a constexpr function is being evaluated at compile time, where
+// the loads below must stay byte by byte; undefined if the compiler cannot
+// tell, and then they always are.
+#if defined(__cpp_lib_is_constant_evaluated)
+#define CPPUTILS_CONSTANT_EVALUATED() std::is_constant_evaluated()
+#elif defined(__clang__) && defined(__has_builtin)
+#if __has_builtin(__builtin_is_constant_evaluated)
+#define CPPUTILS_CONSTANT_EVALUATED() __builtin_is_constant_evaluated()
+#endif
+#elif defined(__GNUC__) && __GNUC__ >= 9
+#define CPPUTILS_CONSTANT_EVALUATED() __builtin_is_constant_evaluated()
+#endif
+
+#if defined(CPPUTILS_CONSTANT_EVALUATED) && defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#define CPPUTILS_HASH_NATIVE_LOADS 1
+#endif
+
+namespace detail {
+
+// Little-endian loads spelled as shifts so they work in constant
+// expressions. At runtime on little-endian targets they are plain memcpy
+// loads: left to the optimiser, the shift loops cost hash64 about three
+// times its speed.
+constexpr std::uint64_t load64(const char* p) {
+#if defined(CPPUTILS_HASH_NATIVE_LOADS)
+    if (!CPPUTILS_CONSTANT_EVALUATED()) {
+        std::uint64_t v = 0;
+        std::memcpy(&v, p, sizeof(v));
+        return v;
+    }
+#endif
+    std::uint64_t v = 0;
+    for (int i = 0; i < 8; ++i) {
+        v |= std::uint64_t(static_cast<unsigned char>(p[i])) << (8 * i);
+    }
+    return v;
+}
+
+constexpr std::uint64_t load32(const char* p) {
+#if defined(CPPUTILS_HASH_NATIVE_LOADS)
+    if (!CPPUTILS_CONSTANT_EVALUATED()) {
+        std::uint32_t v = 0;
+        std::memcpy(&v, p, sizeof(v));
+        return v;
+    }
+#endif
+    std::uint64_t v = 0;
+    for (int i = 0; i < 4; ++i) {
+        v |= std::uint64_t(static_cast<unsigned char>(p[i])) << (8 * i);
+    }
+    return v;
+}
+
+// Full 64x64 -> 128-bit product, as (lo, hi).
+constexpr void multiply128(std::uint64_t& a, std::uint64_t& b) {
+#if defined(__SIZEOF_INT128__)
+    __extension__ typedef unsigned __int128 uint128;
+    const uint128 r = uint128(a) * b;
+    a = static_cast<std::uint64_t>(r);
+    b = static_cast<std::uint64_t>(r >> 64);
+#else
+    const std::uint64_t ha = a >> 32, la = a & 0xffffffffu, hb = b >> 32, lb = b & 0xffffffffu;
+    const std::uint64_t hi = ha * hb, mid0 = ha * lb, mid1 = hb * la, low = la * lb;
+    const std::uint64_t t = low + (mid0 << 32);
+    std::uint64_t carry = t < low;
+    const std::uint64_t lo = t + (mid1 << 32);
+    carry += lo < t;
+    a = lo;
+    b = hi + (mid0 >> 32) + (mid1 >> 32) + carry;
+#endif
+}
+
+constexpr std::uint64_t mix(std::uint64_t a, std::uint64_t b) {
+    multiply128(a, b);
+    return a ^ b;
+}
+
+constexpr std::uint64_t HashP0 = 0xa0761d6478bd642full;
+constexpr std::uint64_t HashP1 = 0xe7037ed1a0b428dbull;
+constexpr std::uint64_t HashP2 = 0x8ebc6af09c88c6e3ull;
+
+} // namespace detail
+
+// 64-bit string hash in the style of wyhash: 16 bytes per multiply-mix step,
+// and short keys read with a few overlapping loads rather than byte by byte.
+// constexpr, so _hs literals hash at compile time to the same value.
+constexpr std::uint64_t hash64(const char* str, std::size_t length, std::uint64_t seed = 0) {
+    constexpr std::uint64_t P0 = detail::HashP0;
+    constexpr std::uint64_t P1 = detail::HashP1;
+    constexpr std::uint64_t P2 = detail::HashP2;
+    seed ^= detail::mix(seed ^ P0, P1);
+    std::uint64_t a = 0;
+    std::uint64_t b = 0;
+    if (length <= 16) {
+        if (length >= 4) {
+            const std::size_t step = (length >> 3) << 2;
+            a = (detail::load32(str) << 32) | detail::load32(str + step);
+            b = (detail::load32(str + length - 4) << 32) | detail::load32(str + length - 4 - step);
+        } else if (length > 0) {
+            a = (std::uint64_t(static_cast<unsigned char>(str[0])) << 16) |
+                (std::uint64_t(static_cast<unsigned char>(str[length >> 1])) << 8) |
+                std::uint64_t(static_cast<unsigned char>(str[length - 1]));
+        }
+    } else {
+        std::size_t remaining = length;
+        while (remaining > 16) {
+            seed = detail::mix(detail::load64(str) ^ P1, detail::load64(str + 8) ^ seed);
+            str += 16;
+            remaining -= 16;
+        }
+        // The last 16 bytes, overlapping the final block if need be.
+        a = detail::load64(str + remaining - 16);
+        b = detail::load64(str + remaining - 8);
+    }
+    a ^= P1;
+    b ^= seed;
+    detail::multiply128(a, b);
+    return detail::mix(a ^ P2 ^ length, b ^ P1);
+}
+
+namespace detail {
+
+// hash64 with seed 0 for length <= 32, as straight-line code: at most one
+// block step, so there is no loop to predict.
+inline std::uint64_t hash64Short(const char* str, std::size_t length) {
+    constexpr std::uint64_t Seed = mix(HashP0, HashP1);
+    std::uint64_t seed = Seed;
+    std::uint64_t a = 0;
+    std::uint64_t b = 0;
+    if (length > 16) {
+        seed = mix(load64(str) ^ HashP1, load64(str + 8) ^ Seed);
+        a = load64(str + length - 16);
+        b = load64(str + length - 8);
+    } else if (length >= 4) {
+        const std::size_t step = (length >> 3) << 2;
+        a = (load32(str) << 32) | load32(str + step);
+        b = (load32(str + length - 4) << 32) | load32(str + length - 4 - step);
+    } else if (length > 0) {
+        a = (std::uint64_t(static_cast<unsigned char>(str[0])) << 16) |
+            (std::uint64_t(static_cast<unsigned char>(str[length >> 1])) << 8) |
+            std::uint64_t(static_cast<unsigned char>(str[length - 1]));
+    }
+    a ^= HashP1;
+    b ^= seed;
+    multiply128(a, b);
+    return mix(a ^ HashP2 ^ length, b ^ HashP1);
+}
+
+inline std::uint64_t hash64Any(std::string_view str) {
+    return str.size() <= 32 ? hash64Short(str.data(), str.size()) : hash64(str.data(), str.size());
+}
+
+} // namespace detail
+
+// hash64 of in[0, count) into out, e.g. for intern_batch. Works four keys
+// per step so the multiplies of independent keys overlap in the pipeline;
+// keys of up to 32 bytes (tickers, field names) skip the block loop.
+inline void hash64_batch(const std::string_view* in, std::size_t count, std::uint64_t* out) {
+    std::size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        const std::uint64_t h0 = detail::hash64Any(in[i]);
+        const std::uint64_t h1 = detail::hash64Any(in[i + 1]);
+        const std::uint64_t h2 = detail::hash64Any(in[i + 2]);
+        const std::uint64_t h3 = detail::hash64Any(in[i + 3]);
+        out[i] = h0;
+        out[i + 1] = h1;
+        out[i + 2] = h2;
+        out[i + 3] = h3;
+    }
+    for (; i < count; ++i) {
+        out[i] = detail::hash64Any(in[i]);
+    }
+}
+
 class StringPool;
 class String;
 using StringPtr = std::shared_ptr<const String>;
@@ -40,7 +242,8 @@ struct is_allowed_string_type :
     std::disjunction<
         std::is_same<std::decay_t<T>, std::string>,
         std::is_same<std::decay_t<T>, char*>,
-        std::is_same<std::decay_t<T>, const char*>
+        std::is_same<std::decay_t<T>, const char*>,
+        std::is_same<std::decay_t<T>, std::string_view>
     > {};
 
 // 特化处理 const char[N]
@@ -51,174 +254,2309 @@ struct is_allowed_string_type<const char[N]> : std::true_type {};
 template<std::size_t N>
 struct is_allowed_string_type<char[N]> : std::true_type {};
 
+// An interned string. Header and characters share one allocation: counted
+// strings come from allocate_shared with the characters appended after its
+// control block, so the reference counts, this header and the bytes are a
+// single heap block; immortal strings put the header and the bytes side by
+// side in the arena. The length (in data) and the hash sit at fixed offsets.
 class String {
 public:
-    std::string data;
+    // Points at the characters stored right after this header; always
+    // followed by a NUL.
+    std::string_view data;
 
     size_t length() const { return data.length(); }
     size_t size() const { return data.size(); }
     bool empty() const { return data.empty(); }
+    const char* c_str() const { return data.data(); }
+    // hash64 of the characters, as computed when the string was interned.
+    std::uint64_t hash() const { return hash_; }
     char operator[](size_t index) const { return data[index]; }
     char at(size_t index) const { return data.at(index); }
-    size_t find(const std::string& str, size_t pos = 0) const { return data.find(str, pos); }
-    size_t rfind(const std::string& str, size_t pos = std::string::npos) const { return data.rfind(str, pos); }
-    std::string substr(size_t pos = 0, size_t len = std::string::npos) const { return data.substr(pos, len); }
+    size_t find(std::string_view str, size_t pos = 0) const { return data.find(str, pos); }
+    size_t find(char c, size_t pos = 0) const { return data.find(c, pos); }
+    size_t rfind(std::string_view str, size_t pos = std::string::npos) const { return data.rfind(str, pos); }
+    size_t rfind(char c, size_t pos = std::string::npos) const { return data.rfind(c, pos); }
+    std::string substr(size_t pos = 0, size_t len = std::string::npos) const { return std::string(data.substr(pos, len)); }
+
+    // Views borrow the interned characters and copy nothing; they stay valid
+    // while the string is alive.
+    std::string_view view() const { return data; }
+    std::string_view substr_view(size_t pos = 0, size_t len = std::string::npos) const { return data.substr(pos, len); }
+    operator std::string_view() const { return data; }
+
+    bool starts_with(std::string_view prefix) const { return data.substr(0, prefix.size()) == prefix; }
+    bool starts_with(char c) const { return !data.empty() && data.front() == c; }
+    bool ends_with(std::string_view suffix) const {
+        return data.size() >= suffix.size() && data.compare(data.size() - suffix.size(), suffix.size(), suffix) == 0;
+    }
+    bool ends_with(char c) const { return !data.empty() && data.back() == c; }
 
     bool operator==(const String& other) const { return data == other.data; }
     bool operator!=(const String& other) const { return data != other.data; }
 
+    // The pool that interned this string; nullptr for strings served from a
+    // snapshot base layer, and for counted strings that outlived their pool.
+    StringPool* pool() const { return pool_; }
+
+    // Queues a counted string's entry for removal from its pool.
+    ~String();
+
 private:
     // No copy and assignment constructors
     String(const String&) = delete;
     String& operator=(const String&) = delete;
-    explicit String(const char* str) : data(str) {}
-    explicit String(const std::string& str) : data(str) {}
+
+    // Over characters that live elsewhere (an arena or a snapshot mapping).
+    String(std::string_view chars, std::uint64_t hash) : data(chars), hash_(hash) {}
+
+    // Copies src to *chars, which the allocating code fills in before the
+    // constructor runs, and registers with pool for removal on destruction.
+    String(char* const* chars, std::string_view src, std::uint64_t hash, StringPool* pool)
+        : data(place(*chars, src)), hash_(hash), pool_(pool) {}
+
+    static std::string_view place(char* chars, std::string_view src) {
+        std::memcpy(chars, src.data(), src.size());
+        chars[src.size()] = '\0';
+        return std::string_view(chars, src.size());
+    }
+
+    static size_t footprint(size_t length) {
+        return sizeof(String) + length + 1;
+    }
+
+    // Builds the header and characters in one block of footprint(length)
+    // bytes, suitably aligned for String.
+    static String* construct(void* block, std::string_view src, std::uint64_t hash, StringPool* pool) {
+        char* chars = static_cast<char*>(block) + sizeof(String);
+        String* string = new (block) String(place(chars, src), hash);
+        string->pool_ = pool;
+        return string;
+    }
+
+    std::uint64_t hash_;
+    // The owning pool, cleared if a counted string outlives it, and for
+    // counted strings the table entry the destructor hands back to it.
+    mutable StringPool* pool_ = nullptr;
+    mutable void* entry_ = nullptr;
+    // StringHandle id, or 0 until one is first requested.
+    mutable std::atomic<std::uint32_t> handle_{0};
 
 public:
     friend class StringPool;
+    friend class StringSnapshot;
+    friend class StringHandle;
 };
 
-class StringPool {
+// Where a StringPool's own allocations go: a std::pmr::memory_resource if it
+// was given one, aligned operator new otherwise. Held by value; a null
+// resource means the heap.
+class PoolMemory {
 public:
-    static std::shared_ptr<StringPool> getInstance() {
-        static std::shared_ptr<StringPool> instance(new StringPool());
-        return instance;
+    PoolMemory() = default;
+
+#if defined(__cpp_lib_memory_resource)
+    explicit PoolMemory(std::pmr::memory_resource* resource) : resource_(resource) {}
+
+    std::pmr::memory_resource* resource() const {
+        return resource_;
     }
+#endif
 
-    template<typename T, typename = std::enable_if_t<is_allowed_string_type<T>::value>>
-    static StringPtr try_emplace(T&& arg) {
-        std::string str(arg);
-        return StringPool::getInstance()->intern(str.c_str(), fnv1a(str.c_str(), str.length()));
+    void* allocate(size_t bytes, size_t alignment = alignof(std::max_align_t)) const {
+#if defined(__cpp_lib_memory_resource)
+        if (resource_ != nullptr) {
+            return resource_->allocate(bytes, alignment);
+        }
+#endif
+        if (alignment <= __STDCPP_DEFAULT_NEW_ALIGNMENT__) {
+            return ::operator new(bytes);
+        }
+        return ::operator new(bytes, std::align_val_t(alignment));
     }
 
-    StringPtr intern(const char* str, std::uint32_t hash);
+    void deallocate(void* p, size_t bytes, size_t alignment = alignof(std::max_align_t)) const noexcept {
+#if defined(__cpp_lib_memory_resource)
+        if (resource_ != nullptr) {
+            resource_->deallocate(p, bytes, alignment);
+            return;
+        }
+#endif
+        (void)bytes;
+        if (alignment <= __STDCPP_DEFAULT_NEW_ALIGNMENT__) {
+            ::operator delete(p);
+        } else {
+            ::operator delete(p, std::align_val_t(alignment));
+        }
+    }
 
-    ~StringPool() {
-        clearPool();
+    template<typename T, typename... Args>
+    T* create(Args&&... args) const {
+        void* p = allocate(sizeof(T), alignof(T));
+        try {
+            return ::new (p) T{std::forward<Args>(args)...};
+        } catch (...) {
+            deallocate(p, sizeof(T), alignof(T));
+            throw;
+        }
     }
 
-    bool isStringIntern(const std::string& str) {
-        return getStringByHash(fnv1a_runtime(str.c_str(), str.length())) != nullptr;
+    template<typename T>
+    void destroy(T* p) const noexcept {
+        p->~T();
+        deallocate(p, sizeof(T), alignof(T));
     }
 
-    StringPtr getStringByHash(std::uint32_t hash) {
-        std::lock_guard<std::mutex> lock(mutex_);
-        auto it = pool_.find(hash);
-        if (it != pool_.end()) {
-            return it->second.lock();
-        }
-        return nullptr;
+    bool operator==(const PoolMemory& other) const {
+        return resource_ == other.resource_;
+    }
+
+    bool operator!=(const PoolMemory& other) const {
+        return resource_ != other.resource_;
     }
 
 private:
-    StringPool() = default;
+#if defined(__cpp_lib_memory_resource)
+    std::pmr::memory_resource* resource_ = nullptr;
+#else
+    void* resource_ = nullptr;
+#endif
+};
 
-    void clearPool() {
-        std::lock_guard<std::mutex> lock(mutex_);
-        while (!pool_.empty()) {
-            auto it = pool_.begin();
-            pool_.erase(it); // Erase from the pool map
-        }
+// std::allocator over a PoolMemory, for the containers inside StringPool.
+template<typename T>
+struct PoolAllocator {
+    using value_type = T;
+    using propagate_on_container_move_assignment = std::true_type;
+    using propagate_on_container_swap = std::true_type;
+
+    PoolAllocator() = default;
+
+    explicit PoolAllocator(PoolMemory memory) : memory(memory) {}
+
+    template<typename U>
+    PoolAllocator(const PoolAllocator<U>& other) : memory(other.memory) {}
+
+    T* allocate(size_t n) {
+        return static_cast<T*>(memory.allocate(n * sizeof(T), alignof(T)));
+    }
+
+    void deallocate(T* p, size_t n) noexcept {
+        memory.deallocate(p, n * sizeof(T), alignof(T));
+    }
+
+    template<typename U>
+    bool operator==(const PoolAllocator<U>& other) const {
+        return memory == other.memory;
+    }
+
+    template<typename U>
+    bool operator!=(const PoolAllocator<U>& other) const {
+        return memory != other.memory;
     }
 
-    std::mutex mutex_;
-    std::unordered_map<std::uint32_t, std::weak_ptr<const String>> pool_;
+    PoolMemory memory;
 };
 
-class StringRef {
+// Bump allocator for strings that are never freed one by one. Blocks are
+// carved front to back, so strings interned together sit next to each other,
+// and the memory goes back only when the arena is destroyed. Requests larger
+// than a quarter block get a block of their own rather than wasting the tail
+// of the current one.
+class StringArena {
 public:
-    template<typename T, typename = std::enable_if_t<is_allowed_string_type<T>::value>>
-    StringRef(T&& arg) : ptr_(StringPool::try_emplace(std::forward<T>(arg))) {}
+    static constexpr size_t BlockSize = 64 * 1024;
 
-    StringRef(StringPtr ptr) : ptr_(ptr) {}
-    //StringRef(StringPtr& ptr) : ptr_(ptr) {}
+    explicit StringArena(PoolMemory memory = PoolMemory()) : memory_(memory) {}
+    StringArena(const StringArena&) = delete;
+    StringArena& operator=(const StringArena&) = delete;
 
-    StringRef(const StringRef& other) : ptr_(other.ptr_) {};
-    StringRef& operator=(const StringRef& other) {
-        ptr_ = other.ptr_;
-        return *this;
+    ~StringArena() {
+        while (blocks_ != nullptr) {
+            Block* next = blocks_->next;
+            memory_.deallocate(blocks_, blocks_->size);
+            blocks_ = next;
+        }
     }
 
-    StringRef(StringRef&& other) noexcept : ptr_(std::move(other.ptr_)) {}
-    StringRef& operator=(StringRef&& other) noexcept {
-        if (this != &other) {
-            ptr_ = std::move(other.ptr_);
+    // Where blocks come from; only before the first allocate().
+    void setMemory(PoolMemory memory) {
+        assert(blocks_ == nullptr);
+        memory_ = memory;
+    }
+
+    void* allocate(size_t bytes) {
+        bytes = (bytes + alignof(std::max_align_t) - 1) & ~(alignof(std::max_align_t) - 1);
+        used_ += bytes;
+        if (bytes > BlockSize / 4) {
+            return addBlock(bytes);
         }
-        return *this;
+        if (bytes > remaining_) {
+            next_ = static_cast<char*>(addBlock(BlockSize));
+            remaining_ = BlockSize;
+        }
+        void* p = next_;
+        next_ += bytes;
+        remaining_ -= bytes;
+        return p;
     }
 
-    // Get the shared pointer
-    operator StringPtr() const {
-        return ptr_;
+    // Bytes handed out, and bytes obtained from the heap.
+    size_t bytes_used() const {
+        return used_;
     }
 
-    const String* operator->() const {
-        return ptr_.get();
+    size_t bytes_reserved() const {
+        return reserved_;
     }
 
-    //const String& operator.() const {
-        //return *ptr_;
-    //}
+private:
+    // Blocks are chained through a header at their front, so growing the
+    // arena makes no allocation besides the block itself.
+    struct alignas(std::max_align_t) Block {
+        Block* next;
+        size_t size;
+    };
 
-    const String& operator*() const {
-        return *ptr_;
+    void* addBlock(size_t bytes) {
+        const size_t size = sizeof(Block) + bytes;
+        Block* block = static_cast<Block*>(memory_.allocate(size));
+        block->next = blocks_;
+        block->size = size;
+        blocks_ = block;
+        reserved_ += bytes;
+        return block + 1;
     }
 
-    bool operator==(const StringRef& other) const {
-        return ptr_.get() == other.ptr_.get();
+    PoolMemory memory_;
+    Block* blocks_ = nullptr;
+    char* next_ = nullptr;
+    size_t remaining_ = 0;
+    size_t used_ = 0;
+    size_t reserved_ = 0;
+};
+
+// How long an interned string lives. Counted strings are freed with their
+// last StringPtr; immortal ones are placed in the pool's arena, live as long
+// as the pool, and their StringPtrs carry no reference count, so copying one
+// costs no atomic operation.
+enum class StringLifetime {
+    Counted,
+    Immortal
+};
+
+// A whole file, mapped read-only, or read into memory where mmap is not
+// available. Pages of a mapping are faulted in as they are touched.
+class MappedFile {
+public:
+    MappedFile() = default;
+
+    ~MappedFile() {
+#if defined(__unix__) || defined(__APPLE__)
+        if (mapping_ != nullptr) {
+            munmap(mapping_, size_);
+        }
+#endif
     }
 
-    bool operator!=(const StringRef& other) const {
-        return ptr_.get() != other.ptr_.get();
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // False if path cannot be opened or mapped; call once.
+    bool open(const std::string& path) {
+#if defined(__unix__) || defined(__APPLE__)
+        const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            return false;
+        }
+        struct stat info;
+        bool mapped = false;
+        if (fstat(fd, &info) == 0) {
+            size_ = static_cast<size_t>(info.st_size);
+            if (size_ == 0) {
+                // mmap rejects empty lengths.
+                data_ = "";
+                mapped = true;
+            } else {
+                void* p = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+                if (p != MAP_FAILED) {
+                    mapping_ = p;
+                    data_ = static_cast<const char*>(p);
+                    mapped = true;
+                }
+            }
+        }
+        ::close(fd);
+        return mapped;
+#else
+        std::ifstream in(path, std::ios::binary | std::ios::ate);
+        if (!in) {
+            return false;
+        }
+        size_ = static_cast<size_t>(in.tellg());
+        buffer_.reset(new char[size_ + 1]);
+        in.seekg(0);
+        in.read(buffer_.get(), static_cast<std::streamsize>(size_));
+        data_ = buffer_.get();
+        return static_cast<bool>(in);
+#endif
     }
 
-    const String* getRawPointer() const {
-        return ptr_.get();
+    // Tells the kernel the mapping will be read front to back, so it reads
+    // ahead aggressively.
+    void adviseSequential() const {
+#if defined(__unix__) || defined(__APPLE__)
+        if (mapping_ != nullptr) {
+            madvise(mapping_, size_, MADV_SEQUENTIAL);
+        }
+#endif
     }
 
-    size_t length() const { return ptr_->length(); }
-    size_t size() const { return ptr_->size(); }
-    bool empty() const { return ptr_->empty(); }
-    char operator[](size_t index) const { return (*ptr_)[index]; }
-    char at(size_t index) const { return ptr_->at(index); }
-    size_t find(const std::string& str, size_t pos = 0) const { return ptr_->find(str, pos); }
-    size_t rfind(const std::string& str, size_t pos = std::string::npos) const { return ptr_->rfind(str, pos); }
-    std::string substr(size_t pos = 0, size_t len = std::string::npos) const { return ptr_->substr(pos, len); }
+    const char* data() const {
+        return data_;
+    }
+
+    size_t size() const {
+        return size_;
+    }
+
+    std::string_view view() const {
+        return std::string_view(data_, size_);
+    }
 
 private:
-    StringPtr ptr_;
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+    void* mapping_ = nullptr;
+    std::unique_ptr<char[]> buffer_;
 };
 
-// Custom hash function for StringRef
-namespace std {
-    template<>
-    struct hash<StringRef> {
-        size_t operator()(const StringRef& ref) const {
-            return std::hash<const String*>{}(static_cast<StringPtr>(ref).get());
+// A read-only string table in a file, written by StringPool::saveSnapshot()
+// and mapped back with open(). The file holds a header, an open-addressed
+// index of (hash, record) pairs, a record array of (offset, length) and the
+// NUL-terminated characters, so opening it reads nothing up front: index
+// pages and characters are faulted in as lookups touch them. The String
+// header for a record is built on its first lookup.
+//
+// Layout is native-endian and tied to hash64; a file from another platform
+// or hash version is rejected by open().
+class StringSnapshot {
+public:
+    // nullptr if path cannot be read or is not a snapshot.
+    static std::unique_ptr<StringSnapshot> open(const std::string& path) {
+        std::unique_ptr<StringSnapshot> snapshot(new StringSnapshot());
+        if (!snapshot->map(path) || !snapshot->validate()) {
+            return nullptr;
+        }
+        snapshot->headers_.reset(new std::atomic<const String*>[snapshot->header().count]());
+        return snapshot;
+    }
+
+    // Writes strings, given with their hash64, as a snapshot file. Any
+    // other hash makes open() reject the file.
+    static bool write(const std::string& path, const std::vector<std::pair<std::uint64_t, std::string_view>>& strings) {
+        Header header{};
+        std::memcpy(header.magic, Magic, sizeof(header.magic));
+        header.count = strings.size();
+        header.slots = 16;
+        while (header.slots < strings.size() * 2) {
+            header.slots <<= 1;
+        }
+        std::vector<Slot> index(header.slots, Slot{0, 0});
+        std::vector<Record> records;
+        records.reserve(strings.size());
+        for (size_t i = 0; i < strings.size(); ++i) {
+            size_t j = strings[i].first & (header.slots - 1);
+            while (index[j].record != 0) {
+                j = (j + 1) & (header.slots - 1);
+            }
+            index[j] = Slot{strings[i].first, i + 1};
+            records.push_back(Record{header.bytes, strings[i].second.size()});
+            header.bytes += strings[i].second.size() + 1;
+        }
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.write(reinterpret_cast<const char*>(index.data()), static_cast<std::streamsize>(index.size() * sizeof(Slot)));
+        out.write(reinterpret_cast<const char*>(records.data()), static_cast<std::streamsize>(records.size() * sizeof(Record)));
+        for (const auto& string : strings) {
+            out.write(string.second.data(), static_cast<std::streamsize>(string.second.size()));
+            out.put('\0');
+        }
+        out.close();
+        return static_cast<bool>(out);
+    }
+
+    ~StringSnapshot() {
+        if (headers_ != nullptr) {
+            for (size_t i = 0; i < header().count; ++i) {
+                delete headers_[i].load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    StringSnapshot(const StringSnapshot&) = delete;
+    StringSnapshot& operator=(const StringSnapshot&) = delete;
+
+    size_t size() const {
+        return header().count;
+    }
+
+    std::string_view view(size_t record) const {
+        const Record& r = records()[record];
+        return std::string_view(characters() + r.offset, r.length);
+    }
+
+    // The String for key, or nullptr. Safe from any thread.
+    const String* find(std::string_view key, std::uint64_t hash) const {
+        const size_t mask = header().slots - 1;
+        for (size_t i = hash & mask;; i = (i + 1) & mask) {
+            const Slot& slot = index()[i];
+            if (slot.record == 0) {
+                return nullptr;
+            }
+            if (slot.hash == hash && view(slot.record - 1) == key) {
+                return string(slot.record - 1, slot.hash);
+            }
         }
+    }
+
+    // Some string with this hash, or nullptr.
+    const String* findHash(std::uint64_t hash) const {
+        const size_t mask = header().slots - 1;
+        for (size_t i = hash & mask;; i = (i + 1) & mask) {
+            const Slot& slot = index()[i];
+            if (slot.record == 0) {
+                return nullptr;
+            }
+            if (slot.hash == hash) {
+                return string(slot.record - 1, slot.hash);
+            }
+        }
+    }
+
+private:
+    static constexpr char Magic[8] = {'C', 'P', 'U', 'S', 'T', 'R', '0', '1'};
+
+    struct Header {
+        char magic[8];
+        std::uint64_t count;
+        std::uint64_t slots;
+        std::uint64_t bytes;
     };
-}
 
-inline StringPtr operator"" _hs(const char* str, std::size_t length) {
-    uint32_t hash = fnv1a(str, length);
-    return StringPool::getInstance()->intern(str, hash);
-}
+    // record is 1-based; 0 marks an empty slot.
+    struct Slot {
+        std::uint64_t hash;
+        std::uint64_t record;
+    };
+
+    struct Record {
+        std::uint64_t offset;
+        std::uint64_t length;
+    };
+
+    StringSnapshot() = default;
+
+    bool map(const std::string& path) {
+        if (!file_.open(path) || file_.size() < sizeof(Header)) {
+            return false;
+        }
+        base_ = file_.data();
+        size_ = file_.size();
+        return true;
+    }
+
+    // Checks everything find() and view() will dereference, so a truncated
+    // or corrupt file is turned away here rather than read out of bounds:
+    // the sections add up to the mapping, each record has exactly one index
+    // slot, which leaves an empty slot to end every probe, and each record
+    // lies inside the character block, ends in a NUL and hashes to what its
+    // slot says. Reads the whole file once.
+    bool validate() const {
+        const Header& h = header();
+        if (std::memcmp(h.magic, Magic, sizeof(Magic)) != 0 || h.slots == 0 || (h.slots & (h.slots - 1)) != 0 ||
+            h.count >= h.slots) {
+            return false;
+        }
+        // Bounded first, so the sum below cannot overflow.
+        const size_t room = size_ - sizeof(Header);
+        if (h.slots > room / sizeof(Slot) || h.count > room / sizeof(Record) || h.bytes > room ||
+            size_ != sizeof(Header) + h.slots * sizeof(Slot) + h.count * sizeof(Record) + h.bytes) {
+            return false;
+        }
+        std::vector<bool> indexed(h.count, false);
+        size_t used = 0;
+        for (size_t i = 0; i < h.slots; ++i) {
+            const Slot& slot = index()[i];
+            if (slot.record == 0) {
+                continue;
+            }
+            if (slot.record > h.count || indexed[slot.record - 1]) {
+                return false;
+            }
+            indexed[slot.record - 1] = true;
+            ++used;
+            const Record& r = records()[slot.record - 1];
+            if (r.offset >= h.bytes || r.length >= h.bytes - r.offset || characters()[r.offset + r.length] != '\0' ||
+                hash64(characters() + r.offset, r.length) != slot.hash) {
+                return false;
+            }
+        }
+        return used == h.count;
+    }
+
+    const Header& header() const {
+        return *reinterpret_cast<const Header*>(base_);
+    }
+
+    const Slot* index() const {
+        return reinterpret_cast<const Slot*>(base_ + sizeof(Header));
+    }
+
+    const Record* records() const {
+        return reinterpret_cast<const Record*>(index() + header().slots);
+    }
+
+    const char* characters() const {
+        return reinterpret_cast<const char*>(records() + header().count);
+    }
+
+    // Builds record's header on first use; racing builders keep the first.
+    const String* string(size_t record, std::uint64_t hash) const {
+        const String* existing = headers_[record].load(std::memory_order_acquire);
+        if (existing != nullptr) {
+            return existing;
+        }
+        const String* fresh = new String(view(record), hash);
+        if (headers_[record].compare_exchange_strong(existing, fresh, std::memory_order_acq_rel)) {
+            return fresh;
+        }
+        delete fresh;
+        return existing;
+    }
+
+    const char* base_ = nullptr;
+    size_t size_ = 0;
+    MappedFile file_;
+    std::unique_ptr<std::atomic<const String*>[]> headers_;
+};
+
+// Immutable minimal perfect hash over a fixed set of interned strings, built
+// by StringPool::freeze() in the style of CHD (hash, displace): keys are
+// split by hash into buckets of about four, and each bucket stores the
+// displacement that sent all of its keys to free slots. A lookup reads one
+// displacement and then exactly one slot, with no probing and no lock.
+//
+// The table keeps about one slot in nine free. At a load factor of one, the
+// last buckets placed must each hit one of a handful of free slots among
+// millions and can run out of displacements; with the slack they rarely
+// need more than a few tries, and a build that still fails retries in a
+// larger table.
+//
+// Distinct strings whose hash64 values collide cannot be separated by any
+// displacement, so build() leaves them out; the pool still finds them in its
+// shards.
+class FrozenStringTable {
+public:
+    // nullptr if some bucket found no displacement at any table size tried.
+    static std::unique_ptr<FrozenStringTable> build(std::vector<std::pair<std::uint64_t, const String*>> keys) {
+        std::sort(keys.begin(), keys.end(),
+                  [](const auto& a, const auto& b) { return a.first < b.first; });
+        size_t kept = 0;
+        for (size_t i = 0; i < keys.size(); ++i) {
+            const bool clash = (i > 0 && keys[i - 1].first == keys[i].first) ||
+                               (i + 1 < keys.size() && keys[i + 1].first == keys[i].first);
+            if (!clash) {
+                keys[kept++] = keys[i];
+            }
+        }
+        keys.resize(kept);
+
+        std::unique_ptr<FrozenStringTable> table(new FrozenStringTable());
+        if (keys.empty()) {
+            return table;
+        }
+        const size_t n = keys.size();
+        const size_t bucketCount = (n + BucketSize - 1) / BucketSize;
+
+        // Counting sort of the keys by bucket, then buckets largest first:
+        // the crowded ones are easiest to place while the table is empty.
+        std::vector<std::uint32_t> start(bucketCount + 1, 0);
+        for (const auto& key : keys) {
+            ++start[reduce(key.first, bucketCount) + 1];
+        }
+        for (size_t b = 0; b < bucketCount; ++b) {
+            start[b + 1] += start[b];
+        }
+        std::vector<std::uint32_t> members(n);
+        {
+            std::vector<std::uint32_t> next(start.begin(), start.end() - 1);
+            for (size_t i = 0; i < n; ++i) {
+                members[next[reduce(keys[i].first, bucketCount)]++] = static_cast<std::uint32_t>(i);
+            }
+        }
+        std::vector<std::uint32_t> order(bucketCount);
+        for (size_t b = 0; b < bucketCount; ++b) {
+            order[b] = static_cast<std::uint32_t>(b);
+        }
+        std::stable_sort(order.begin(), order.end(), [&](std::uint32_t a, std::uint32_t b) {
+            return start[a + 1] - start[a] > start[b + 1] - start[b];
+        });
+
+        size_t slotCount = n + n / 8 + 1;
+        for (int attempt = 0; attempt < MaxAttempts; ++attempt, slotCount += n / 4 + 1) {
+            if (table->place(keys, start, members, order, slotCount)) {
+                table->keys_ = n;
+                return table;
+            }
+        }
+        return nullptr;
+    }
+
+    FrozenStringTable(const FrozenStringTable&) = delete;
+    FrozenStringTable& operator=(const FrozenStringTable&) = delete;
+
+    // The String for key, or nullptr. Safe from any thread.
+    const String* find(std::string_view key, std::uint64_t hash) const {
+        if (slots_.empty()) {
+            return nullptr;
+        }
+        const std::uint32_t d = displacements_[reduce(hash, displacements_.size())];
+        const Slot& slot = slots_[slotOf(hash, d, slots_.size())];
+        return slot.hash == hash && slot.string != nullptr && slot.string->data == key ? slot.string : nullptr;
+    }
+
+    // Keys in the table.
+    size_t size() const {
+        return keys_;
+    }
 
-inline StringPtr StringPool::intern(const char* str, std::uint32_t hash) {
-    std::lock_guard<std::mutex> lock(mutex_);
+    // Slots, free ones included.
+    size_t capacity() const {
+        return slots_.size();
+    }
 
-    auto it = pool_.find(hash);
-    if (it != pool_.end()) {
-        return it->second.lock();
+    // Bytes of index beyond the slots themselves.
+    size_t displacementBytes() const {
+        return displacements_.size() * sizeof(std::uint32_t);
     }
-    auto deleter = [this, hash](const String* p) {
-        std::lock_guard<std::mutex> lock(this->mutex_);
-        this->pool_.erase(hash);
-        delete p;
+
+private:
+    static constexpr size_t BucketSize = 4;
+    static constexpr std::uint32_t MaxDisplacement = std::uint32_t(1) << 20;
+    static constexpr int MaxAttempts = 4;
+
+    struct Slot {
+        std::uint64_t hash;
+        const String* string;
     };
-    auto string_ref = StringPtr(new String(str), deleter);
-    pool_.emplace(hash, std::weak_ptr<const String>(string_ref));
-    return string_ref;
+
+    FrozenStringTable() = default;
+
+    // Places every bucket, largest first, into slotCount slots; false if
+    // some bucket found no displacement.
+    bool place(const std::vector<std::pair<std::uint64_t, const String*>>& keys, const std::vector<std::uint32_t>& start,
+               const std::vector<std::uint32_t>& members, const std::vector<std::uint32_t>& order, size_t slotCount) {
+        displacements_.assign(order.size(), 0);
+        slots_.assign(slotCount, Slot{0, nullptr});
+        std::vector<bool> taken(slotCount, false);
+        std::vector<size_t> positions;
+        for (const std::uint32_t b : order) {
+            const size_t first = start[b];
+            const size_t count = start[b + 1] - first;
+            if (count == 0) {
+                break;
+            }
+            std::uint32_t d = 0;
+            for (;; ++d) {
+                if (d == MaxDisplacement) {
+                    return false;
+                }
+                positions.clear();
+                bool fits = true;
+                for (size_t k = 0; k < count && fits; ++k) {
+                    const size_t pos = slotOf(keys[members[first + k]].first, d, slotCount);
+                    fits = !taken[pos] && std::find(positions.begin(), positions.end(), pos) == positions.end();
+                    positions.push_back(pos);
+                }
+                if (fits) {
+                    break;
+                }
+            }
+            displacements_[b] = d;
+            for (size_t k = 0; k < count; ++k) {
+                taken[positions[k]] = true;
+                const auto& key = keys[members[first + k]];
+                slots_[positions[k]] = Slot{key.first, key.second};
+            }
+        }
+        return true;
+    }
+
+    // Maps x onto [0, n) by its high bits, without a division.
+    static size_t reduce(std::uint64_t x, size_t n) {
+#if defined(__SIZEOF_INT128__)
+        return static_cast<size_t>((static_cast<unsigned __int128>(x) * n) >> 64);
+#else
+        return static_cast<size_t>(x % n);
+#endif
+    }
+
+    static size_t slotOf(std::uint64_t hash, std::uint32_t d, size_t n) {
+        std::uint64_t x = hash ^ (std::uint64_t(d + 1) * 0x9E3779B97F4A7C15ull);
+        x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+        x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+        return reduce(x ^ (x >> 31), n);
+    }
+
+    std::vector<std::uint32_t> displacements_;
+    std::vector<Slot> slots_;
+    size_t keys_ = 0;
+    // Counted strings in the table, kept alive for as long as it is.
+    std::vector<StringPtr> owners_;
+
+    friend class StringPool;
+};
+
+// What a frozen pool does with a string it has never seen: Overlay interns
+// it into the ordinary shards, Sealed refuses (intern throws).
+enum class FreezeMode {
+    Overlay,
+    Sealed
+};
+
+// StringPool counters. Build with -DCPPUTILS_STRING_POOL_STATS=0 to compile
+// them out; the pool then uses NullStringPoolStats and stats() is all zeros.
+#ifndef CPPUTILS_STRING_POOL_STATS
+#define CPPUTILS_STRING_POOL_STATS 1
+#endif
+
+struct StringPoolStatsSnapshot {
+    std::uint64_t hits = 0;
+    std::uint64_t misses = 0;
+    std::uint64_t releases = 0;
+    // Counted and immortal strings in the shards; the base layer is
+    // counted separately.
+    std::uint64_t liveStrings = 0;
+    std::uint64_t liveBytes = 0;
+    std::uint64_t mappedStrings = 0;
+    std::uint64_t lockContended = 0;
+    std::uint64_t lockWaitNanoseconds = 0;
+    std::uint64_t collisions = 0;
+
+    double hitRate() const {
+        return hits + misses == 0 ? 0.0 : double(hits) / double(hits + misses);
+    }
+
+    double averageLength() const {
+        return liveStrings == 0 ? 0.0 : double(liveBytes) / double(liveStrings);
+    }
+};
+
+struct NullStringPoolStats {
+    static constexpr bool enabled = false;
+
+    void onHit(size_t = 1) {}
+    void onInsert(size_t) {}
+    void onRelease(size_t) {}
+    void onLockContended(std::uint64_t) {}
+    void onCollision() {}
+
+    StringPoolStatsSnapshot snapshot() const { return {}; }
+    void reset() {}
+};
+
+// Counters on a ShardedCounters, as in QueueStats: each thread increments
+// its own cache line and snapshot() sums the lanes. A hit costs one relaxed
+// add.
+class StringPoolStats {
+public:
+    static constexpr bool enabled = true;
+    static constexpr size_t Lanes = ShardedDefaultLanes;
+
+    void onHit(size_t count = 1) {
+        counters.add(Hits, count);
+    }
+
+    // A miss that inserted a string of length characters.
+    void onInsert(size_t length) {
+        Counters::Lane& l = counters.lane();
+        l.add(Misses, 1);
+        l.add(BytesIn, length);
+    }
+
+    // A counted string was destroyed and removed.
+    void onRelease(size_t length) {
+        Counters::Lane& l = counters.lane();
+        l.add(Releases, 1);
+        l.add(BytesOut, length);
+    }
+
+    // A shard lock was held by someone else; waitNanoseconds to get it.
+    void onLockContended(std::uint64_t waitNanoseconds) {
+        Counters::Lane& l = counters.lane();
+        l.add(Contended, 1);
+        l.add(WaitNanoseconds, waitNanoseconds);
+    }
+
+    // Different strings with equal hash64 met during a lookup.
+    void onCollision() {
+        counters.add(Collisions, 1);
+    }
+
+    StringPoolStatsSnapshot snapshot() const {
+        const auto sums = counters.snapshot();
+        StringPoolStatsSnapshot result;
+        result.hits = sums[Hits];
+        result.misses = sums[Misses];
+        result.releases = sums[Releases];
+        result.lockContended = sums[Contended];
+        result.lockWaitNanoseconds = sums[WaitNanoseconds];
+        result.collisions = sums[Collisions];
+        const std::uint64_t bytesIn = sums[BytesIn];
+        const std::uint64_t bytesOut = sums[BytesOut];
+        // Lanes are read one at a time, so a release can be seen before
+        // its insert.
+        result.liveStrings = result.misses > result.releases ? result.misses - result.releases : 0;
+        result.liveBytes = bytesIn > bytesOut ? bytesIn - bytesOut : 0;
+        return result;
+    }
+
+    // Zeroes the event counters. Live strings and bytes are derived from
+    // them and restart from zero as well.
+    void reset() {
+        counters.reset();
+    }
+
+private:
+    enum Counter : size_t {
+        Hits,
+        Misses,
+        Releases,
+        BytesIn,
+        BytesOut,
+        Contended,
+        WaitNanoseconds,
+        Collisions,
+        CounterCount
+    };
+
+    using Counters = ShardedCounters<std::uint64_t, CounterCount, Lanes>;
+
+    Counters counters;
+};
+
+// Interned strings keyed by hash. The pool is split into ShardCount
+// sub-pools selected by the top bits of the hash, each with its own mutex and
+// table on its own cache line, so threads interning different strings rarely
+// contend, and the release of a string's last reference only locks its shard.
+//
+// Lookups of strings that already exist take no lock: each shard's table is
+// open-addressed over immutable entries that are published with a release
+// store, and entries or tables a writer replaces are freed through an
+// EpochDomain once no reader can still hold them. Only first-time inserts,
+// removals of released strings and table growth lock the shard.
+//
+// Immortal strings (see StringLifetime) are bump-allocated from an arena per
+// shard and never removed: use them for symbol tables that only grow. A
+// string keeps whichever lifetime it was first interned with while it is
+// alive, so asking for an immortal copy of a live counted string returns the
+// counted one and identity comparisons stay valid.
+//
+// A snapshot loaded with loadSnapshot() becomes a read-only base layer that
+// every lookup checks first; its strings are immortal. Load it at startup,
+// before interning any string it contains, so each string has one identity.
+//
+// Besides the process-wide instance, pools can be created for subsystems or
+// sessions of their own. An arena-backed one (default lifetime Immortal)
+// keeps every string and entry in its shards' arenas, so destroying it frees
+// a handful of blocks instead of calling a deleter per string; StringPtrs to
+// its strings must not outlive it. Counted strings may outlive their pool.
+//
+// A pool can also be given a std::pmr::memory_resource for its strings,
+// entries, tables and handle directory, e.g. a monotonic buffer reserved at
+// startup so that interning never reaches malloc. The resource must outlive
+// the pool and every counted string from it. Snapshots, freeze() and the
+// vector-returning helpers still use the heap.
+class StringPool {
+public:
+    using Stats = std::conditional_t<CPPUTILS_STRING_POOL_STATS != 0, StringPoolStats, NullStringPoolStats>;
+
+    static constexpr unsigned ShardBits = 4;
+    static constexpr size_t ShardCount = size_t(1) << ShardBits;
+
+    // An independent pool: its strings are distinct objects from equal
+    // ones in any other pool, and destroying it drops them all at once.
+    // Give it StringLifetime::Immortal to make it arena-backed.
+    StringPool() : StringPool(StringLifetime::Counted) {}
+
+    explicit StringPool(StringLifetime defaultLifetime) : StringPool(defaultLifetime, PoolMemory()) {}
+
+#if defined(__cpp_lib_memory_resource)
+    // Throws std::invalid_argument if resource is null.
+    StringPool(StringLifetime defaultLifetime, std::pmr::memory_resource* resource)
+        : StringPool(defaultLifetime, PoolMemory(checkResource(resource))) {}
+
+    std::pmr::memory_resource* resource() const {
+        return memory_.resource();
+    }
+#endif
+
+    StringPool(const StringPool&) = delete;
+    StringPool& operator=(const StringPool&) = delete;
+
+    // The process-wide pool behind try_emplace, StringRef, StringHandle and
+    // the literals. It is never destroyed, so strings held by other static
+    // objects can still be released during static destruction, and callers
+    // get a plain reference with no reference count to touch.
+    static StringPool& instance() {
+        static StringPool* const pool = new StringPool();
+        return *pool;
+    }
+
+    // instance() for older callers. The pointer owns nothing, so copying it
+    // is as cheap as copying a raw pointer.
+    static std::shared_ptr<StringPool> getInstance() {
+        return std::shared_ptr<StringPool>(std::shared_ptr<StringPool>(), &instance());
+    }
+
+    // Hashes the argument in place and copies it only if it is new, so a
+    // hit on a view into a larger buffer allocates nothing.
+    template<typename T, typename = std::enable_if_t<is_allowed_string_type<T>::value>>
+    static StringPtr try_emplace(T&& arg) {
+        const std::string_view str(arg);
+        return StringPool::instance().intern(str, hash64(str.data(), str.size()));
+    }
+
+    static StringPtr try_emplace(const char* str, size_t length) {
+        return try_emplace(std::string_view(str, length));
+    }
+
+    // As try_emplace, but an inserted string is immortal whatever the
+    // default lifetime.
+    template<typename T, typename = std::enable_if_t<is_allowed_string_type<T>::value>>
+    static StringPtr try_emplace_immortal(T&& arg) {
+        const std::string_view str(arg);
+        return StringPool::instance().intern(str, hash64(str.data(), str.size()), StringLifetime::Immortal);
+    }
+
+    // hash must be hash64 of str for lookups by content to find the result;
+    // strings that share a hash are told apart by comparing characters.
+    // str need not be NUL-terminated.
+    StringPtr intern(std::string_view str, std::uint64_t hash) {
+        return intern(str, hash, defaultLifetime());
+    }
+
+    StringPtr intern(std::string_view str, std::uint64_t hash, StringLifetime lifetime);
+
+    // Hashes str itself; the instance counterpart of try_emplace.
+    StringPtr intern(std::string_view str) {
+        return intern(str, hash64(str.data(), str.size()));
+    }
+
+    // The lifetime try_emplace, StringRef and _hs give new strings.
+    void setDefaultLifetime(StringLifetime lifetime) {
+        defaultLifetime_.store(lifetime, std::memory_order_relaxed);
+    }
+
+    StringLifetime defaultLifetime() const {
+        return defaultLifetime_.load(std::memory_order_relaxed);
+    }
+
+    // Heap obtained for immortal strings across all shards.
+    size_t arenaBytes() {
+        size_t total = 0;
+        for (Shard& shard : shards_) {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            total += shard.arena.bytes_reserved();
+        }
+        return total;
+    }
+
+    // Interns in[0, count) into out[0, count), which are overwritten. All
+    // keys are hashed first and the lock-free hits resolved under one epoch
+    // guard with their slots prefetched; the misses are grouped by shard
+    // and each shard is locked once for the whole batch.
+    void intern_batch(const std::string_view* in, size_t count, StringPtr* out) {
+        intern_batch(in, count, out, defaultLifetime());
+    }
+
+    void intern_batch(const std::string_view* in, size_t count, StringPtr* out, StringLifetime lifetime);
+
+    std::vector<StringPtr> intern_batch(const std::vector<std::string_view>& in) {
+        std::vector<StringPtr> out(in.size());
+        intern_batch(in.data(), in.size(), out.data());
+        return out;
+    }
+
+    // The StringHandle id of str, giving it one on first use. A counted
+    // string is pinned by this, since a handle does not keep it alive.
+    std::uint32_t handleOf(std::string_view str, std::uint64_t hash);
+
+    // The string behind a handle id, or nullptr for 0. Lock-free.
+    const String* resolveHandle(std::uint32_t id) const {
+        if (id == 0) {
+            return nullptr;
+        }
+        const auto* pages = handlePages_.load(std::memory_order_acquire);
+        const auto* page = pages[id >> HandlePageBits].load(std::memory_order_acquire);
+        return page[id & (HandlePageSize - 1)].string.load(std::memory_order_acquire);
+    }
+
+    // Dense symbol ids for dictionary-encoded data: a symbol id is its
+    // string's handle id minus one, so ids run 0, 1, 2, ... in the order
+    // strings first get one, and are stable for the life of the pool.
+    std::uint32_t symbolId(std::string_view str) {
+        return handleOf(str, hash64(str.data(), str.size())) - 1;
+    }
+
+    // The symbol id str already has, or NoSymbol; unlike symbolId() this
+    // never interns str or assigns it an id.
+    static constexpr std::uint32_t NoSymbol = ~std::uint32_t(0);
+
+    std::uint32_t lookupSymbol(std::string_view str) {
+        const StringPtr string = lookup(str);
+        const std::uint32_t handle = string ? string->handle_.load(std::memory_order_acquire) : 0;
+        return handle == 0 ? NoSymbol : handle - 1;
+    }
+
+    // symbolId() for count strings at once, interned through intern_batch
+    // so each shard is locked once per chunk rather than once per string.
+    void ids_of(const std::string_view* in, size_t count, std::uint32_t* out);
+
+    std::vector<std::uint32_t> ids_of(const std::vector<std::string_view>& in) {
+        std::vector<std::uint32_t> out(in.size());
+        ids_of(in.data(), in.size(), out.data());
+        return out;
+    }
+
+#if defined(__cpp_lib_span)
+    void ids_of(std::span<const std::string_view> in, std::span<std::uint32_t> out) {
+        if (out.size() < in.size()) {
+            throw std::invalid_argument("ids_of needs an output slot per input string.");
+        }
+        ids_of(in.data(), in.size(), out.data());
+    }
+#endif
+
+    // The characters of symbol id, read straight from the directory without
+    // touching the string's header. id must have come from this pool.
+    std::string_view symbolView(std::uint32_t id) const {
+        const std::uint32_t handle = id + 1;
+        const auto* pages = handlePages_.load(std::memory_order_acquire);
+        const auto* page = pages[handle >> HandlePageBits].load(std::memory_order_acquire);
+        return page[handle & (HandlePageSize - 1)].view;
+    }
+
+    // Symbol ids handed out so far; every id below this is taken, although
+    // one still being assigned on another thread may not be readable yet.
+    std::uint32_t symbolCount() const {
+        return nextHandle_.load(std::memory_order_acquire) - 1;
+    }
+
+    // Removes the entries of every string released so far and returns how
+    // many there were. Releases queue their entries and sweep every
+    // SweepBatch by themselves; call this to sweep sooner, e.g. when idle.
+    size_t collect() {
+        size_t swept = 0;
+        for (Shard& shard : shards_) {
+            if (shard.garbageCount.load(std::memory_order_relaxed) == 0) {
+                continue;
+            }
+            const auto lock = lockShard(shard);
+            swept += shard.sweep();
+        }
+        return swept;
+    }
+
+    // Keeps a counted string alive for the rest of the pool's life, e.g. a
+    // hot key that would otherwise be freed and re-interned over and over.
+    void pin(const StringPtr& string) {
+        if (string == nullptr || string.use_count() == 0) {
+            return;
+        }
+        Shard& shard = shardFor(string->hash());
+        const auto lock = lockShard(shard);
+        shard.pinned.push_back(string);
+    }
+
+    // Writes every live string, base layer included, as a snapshot file,
+    // leaving out strings interned under a hash other than hash64.
+    bool saveSnapshot(const std::string& path) {
+        std::vector<StringPtr> held;
+        std::vector<std::pair<std::uint64_t, std::string_view>> strings;
+        if (const StringSnapshot* base = snapshot()) {
+            for (size_t i = 0; i < base->size(); ++i) {
+                const std::string_view view = base->view(i);
+                strings.emplace_back(hash64(view.data(), view.size()), view);
+            }
+        }
+        for (Shard& shard : shards_) {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            const Table* current = shard.table.load(std::memory_order_relaxed);
+            for (size_t i = 0; i <= current->mask; ++i) {
+                const Entry* entry = current->slots[i].load(std::memory_order_relaxed);
+                if (entry == nullptr || entry == tombstone()) {
+                    continue;
+                }
+                StringPtr string = entry->get();
+                // One interned under a hash of the caller's own cannot be
+                // found by content, and a snapshot holds hash64 values only.
+                if (string && entry->hash == hash64(string->data.data(), string->data.size())) {
+                    strings.emplace_back(entry->hash, string->data);
+                    held.push_back(std::move(string));
+                }
+            }
+        }
+        return StringSnapshot::write(path, strings);
+    }
+
+    // Maps path as the base layer. False if it is not a valid snapshot, a
+    // base layer is already attached or the pool is frozen.
+    bool loadSnapshot(const std::string& path) {
+        if (frozen() != nullptr) {
+            return false;
+        }
+        std::unique_ptr<StringSnapshot> loaded = StringSnapshot::open(path);
+        StringSnapshot* expected = nullptr;
+        if (loaded == nullptr || !base_.compare_exchange_strong(expected, loaded.get(), std::memory_order_acq_rel)) {
+            return false;
+        }
+        loaded.release();
+        return true;
+    }
+
+    const StringSnapshot* snapshot() const {
+        return base_.load(std::memory_order_acquire);
+    }
+
+    // Builds a FrozenStringTable over every string interned so far, base
+    // layer included, and checks it before anything else from then on. Its
+    // counted strings are pinned for the life of the pool. Strings interned
+    // later go to the shards as before, unless mode is Sealed, in which case
+    // interning one throws std::out_of_range. False if the pool is already
+    // frozen or the table could not be built.
+    bool freeze(FreezeMode mode = FreezeMode::Overlay) {
+        if (frozen() != nullptr) {
+            return false;
+        }
+        std::vector<StringPtr> owners;
+        std::vector<std::pair<std::uint64_t, const String*>> keys;
+        if (const StringSnapshot* base = snapshot()) {
+            for (size_t i = 0; i < base->size(); ++i) {
+                const std::string_view view = base->view(i);
+                const std::uint64_t hash = hash64(view.data(), view.size());
+                keys.emplace_back(hash, base->find(view, hash));
+            }
+        }
+        for (Shard& shard : shards_) {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            const Table* current = shard.table.load(std::memory_order_relaxed);
+            for (size_t i = 0; i <= current->mask; ++i) {
+                const Entry* entry = current->slots[i].load(std::memory_order_relaxed);
+                if (entry == nullptr || entry == tombstone()) {
+                    continue;
+                }
+                if (StringPtr string = entry->get()) {
+                    keys.emplace_back(entry->hash, string.get());
+                    if (!entry->immortal) {
+                        owners.push_back(std::move(string));
+                    }
+                }
+            }
+        }
+        std::unique_ptr<FrozenStringTable> table = FrozenStringTable::build(std::move(keys));
+        if (table == nullptr) {
+            return false;
+        }
+        table->owners_ = std::move(owners);
+        FrozenStringTable* expected = nullptr;
+        if (!frozen_.compare_exchange_strong(expected, table.get(), std::memory_order_acq_rel)) {
+            return false;
+        }
+        table.release();
+        sealed_.store(mode == FreezeMode::Sealed, std::memory_order_relaxed);
+        return true;
+    }
+
+    const FrozenStringTable* frozen() const {
+        return frozen_.load(std::memory_order_acquire);
+    }
+
+    // Counters since start or the last resetStats(). hits and misses count
+    // intern calls (batched ones included): a miss is an insert.
+    StringPoolStatsSnapshot stats() const {
+        StringPoolStatsSnapshot result = stats_.snapshot();
+        if (Stats::enabled) {
+            for (const Shard& shard : shards_) {
+                result.collisions += shard.collisions.load(std::memory_order_relaxed);
+            }
+        }
+        if (const StringSnapshot* base = snapshot()) {
+            result.mappedStrings = base->size();
+        }
+        return result;
+    }
+
+    void resetStats() {
+        stats_.reset();
+        for (Shard& shard : shards_) {
+            shard.collisions.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    ~StringPool() {
+        // Pinned strings remove themselves from their shard as they go, so
+        // drop them while everything they touch is still alive.
+        for (Shard& shard : shards_) {
+            PinnedList pinned(shard.pinned.get_allocator());
+            {
+                std::lock_guard<std::mutex> lock(shard.mutex);
+                pinned.swap(shard.pinned);
+            }
+        }
+        // The frozen table's counted strings, likewise.
+        delete frozen_.load(std::memory_order_relaxed);
+        for (Shard& shard : shards_) {
+            dropEntries(shard);
+        }
+        delete base_.load(std::memory_order_relaxed);
+        if (std::atomic<HandleSlot*>* pages = handlePages_.load(std::memory_order_relaxed)) {
+            for (size_t i = 0; i < HandlePageCount; ++i) {
+                if (HandleSlot* slots = pages[i].load(std::memory_order_relaxed)) {
+                    memory_.deallocate(slots, HandlePageSize * sizeof(HandleSlot), alignof(HandleSlot));
+                }
+            }
+            memory_.deallocate(pages, HandlePageCount * sizeof(pages[0]), alignof(std::atomic<HandleSlot*>));
+        }
+    }
+
+    bool isStringIntern(std::string_view str) {
+        return lookup(str) != nullptr;
+    }
+
+    // The interned copy of str, or nullptr; never inserts.
+    StringPtr lookup(std::string_view key) {
+        const std::uint64_t hash = hash64(key.data(), key.size());
+        if (const String* mapped = findMapped(key, hash)) {
+            return StringPtr(StringPtr(), mapped);
+        }
+        Shard& shard = shardFor(hash);
+        {
+            EpochDomain::Guard guard(epochs());
+            if (guard) {
+                return shard.find(hash, key);
+            }
+        }
+        const auto lock = lockShard(shard);
+        return shard.find(hash, key);
+    }
+
+    // Some live string with this hash, or nullptr. Without the characters
+    // a collision cannot be ruled out; prefer lookup().
+    StringPtr getStringByHash(std::uint64_t hash) {
+        if (const StringSnapshot* base = snapshot()) {
+            if (const String* mapped = base->findHash(hash)) {
+                return StringPtr(StringPtr(), mapped);
+            }
+        }
+        Shard& shard = shardFor(hash);
+        {
+            EpochDomain::Guard guard(epochs());
+            if (guard) {
+                return shard.find(hash, {}, false);
+            }
+        }
+        const auto lock = lockShard(shard);
+        return shard.find(hash, {}, false);
+    }
+
+private:
+    // The frozen table, then the base layer: strings no shard lock or epoch
+    // guard is needed for.
+    const String* findMapped(std::string_view key, std::uint64_t hash) const {
+        if (const FrozenStringTable* table = frozen()) {
+            if (const String* string = table->find(key, hash)) {
+                return string;
+            }
+        }
+        const StringSnapshot* base = snapshot();
+        return base != nullptr ? base->find(key, hash) : nullptr;
+    }
+
+    // owner is empty for immortal strings. string identifies the entry but
+    // is only dereferenced through get(): once owner expires the String is
+    // destroyed. view stays readable for as long as the entry exists, since
+    // owner keeps allocate_shared's block, characters included, allocated.
+    struct Entry {
+        std::uint64_t hash;
+        const String* string;
+        std::string_view view;
+        std::weak_ptr<const String> owner;
+        bool immortal;
+        // Link in the shard's garbage list once the string has died.
+        std::atomic<Entry*> nextGarbage{nullptr};
+
+        StringPtr get() const {
+            // Aliasing an empty owner gives a non-null StringPtr without a
+            // control block, so copies of it never touch a reference count.
+            return immortal ? StringPtr(StringPtr(), string) : owner.lock();
+        }
+    };
+
+    struct Table {
+        Table(size_t capacity, PoolMemory memory)
+            : mask(capacity - 1),
+              slots(static_cast<std::atomic<Entry*>*>(memory.allocate(capacity * sizeof(std::atomic<Entry*>)))),
+              memory(memory) {
+            for (size_t i = 0; i < capacity; ++i) {
+                new (slots + i) std::atomic<Entry*>(nullptr);
+            }
+        }
+
+        Table(const Table&) = delete;
+        Table& operator=(const Table&) = delete;
+
+        ~Table() {
+            memory.deallocate(slots, (mask + 1) * sizeof(std::atomic<Entry*>));
+        }
+
+        size_t mask;
+        std::atomic<Entry*>* slots;
+        PoolMemory memory;
+        // Writer-side counts: live entries, and live plus tombstones.
+        size_t live = 0;
+        size_t used = 0;
+    };
+
+    struct Retired {
+        void* object;
+        void (*destroy)(const PoolMemory&, void*);
+        std::uint64_t epoch;
+    };
+
+    using RetiredList = std::vector<Retired, PoolAllocator<Retired>>;
+    using PinnedList = std::vector<StringPtr, PoolAllocator<StringPtr>>;
+
+    static void destroyEntry(const PoolMemory& memory, void* entry) {
+        memory.destroy(static_cast<Entry*>(entry));
+    }
+
+    static void destroyTable(const PoolMemory& memory, void* table) {
+        memory.destroy(static_cast<Table*>(table));
+    }
+
+    static constexpr size_t InitialCapacity = 64;
+    static constexpr size_t ReclaimThreshold = 64;
+    // Dead strings a shard queues before a release sweeps them.
+    static constexpr size_t SweepBatch = 256;
+
+    // Marks a removed entry so probes for later entries keep going.
+    static Entry* tombstone() {
+        static Entry marker{0, nullptr, {}, {}, false};
+        return &marker;
+    }
+
+    // Handle ids index a two-level directory whose pages are allocated on
+    // demand and never move, as is the directory itself, so resolving one
+    // is three dependent loads. Each slot keeps the string's characters
+    // beside it for symbolView().
+    static constexpr unsigned HandlePageBits = 14;
+    static constexpr size_t HandlePageSize = size_t(1) << HandlePageBits;
+    static constexpr size_t HandlePageCount = size_t(1) << 14;
+
+    struct HandleSlot {
+        std::atomic<const String*> string{nullptr};
+        // Written before string is published.
+        std::string_view view;
+    };
+
+    // handleOf() once the string is interned.
+    std::uint32_t handleOf(const StringPtr& string);
+
+    // The page directory, allocated on first use; racing callers keep the
+    // first one.
+    std::atomic<HandleSlot*>* handleDirectory() {
+        std::atomic<HandleSlot*>* pages = handlePages_.load(std::memory_order_acquire);
+        if (pages != nullptr) {
+            return pages;
+        }
+        auto* fresh = static_cast<std::atomic<HandleSlot*>*>(
+            memory_.allocate(HandlePageCount * sizeof(pages[0]), alignof(std::atomic<HandleSlot*>)));
+        for (size_t i = 0; i < HandlePageCount; ++i) {
+            new (fresh + i) std::atomic<HandleSlot*>(nullptr);
+        }
+        if (handlePages_.compare_exchange_strong(pages, fresh, std::memory_order_acq_rel)) {
+            return fresh;
+        }
+        memory_.deallocate(fresh, HandlePageCount * sizeof(pages[0]), alignof(std::atomic<HandleSlot*>));
+        return pages;
+    }
+
+    // Called with the string's shard lock held.
+    std::uint32_t assignHandle(const String* string) {
+        const std::uint32_t id = nextHandle_.fetch_add(1, std::memory_order_relaxed);
+        if (id >> HandlePageBits >= HandlePageCount) {
+            throw std::length_error("StringPool handle ids exhausted.");
+        }
+        auto& slot = handleDirectory()[id >> HandlePageBits];
+        auto* page = slot.load(std::memory_order_acquire);
+        if (page == nullptr) {
+            auto* fresh = static_cast<HandleSlot*>(memory_.allocate(HandlePageSize * sizeof(HandleSlot), alignof(HandleSlot)));
+            for (size_t i = 0; i < HandlePageSize; ++i) {
+                new (fresh + i) HandleSlot();
+            }
+            if (slot.compare_exchange_strong(page, fresh, std::memory_order_acq_rel)) {
+                page = fresh;
+            } else {
+                memory_.deallocate(fresh, HandlePageSize * sizeof(HandleSlot), alignof(HandleSlot));
+            }
+        }
+        HandleSlot& entry = page[id & (HandlePageSize - 1)];
+        entry.view = string->data;
+        entry.string.store(string, std::memory_order_release);
+        string->handle_.store(id, std::memory_order_release);
+        return id;
+    }
+
+    static EpochDomain& epochs() {
+        static EpochDomain domain;
+        return domain;
+    }
+
+    struct alignas(64) Shard {
+        Shard() = default;
+
+        // Called once by the pool's constructor, before any other use.
+        void attach(PoolMemory poolMemory) {
+            memory = poolMemory;
+            arena.setMemory(poolMemory);
+            retired = RetiredList(PoolAllocator<Retired>(poolMemory));
+            pinned = PinnedList(PoolAllocator<StringPtr>(poolMemory));
+            table.store(memory.create<Table>(InitialCapacity, poolMemory), std::memory_order_relaxed);
+        }
+
+        // Entries still in the table are the pool's to drop (dropEntries).
+        ~Shard() {
+            // Their destructors still look at the table.
+            pinned.clear();
+            if (Table* current = table.load(std::memory_order_relaxed)) {
+                memory.destroy(current);
+            }
+            for (const Retired& r : retired) {
+                r.destroy(memory, r.object);
+            }
+        }
+
+        // Safe inside an epoch guard or with the mutex held. An expired entry
+        // for key is passed over until a sweep removes it.
+        StringPtr find(std::uint64_t hash, std::string_view key, bool verify = true) const {
+            const Table* current = table.load(std::memory_order_acquire);
+            for (size_t i = hash & current->mask;; i = (i + 1) & current->mask) {
+                const Entry* entry = current->slots[i].load(std::memory_order_acquire);
+                if (entry == nullptr) {
+                    return nullptr;
+                }
+                if (entry == tombstone() || entry->hash != hash) {
+                    continue;
+                }
+                // Characters first, so a collision never takes a reference:
+                // dropping one with the lock held could destroy a String,
+                // whose release may try to sweep this shard.
+                if (verify && entry->view != key) {
+                    if (Stats::enabled) {
+                        collisions.fetch_add(1, std::memory_order_relaxed);
+                    }
+                } else if (StringPtr string = entry->get()) {
+                    return string;
+                }
+            }
+        }
+
+        // Prefetches the first slot hash probes.
+        void prefetch(std::uint64_t hash) const {
+#if defined(__GNUC__)
+            const Table* current = table.load(std::memory_order_acquire);
+            __builtin_prefetch(&current->slots[hash & current->mask]);
+#else
+            (void)hash;
+#endif
+        }
+
+        // Writer: publishes an entry for a string find() just missed.
+        void insert(Entry* entry) {
+            Table* current = table.load(std::memory_order_relaxed);
+            if ((current->used + 1) * 4 > (current->mask + 1) * 3) {
+                current = rebuild(current);
+            }
+            for (size_t i = entry->hash & current->mask;; i = (i + 1) & current->mask) {
+                Entry* occupant = current->slots[i].load(std::memory_order_relaxed);
+                if (occupant == nullptr || occupant == tombstone()) {
+                    current->slots[i].store(entry, std::memory_order_release);
+                    ++current->live;
+                    if (occupant == nullptr) {
+                        ++current->used;
+                    }
+                    return;
+                }
+            }
+        }
+
+        // Writer: unlinks and retires target, whose string has died.
+        void remove(Entry* target) {
+            Table* current = table.load(std::memory_order_relaxed);
+            for (size_t i = target->hash & current->mask;; i = (i + 1) & current->mask) {
+                Entry* entry = current->slots[i].load(std::memory_order_relaxed);
+                if (entry == nullptr) {
+                    return;
+                }
+                if (entry == target) {
+                    current->slots[i].store(tombstone(), std::memory_order_release);
+                    --current->live;
+                    --counted;
+                    retire(entry, destroyEntry);
+                    return;
+                }
+            }
+        }
+
+        // Lock-free: queues entry for the next sweep.
+        void pushGarbage(Entry* entry) {
+            Entry* head = garbage.load(std::memory_order_relaxed);
+            do {
+                entry->nextGarbage.store(head, std::memory_order_relaxed);
+            } while (!garbage.compare_exchange_weak(head, entry, std::memory_order_release, std::memory_order_relaxed));
+        }
+
+        // Writer: removes everything queued so far.
+        size_t sweep() {
+            Entry* list = garbage.exchange(nullptr, std::memory_order_acquire);
+            size_t swept = 0;
+            while (list != nullptr) {
+                Entry* next = list->nextGarbage.load(std::memory_order_relaxed);
+                remove(list);
+                list = next;
+                ++swept;
+            }
+            garbageCount.fetch_sub(swept, std::memory_order_relaxed);
+            return swept;
+        }
+
+        // Copies the live entries into a table sized for twice their count,
+        // which also clears out the tombstones.
+        Table* rebuild(Table* old) {
+            size_t capacity = InitialCapacity;
+            while (capacity < (old->live + 1) * 2) {
+                capacity <<= 1;
+            }
+            Table* fresh = memory.create<Table>(capacity, memory);
+            for (size_t i = 0; i <= old->mask; ++i) {
+                Entry* entry = old->slots[i].load(std::memory_order_relaxed);
+                if (entry == nullptr || entry == tombstone()) {
+                    continue;
+                }
+                size_t j = entry->hash & fresh->mask;
+                while (fresh->slots[j].load(std::memory_order_relaxed) != nullptr) {
+                    j = (j + 1) & fresh->mask;
+                }
+                fresh->slots[j].store(entry, std::memory_order_relaxed);
+            }
+            fresh->live = fresh->used = old->live;
+            table.store(fresh, std::memory_order_release);
+            retire(old, destroyTable);
+            return fresh;
+        }
+
+        void retire(void* object, void (*destroy)(const PoolMemory&, void*)) {
+            retired.push_back(Retired{object, destroy, epochs().retireEpoch()});
+            if (retired.size() < ReclaimThreshold) {
+                return;
+            }
+            const std::uint64_t safe = epochs().safeBefore();
+            size_t kept = 0;
+            for (const Retired& r : retired) {
+                if (r.epoch < safe) {
+                    r.destroy(memory, r.object);
+                } else {
+                    retired[kept++] = r;
+                }
+            }
+            retired.resize(kept);
+        }
+
+        std::mutex mutex;
+        std::atomic<Table*> table{nullptr};
+        PoolMemory memory;
+        RetiredList retired;
+        // Immortal strings and their entries.
+        StringArena arena;
+        // Live entries of counted strings, i.e. those not in the arena.
+        size_t counted = 0;
+        // Counted strings that were given a handle.
+        PinnedList pinned;
+        // Entries of dead strings, pushed by their destructors without the
+        // lock and removed in batches.
+        std::atomic<Entry*> garbage{nullptr};
+        std::atomic<size_t> garbageCount{0};
+        // Kept here rather than in Stats so the probes need no pool pointer;
+        // collisions are rare enough that sharing the line costs nothing.
+        mutable std::atomic<std::uint64_t> collisions{0};
+    };
+
+    // Tables probe from the low bits, so the shard takes the high ones.
+    static size_t shardIndex(std::uint64_t hash) {
+        return static_cast<size_t>(hash >> (64 - ShardBits));
+    }
+
+    Shard& shardFor(std::uint64_t hash) {
+        return shards_[shardIndex(hash)];
+    }
+
+    // Locks shard's mutex, timing the wait when it was already held.
+    std::unique_lock<std::mutex> lockShard(Shard& shard) {
+        std::unique_lock<std::mutex> lock(shard.mutex, std::try_to_lock);
+        if (!lock.owns_lock()) {
+            if (Stats::enabled) {
+                const auto start = std::chrono::steady_clock::now();
+                lock.lock();
+                const auto waited = std::chrono::steady_clock::now() - start;
+                stats_.onLockContended(static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(waited).count()));
+            } else {
+                lock.lock();
+            }
+        }
+        return lock;
+    }
+
+    // allocate_shared allocator that adds Extra bytes after the block it is
+    // asked for and reports where they start through *trailing, so the
+    // characters of a counted String share its control block's allocation.
+    template<typename T>
+    struct TrailingAllocator {
+        using value_type = T;
+
+        TrailingAllocator(size_t extra, char** trailing, PoolMemory memory)
+            : extra(extra), trailing(trailing), memory(memory) {}
+
+        template<typename U>
+        TrailingAllocator(const TrailingAllocator<U>& other)
+            : extra(other.extra), trailing(other.trailing), memory(other.memory) {}
+
+        T* allocate(size_t n) {
+            char* block = static_cast<char*>(memory.allocate(n * sizeof(T) + extra, alignof(T)));
+            *trailing = block + n * sizeof(T);
+            return reinterpret_cast<T*>(block);
+        }
+
+        void deallocate(T* p, size_t n) noexcept {
+            memory.deallocate(p, n * sizeof(T) + extra, alignof(T));
+        }
+
+        // allocate_shared constructs through here, which can reach String's
+        // private constructor.
+        template<typename U, typename... Args>
+        void construct(U* p, Args&&... args) {
+            ::new (static_cast<void*>(p)) U(std::forward<Args>(args)...);
+        }
+
+        template<typename U>
+        void destroy(U* p) {
+            p->~U();
+        }
+
+        template<typename U>
+        bool operator==(const TrailingAllocator<U>& other) const {
+            return extra == other.extra && memory == other.memory;
+        }
+
+        template<typename U>
+        bool operator!=(const TrailingAllocator<U>& other) const {
+            return !(*this == other);
+        }
+
+        size_t extra;
+        char** trailing;
+        PoolMemory memory;
+    };
+
+    // Called by a counted String's destructor. Takes no lock unless this
+    // release completes a batch, and even then only if the lock is free;
+    // otherwise the next release or collect() sweeps.
+    void release(const String& string) {
+        Shard& shard = shardFor(string.hash_);
+        shard.pushGarbage(static_cast<Entry*>(string.entry_));
+        stats_.onRelease(string.length());
+        if (shard.garbageCount.fetch_add(1, std::memory_order_relaxed) + 1 >= SweepBatch) {
+            std::unique_lock<std::mutex> lock(shard.mutex, std::try_to_lock);
+            if (lock.owns_lock()) {
+                shard.sweep();
+            }
+        }
+    }
+
+    friend class String;
+
+    // Adds key, which the caller found missing with shard's mutex held.
+    StringPtr insertLocked(Shard& shard, std::string_view key, std::uint64_t hash, StringLifetime lifetime);
+
+    // Destruction: frees the entries of counted strings and detaches the
+    // strings still alive, which stay readable but no longer report their
+    // release. A shard holding only immortal strings is skipped without
+    // looking at its table; its arena takes everything with it.
+    void dropEntries(Shard& shard) {
+        if (shard.counted == 0) {
+            return;
+        }
+        const Table* current = shard.table.load(std::memory_order_relaxed);
+        for (size_t i = 0; i <= current->mask; ++i) {
+            Entry* entry = current->slots[i].load(std::memory_order_relaxed);
+            if (entry == nullptr || entry == tombstone() || entry->immortal) {
+                continue;
+            }
+            if (StringPtr string = entry->owner.lock()) {
+                // Cleared first, so letting go of the last reference here
+                // does not come back to this pool.
+                string->pool_ = nullptr;
+            }
+            shard.memory.destroy(entry);
+        }
+    }
+
+    StringPool(StringLifetime defaultLifetime, PoolMemory memory)
+        : memory_(memory), defaultLifetime_(defaultLifetime) {
+        for (Shard& shard : shards_) {
+            shard.attach(memory);
+        }
+    }
+
+#if defined(__cpp_lib_memory_resource)
+    static std::pmr::memory_resource* checkResource(std::pmr::memory_resource* resource) {
+        if (resource == nullptr) {
+            throw std::invalid_argument("StringPool needs a memory resource.");
+        }
+        return resource;
+    }
+#endif
+
+    const PoolMemory memory_;
+    Shard shards_[ShardCount];
+    std::atomic<StringLifetime> defaultLifetime_{StringLifetime::Counted};
+    std::atomic<std::uint32_t> nextHandle_{1};
+    std::atomic<StringSnapshot*> base_{nullptr};
+    std::atomic<FrozenStringTable*> frozen_{nullptr};
+    std::atomic<bool> sealed_{false};
+    Stats stats_;
+    // The page directory, allocated with the first handle so that pools
+    // that never hand one out do not carry it.
+    std::atomic<std::atomic<HandleSlot*>*> handlePages_{nullptr};
+};
+
+class StringRef {
+public:
+    template<typename T, typename = std::enable_if_t<is_allowed_string_type<T>::value>>
+    StringRef(T&& arg) : ptr_(StringPool::try_emplace(std::forward<T>(arg))) {}
+
+    // Interned in pool rather than the process-wide one.
+    template<typename T, typename = std::enable_if_t<is_allowed_string_type<T>::value>>
+    StringRef(StringPool& pool, T&& arg) : ptr_(pool.intern(std::string_view(arg))) {}
+
+    StringRef(StringPtr ptr) : ptr_(ptr) {}
+    //StringRef(StringPtr& ptr) : ptr_(ptr) {}
+
+    StringRef(const StringRef& other) : ptr_(other.ptr_) {};
+    StringRef& operator=(const StringRef& other) {
+        ptr_ = other.ptr_;
+        return *this;
+    }
+
+    StringRef(StringRef&& other) noexcept : ptr_(std::move(other.ptr_)) {}
+    StringRef& operator=(StringRef&& other) noexcept {
+        if (this != &other) {
+            ptr_ = std::move(other.ptr_);
+        }
+        return *this;
+    }
+
+    // Get the shared pointer
+    operator StringPtr() const {
+        return ptr_;
+    }
+
+    const String* operator->() const {
+        return ptr_.get();
+    }
+
+    //const String& operator.() const {
+        //return *ptr_;
+    //}
+
+    const String& operator*() const {
+        return *ptr_;
+    }
+
+    bool operator==(const StringRef& other) const {
+        return ptr_.get() == other.ptr_.get();
+    }
+
+    bool operator!=(const StringRef& other) const {
+        return ptr_.get() != other.ptr_.get();
+    }
+
+    // Orders by address: O(1) and consistent within a process, but not
+    // alphabetical and not repeatable across runs. Use StringContentLess
+    // where output order matters.
+    bool operator<(const StringRef& other) const {
+        return std::less<const String*>()(ptr_.get(), other.ptr_.get());
+    }
+
+    const String* getRawPointer() const {
+        return ptr_.get();
+    }
+
+    // See String::pool(). Refs compare equal only within one pool.
+    StringPool* pool() const {
+        return ptr_->pool();
+    }
+
+    // The string's hash64, cached at intern time: the same in every process,
+    // so it can index persisted or shared tables without rehashing.
+    std::uint64_t hash() const { return ptr_->hash(); }
+
+    size_t length() const { return ptr_->length(); }
+    size_t size() const { return ptr_->size(); }
+    bool empty() const { return ptr_->empty(); }
+    char operator[](size_t index) const { return (*ptr_)[index]; }
+    char at(size_t index) const { return ptr_->at(index); }
+    size_t find(std::string_view str, size_t pos = 0) const { return ptr_->find(str, pos); }
+    size_t find(char c, size_t pos = 0) const { return ptr_->find(c, pos); }
+    size_t rfind(std::string_view str, size_t pos = std::string::npos) const { return ptr_->rfind(str, pos); }
+    size_t rfind(char c, size_t pos = std::string::npos) const { return ptr_->rfind(c, pos); }
+    std::string substr(size_t pos = 0, size_t len = std::string::npos) const { return ptr_->substr(pos, len); }
+
+    // Zero-copy access; the views live as long as the string does, so at
+    // least as long as this StringRef.
+    std::string_view view() const { return ptr_->data; }
+    std::string_view substr_view(size_t pos = 0, size_t len = std::string::npos) const { return ptr_->substr_view(pos, len); }
+    operator std::string_view() const { return ptr_->data; }
+    bool starts_with(std::string_view prefix) const { return ptr_->starts_with(prefix); }
+    bool starts_with(char c) const { return ptr_->starts_with(c); }
+    bool ends_with(std::string_view suffix) const { return ptr_->ends_with(suffix); }
+    bool ends_with(char c) const { return ptr_->ends_with(c); }
+
+private:
+    StringPtr ptr_;
+};
+
+// Alphabetical order for deterministic output, e.g. std::map<StringRef, V,
+// StringContentLess>. Equal strings are the same object, so this agrees with
+// operator== on StringRef.
+struct StringContentLess {
+    bool operator()(const StringRef& a, const StringRef& b) const {
+        return a.getRawPointer() != b.getRawPointer() && a->data < b->data;
+    }
+};
+
+// Custom hash function for StringRef: the cached content hash, so no bytes
+// are read and equal strings hash alike in every process.
+namespace std {
+    template<>
+    struct hash<StringRef> {
+        size_t operator()(const StringRef& ref) const {
+            return static_cast<size_t>(ref.hash());
+        }
+    };
+}
+
+// A 4-byte reference to an interned string: an id into the pool's handle
+// directory rather than a shared_ptr, so it is trivially copyable, copies
+// touch no reference count, and equality and hashing compare the id. The
+// string it names is immortal or pinned, so a handle never dangles.
+//
+// Handles name strings of the process-wide pool only; four bytes leave no
+// room to say which pool an id belongs to. A scoped pool numbers its own
+// strings with symbolId() and symbolView() instead, and making a handle
+// from one of its refs throws std::invalid_argument rather than quietly
+// handing out a handle to a copy in the process-wide pool.
+class StringHandle {
+public:
+    StringHandle() = default;
+
+    template<typename T, typename = std::enable_if_t<is_allowed_string_type<T>::value>>
+    explicit StringHandle(T&& arg) {
+        const std::string_view str(arg);
+        id_ = StringPool::instance().handleOf(str, hash64(str.data(), str.size()));
+    }
+
+    // Pins ref's string if it is counted. Throws std::invalid_argument if
+    // ref belongs to another pool.
+    explicit StringHandle(const StringRef& ref) {
+        if (const String* string = ref.getRawPointer()) {
+            if (!inProcessPool(string)) {
+                throw std::invalid_argument("StringHandle only names strings of the process-wide StringPool.");
+            }
+            id_ = StringPool::instance().handleOf(string->data, string->hash());
+        }
+    }
+
+    // The handle string already has, or a null handle; unlike the
+    // constructors this never assigns one, so nothing gets pinned. Strings
+    // of other pools get a null handle, as their ids mean nothing here.
+    static StringHandle existing(const String* string) {
+        StringHandle handle;
+        if (string && inProcessPool(string)) {
+            handle.id_ = string->handle_.load(std::memory_order_acquire);
+        }
+        return handle;
+    }
+
+    // Whether string belongs to the process-wide pool, including its
+    // snapshot base layer, whose strings have no pool of their own.
+    static bool inProcessPool(const String* string) {
+        StringPool& pool = StringPool::instance();
+        if (const StringPool* owner = string->pool()) {
+            return owner == &pool;
+        }
+        const StringSnapshot* base = pool.snapshot();
+        return base != nullptr && base->find(string->data, string->hash()) == string;
+    }
+
+    static StringHandle fromId(std::uint32_t id) {
+        StringHandle handle;
+        handle.id_ = id;
+        return handle;
+    }
+
+    std::uint32_t id() const {
+        return id_;
+    }
+
+    const String* get() const {
+        return StringPool::instance().resolveHandle(id_);
+    }
+
+    const String* operator->() const {
+        return get();
+    }
+
+    const String& operator*() const {
+        return *get();
+    }
+
+    // A StringPtr that owns nothing; the string outlives it regardless.
+    operator StringPtr() const {
+        return StringPtr(StringPtr(), get());
+    }
+
+    explicit operator bool() const {
+        return id_ != 0;
+    }
+
+    bool operator==(const StringHandle& other) const {
+        return id_ == other.id_;
+    }
+
+    bool operator!=(const StringHandle& other) const {
+        return id_ != other.id_;
+    }
+
+private:
+    std::uint32_t id_ = 0;
+};
+
+static_assert(sizeof(StringHandle) == 4 && std::is_trivially_copyable<StringHandle>::value,
+              "StringHandle must stay a trivially copyable 32-bit id.");
+
+namespace std {
+    template<>
+    struct hash<StringHandle> {
+        size_t operator()(const StringHandle& handle) const {
+            return std::hash<std::uint32_t>{}(handle.id());
+        }
+    };
+}
+
+// Small direct-mapped cache in front of StringPool for one thread that
+// interns the same keys over and over, e.g. a decoder seeing the same field
+// names in every message. A hit compares the key against the cached string
+// and never reaches the pool's tables.
+//
+// Counted strings are cached through a weak_ptr, so one released while
+// cached simply misses next time; immortal strings are cached as plain
+// pointers and a hit on one touches no shared memory at all. Not
+// thread-safe: use one cache per thread, e.g. local().
+template<size_t Entries = 256>
+class StringCache {
+public:
+    static_assert(Entries != 0 && (Entries & (Entries - 1)) == 0, "StringCache size must be a power of two.");
+
+    // This thread's cache.
+    static StringCache& local() {
+        static thread_local StringCache cache;
+        return cache;
+    }
+
+    template<typename T, typename = std::enable_if_t<is_allowed_string_type<T>::value>>
+    StringPtr intern(T&& arg) {
+        const std::string_view key(arg);
+        const std::uint64_t hash = hash64(key.data(), key.size());
+        Line& line = lines_[hash & (Entries - 1)];
+        if (line.hash == hash && line.string != nullptr) {
+            StringPtr cached = line.immortal ? StringPtr(StringPtr(), line.string) : line.owner.lock();
+            if (cached != nullptr && cached->data == key) {
+                ++hits_;
+                return cached;
+            }
+        }
+        ++misses_;
+        StringPtr string = StringPool::instance().intern(key, hash);
+        line.hash = hash;
+        line.string = string.get();
+        line.immortal = string.use_count() == 0;
+        line.owner = line.immortal ? std::weak_ptr<const String>() : std::weak_ptr<const String>(string);
+        return string;
+    }
+
+    void clear() {
+        for (Line& line : lines_) {
+            line = Line();
+        }
+    }
+
+    size_t hits() const {
+        return hits_;
+    }
+
+    size_t misses() const {
+        return misses_;
+    }
+
+private:
+    struct Line {
+        std::uint64_t hash = 0;
+        const String* string = nullptr;
+        std::weak_ptr<const String> owner;
+        bool immortal = false;
+    };
+
+    Line lines_[Entries];
+    size_t hits_ = 0;
+    size_t misses_ = 0;
+};
+
+// Interns on every evaluation; for hot paths use CPPUTILS_INTERN or _is.
+inline StringPtr operator"" _hs(const char* str, std::size_t length) {
+    return StringPool::instance().intern(std::string_view(str, length), hash64(str, length));
+}
+
+// CPPUTILS_INTERN("price") is a const StringPtr& to the interned literal.
+// The hash is a constant expression and the string is interned, immortal,
+// the first time the expression runs; every later evaluation is the check
+// of a function-local static that has already been initialised and one
+// load, with no pool lookup and no lock. Each use site has its own static.
+#define CPPUTILS_INTERN(literal)                                                                          \
+    ([]() -> const StringPtr& {                                                                           \
+        constexpr std::string_view cpputils_literal(literal);                                             \
+        constexpr std::uint64_t cpputils_hash = hash64(cpputils_literal.data(), cpputils_literal.size()); \
+        static const StringPtr cpputils_interned =                                                        \
+            StringPool::instance().intern(cpputils_literal, cpputils_hash, StringLifetime::Immortal); \
+        return cpputils_interned;                                                                         \
+    }())
+
+#if defined(__cpp_nontype_template_args) && __cpp_nontype_template_args >= 201911L
+// A string literal as a template argument, for the _is operator below.
+template<std::size_t N>
+struct StringLiteral {
+    constexpr StringLiteral(const char (&str)[N]) {
+        for (std::size_t i = 0; i < N; ++i) {
+            chars[i] = str[i];
+        }
+    }
+
+    constexpr std::string_view view() const {
+        return std::string_view(chars, N - 1);
+    }
+
+    char chars[N];
+};
+
+// "price"_is: CPPUTILS_INTERN as a literal suffix, one static per distinct
+// literal rather than per use site. Needs C++20.
+template<StringLiteral Literal>
+const StringPtr& operator""_is() {
+    constexpr std::uint64_t hash = hash64(Literal.chars, Literal.view().size());
+    static const StringPtr interned = StringPool::instance().intern(Literal.view(), hash, StringLifetime::Immortal);
+    return interned;
+}
+#endif
+
+inline StringPtr StringPool::intern(std::string_view key, std::uint64_t hash, StringLifetime lifetime) {
+    if (const String* mapped = findMapped(key, hash)) {
+        stats_.onHit();
+        return StringPtr(StringPtr(), mapped);
+    }
+    Shard& shard = shardFor(hash);
+    {
+        EpochDomain::Guard guard(epochs());
+        if (guard) {
+            if (StringPtr existing = shard.find(hash, key)) {
+                stats_.onHit();
+                return existing;
+            }
+        }
+    }
+
+    const auto lock = lockShard(shard);
+    if (StringPtr existing = shard.find(hash, key)) {
+        stats_.onHit();
+        return existing;
+    }
+    return insertLocked(shard, key, hash, lifetime);
+}
+
+inline StringPtr StringPool::insertLocked(Shard& shard, std::string_view key, std::uint64_t hash, StringLifetime lifetime) {
+    if (sealed_.load(std::memory_order_relaxed)) {
+        throw std::out_of_range("StringPool is sealed; cannot intern a new string.");
+    }
+    stats_.onInsert(key.size());
+    if (lifetime == StringLifetime::Immortal) {
+        const String* string = String::construct(shard.arena.allocate(String::footprint(key.size())), key, hash, this);
+        // The entry lives in the arena as well, so the pool can drop both
+        // with the arena's blocks.
+        shard.insert(new (shard.arena.allocate(sizeof(Entry))) Entry{hash, string, string->data, {}, true});
+        return StringPtr(StringPtr(), string);
+    }
+    // Either a first insert, or the string died and its entry is waiting in
+    // the garbage list; the new entry sits beside the expired one.
+    char* chars = nullptr;
+    StringPtr string =
+        std::allocate_shared<String>(TrailingAllocator<String>(key.size() + 1, &chars, memory_), &chars, key, hash, this);
+    Entry* entry = memory_.create<Entry>(hash, string.get(), string->data, std::weak_ptr<const String>(string), false);
+    string->entry_ = entry;
+    shard.insert(entry);
+    ++shard.counted;
+    return string;
+}
+
+inline String::~String() {
+    if (pool_ != nullptr && entry_ != nullptr) {
+        pool_->release(*this);
+    }
+}
+
+inline void StringPool::intern_batch(const std::string_view* in, size_t count, StringPtr* out, StringLifetime lifetime) {
+    // Batches up to ids_of()'s chunk size need no heap.
+    constexpr size_t InlineBatch = 64;
+    std::uint64_t inlineHashes[InlineBatch];
+    std::uint32_t inlineOrder[InlineBatch];
+    std::vector<std::uint64_t> heapHashes;
+    std::vector<std::uint32_t> heapOrder;
+    std::uint64_t* hashes = inlineHashes;
+    // Batch positions ordered by shard; shard s owns order[start[s], start[s + 1]).
+    std::uint32_t* order = inlineOrder;
+    if (count > InlineBatch) {
+        heapHashes.resize(count);
+        heapOrder.resize(count);
+        hashes = heapHashes.data();
+        order = heapOrder.data();
+    }
+    size_t start[ShardCount + 1] = {};
+    hash64_batch(in, count, hashes);
+    for (size_t i = 0; i < count; ++i) {
+        ++start[shardIndex(hashes[i]) + 1];
+        // Dropping an old value could destroy a String; do it before any lock.
+        out[i].reset();
+    }
+    for (size_t s = 0; s < ShardCount; ++s) {
+        start[s + 1] += start[s];
+    }
+    {
+        size_t next[ShardCount];
+        std::copy(start, start + ShardCount, next);
+        for (size_t i = 0; i < count; ++i) {
+            order[next[shardIndex(hashes[i])]++] = static_cast<std::uint32_t>(i);
+        }
+    }
+
+    {
+        EpochDomain::Guard guard(epochs());
+        if (guard) {
+            for (size_t i = 0; i < count; ++i) {
+                shardFor(hashes[i]).prefetch(hashes[i]);
+            }
+            for (size_t i = 0; i < count; ++i) {
+                if (const String* mapped = findMapped(in[i], hashes[i])) {
+                    out[i] = StringPtr(StringPtr(), mapped);
+                } else {
+                    out[i] = shardFor(hashes[i]).find(hashes[i], in[i]);
+                }
+                if (out[i] != nullptr) {
+                    stats_.onHit();
+                }
+            }
+        }
+    }
+
+    for (size_t s = 0; s < ShardCount; ++s) {
+        size_t first = start[s];
+        while (first < start[s + 1] && out[order[first]] != nullptr) {
+            ++first;
+        }
+        if (first == start[s + 1]) {
+            continue;
+        }
+        Shard& shard = shards_[s];
+        const auto lock = lockShard(shard);
+        for (size_t k = first; k < start[s + 1]; ++k) {
+            const std::uint32_t i = order[k];
+            if (out[i] != nullptr) {
+                continue;
+            }
+            if (const String* mapped = findMapped(in[i], hashes[i])) {
+                out[i] = StringPtr(StringPtr(), mapped);
+                stats_.onHit();
+                continue;
+            }
+            out[i] = shard.find(hashes[i], in[i]);
+            if (out[i] != nullptr) {
+                stats_.onHit();
+            } else {
+                out[i] = insertLocked(shard, in[i], hashes[i], lifetime);
+            }
+        }
+    }
+}
+
+inline std::uint32_t StringPool::handleOf(std::string_view str, std::uint64_t hash) {
+    // Handles are for long-lived symbols, so a new string starts immortal.
+    return handleOf(intern(str, hash, StringLifetime::Immortal));
+}
+
+inline std::uint32_t StringPool::handleOf(const StringPtr& string) {
+    if (const std::uint32_t id = string->handle_.load(std::memory_order_acquire)) {
+        return id;
+    }
+    Shard& shard = shardFor(string->hash());
+    const auto lock = lockShard(shard);
+    if (const std::uint32_t id = string->handle_.load(std::memory_order_relaxed)) {
+        return id;
+    }
+    if (string.use_count() != 0) {
+        shard.pinned.push_back(string);
+    }
+    return assignHandle(string.get());
+}
+
+inline void StringPool::ids_of(const std::string_view* in, size_t count, std::uint32_t* out) {
+    // Chunked so the interned pointers stay on the stack.
+    constexpr size_t Chunk = 64;
+    StringPtr strings[Chunk];
+    for (size_t done = 0; done < count; done += Chunk) {
+        const size_t n = std::min(Chunk, count - done);
+        intern_batch(in + done, n, strings, StringLifetime::Immortal);
+        for (size_t i = 0; i < n; ++i) {
+            out[done + i] = handleOf(strings[i]) - 1;
+        }
+    }
 }
 
 #endif // STRING_INTERN_H
@@ -0,0 +1,149 @@
+#ifndef STRING_LOADER_H
+#define STRING_LOADER_H
+
+#include "StringIntern.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+struct TokenizeOptions {
+    // Every one of these characters ends a token.
+    std::string_view delimiters = " \t\r\n";
+    // Target chunk length; each chunk is extended to the next delimiter, so
+    // no token is split between two chunks.
+    size_t chunkBytes = size_t(1) << 20;
+    // Tokens are interned through ids_of() this many at a time.
+    size_t batchSize = 1024;
+};
+
+// Bulk loader for large delimited text: splits the input into chunks on
+// delimiter boundaries and tokenizes and interns the chunks in parallel on a
+// ThreadPool, each worker feeding its tokens to StringPool::ids_of() in
+// batches. Empty tokens (runs of delimiters) are skipped.
+//
+// The result holds one array of dense symbol ids per chunk, in input order,
+// so concatenating them gives the file's tokens in order; interned in the
+// process-wide pool, a token's StringHandle is StringHandle::fromId(id + 1),
+// while a scoped pool's ids go back to strings through its symbolView().
+// Which new string gets which id depends on how the chunks race, so ids are
+// dense but not in file order.
+class StringLoader {
+public:
+    using Chunks = std::vector<std::vector<std::uint32_t>>;
+
+    // Throws std::runtime_error if path cannot be mapped.
+    static Chunks internFile(const std::string& path, ThreadPool& threads, StringPool& pool = StringPool::instance(),
+                             const TokenizeOptions& options = TokenizeOptions()) {
+        MappedFile file;
+        if (!file.open(path)) {
+            throw std::runtime_error("StringLoader cannot map " + path);
+        }
+        file.adviseSequential();
+        return internText(file.view(), threads, pool, options);
+    }
+
+    // As internFile(), over text already in memory.
+    static Chunks internText(std::string_view text, ThreadPool& threads, StringPool& pool = StringPool::instance(),
+                             const TokenizeOptions& options = TokenizeOptions()) {
+        if (options.delimiters.empty() || options.chunkBytes == 0 || options.batchSize == 0) {
+            throw std::invalid_argument("StringLoader needs delimiters, a chunk size and a batch size.");
+        }
+        const Delimiters delimiters(options.delimiters);
+        const std::vector<std::string_view> chunks = split(text, delimiters, options.chunkBytes);
+        Chunks ids(chunks.size());
+        // Tasks must not throw, so the first failure is carried out.
+        std::exception_ptr failure;
+        std::mutex failureMutex;
+        threads.parallel_for(0, chunks.size(), [&](size_t i) {
+            try {
+                ids[i] = internChunk(chunks[i], delimiters, pool, options.batchSize);
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(failureMutex);
+                if (!failure) {
+                    failure = std::current_exception();
+                }
+            }
+        });
+        if (failure) {
+            std::rethrow_exception(failure);
+        }
+        return ids;
+    }
+
+private:
+    // One flag per byte value, so classifying a character is one load
+    // whatever the number of delimiters.
+    struct Delimiters {
+        explicit Delimiters(std::string_view chars) {
+            for (const char c : chars) {
+                table[static_cast<unsigned char>(c)] = true;
+            }
+        }
+
+        bool operator()(char c) const {
+            return table[static_cast<unsigned char>(c)];
+        }
+
+        bool table[256] = {};
+    };
+
+    // Cuts text after the first delimiter at or beyond each chunkBytes mark.
+    static std::vector<std::string_view> split(std::string_view text, const Delimiters& isDelimiter, size_t chunkBytes) {
+        std::vector<std::string_view> chunks;
+        size_t begin = 0;
+        while (begin < text.size()) {
+            size_t end = std::min(begin + chunkBytes, text.size());
+            while (end < text.size() && !isDelimiter(text[end])) {
+                ++end;
+            }
+            end = std::min(end + 1, text.size());
+            chunks.push_back(text.substr(begin, end - begin));
+            begin = end;
+        }
+        return chunks;
+    }
+
+    static std::vector<std::uint32_t> internChunk(std::string_view chunk, const Delimiters& isDelimiter,
+                                                  StringPool& pool, size_t batchSize) {
+        std::vector<std::uint32_t> ids;
+        std::vector<std::string_view> batch;
+        batch.reserve(batchSize);
+        auto flush = [&] {
+            const size_t first = ids.size();
+            ids.resize(first + batch.size());
+            pool.ids_of(batch.data(), batch.size(), ids.data() + first);
+            batch.clear();
+        };
+        const char* p = chunk.data();
+        const char* const end = p + chunk.size();
+        while (p != end) {
+            while (p != end && isDelimiter(*p)) {
+                ++p;
+            }
+            const char* start = p;
+            while (p != end && !isDelimiter(*p)) {
+                ++p;
+            }
+            if (p != start) {
+                batch.emplace_back(start, static_cast<size_t>(p - start));
+                if (batch.size() == batchSize) {
+                    flush();
+                }
+            }
+        }
+        if (!batch.empty()) {
+            flush();
+        }
+        return ids;
+    }
+};
+
+#endif // STRING_LOADER_H
@@ -0,0 +1,298 @@
+#ifndef STRING_PATH_H
+#define STRING_PATH_H
+
+#include "StringIntern.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Interned hierarchical keys such as "md.venue.XNAS.AAPL.bid", stored as a
+// tree: each path is a node holding its parent's id and the symbol id of its
+// last segment, so a shared prefix is stored once however many keys sit
+// under it, and each distinct segment is one string in the StringPool.
+//
+// append() finds or adds a child from the parent's id and the segment alone,
+// hashing only the segment; parent(), segment() and depth() read the node
+// directly, and the children of a node are a linked list, so walking them
+// costs one load per child. Ids are dense, 0 being the empty root path, and
+// are stable for the life of the PathPool.
+//
+// Thread-safe. Lookups and inserts share one mutex; parent(), segment(),
+// depth() and forEachChild() take none. Segments are interned as symbols
+// (see StringPool::symbolId) and so stay in the pool for good.
+class PathPool {
+public:
+    using Id = std::uint32_t;
+
+    static constexpr Id Root = 0;
+    static constexpr Id NotFound = ~Id(0);
+
+    explicit PathPool(char separator = '.', StringPool& strings = StringPool::instance())
+        : separator_(separator), strings_(strings) {
+        index_.assign(InitialIndex, IndexSlot{EmptyKey, 0});
+        Node& root = addNode();
+        root.parent = Root;
+        root.segment = NoSegment;
+        root.depth = 0;
+    }
+
+    ~PathPool() {
+        for (auto& page : pages_) {
+            delete[] page.load(std::memory_order_relaxed);
+        }
+    }
+
+    PathPool(const PathPool&) = delete;
+    PathPool& operator=(const PathPool&) = delete;
+
+    // The child of parent named segment, added if new.
+    Id append(Id parent, std::string_view segment) {
+        const std::uint32_t symbol = strings_.symbolId(segment);
+        std::lock_guard<std::mutex> lock(mutex_);
+        return childLocked(parent, symbol, true);
+    }
+
+    // As append(), but NotFound instead of adding.
+    Id find(Id parent, std::string_view segment) const {
+        const std::uint32_t symbol = strings_.lookupSymbol(segment);
+        if (symbol == StringPool::NoSymbol) {
+            return NotFound;
+        }
+        std::lock_guard<std::mutex> lock(mutex_);
+        return findLocked(parent, symbol);
+    }
+
+    // Splits path on the separator and appends each segment from the root;
+    // the empty path is Root. Every segment counts, empty ones included.
+    Id intern(std::string_view path) {
+        if (path.empty()) {
+            return Root;
+        }
+        Id id = Root;
+        forEachSegment(path, [&](std::string_view segment) {
+            id = append(id, segment);
+            return true;
+        });
+        return id;
+    }
+
+    // The node for path, or NotFound; never adds.
+    Id lookup(std::string_view path) const {
+        if (path.empty()) {
+            return Root;
+        }
+        Id id = Root;
+        forEachSegment(path, [&](std::string_view segment) {
+            id = find(id, segment);
+            return id != NotFound;
+        });
+        return id;
+    }
+
+    // Root is its own parent.
+    Id parent(Id id) const {
+        return node(id).parent;
+    }
+
+    // The last segment; empty for Root.
+    std::string_view segment(Id id) const {
+        const Node& n = node(id);
+        return n.segment == NoSegment ? std::string_view() : strings_.symbolView(n.segment);
+    }
+
+    // Number of segments; 0 for Root.
+    std::uint32_t depth(Id id) const {
+        return node(id).depth;
+    }
+
+    // True if ancestor is id or one of its parents.
+    bool isPrefixOf(Id ancestor, Id id) const {
+        const std::uint32_t target = depth(ancestor);
+        while (depth(id) > target) {
+            id = parent(id);
+        }
+        return id == ancestor;
+    }
+
+    // The full path, joined with the separator.
+    std::string str(Id id) const {
+        std::vector<std::string_view> segments(depth(id));
+        size_t length = segments.empty() ? 0 : segments.size() - 1;
+        for (size_t i = segments.size(); i-- > 0; id = parent(id)) {
+            segments[i] = segment(id);
+            length += segments[i].size();
+        }
+        std::string result;
+        result.reserve(length);
+        for (size_t i = 0; i < segments.size(); ++i) {
+            if (i != 0) {
+                result += separator_;
+            }
+            result.append(segments[i].data(), segments[i].size());
+        }
+        return result;
+    }
+
+    // Calls fn(child) for every direct child of id, newest first.
+    template<typename F>
+    void forEachChild(Id id, F&& fn) const {
+        for (Id child = node(id).firstChild.load(std::memory_order_acquire); child != NotFound;
+             child = node(child).nextSibling) {
+            fn(child);
+        }
+    }
+
+    // Nodes, Root included.
+    size_t size() const {
+        return count_.load(std::memory_order_acquire);
+    }
+
+    // Bytes held by the tree and its child index; the segment strings are
+    // the StringPool's.
+    size_t bytes() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        size_t pages = 0;
+        for (const auto& page : pages_) {
+            pages += page.load(std::memory_order_relaxed) != nullptr;
+        }
+        return pages * PageSize * sizeof(Node) + index_.capacity() * sizeof(IndexSlot);
+    }
+
+private:
+    static constexpr std::uint32_t NoSegment = ~std::uint32_t(0);
+    static constexpr std::uint64_t EmptyKey = ~std::uint64_t(0);
+    static constexpr size_t InitialIndex = 64;
+
+    // Nodes live in fixed pages that never move, so readers need no lock.
+    static constexpr unsigned PageBits = 12;
+    static constexpr size_t PageSize = size_t(1) << PageBits;
+    static constexpr size_t PageCount = size_t(1) << 16;
+
+    struct Node {
+        Id parent;
+        std::uint32_t segment;
+        std::uint32_t depth;
+        // Written before the node is linked in as its parent's first child.
+        Id nextSibling;
+        std::atomic<Id> firstChild{NotFound};
+    };
+
+    // (parent << 32 | segment) -> child, open-addressed.
+    struct IndexSlot {
+        std::uint64_t key;
+        Id child;
+    };
+
+    template<typename F>
+    void forEachSegment(std::string_view path, F&& fn) const {
+        size_t start = 0;
+        while (true) {
+            const size_t end = path.find(separator_, start);
+            const std::string_view segment = path.substr(start, end == std::string_view::npos ? end : end - start);
+            if (!fn(segment) || end == std::string_view::npos) {
+                return;
+            }
+            start = end + 1;
+        }
+    }
+
+    const Node& node(Id id) const {
+        return pages_[id >> PageBits].load(std::memory_order_acquire)[id & (PageSize - 1)];
+    }
+
+    Node& addNode() {
+        const size_t id = count_.load(std::memory_order_relaxed);
+        if ((id >> PageBits) >= PageCount || id >= NotFound) {
+            throw std::length_error("PathPool node ids exhausted.");
+        }
+        auto& slot = pages_[id >> PageBits];
+        Node* page = slot.load(std::memory_order_relaxed);
+        if (page == nullptr) {
+            page = new Node[PageSize];
+            slot.store(page, std::memory_order_release);
+        }
+        count_.store(id + 1, std::memory_order_release);
+        return page[id & (PageSize - 1)];
+    }
+
+    static size_t slotOf(std::uint64_t key, size_t mask) {
+        return static_cast<size_t>((key * 0x9E3779B97F4A7C15ull) >> 32) & mask;
+    }
+
+    Id findLocked(Id parent, std::uint32_t symbol) const {
+        const std::uint64_t key = (std::uint64_t(parent) << 32) | symbol;
+        const size_t mask = index_.size() - 1;
+        for (size_t i = slotOf(key, mask);; i = (i + 1) & mask) {
+            if (index_[i].key == key) {
+                return index_[i].child;
+            }
+            if (index_[i].key == EmptyKey) {
+                return NotFound;
+            }
+        }
+    }
+
+    Id childLocked(Id parent, std::uint32_t symbol, bool add) {
+        const std::uint64_t key = (std::uint64_t(parent) << 32) | symbol;
+        size_t mask = index_.size() - 1;
+        size_t i = slotOf(key, mask);
+        for (; index_[i].key != EmptyKey; i = (i + 1) & mask) {
+            if (index_[i].key == key) {
+                return index_[i].child;
+            }
+        }
+        if (!add) {
+            return NotFound;
+        }
+        const Id id = static_cast<Id>(size());
+        Node& child = addNode();
+        Node& up = const_cast<Node&>(node(parent));
+        child.parent = parent;
+        child.segment = symbol;
+        child.depth = up.depth + 1;
+        child.nextSibling = up.firstChild.load(std::memory_order_relaxed);
+        up.firstChild.store(id, std::memory_order_release);
+
+        if ((indexUsed_ + 1) * 4 > index_.size() * 3) {
+            growIndex();
+            mask = index_.size() - 1;
+            for (i = slotOf(key, mask); index_[i].key != EmptyKey; i = (i + 1) & mask) {
+            }
+        }
+        index_[i] = IndexSlot{key, id};
+        ++indexUsed_;
+        return id;
+    }
+
+    void growIndex() {
+        std::vector<IndexSlot> old(index_.size() * 2, IndexSlot{EmptyKey, 0});
+        old.swap(index_);
+        const size_t mask = index_.size() - 1;
+        for (const IndexSlot& slot : old) {
+            if (slot.key != EmptyKey) {
+                size_t i = slotOf(slot.key, mask);
+                while (index_[i].key != EmptyKey) {
+                    i = (i + 1) & mask;
+                }
+                index_[i] = slot;
+            }
+        }
+    }
+
+    const char separator_;
+    StringPool& strings_;
+    mutable std::mutex mutex_;
+    std::vector<IndexSlot> index_;
+    size_t indexUsed_ = 0;
+    std::atomic<size_t> count_{0};
+    std::atomic<Node*> pages_[PageCount] = {};
+};
+
+#endif // STRING_PATH_H
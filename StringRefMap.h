@@ -0,0 +1,550 @@
+#ifndef STRING_REF_MAP_H
+#define STRING_REF_MAP_H
+
+#include "StringIntern.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define CPPUTILS_STRING_MAP_SSE2 1
+#endif
+
+// Open-addressing hash map keyed by interned strings, laid out like a Swiss
+// table: one control byte per slot holding 7 bits of the key's hash, probed
+// sixteen at a time, and the entries themselves in a flat array beside it.
+//
+// Keys are stored as StringHandle ids. Interned strings are equal exactly
+// when they are the same string, so a 4-byte id compare stands in for
+// string equality and the hash is computed from the id too: a lookup reads
+// the key's own header for its handle, scans one control group and then
+// touches the one slot that matched, without ever visiting the string.
+//
+// Inserting a key gives it a handle, which pins counted strings for the
+// life of the pool (see StringHandle); lookups and erase never do. As
+// handles only name strings of the process-wide pool, so do the keys:
+// inserting a StringRef of a scoped pool throws std::invalid_argument, and
+// looking one up finds nothing. Not thread-safe.
+template<typename V>
+class StringRefMap {
+public:
+    using key_type = StringHandle;
+    using mapped_type = V;
+    using value_type = std::pair<const StringHandle, V>;
+    using size_type = size_t;
+
+    template<bool Const>
+    class Iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = StringRefMap::value_type;
+        using difference_type = std::ptrdiff_t;
+        using pointer = std::conditional_t<Const, const value_type*, value_type*>;
+        using reference = std::conditional_t<Const, const value_type&, value_type&>;
+
+        Iterator() = default;
+
+        // const_iterator from iterator.
+        template<bool C = Const, typename = std::enable_if_t<C>>
+        Iterator(const Iterator<false>& other) : ctrl_(other.ctrl_), slot_(other.slot_), end_(other.end_) {}
+
+        reference operator*() const {
+            return *slot_;
+        }
+
+        pointer operator->() const {
+            return slot_;
+        }
+
+        Iterator& operator++() {
+            ++ctrl_;
+            ++slot_;
+            skipFree();
+            return *this;
+        }
+
+        Iterator operator++(int) {
+            Iterator previous = *this;
+            ++*this;
+            return previous;
+        }
+
+        bool operator==(const Iterator& other) const {
+            return slot_ == other.slot_;
+        }
+
+        bool operator!=(const Iterator& other) const {
+            return slot_ != other.slot_;
+        }
+
+    private:
+        friend class StringRefMap;
+        template<bool>
+        friend class Iterator;
+
+        Iterator(const std::int8_t* ctrl, pointer slot, const std::int8_t* end)
+            : ctrl_(ctrl), slot_(slot), end_(end) {
+            skipFree();
+        }
+
+        void skipFree() {
+            while (ctrl_ != end_ && *ctrl_ < 0) {
+                ++ctrl_;
+                ++slot_;
+            }
+        }
+
+        const std::int8_t* ctrl_ = nullptr;
+        pointer slot_ = nullptr;
+        const std::int8_t* end_ = nullptr;
+    };
+
+    using iterator = Iterator<false>;
+    using const_iterator = Iterator<true>;
+
+    explicit StringRefMap(size_t expected = 0) {
+        if (expected != 0) {
+            reserve(expected);
+        }
+    }
+
+    StringRefMap(const StringRefMap& other) : StringRefMap(other.size_) {
+        for (const value_type& entry : other) {
+            insertUnique(entry.first, entry.second);
+        }
+    }
+
+    StringRefMap& operator=(const StringRefMap& other) {
+        if (this != &other) {
+            StringRefMap copy(other);
+            swap(copy);
+        }
+        return *this;
+    }
+
+    StringRefMap(StringRefMap&& other) noexcept {
+        swap(other);
+    }
+
+    StringRefMap& operator=(StringRefMap&& other) noexcept {
+        if (this != &other) {
+            StringRefMap moved(std::move(other));
+            swap(moved);
+        }
+        return *this;
+    }
+
+    ~StringRefMap() {
+        destroyAll();
+        release();
+    }
+
+    void swap(StringRefMap& other) noexcept {
+        std::swap(ctrl_, other.ctrl_);
+        std::swap(slots_, other.slots_);
+        std::swap(capacity_, other.capacity_);
+        std::swap(size_, other.size_);
+        std::swap(growthLeft_, other.growthLeft_);
+    }
+
+    iterator begin() {
+        return iterator(ctrl_, slots_, ctrl_ + capacity_);
+    }
+
+    iterator end() {
+        return iterator(ctrl_ + capacity_, slots_ + capacity_, ctrl_ + capacity_);
+    }
+
+    const_iterator begin() const {
+        return const_iterator(ctrl_, slots_, ctrl_ + capacity_);
+    }
+
+    const_iterator end() const {
+        return const_iterator(ctrl_ + capacity_, slots_ + capacity_, ctrl_ + capacity_);
+    }
+
+    size_t size() const {
+        return size_;
+    }
+
+    bool empty() const {
+        return size_ == 0;
+    }
+
+    // Number of slots; the map grows once seven eighths are taken.
+    size_t capacity() const {
+        return capacity_;
+    }
+
+    // Makes room for count entries without further rehashing.
+    void reserve(size_t count) {
+        size_t capacity = GroupWidth;
+        while (maxLoad(capacity) < count) {
+            capacity <<= 1;
+        }
+        if (capacity > capacity_) {
+            rehash(capacity);
+        }
+    }
+
+    iterator find(StringHandle key) {
+        const size_t index = indexOf(key);
+        return index == NotFound ? end() : iteratorAt(index);
+    }
+
+    const_iterator find(StringHandle key) const {
+        const size_t index = indexOf(key);
+        return index == NotFound ? end() : const_iterator(ctrl_ + index, slots_ + index, ctrl_ + capacity_);
+    }
+
+    // A string that has never had a handle cannot be a key, so this costs
+    // one load from its header before the probe and never pins anything.
+    iterator find(const StringRef& key) {
+        return find(StringHandle::existing(key.getRawPointer()));
+    }
+
+    const_iterator find(const StringRef& key) const {
+        return find(StringHandle::existing(key.getRawPointer()));
+    }
+
+    bool contains(StringHandle key) const {
+        return indexOf(key) != NotFound;
+    }
+
+    bool contains(const StringRef& key) const {
+        return contains(StringHandle::existing(key.getRawPointer()));
+    }
+
+    // Constructs V from args unless key is present; returns the entry and
+    // whether it was inserted.
+    template<typename... Args>
+    std::pair<iterator, bool> try_emplace(StringHandle key, Args&&... args) {
+        if (!key) {
+            throw std::invalid_argument("StringRefMap keys must not be null.");
+        }
+        const std::uint64_t hash = hashOf(key);
+        const size_t found = probe(key, hash);
+        if (found != NotFound) {
+            return {iteratorAt(found), false};
+        }
+        return {iteratorAt(insertNew(key, hash, std::forward<Args>(args)...)), true};
+    }
+
+    template<typename... Args>
+    std::pair<iterator, bool> try_emplace(const StringRef& key, Args&&... args) {
+        return try_emplace(handleFor(key), std::forward<Args>(args)...);
+    }
+
+    V& operator[](StringHandle key) {
+        return try_emplace(key).first->second;
+    }
+
+    V& operator[](const StringRef& key) {
+        return try_emplace(key).first->second;
+    }
+
+    bool erase(StringHandle key) {
+        const size_t index = indexOf(key);
+        if (index == NotFound) {
+            return false;
+        }
+        eraseAt(index);
+        return true;
+    }
+
+    bool erase(const StringRef& key) {
+        return erase(StringHandle::existing(key.getRawPointer()));
+    }
+
+    iterator erase(const_iterator position) {
+        const size_t index = static_cast<size_t>(position.slot_ - slots_);
+        eraseAt(index);
+        return iterator(ctrl_ + index + 1, slots_ + index + 1, ctrl_ + capacity_);
+    }
+
+    // Drops every entry but keeps the slots.
+    void clear() {
+        destroyAll();
+        if (ctrl_) {
+            std::memset(ctrl_, Empty, capacity_ + GroupWidth);
+        }
+        size_ = 0;
+        growthLeft_ = maxLoad(capacity_);
+    }
+
+private:
+    // Control byte values: a full slot holds the hash's top 7 bits, so the
+    // sign bit alone tells full from free.
+    static constexpr std::int8_t Empty = -128;
+    static constexpr std::int8_t Deleted = -2;
+
+    static constexpr size_t GroupWidth = 16;
+    static constexpr size_t NotFound = ~size_t(0);
+
+    // Sixteen control bytes loaded at once; matches come back as a bitmask
+    // with bit i set for byte i.
+    struct Group {
+        explicit Group(const std::int8_t* ctrl) {
+#if defined(CPPUTILS_STRING_MAP_SSE2)
+            bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ctrl));
+#else
+            std::memcpy(bytes, ctrl, GroupWidth);
+#endif
+        }
+
+        std::uint32_t match(std::int8_t h2) const {
+#if defined(CPPUTILS_STRING_MAP_SSE2)
+            return static_cast<std::uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(h2), bytes)));
+#else
+            std::uint32_t mask = 0;
+            for (size_t i = 0; i < GroupWidth; ++i) {
+                mask |= std::uint32_t(bytes[i] == h2) << i;
+            }
+            return mask;
+#endif
+        }
+
+        std::uint32_t matchEmpty() const {
+            return match(Empty);
+        }
+
+        // Empty or deleted: the slots an insert may take.
+        std::uint32_t matchFree() const {
+#if defined(CPPUTILS_STRING_MAP_SSE2)
+            return static_cast<std::uint32_t>(_mm_movemask_epi8(bytes));
+#else
+            std::uint32_t mask = 0;
+            for (size_t i = 0; i < GroupWidth; ++i) {
+                mask |= std::uint32_t(bytes[i] < 0) << i;
+            }
+            return mask;
+#endif
+        }
+
+#if defined(CPPUTILS_STRING_MAP_SSE2)
+        __m128i bytes;
+#else
+        std::int8_t bytes[GroupWidth];
+#endif
+    };
+
+    // Walks the table group by group with growing strides; with a power of
+    // two capacity this reaches every group before repeating.
+    struct ProbeSequence {
+        ProbeSequence(std::uint64_t hash, size_t mask) : mask(mask), offset(static_cast<size_t>(hash) & mask) {}
+
+        void next() {
+            stride += GroupWidth;
+            offset = (offset + stride) & mask;
+        }
+
+        size_t mask;
+        size_t offset;
+        size_t stride = 0;
+    };
+
+    static unsigned lowestBit(std::uint32_t mask) {
+#if defined(__GNUC__) || defined(__clang__)
+        return static_cast<unsigned>(__builtin_ctz(mask));
+#else
+        unsigned bit = 0;
+        while (!(mask & 1)) {
+            mask >>= 1;
+            ++bit;
+        }
+        return bit;
+#endif
+    }
+
+    static unsigned highestBit(std::uint32_t mask) {
+#if defined(__GNUC__) || defined(__clang__)
+        return 31u - static_cast<unsigned>(__builtin_clz(mask));
+#else
+        unsigned bit = 0;
+        while (mask >>= 1) {
+            ++bit;
+        }
+        return bit;
+#endif
+    }
+
+    // Handle ids are handed out densely, so a multiplicative hash already
+    // spreads them: the low bits, which pick the slot, are a bijection of the
+    // id's low bits, and the well mixed high bits go into the control byte.
+    static std::uint64_t hashOf(StringHandle key) {
+        return std::uint64_t(key.id()) * 0x9E3779B97F4A7C15ull;
+    }
+
+    static std::int8_t h2(std::uint64_t hash) {
+        return static_cast<std::int8_t>(hash >> 57);
+    }
+
+    static size_t maxLoad(size_t capacity) {
+        return capacity - capacity / 8;
+    }
+
+    // Reuses the string's existing handle before falling back to the pool,
+    // which interns and pins it.
+    static StringHandle handleFor(const StringRef& key) {
+        const String* string = key.getRawPointer();
+        if (string != nullptr && !StringHandle::inProcessPool(string)) {
+            throw std::invalid_argument("StringRefMap keys must come from the process-wide StringPool.");
+        }
+        const StringHandle handle = StringHandle::existing(string);
+        return handle ? handle : StringHandle(key);
+    }
+
+    iterator iteratorAt(size_t index) {
+        return iterator(ctrl_ + index, slots_ + index, ctrl_ + capacity_);
+    }
+
+    size_t indexOf(StringHandle key) const {
+        if (!key || size_ == 0) {
+            return NotFound;
+        }
+        return probe(key, hashOf(key));
+    }
+
+    size_t probe(StringHandle key, std::uint64_t hash) const {
+        if (capacity_ == 0) {
+            return NotFound;
+        }
+        ProbeSequence seq(hash, capacity_ - 1);
+        while (true) {
+            const Group group(ctrl_ + seq.offset);
+            for (std::uint32_t mask = group.match(h2(hash)); mask; mask &= mask - 1) {
+                const size_t index = (seq.offset + lowestBit(mask)) & seq.mask;
+                if (slots_[index].first == key) {
+                    return index;
+                }
+            }
+            if (group.matchEmpty()) {
+                return NotFound;
+            }
+            seq.next();
+        }
+    }
+
+    size_t findFree(std::uint64_t hash) const {
+        ProbeSequence seq(hash, capacity_ - 1);
+        while (true) {
+            const std::uint32_t mask = Group(ctrl_ + seq.offset).matchFree();
+            if (mask) {
+                return (seq.offset + lowestBit(mask)) & seq.mask;
+            }
+            seq.next();
+        }
+    }
+
+    // The first GroupWidth control bytes are mirrored after the last slot,
+    // so a group read near the end need not wrap.
+    void setCtrl(size_t index, std::int8_t value) {
+        ctrl_[index] = value;
+        if (index < GroupWidth) {
+            ctrl_[capacity_ + index] = value;
+        }
+    }
+
+    template<typename... Args>
+    size_t insertNew(StringHandle key, std::uint64_t hash, Args&&... args) {
+        if (growthLeft_ == 0) {
+            // Mostly tombstones: rebuild in place; otherwise double.
+            rehash(size_ < maxLoad(capacity_) / 2 ? capacity_ : std::max(capacity_ * 2, GroupWidth));
+        }
+        const size_t index = findFree(hash);
+        ::new (static_cast<void*>(slots_ + index))
+            value_type(std::piecewise_construct, std::forward_as_tuple(key), std::forward_as_tuple(std::forward<Args>(args)...));
+        if (ctrl_[index] == Empty) {
+            --growthLeft_;
+        }
+        setCtrl(index, h2(hash));
+        ++size_;
+        return index;
+    }
+
+    // Copy construction only: the key is known to be absent.
+    void insertUnique(StringHandle key, const V& value) {
+        insertNew(key, hashOf(key), value);
+    }
+
+    void eraseAt(size_t index) {
+        slots_[index].~value_type();
+        --size_;
+        // If every sixteen-byte window covering the slot also holds an empty
+        // byte, no probe can ever have passed over it and it may go back to
+        // empty; otherwise it must stay a tombstone.
+        const size_t before = (index - GroupWidth) & (capacity_ - 1);
+        const std::uint32_t emptyAfter = Group(ctrl_ + index).matchEmpty();
+        const std::uint32_t emptyBefore = Group(ctrl_ + before).matchEmpty();
+        const bool neverFull = emptyAfter && emptyBefore &&
+                               lowestBit(emptyAfter) + (GroupWidth - 1 - highestBit(emptyBefore)) < GroupWidth;
+        if (neverFull) {
+            setCtrl(index, Empty);
+            ++growthLeft_;
+        } else {
+            setCtrl(index, Deleted);
+        }
+    }
+
+    void rehash(size_t capacity) {
+        std::int8_t* oldCtrl = ctrl_;
+        value_type* oldSlots = slots_;
+        const size_t oldCapacity = capacity_;
+
+        ctrl_ = static_cast<std::int8_t*>(::operator new(capacity + GroupWidth));
+        std::memset(ctrl_, Empty, capacity + GroupWidth);
+        slots_ = std::allocator<value_type>().allocate(capacity);
+        capacity_ = capacity;
+        growthLeft_ = maxLoad(capacity) - size_;
+
+        for (size_t i = 0; i < oldCapacity; ++i) {
+            if (oldCtrl[i] >= 0) {
+                const std::uint64_t hash = hashOf(oldSlots[i].first);
+                const size_t index = findFree(hash);
+                ::new (static_cast<void*>(slots_ + index)) value_type(std::move(oldSlots[i]));
+                oldSlots[i].~value_type();
+                setCtrl(index, h2(hash));
+            }
+        }
+        if (oldCtrl) {
+            ::operator delete(oldCtrl);
+            std::allocator<value_type>().deallocate(oldSlots, oldCapacity);
+        }
+    }
+
+    void destroyAll() {
+        for (size_t i = 0; i < capacity_ && size_ != 0; ++i) {
+            if (ctrl_[i] >= 0) {
+                slots_[i].~value_type();
+            }
+        }
+    }
+
+    void release() {
+        if (ctrl_) {
+            ::operator delete(ctrl_);
+            std::allocator<value_type>().deallocate(slots_, capacity_);
+        }
+        ctrl_ = nullptr;
+        slots_ = nullptr;
+        capacity_ = 0;
+    }
+
+    std::int8_t* ctrl_ = nullptr;
+    value_type* slots_ = nullptr;
+    size_t capacity_ = 0;
+    size_t size_ = 0;
+    size_t growthLeft_ = 0;
+};
+
+#endif // STRING_REF_MAP_H
@@ -0,0 +1,270 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include "Queue.h"
+#include "Topology.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Counts outstanding tasks so a caller can join on a group of them without
+// futures. ThreadPool::wait() runs queued tasks while it waits, which is what
+// makes nested parallel_for safe on worker threads.
+class WaitGroup {
+public:
+    void add(size_t n = 1) { count.fetch_add(n, std::memory_order_relaxed); }
+    void done() { count.fetch_sub(1, std::memory_order_acq_rel); }
+    bool idle() const { return count.load(std::memory_order_acquire) == 0; }
+
+private:
+    std::atomic<size_t> count{0};
+};
+
+// Work-stealing pool. Each worker owns a WorkStealingDeque and runs its own
+// tasks LIFO; idle workers take from the shared MPMC injection queue (where
+// submissions from outside the pool land) and then steal from random victims.
+// Workers that find nothing park on a condition variable, and submitters only
+// touch the mutex when somebody is actually parked.
+//
+// Tasks must not throw.
+class ThreadPool {
+public:
+    explicit ThreadPool(size_t threads = std::thread::hardware_concurrency())
+        : ThreadPool(threads, std::vector<int>()) {}
+
+    // Pins worker i to cpus[i % cpus.size()], e.g. one LLC group from
+    // CpuTopology so stolen tasks stay in a shared cache. An empty list
+    // leaves the workers unpinned.
+    ThreadPool(size_t threads, std::vector<int> cpus) {
+        if (threads == 0) {
+            threads = 1;
+        }
+        for (size_t i = 0; i < threads; ++i) {
+            workers.emplace_back(new Worker());
+        }
+        for (size_t i = 0; i < threads; ++i) {
+            workers[i]->thread = std::thread([this, i] { workerLoop(i); });
+            if (!cpus.empty()) {
+                pin_thread(workers[i]->thread, cpus[i % cpus.size()]);
+            }
+        }
+    }
+
+    // Runs every task still queued, then joins the workers.
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(sleepMutex);
+            stopping.store(true, std::memory_order_seq_cst);
+        }
+        sleepCondition.notify_all();
+        for (auto& worker : workers) {
+            worker->thread.join();
+        }
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    template<typename F>
+    void submit(F&& fn) {
+        push(new Task{std::function<void()>(std::forward<F>(fn)), nullptr});
+    }
+
+    template<typename F>
+    void submit(WaitGroup& group, F&& fn) {
+        group.add();
+        push(new Task{std::function<void()>(std::forward<F>(fn)), &group});
+    }
+
+    // Runs queued tasks on the calling thread until every task in group has
+    // finished.
+    void wait(WaitGroup& group) {
+        const size_t self = currentWorker();
+        while (!group.idle()) {
+            if (!runOne(self)) {
+                std::this_thread::yield();
+            }
+        }
+    }
+
+    // Calls body(i) for every i in [first, last). The range is halved
+    // recursively into tasks until pieces are at most grain long, so idle
+    // workers steal large pieces and the owner keeps the hot half.
+    template<typename F>
+    void parallel_for(size_t first, size_t last, F&& body, size_t grain = 1) {
+        if (first >= last) {
+            return;
+        }
+        WaitGroup group;
+        split(group, first, last, grain == 0 ? 1 : grain, body);
+        wait(group);
+    }
+
+    size_t size() const {
+        return workers.size();
+    }
+
+private:
+    struct Task {
+        std::function<void()> fn;
+        WaitGroup* group;
+    };
+
+    struct Worker {
+        WorkStealingDeque<Task*> tasks;
+        std::thread thread;
+    };
+
+    static constexpr size_t NoWorker = static_cast<size_t>(-1);
+    static constexpr size_t InjectionCapacity = 4096;
+
+    struct ThreadContext {
+        const ThreadPool* pool = nullptr;
+        size_t index = NoWorker;
+        std::uint64_t seed = 0x9e3779b97f4a7c15ull;
+    };
+
+    static ThreadContext& context() {
+        static thread_local ThreadContext ctx;
+        return ctx;
+    }
+
+    size_t currentWorker() const {
+        const ThreadContext& ctx = context();
+        return ctx.pool == this ? ctx.index : NoWorker;
+    }
+
+    template<typename F>
+    void split(WaitGroup& group, size_t first, size_t last, size_t grain, F& body) {
+        while (last - first > grain) {
+            const size_t middle = first + (last - first) / 2;
+            submit(group, [this, &group, middle, last, grain, &body] {
+                split(group, middle, last, grain, body);
+            });
+            last = middle;
+        }
+        for (size_t i = first; i < last; ++i) {
+            body(i);
+        }
+    }
+
+    void push(Task* task) {
+        const size_t self = currentWorker();
+        if (self != NoWorker) {
+            workers[self]->tasks.push(task);
+        } else {
+            while (!injection.enqueue(task)) {
+                if (!runOne(NoWorker)) {
+                    std::this_thread::yield();
+                }
+            }
+        }
+        // Pairs with the fence in park(): either the parked worker sees the
+        // task, or we see it parked.
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (sleepers.load(std::memory_order_relaxed) != 0) {
+            std::lock_guard<std::mutex> lock(sleepMutex);
+            sleepCondition.notify_one();
+        }
+    }
+
+    Task* find(size_t self) {
+        Task* task = nullptr;
+        if (self != NoWorker && workers[self]->tasks.pop(task)) {
+            return task;
+        }
+        if (injection.dequeue(task)) {
+            return task;
+        }
+        const size_t count = workers.size();
+        const size_t start = static_cast<size_t>(nextRandom() % count);
+        for (size_t i = 0; i < count; ++i) {
+            const size_t victim = (start + i) % count;
+            if (victim != self && workers[victim]->tasks.steal(task)) {
+                return task;
+            }
+        }
+        return nullptr;
+    }
+
+    bool runOne(size_t self) {
+        Task* task = find(self);
+        if (task == nullptr) {
+            return false;
+        }
+        task->fn();
+        if (task->group != nullptr) {
+            task->group->done();
+        }
+        delete task;
+        return true;
+    }
+
+    bool hasWork() const {
+        if (!injection.empty()) {
+            return true;
+        }
+        for (const auto& worker : workers) {
+            if (!worker->tasks.empty()) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void park() {
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        sleepers.fetch_add(1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (!hasWork() && !stopping.load(std::memory_order_relaxed)) {
+            sleepCondition.wait(lock);
+        }
+        sleepers.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    void workerLoop(size_t index) {
+        ThreadContext& ctx = context();
+        ctx.pool = this;
+        ctx.index = index;
+        ctx.seed += index;
+        const int spins = 64;
+        while (true) {
+            bool ran = false;
+            for (int i = 0; i < spins && !ran; ++i) {
+                ran = runOne(index);
+            }
+            if (ran) {
+                continue;
+            }
+            if (stopping.load(std::memory_order_acquire) && !hasWork()) {
+                return;
+            }
+            park();
+        }
+    }
+
+    // xorshift64; only used to pick steal victims.
+    static std::uint64_t nextRandom() {
+        std::uint64_t& x = context().seed;
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+        return x;
+    }
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    MPMCQueue<Task*, InjectionCapacity> injection;
+
+    std::mutex sleepMutex;
+    std::condition_variable sleepCondition;
+    std::atomic<size_t> sleepers{0};
+    std::atomic<bool> stopping{false};
+};
+
+#endif // THREAD_POOL_H
@@ -0,0 +1,131 @@
+#ifndef THREAD_RINGS_H
+#define THREAD_RINGS_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+// The per-thread rings of a process-wide recorder (Tracer, AsyncLogger):
+// each thread gets a ring of its own on first use and writes it without a
+// lock; the draining thread reads every ring and frees those whose thread
+// has exited once they are empty.
+
+namespace detail {
+
+// What a ring carries besides its records.
+struct ThreadRing {
+    explicit ThreadRing(std::uint32_t thread) : thread(thread) {}
+
+    // Threads are numbered from 1 in the order they registered.
+    const std::uint32_t thread;
+    std::atomic<std::uint64_t> dropped{0};
+    // Set when the thread exits; the drainer frees the ring once empty.
+    std::atomic<bool> finished{false};
+
+    // Counts a record lost to a full ring. Only the ring's thread calls
+    // this, so it needs no locked instruction.
+    void drop() {
+        dropped.store(dropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+};
+
+// The rings of one recorder, which must never be destroyed, so threads may
+// record during static destruction. The thread-locals are per Ring type,
+// so each recorder needs a Ring type of its own, derived from ThreadRing.
+// The recorder's mutex guards the list; the calling thread's own ring is
+// reached without it.
+template<typename Ring>
+class ThreadRings {
+public:
+    // The calling thread's ring, registering it first with a ring from
+    // make(thread) under mutex. nullptr when called from a thread-local
+    // destructor after the thread let go of its ring.
+    template<typename Make>
+    Ring* local(std::mutex& mutex, Make&& make) {
+        Ring* ring = current();
+        if (ring != nullptr) {
+            return ring;
+        }
+        Owner& owner = owned();
+        if (owner.exited) {
+            return nullptr;
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        std::unique_ptr<Ring> made(make(++threads_));
+        rings_.push_back(std::move(made));
+        owner.ring = rings_.back().get();
+        current() = owner.ring;
+        return owner.ring;
+    }
+
+    // Whether the thread of each ring had exited. Taken before a drain, so
+    // that reap() only frees rings drained after their last record.
+    std::vector<bool> finished() const {
+        std::vector<bool> result(rings_.size());
+        for (size_t i = 0; i < rings_.size(); ++i) {
+            result[i] = rings_[i]->finished.load(std::memory_order_acquire);
+        }
+        return result;
+    }
+
+    // Frees the rings finished when the flags were taken for which
+    // drained(ring) holds; returns the drops they counted.
+    template<typename Drained>
+    std::uint64_t reap(const std::vector<bool>& finished, Drained&& drained) {
+        std::uint64_t dropped = 0;
+        for (size_t i = finished.size(); i-- > 0;) {
+            if (finished[i] && drained(*rings_[i])) {
+                dropped += rings_[i]->dropped.load(std::memory_order_relaxed);
+                rings_.erase(rings_.begin() + static_cast<std::ptrdiff_t>(i));
+            }
+        }
+        return dropped;
+    }
+
+    size_t size() const {
+        return rings_.size();
+    }
+
+    typename std::vector<std::unique_ptr<Ring>>::const_iterator begin() const {
+        return rings_.begin();
+    }
+
+    typename std::vector<std::unique_ptr<Ring>>::const_iterator end() const {
+        return rings_.end();
+    }
+
+private:
+    // Trivially initialised, so the fast path needs no guard check.
+    static Ring*& current() {
+        static thread_local Ring* ring = nullptr;
+        return ring;
+    }
+
+    struct Owner {
+        ~Owner() {
+            current() = nullptr;
+            exited = true;
+            if (ring != nullptr) {
+                ring->finished.store(true, std::memory_order_release);
+            }
+        }
+        Ring* ring = nullptr;
+        bool exited = false;
+    };
+
+    static Owner& owned() {
+        static thread_local Owner owner;
+        return owner;
+    }
+
+    std::vector<std::unique_ptr<Ring>> rings_;
+    std::uint32_t threads_ = 0;
+};
+
+} // namespace detail
+
+#endif // THREAD_RINGS_H
@@ -0,0 +1,290 @@
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+#include "Queue.h"
+
+#include <chrono>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+// Identifies a scheduled timer; stays safe to cancel after the timer fired
+// or was cancelled (cancel() then returns false).
+using TimerId = std::uint64_t;
+
+// Hierarchical timing wheel (Varghese and Lauck) with O(1) schedule and
+// cancel. Eight levels of 256 slots cover the whole 64-bit tick range: a
+// timer sits in the level of the highest 8-bit group in which its expiry
+// differs from the current tick, and is cascaded one level down each time the
+// wheel reaches its slot. Timers are nodes in one pooled vector linked by
+// index, so scheduling millions of mostly-cancelled timeouts allocates only
+// when the pool grows.
+//
+// Not thread-safe: one thread schedules, cancels and advances. Expired
+// payloads can be handed to another thread in batches through an SPSCQueue.
+template<typename T>
+class TimerWheel {
+public:
+    using clock = std::chrono::steady_clock;
+
+    static constexpr unsigned LevelBits = 8;
+    static constexpr unsigned Levels = 64 / LevelBits;
+    static constexpr size_t SlotsPerLevel = size_t(1) << LevelBits;
+
+    explicit TimerWheel(clock::duration tick = std::chrono::milliseconds(1), size_t expectedTimers = 0)
+        : tick(tick), start(clock::now()) {
+        if (tick <= clock::duration::zero()) {
+            throw std::invalid_argument("TimerWheel tick must be positive.");
+        }
+        for (auto& list : slots) {
+            list = Slot{};
+        }
+        nodes.reserve(expectedTimers);
+    }
+
+    // Fires delay ticks from now; a delay of zero fires on the next tick.
+    TimerId schedule(std::uint64_t delay, T payload) {
+        const std::uint32_t index = allocate();
+        Node& node = nodes[index];
+        node.expiry = current + (delay == 0 ? 1 : delay);
+        node.payload.emplace(std::move(payload));
+        link(index);
+        ++active;
+        return (static_cast<TimerId>(node.generation) << 32) | index;
+    }
+
+    // Rounds up to whole ticks.
+    template<typename Rep, typename Period>
+    TimerId schedule_after(const std::chrono::duration<Rep, Period>& delay, T payload) {
+        const auto d = std::chrono::duration_cast<clock::duration>(delay);
+        const std::uint64_t ticks = d <= clock::duration::zero() ? 0 : static_cast<std::uint64_t>((d + tick - clock::duration(1)) / tick);
+        return schedule(ticks, std::move(payload));
+    }
+
+    bool cancel(TimerId id) {
+        const std::uint32_t index = static_cast<std::uint32_t>(id);
+        if (index >= nodes.size()) {
+            return false;
+        }
+        Node& node = nodes[index];
+        if (node.generation != static_cast<std::uint32_t>(id >> 32) || !node.payload) {
+            return false;
+        }
+        unlink(index);
+        release(index);
+        --active;
+        return true;
+    }
+
+    // Moves the wheel forward by ticks, calling sink(T&&) for every timer
+    // that expires, in expiry order between ticks. Returns how many fired.
+    template<typename Sink>
+    size_t advance(std::uint64_t ticks, Sink&& sink) {
+        size_t fired = 0;
+        for (std::uint64_t i = 0; i < ticks; ++i) {
+            if (active == 0) {
+                // Nothing can expire, so skip the remaining slot visits.
+                current += ticks - i;
+                break;
+            }
+            ++current;
+            cascade();
+            fired += expire(sink);
+        }
+        return fired;
+    }
+
+    // Delivers expired payloads into out with enqueue_bulk. Payloads that do
+    // not fit stay in a backlog that is delivered first on the next call;
+    // returns how many were delivered this time.
+    template<size_t Capacity, typename Traits>
+    size_t advance(std::uint64_t ticks, SPSCQueue<T, Capacity, Traits>& out) {
+        advance(ticks, [this](T&& payload) { backlog.push_back(std::move(payload)); });
+        return flush(out);
+    }
+
+    // Clock-driven variants: advance to the tick that contains now.
+    template<typename Sink>
+    size_t advance_to(clock::time_point now, Sink&& sink) {
+        return advance(ticksUntil(now), sink);
+    }
+
+    template<size_t Capacity, typename Traits>
+    size_t advance_to(clock::time_point now, SPSCQueue<T, Capacity, Traits>& out) {
+        advance(ticksUntil(now), [this](T&& payload) { backlog.push_back(std::move(payload)); });
+        return flush(out);
+    }
+
+    template<typename Sink>
+    size_t poll(Sink&& sink) {
+        return advance_to(clock::now(), sink);
+    }
+
+    // Ticks elapsed since construction, as far as the wheel has advanced.
+    std::uint64_t now() const {
+        return current;
+    }
+
+    // Scheduled timers not yet fired or cancelled.
+    size_t size() const {
+        return active;
+    }
+
+    // Expired payloads still waiting for room in the output queue.
+    size_t pending() const {
+        return backlog.size() - backlogHead;
+    }
+
+private:
+    static constexpr std::uint32_t Nil = std::numeric_limits<std::uint32_t>::max();
+
+    struct Node {
+        std::uint64_t expiry = 0;
+        std::uint32_t prev = Nil;
+        std::uint32_t next = Nil;
+        std::uint32_t generation = 0;
+        // Index into slots of the list holding the node.
+        std::uint32_t slot = 0;
+        // Empty while the node is on the free list.
+        std::optional<T> payload;
+    };
+
+    // Timers due in the same slot keep their scheduling order.
+    struct Slot {
+        std::uint32_t head = Nil;
+        std::uint32_t tail = Nil;
+    };
+
+    std::uint64_t ticksUntil(clock::time_point now) const {
+        if (now <= start) {
+            return 0;
+        }
+        const std::uint64_t target = static_cast<std::uint64_t>((now - start) / tick);
+        return target > current ? target - current : 0;
+    }
+
+    std::uint32_t allocate() {
+        if (freeList != Nil) {
+            const std::uint32_t index = freeList;
+            freeList = nodes[index].next;
+            return index;
+        }
+        if (nodes.size() >= Nil) {
+            throw std::length_error("TimerWheel is full.");
+        }
+        nodes.emplace_back();
+        return static_cast<std::uint32_t>(nodes.size() - 1);
+    }
+
+    void release(std::uint32_t index) {
+        Node& node = nodes[index];
+        node.payload.reset();
+        ++node.generation;
+        node.prev = Nil;
+        node.next = freeList;
+        freeList = index;
+    }
+
+    std::uint32_t slotOf(std::uint64_t expiry) const {
+        const std::uint64_t differing = expiry ^ current;
+        unsigned level = 0;
+        while (level + 1 < Levels && (differing >> (LevelBits * (level + 1))) != 0) {
+            ++level;
+        }
+        return static_cast<std::uint32_t>(level * SlotsPerLevel + ((expiry >> (LevelBits * level)) & (SlotsPerLevel - 1)));
+    }
+
+    void link(std::uint32_t index) {
+        Node& node = nodes[index];
+        node.slot = slotOf(node.expiry);
+        Slot& list = slots[node.slot];
+        node.prev = list.tail;
+        node.next = Nil;
+        if (list.tail != Nil) {
+            nodes[list.tail].next = index;
+        } else {
+            list.head = index;
+        }
+        list.tail = index;
+    }
+
+    void unlink(std::uint32_t index) {
+        Node& node = nodes[index];
+        Slot& list = slots[node.slot];
+        if (node.prev != Nil) {
+            nodes[node.prev].next = node.next;
+        } else {
+            list.head = node.next;
+        }
+        if (node.next != Nil) {
+            nodes[node.next].prev = node.prev;
+        } else {
+            list.tail = node.prev;
+        }
+    }
+
+    // On a tick whose low 8*l bits are all zero, the slot for that tick on
+    // level l comes due; re-file its timers relative to the new tick, from
+    // the top level down so nothing is re-filed into a slot already passed.
+    void cascade() {
+        unsigned top = 0;
+        while (top + 1 < Levels && (current & ((std::uint64_t(1) << (LevelBits * (top + 1))) - 1)) == 0) {
+            ++top;
+        }
+        for (unsigned level = top; level > 0; --level) {
+            Slot& list = slots[level * SlotsPerLevel + ((current >> (LevelBits * level)) & (SlotsPerLevel - 1))];
+            std::uint32_t index = list.head;
+            list = Slot{};
+            while (index != Nil) {
+                const std::uint32_t next = nodes[index].next;
+                link(index);
+                index = next;
+            }
+        }
+    }
+
+    template<typename Sink>
+    size_t expire(Sink& sink) {
+        // Unlinks one node at a time so the sink may cancel or schedule.
+        const std::uint32_t slot = static_cast<std::uint32_t>(current & (SlotsPerLevel - 1));
+        size_t fired = 0;
+        while (slots[slot].head != Nil) {
+            const std::uint32_t index = slots[slot].head;
+            unlink(index);
+            T payload = std::move(*nodes[index].payload);
+            release(index);
+            --active;
+            ++fired;
+            sink(std::move(payload));
+        }
+        return fired;
+    }
+
+    template<size_t Capacity, typename Traits>
+    size_t flush(SPSCQueue<T, Capacity, Traits>& out) {
+        const size_t n = out.enqueue_bulk(std::make_move_iterator(backlog.begin() + backlogHead), backlog.size() - backlogHead);
+        backlogHead += n;
+        if (backlogHead == backlog.size()) {
+            backlog.clear();
+            backlogHead = 0;
+        }
+        return n;
+    }
+
+    clock::duration tick;
+    clock::time_point start;
+    std::uint64_t current = 0;
+    size_t active = 0;
+
+    std::vector<Node> nodes;
+    std::uint32_t freeList = Nil;
+    Slot slots[Levels * SlotsPerLevel];
+
+    std::vector<T> backlog;
+    size_t backlogHead = 0;
+};
+
+#endif // TIMER_WHEEL_H
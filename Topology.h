@@ -0,0 +1,282 @@
+#ifndef TOPOLOGY_H
+#define TOPOLOGY_H
+
+#include "SlotAllocator.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#if defined(__linux__)
+#include <dirent.h>
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+// One logical CPU. core, llc and node are dense ids (0, 1, ...) into
+// CpuTopology's groups, not the kernel's raw core_id, which repeats across
+// packages.
+struct CpuInfo {
+    int cpu = 0;
+    int core = 0;
+    int llc = 0;
+    int node = 0;
+    int package = 0;
+};
+
+// Which logical CPUs share a physical core (SMT siblings), a last-level
+// cache and a NUMA node, read once from /sys/devices/system/cpu. Where sysfs
+// is unavailable every CPU is reported as its own core in one LLC and node.
+//
+// Use it to place queue endpoints deliberately: an SPSC ring between SMT
+// siblings or within an LLC moves cache lines through a shared cache, while
+// across LLCs or sockets every transfer is a coherence miss.
+class CpuTopology {
+public:
+    static const CpuTopology& instance() {
+        static const CpuTopology topology = scan();
+        return topology;
+    }
+
+    // Reads the topology below root; instance() uses the real sysfs.
+    static CpuTopology scan(const std::string& root = "/sys/devices/system/cpu") {
+        CpuTopology topology;
+        std::vector<int> online = parseList(readFirstLine(root + "/online"));
+        if (online.empty()) {
+            for (unsigned i = 0; i < std::max(1u, std::thread::hardware_concurrency()); ++i) {
+                online.push_back(static_cast<int>(i));
+            }
+        }
+        std::map<std::pair<int, int>, int> cores;
+        std::map<int, int> llcs;
+        std::map<int, int> nodes;
+        for (const int cpu : online) {
+            const std::string dir = root + "/cpu" + std::to_string(cpu);
+            CpuInfo info;
+            info.cpu = cpu;
+            info.package = readInt(dir + "/topology/physical_package_id", 0);
+            const int coreId = readInt(dir + "/topology/core_id", cpu);
+            info.core = denseId(cores, {info.package, coreId});
+            info.llc = denseId(llcs, lastLevelCacheKey(dir, cpu));
+            info.node = denseId(nodes, nodeOf(dir));
+            topology.entries.push_back(info);
+        }
+        topology.coreGroups = group(topology.entries, &CpuInfo::core, cores.size());
+        topology.llcGroups = group(topology.entries, &CpuInfo::llc, llcs.size());
+        topology.nodeGroups = group(topology.entries, &CpuInfo::node, nodes.size());
+        topology.nodeIds.resize(nodes.size());
+        for (const auto& entry : nodes) {
+            topology.nodeIds[entry.second] = entry.first;
+        }
+        return topology;
+    }
+
+    const std::vector<CpuInfo>& cpus() const {
+        return entries;
+    }
+
+    // nullptr for CPUs that are offline or do not exist.
+    const CpuInfo* find(int cpu) const {
+        for (const CpuInfo& info : entries) {
+            if (info.cpu == cpu) {
+                return &info;
+            }
+        }
+        return nullptr;
+    }
+
+    // CPU lists per physical core, per last-level cache and per NUMA node.
+    const std::vector<std::vector<int>>& cores() const {
+        return coreGroups;
+    }
+
+    const std::vector<std::vector<int>>& llc_groups() const {
+        return llcGroups;
+    }
+
+    const std::vector<std::vector<int>>& nodes() const {
+        return nodeGroups;
+    }
+
+    // The logical CPUs on cpu's physical core, itself included.
+    const std::vector<int>& smt_siblings(int cpu) const {
+        return coreGroups[at(cpu).core];
+    }
+
+    const std::vector<int>& llc_group(int cpu) const {
+        return llcGroups[at(cpu).llc];
+    }
+
+    // The kernel's node number, as mbind() and MappedSlotAllocator expect.
+    int numa_node(int cpu) const {
+        return nodeIds[at(cpu).node];
+    }
+
+    bool shares_core(int a, int b) const {
+        return at(a).core == at(b).core;
+    }
+
+    bool shares_llc(int a, int b) const {
+        return at(a).llc == at(b).llc;
+    }
+
+    // Slot storage for a queue whose consumer runs on cpu: pages come from
+    // that CPU's NUMA node. Pass it to a queue whose Traits::allocator is
+    // MappedSlotAllocator.
+#if defined(__linux__)
+    MappedSlotAllocator allocator_near(int cpu, bool hugePages = true) const {
+        return MappedSlotAllocator(hugePages, nodeGroups.size() > 1 ? numa_node(cpu) : MappedSlotAllocator::AnyNode);
+    }
+#endif
+
+private:
+    const CpuInfo& at(int cpu) const {
+        const CpuInfo* info = find(cpu);
+        return info != nullptr ? *info : entries.front();
+    }
+
+    static std::string readFirstLine(const std::string& path) {
+        std::ifstream in(path);
+        std::string line;
+        std::getline(in, line);
+        return line;
+    }
+
+    static int readInt(const std::string& path, int fallback) {
+        const std::string line = readFirstLine(path);
+        return line.empty() ? fallback : std::atoi(line.c_str());
+    }
+
+    // Parses the kernel's CPU list format, e.g. "0-3,8,10-11".
+    static std::vector<int> parseList(const std::string& list) {
+        std::vector<int> cpus;
+        const char* p = list.c_str();
+        while (*p >= '0' && *p <= '9') {
+            char* end = nullptr;
+            const int first = static_cast<int>(std::strtol(p, &end, 10));
+            int last = first;
+            if (*end == '-') {
+                last = static_cast<int>(std::strtol(end + 1, &end, 10));
+            }
+            for (int cpu = first; cpu <= last; ++cpu) {
+                cpus.push_back(cpu);
+            }
+            p = *end == ',' ? end + 1 : end;
+        }
+        return cpus;
+    }
+
+    // The cache with the highest level that holds data, identified by the
+    // lowest CPU sharing it.
+    static int lastLevelCacheKey(const std::string& cpuDir, int cpu) {
+        int bestLevel = -1;
+        int key = cpu;
+        for (int index = 0;; ++index) {
+            const std::string dir = cpuDir + "/cache/index" + std::to_string(index);
+            const std::string type = readFirstLine(dir + "/type");
+            if (type.empty()) {
+                break;
+            }
+            const int level = readInt(dir + "/level", 0);
+            if (type == "Instruction" || level <= bestLevel) {
+                continue;
+            }
+            const std::vector<int> shared = parseList(readFirstLine(dir + "/shared_cpu_list"));
+            bestLevel = level;
+            key = shared.empty() ? cpu : shared.front();
+        }
+        return key;
+    }
+
+    // sysfs links cpuN/nodeM for the node that owns the CPU.
+    static int nodeOf(const std::string& cpuDir) {
+        int node = 0;
+#if defined(__linux__)
+        if (DIR* dir = opendir(cpuDir.c_str())) {
+            while (dirent* entry = readdir(dir)) {
+                const std::string name = entry->d_name;
+                if (name.size() > 4 && name.compare(0, 4, "node") == 0 && name[4] >= '0' && name[4] <= '9') {
+                    node = std::atoi(name.c_str() + 4);
+                    break;
+                }
+            }
+            closedir(dir);
+        }
+#else
+        (void)cpuDir;
+#endif
+        return node;
+    }
+
+    template<typename Key>
+    static int denseId(std::map<Key, int>& ids, const Key& key) {
+        return ids.emplace(key, static_cast<int>(ids.size())).first->second;
+    }
+
+    static std::vector<std::vector<int>> group(const std::vector<CpuInfo>& entries, int CpuInfo::*member, size_t count) {
+        std::vector<std::vector<int>> groups(count);
+        for (const CpuInfo& info : entries) {
+            groups[info.*member].push_back(info.cpu);
+        }
+        return groups;
+    }
+
+    std::vector<CpuInfo> entries;
+    std::vector<std::vector<int>> coreGroups;
+    std::vector<std::vector<int>> llcGroups;
+    std::vector<std::vector<int>> nodeGroups;
+    std::vector<int> nodeIds;
+};
+
+#if defined(__linux__)
+inline bool pin_native_thread(pthread_t thread, const std::vector<int>& cpus) {
+    if (cpus.empty()) {
+        return false;
+    }
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (const int cpu : cpus) {
+        if (cpu < 0 || cpu >= CPU_SETSIZE) {
+            return false;
+        }
+        CPU_SET(cpu, &set);
+    }
+    return pthread_setaffinity_np(thread, sizeof(set), &set) == 0;
+}
+#endif
+
+// Restricts a thread to cpus. Returns false if the kernel refused (an
+// offline CPU, a cpuset that excludes it) or pinning is unsupported here.
+inline bool pin_thread(std::thread& thread, const std::vector<int>& cpus) {
+#if defined(__linux__)
+    return pin_native_thread(thread.native_handle(), cpus);
+#else
+    (void)thread;
+    (void)cpus;
+    return false;
+#endif
+}
+
+inline bool pin_thread(std::thread& thread, int cpu) {
+    return pin_thread(thread, std::vector<int>{cpu});
+}
+
+inline bool pin_current_thread(const std::vector<int>& cpus) {
+#if defined(__linux__)
+    return pin_native_thread(pthread_self(), cpus);
+#else
+    (void)cpus;
+    return false;
+#endif
+}
+
+inline bool pin_current_thread(int cpu) {
+    return pin_current_thread(std::vector<int>{cpu});
+}
+
+#endif // TOPOLOGY_H
@@ -0,0 +1,400 @@
+#ifndef TRACER_H
+#define TRACER_H
+
+#include "LatencyHistogram.h"
+#include "Queue.h"
+#include "StringIntern.h"
+#include "ThreadRings.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <istream>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// In-process event tracer. Each thread that records gets an SPSCQueue of
+// (TSC ticks, event id, arg) records of its own, so recording is a TSC read
+// and a ring enqueue with no lock and no shared cache line. Event names are
+// StringPool symbols: a record carries the 4-byte symbol id and no
+// characters are copied, and the CPPUTILS_TRACE_* macros intern each name
+// once per use site.
+//
+// start() begins a session and a collector thread that drains the rings
+// every drain period; stop() ends it, and capture() hands over what was
+// collected, to be written as Chrome / Perfetto trace JSON (load it in
+// ui.perfetto.dev or chrome://tracing) or in a compact binary form. A ring
+// that is full drops the record and counts it rather than stall the thread
+// being traced.
+//
+// Build with -DCPPUTILS_TRACING=0 to compile the macros out altogether:
+// their arguments are then not evaluated either.
+
+#ifndef CPPUTILS_TRACING
+#define CPPUTILS_TRACING 1
+#endif
+
+enum class TracePhase : std::uint32_t {
+    Instant,
+    Begin,
+    End,
+    Counter
+};
+
+// One record as a thread's ring holds it.
+struct TraceRecord {
+    std::uint64_t ticks;
+    std::uint32_t event;
+    TracePhase phase;
+    std::uint64_t arg;
+};
+
+struct TraceEvent {
+    std::uint64_t ticks;
+    // Threads are numbered from 1 in the order they first recorded.
+    std::uint32_t thread;
+    std::uint32_t event;
+    TracePhase phase;
+    std::uint64_t arg;
+};
+
+// A finished session: events in time order and the names they refer to.
+struct Trace {
+    std::vector<TraceEvent> events;
+    std::unordered_map<std::uint32_t, std::string> names;
+    double ticksPerNanosecond = 1.0;
+    // Records lost to full rings.
+    std::uint64_t dropped = 0;
+
+    std::string_view name(std::uint32_t event) const {
+        const auto it = names.find(event);
+        return it == names.end() ? std::string_view() : std::string_view(it->second);
+    }
+
+    // Nanoseconds since the first event.
+    double nanoseconds(const TraceEvent& event) const {
+        return events.empty() ? 0.0 : static_cast<double>(event.ticks - events.front().ticks) / ticksPerNanosecond;
+    }
+
+    // Chrome trace event format, one event per line.
+    void writeChromeJson(std::ostream& out) const {
+        out << "{\"displayTimeUnit\":\"ns\",\"otherData\":{\"dropped\":" << dropped << "},\"traceEvents\":[";
+        static const char* const phases[] = {"i", "B", "E", "C"};
+        bool first = true;
+        for (const TraceEvent& event : events) {
+            char timestamp[32];
+            std::snprintf(timestamp, sizeof(timestamp), "%.3f", nanoseconds(event) / 1000.0);
+            out << (first ? "\n" : ",\n") << "{\"name\":";
+            writeJsonString(out, name(event.event));
+            out << ",\"ph\":\"" << phases[static_cast<std::uint32_t>(event.phase)] << "\",\"ts\":" << timestamp
+                << ",\"pid\":1,\"tid\":" << event.thread;
+            if (event.phase == TracePhase::Instant) {
+                out << ",\"s\":\"t\"";
+            }
+            if (event.phase == TracePhase::Counter) {
+                out << ",\"args\":{\"value\":" << event.arg << "}";
+            } else if (event.phase != TracePhase::End) {
+                out << ",\"args\":{\"arg\":" << event.arg << "}";
+            }
+            out << "}";
+            first = false;
+        }
+        out << "\n]}\n";
+    }
+
+    // Native byte order: "CPTRACE1", ticks per ns, dropped, the names
+    // (count, then id, length, bytes each) and the events (count, then the
+    // fields of each in declaration order).
+    void writeBinary(std::ostream& out) const {
+        out.write(Magic, sizeof(Magic));
+        put(out, ticksPerNanosecond);
+        put(out, dropped);
+        put(out, static_cast<std::uint32_t>(names.size()));
+        for (const auto& entry : names) {
+            put(out, entry.first);
+            put(out, static_cast<std::uint32_t>(entry.second.size()));
+            out.write(entry.second.data(), static_cast<std::streamsize>(entry.second.size()));
+        }
+        put(out, static_cast<std::uint64_t>(events.size()));
+        for (const TraceEvent& event : events) {
+            put(out, event.ticks);
+            put(out, event.thread);
+            put(out, event.event);
+            put(out, static_cast<std::uint32_t>(event.phase));
+            put(out, event.arg);
+        }
+    }
+
+    // False, leaving this unchanged, if in does not hold a writeBinary() trace.
+    bool readBinary(std::istream& in) {
+        char magic[sizeof(Magic)];
+        Trace read;
+        std::uint32_t nameCount = 0;
+        if (!in.read(magic, sizeof(magic)) || std::memcmp(magic, Magic, sizeof(Magic)) != 0 ||
+            !get(in, read.ticksPerNanosecond) || !get(in, read.dropped) || !get(in, nameCount)) {
+            return false;
+        }
+        for (std::uint32_t i = 0; i < nameCount; ++i) {
+            std::uint32_t id = 0;
+            std::uint32_t length = 0;
+            if (!get(in, id) || !get(in, length)) {
+                return false;
+            }
+            std::string text(length, '\0');
+            if (!in.read(&text[0], length)) {
+                return false;
+            }
+            read.names.emplace(id, std::move(text));
+        }
+        std::uint64_t eventCount = 0;
+        if (!get(in, eventCount)) {
+            return false;
+        }
+        for (std::uint64_t i = 0; i < eventCount; ++i) {
+            TraceEvent event;
+            std::uint32_t phase = 0;
+            if (!get(in, event.ticks) || !get(in, event.thread) || !get(in, event.event) || !get(in, phase) ||
+                !get(in, event.arg) || phase > static_cast<std::uint32_t>(TracePhase::Counter)) {
+                return false;
+            }
+            event.phase = static_cast<TracePhase>(phase);
+            read.events.push_back(event);
+        }
+        *this = std::move(read);
+        return true;
+    }
+
+private:
+    static constexpr char Magic[8] = {'C', 'P', 'T', 'R', 'A', 'C', 'E', '1'};
+
+    template<typename V>
+    static void put(std::ostream& out, const V& value) {
+        out.write(reinterpret_cast<const char*>(&value), sizeof(value));
+    }
+
+    template<typename V>
+    static bool get(std::istream& in, V& value) {
+        return static_cast<bool>(in.read(reinterpret_cast<char*>(&value), sizeof(value)));
+    }
+
+    static void writeJsonString(std::ostream& out, std::string_view text) {
+        out << '"';
+        for (const char c : text) {
+            if (c == '"' || c == '\\') {
+                out << '\\' << c;
+            } else if (static_cast<unsigned char>(c) < 0x20) {
+                char escaped[8];
+                std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+                out << escaped;
+            } else {
+                out << c;
+            }
+        }
+        out << '"';
+    }
+};
+
+// The process-wide tracer. record() is safe from any thread; start(),
+// stop() and capture() are for one controlling thread.
+class Tracer {
+public:
+    static constexpr size_t DefaultRingCapacity = size_t(1) << 14;
+
+    // Never destroyed, so threads may record during static destruction.
+    static Tracer& instance() {
+        static Tracer* const tracer = new Tracer();
+        return *tracer;
+    }
+
+    // Event ids are symbol ids in the process-wide StringPool.
+    static std::uint32_t eventId(std::string_view name) {
+        return StringPool::instance().symbolId(name);
+    }
+
+    static std::uint32_t eventId(const char* name) {
+        return eventId(std::string_view(name));
+    }
+
+    static std::uint32_t eventId(const StringRef& name) {
+        return eventId(name.view());
+    }
+
+    bool enabled() const {
+        return enabled_.load(std::memory_order_relaxed);
+    }
+
+    void record(std::uint32_t event, TracePhase phase, std::uint64_t arg = 0) {
+        if (!enabled()) {
+            return;
+        }
+        Ring* ring = rings_.local(mutex_, [this](std::uint32_t thread) { return new Ring(ringCapacity_, thread); });
+        if (ring == nullptr) {
+            // Recording from a thread-local destructor after ours ran.
+            return;
+        }
+        if (!ring->records.enqueue(TraceRecord{TscClock::ticks(), event, phase, arg})) {
+            ring->drop();
+        }
+    }
+
+    // Starts a session, dropping whatever an earlier one left uncaptured.
+    // Threads that have not recorded yet get rings of ringCapacity records,
+    // which must be a power of two.
+    void start(std::chrono::milliseconds drainPeriod = std::chrono::milliseconds(1),
+               size_t ringCapacity = DefaultRingCapacity) {
+        checkCapacity(ringCapacity, DynamicCapacity);
+        stop();
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            collected_.clear();
+            dropped_ = 0;
+            TraceRecord discard[256];
+            for (const auto& ring : rings_) {
+                while (ring->records.dequeue_bulk(discard, 256) != 0) {
+                }
+                ring->dropped.store(0, std::memory_order_relaxed);
+            }
+            ringCapacity_ = ringCapacity;
+            stopping_ = false;
+        }
+        enabled_.store(true, std::memory_order_release);
+        collector_ = std::thread([this, drainPeriod] { collect(drainPeriod); });
+    }
+
+    // Ends the session once everything recorded so far is collected.
+    void stop() {
+        enabled_.store(false, std::memory_order_release);
+        if (collector_.joinable()) {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                stopping_ = true;
+            }
+            wake_.notify_one();
+            collector_.join();
+        }
+    }
+
+    // Stops the session and takes what it collected.
+    Trace capture() {
+        stop();
+        Trace trace;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            drainLocked();
+            trace.events.swap(collected_);
+            trace.dropped = dropped_;
+        }
+        // Rings are in order on their own; merge them.
+        std::stable_sort(trace.events.begin(), trace.events.end(),
+                         [](const TraceEvent& a, const TraceEvent& b) { return a.ticks < b.ticks; });
+        StringPool& pool = StringPool::instance();
+        for (const TraceEvent& event : trace.events) {
+            if (trace.names.find(event.event) == trace.names.end()) {
+                trace.names.emplace(event.event, std::string(pool.symbolView(event.event)));
+            }
+        }
+        trace.ticksPerNanosecond = TscClock::ticks_per_nanosecond();
+        return trace;
+    }
+
+private:
+    struct Ring : detail::ThreadRing {
+        Ring(size_t capacity, std::uint32_t thread) : ThreadRing(thread), records(capacity) {}
+
+        SPSCQueue<TraceRecord> records;
+    };
+
+    void collect(std::chrono::milliseconds period) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (!stopping_) {
+            wake_.wait_for(lock, period);
+            drainLocked();
+        }
+        drainLocked();
+    }
+
+    void drainLocked() {
+        TraceRecord batch[256];
+        const std::vector<bool> finished = rings_.finished();
+        for (const auto& ring : rings_) {
+            size_t count;
+            while ((count = ring->records.dequeue_bulk(batch, 256)) != 0) {
+                for (size_t j = 0; j < count; ++j) {
+                    collected_.push_back(TraceEvent{batch[j].ticks, ring->thread, batch[j].event, batch[j].phase, batch[j].arg});
+                }
+            }
+        }
+        dropped_ += rings_.reap(finished, [](const Ring&) { return true; });
+        if (!enabled()) {
+            // The session is over; count the drops of rings still alive.
+            for (const auto& ring : rings_) {
+                dropped_ += ring->dropped.exchange(0, std::memory_order_relaxed);
+            }
+        }
+    }
+
+    Tracer() = default;
+
+    std::atomic<bool> enabled_{false};
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    bool stopping_ = false;
+    std::thread collector_;
+    detail::ThreadRings<Ring> rings_;
+    std::vector<TraceEvent> collected_;
+    std::uint64_t dropped_ = 0;
+    size_t ringCapacity_ = DefaultRingCapacity;
+};
+
+// Records Begin on construction and End on destruction.
+class TraceScope {
+public:
+    explicit TraceScope(std::uint32_t event, std::uint64_t arg = 0) : event_(event) {
+        Tracer::instance().record(event, TracePhase::Begin, arg);
+    }
+
+    ~TraceScope() {
+        Tracer::instance().record(event_, TracePhase::End);
+    }
+
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+
+private:
+    std::uint32_t event_;
+};
+
+#if CPPUTILS_TRACING
+// The event id of a literal name, interned the first time the use site runs.
+#define CPPUTILS_TRACE_ID(name)                                           \
+    ([]() -> std::uint32_t {                                              \
+        static const std::uint32_t cpputils_event = Tracer::eventId(name); \
+        return cpputils_event;                                            \
+    }())
+#define CPPUTILS_TRACE_CONCAT_(a, b) a##b
+#define CPPUTILS_TRACE_CONCAT(a, b) CPPUTILS_TRACE_CONCAT_(a, b)
+
+#define CPPUTILS_TRACE_INSTANT(name, arg) Tracer::instance().record(CPPUTILS_TRACE_ID(name), TracePhase::Instant, (arg))
+#define CPPUTILS_TRACE_BEGIN(name, arg) Tracer::instance().record(CPPUTILS_TRACE_ID(name), TracePhase::Begin, (arg))
+#define CPPUTILS_TRACE_END(name) Tracer::instance().record(CPPUTILS_TRACE_ID(name), TracePhase::End)
+#define CPPUTILS_TRACE_COUNTER(name, value) Tracer::instance().record(CPPUTILS_TRACE_ID(name), TracePhase::Counter, (value))
+#define CPPUTILS_TRACE_SCOPE(name) TraceScope CPPUTILS_TRACE_CONCAT(cpputils_trace_scope_, __LINE__)(CPPUTILS_TRACE_ID(name))
+#else
+#define CPPUTILS_TRACE_INSTANT(name, arg) static_cast<void>(0)
+#define CPPUTILS_TRACE_BEGIN(name, arg) static_cast<void>(0)
+#define CPPUTILS_TRACE_END(name) static_cast<void>(0)
+#define CPPUTILS_TRACE_COUNTER(name, value) static_cast<void>(0)
+#define CPPUTILS_TRACE_SCOPE(name) static_cast<void>(0)
+#endif
+
+#endif // TRACER_H
@@ -0,0 +1,379 @@
+#ifndef UNBOUNDED_QUEUE_H
+#define UNBOUNDED_QUEUE_H
+
+#include "Queue.h"
+
+#include <atomic>
+#include <cstddef>
+#include <new>
+#include <optional>
+#include <utility>
+#include <vector>
+
+// Unbounded queues made of linked fixed-size segments. A full segment never
+// stalls the producer: it links a fresh one (recycled from a small free list
+// when the consumer has drained one, allocated otherwise) and carries on.
+// Within a segment the fast path is the same as SPSCQueue: construct in
+// place, then one store-release.
+
+// Single-producer/single-consumer. The consumer hands drained segments back
+// to the producer over an SPSCQueue, so steady-state operation allocates
+// nothing.
+template<typename T, size_t SegmentSize = 512>
+class UnboundedSPSCQueue {
+    static_assert(SegmentSize > 0, "SegmentSize must be positive.");
+
+public:
+    static constexpr size_t FreeListSize = 8;
+
+    UnboundedSPSCQueue() {
+        headSegment = tailSegment = new Segment();
+    }
+
+    ~UnboundedSPSCQueue() {
+        Segment* segment = headSegment;
+        size_t index = headIndex;
+        while (segment != nullptr) {
+            const size_t committed = segment->committed.load(std::memory_order_relaxed);
+            for (; index < committed; ++index) {
+                segment->slot(index)->~T();
+            }
+            Segment* next = segment->next.load(std::memory_order_relaxed);
+            delete segment;
+            segment = next;
+            index = 0;
+        }
+        Segment* spare;
+        while (freeSegments.dequeue(spare)) {
+            delete spare;
+        }
+    }
+
+    UnboundedSPSCQueue(const UnboundedSPSCQueue&) = delete;
+    UnboundedSPSCQueue& operator=(const UnboundedSPSCQueue&) = delete;
+
+    // Always succeeds (or throws std::bad_alloc); returns bool so it can
+    // stand in for the bounded rings.
+    bool enqueue(const T& value) {
+        return emplace(value);
+    }
+
+    bool enqueue(T&& value) {
+        return emplace(std::move(value));
+    }
+
+    template<typename... Args>
+    bool emplace(Args&&... args) {
+        if (tailIndex == SegmentSize) {
+            Segment* next = nullptr;
+            if (!freeSegments.dequeue(next)) {
+                next = new Segment();
+            }
+            tailSegment->next.store(next, std::memory_order_release);
+            tailSegment = next;
+            tailIndex = 0;
+        }
+        new (tailSegment->slot(tailIndex)) T(std::forward<Args>(args)...);
+        tailSegment->committed.store(++tailIndex, std::memory_order_release);
+        return true;
+    }
+
+    bool dequeue(T& result) {
+        if (!readable()) {
+            return false;
+        }
+        T* slot = headSegment->slot(headIndex++);
+        result = std::move(*slot);
+        slot->~T();
+        return true;
+    }
+
+    std::optional<T> try_pop() {
+        if (!readable()) {
+            return std::nullopt;
+        }
+        T* slot = headSegment->slot(headIndex++);
+        std::optional<T> result(std::move(*slot));
+        slot->~T();
+        return result;
+    }
+
+    // Consumer side only.
+    bool empty() {
+        return !readable();
+    }
+
+private:
+    struct Segment {
+        std::atomic<size_t> committed{0};
+        std::atomic<Segment*> next{nullptr};
+        alignas(T) unsigned char storage[SegmentSize * sizeof(T)];
+
+        T* slot(size_t i) { return std::launder(reinterpret_cast<T*>(storage) + i); }
+    };
+
+    // Moves the consumer to the next segment once the current one is spent.
+    bool readable() {
+        if (headIndex != cachedCommitted) {
+            return true;
+        }
+        cachedCommitted = headSegment->committed.load(std::memory_order_acquire);
+        if (headIndex != cachedCommitted) {
+            return true;
+        }
+        if (headIndex < SegmentSize) {
+            return false;
+        }
+        Segment* next = headSegment->next.load(std::memory_order_acquire);
+        if (next == nullptr) {
+            return false;
+        }
+        recycle(headSegment);
+        headSegment = next;
+        headIndex = 0;
+        cachedCommitted = next->committed.load(std::memory_order_acquire);
+        return cachedCommitted != 0;
+    }
+
+    // The producer has moved past a drained segment for good, so it can be
+    // reset and handed straight back.
+    void recycle(Segment* segment) {
+        segment->committed.store(0, std::memory_order_relaxed);
+        segment->next.store(nullptr, std::memory_order_relaxed);
+        if (!freeSegments.enqueue(segment)) {
+            delete segment;
+        }
+    }
+
+    SPSCQueue<Segment*, FreeListSize> freeSegments;
+
+    alignas(CACHE_LINE_SIZE) Segment* headSegment;
+    size_t headIndex = 0;
+    size_t cachedCommitted = 0;
+
+    alignas(CACHE_LINE_SIZE) Segment* tailSegment;
+    size_t tailIndex = 0;
+};
+
+// Multi-producer/single-consumer. Producers claim slots in the tail segment
+// with one fetch_add and mark each slot ready once it is constructed; the
+// producer that overflows a segment links the next one.
+//
+// A stalled producer may still hold a pointer to a segment the consumer has
+// drained, so drained segments are only recycled after a two-epoch
+// quiescence check: producers register in the counter of the current epoch,
+// the consumer flips the epoch and recycles once the previous epoch's counter
+// has drained to zero.
+template<typename T, size_t SegmentSize = 512>
+class UnboundedMPSCQueue {
+    static_assert(SegmentSize > 0, "SegmentSize must be positive.");
+
+public:
+    static constexpr size_t FreeListSize = 8;
+
+    UnboundedMPSCQueue() {
+        headSegment = new Segment();
+        tailSegment.store(headSegment, std::memory_order_relaxed);
+        inside[0].count.store(0, std::memory_order_relaxed);
+        inside[1].count.store(0, std::memory_order_relaxed);
+    }
+
+    ~UnboundedMPSCQueue() {
+        Segment* segment = headSegment;
+        size_t index = headIndex;
+        while (segment != nullptr) {
+            for (; index < SegmentSize; ++index) {
+                if (segment->ready[index].load(std::memory_order_relaxed)) {
+                    segment->slot(index)->~T();
+                }
+            }
+            Segment* next = segment->next.load(std::memory_order_relaxed);
+            delete segment;
+            segment = next;
+            index = 0;
+        }
+        for (Segment* retiredSegment : retired) {
+            delete retiredSegment;
+        }
+        for (Segment* waitingSegment : waiting) {
+            delete waitingSegment;
+        }
+        Segment* spare;
+        while (freeSegments.dequeue(spare)) {
+            delete spare;
+        }
+    }
+
+    UnboundedMPSCQueue(const UnboundedMPSCQueue&) = delete;
+    UnboundedMPSCQueue& operator=(const UnboundedMPSCQueue&) = delete;
+
+    bool enqueue(const T& value) {
+        return emplace(value);
+    }
+
+    bool enqueue(T&& value) {
+        return emplace(std::move(value));
+    }
+
+    // The element constructor must not throw once a slot is claimed.
+    template<typename... Args>
+    bool emplace(Args&&... args) {
+        const unsigned e = enter();
+        while (true) {
+            Segment* segment = tailSegment.load(std::memory_order_seq_cst);
+            const size_t index = segment->claimed.fetch_add(1, std::memory_order_relaxed);
+            if (index < SegmentSize) {
+                new (segment->slot(index)) T(std::forward<Args>(args)...);
+                segment->ready[index].store(true, std::memory_order_release);
+                break;
+            }
+            Segment* next = segment->next.load(std::memory_order_acquire);
+            if (next == nullptr) {
+                Segment* fresh = nullptr;
+                if (!freeSegments.dequeue(fresh)) {
+                    fresh = new Segment();
+                }
+                if (segment->next.compare_exchange_strong(next, fresh, std::memory_order_acq_rel)) {
+                    next = fresh;
+                } else if (!freeSegments.enqueue(fresh)) {
+                    delete fresh;
+                }
+            }
+            tailSegment.compare_exchange_strong(segment, next, std::memory_order_seq_cst);
+        }
+        leave(e);
+        return true;
+    }
+
+    // Consumer only. Returns false when empty, and also while the oldest
+    // claimed slot is still being written.
+    bool dequeue(T& result) {
+        if (!readable()) {
+            return false;
+        }
+        T* slot = headSegment->slot(headIndex++);
+        result = std::move(*slot);
+        slot->~T();
+        return true;
+    }
+
+    std::optional<T> try_pop() {
+        if (!readable()) {
+            return std::nullopt;
+        }
+        T* slot = headSegment->slot(headIndex++);
+        std::optional<T> result(std::move(*slot));
+        slot->~T();
+        return result;
+    }
+
+    // Consumer side only.
+    bool empty() {
+        return !readable();
+    }
+
+private:
+    struct Segment {
+        Segment() {
+            for (auto& flag : ready) {
+                flag.store(false, std::memory_order_relaxed);
+            }
+        }
+
+        void reset() {
+            for (auto& flag : ready) {
+                flag.store(false, std::memory_order_relaxed);
+            }
+            next.store(nullptr, std::memory_order_relaxed);
+            claimed.store(0, std::memory_order_relaxed);
+        }
+
+        T* slot(size_t i) { return std::launder(reinterpret_cast<T*>(storage) + i); }
+
+        std::atomic<size_t> claimed{0};
+        std::atomic<Segment*> next{nullptr};
+        std::atomic<bool> ready[SegmentSize];
+        alignas(T) unsigned char storage[SegmentSize * sizeof(T)];
+    };
+
+    struct alignas(CACHE_LINE_SIZE) Counter {
+        std::atomic<size_t> count;
+    };
+
+    unsigned enter() {
+        while (true) {
+            const unsigned e = epoch.load(std::memory_order_seq_cst) & 1;
+            inside[e].count.fetch_add(1, std::memory_order_seq_cst);
+            if ((epoch.load(std::memory_order_seq_cst) & 1) == e) {
+                return e;
+            }
+            inside[e].count.fetch_sub(1, std::memory_order_release);
+        }
+    }
+
+    void leave(unsigned e) {
+        inside[e].count.fetch_sub(1, std::memory_order_release);
+    }
+
+    bool readable() {
+        while (true) {
+            if (headIndex < SegmentSize) {
+                return headSegment->ready[headIndex].load(std::memory_order_acquire);
+            }
+            Segment* next = headSegment->next.load(std::memory_order_acquire);
+            if (next == nullptr) {
+                return false;
+            }
+            retired.push_back(headSegment);
+            headSegment = next;
+            headIndex = 0;
+            reclaim();
+        }
+    }
+
+    // Recycles the segments retired before the last epoch flip once no
+    // producer from that epoch is left, then starts a new round with the
+    // segments no producer can reach any more.
+    void reclaim() {
+        if (!waiting.empty()) {
+            if (inside[waitingEpoch].count.load(std::memory_order_seq_cst) != 0) {
+                return;
+            }
+            for (Segment* segment : waiting) {
+                segment->reset();
+                if (!freeSegments.enqueue(segment)) {
+                    delete segment;
+                }
+            }
+            waiting.clear();
+        }
+        Segment* tail = tailSegment.load(std::memory_order_seq_cst);
+        for (size_t i = 0; i < retired.size();) {
+            if (retired[i] != tail) {
+                waiting.push_back(retired[i]);
+                retired[i] = retired.back();
+                retired.pop_back();
+            } else {
+                ++i;
+            }
+        }
+        if (!waiting.empty()) {
+            waitingEpoch = epoch.fetch_add(1, std::memory_order_seq_cst) & 1;
+        }
+    }
+
+    MPMCQueue<Segment*, FreeListSize> freeSegments;
+
+    alignas(CACHE_LINE_SIZE) std::atomic<Segment*> tailSegment;
+    alignas(CACHE_LINE_SIZE) std::atomic<unsigned> epoch{0};
+    Counter inside[2];
+
+    // Consumer-owned.
+    alignas(CACHE_LINE_SIZE) Segment* headSegment;
+    size_t headIndex = 0;
+    std::vector<Segment*> retired;
+    std::vector<Segment*> waiting;
+    unsigned waitingEpoch = 0;
+};
+
+#endif // UNBOUNDED_QUEUE_H
@@ -0,0 +1,247 @@
+#ifndef WAIT_STRATEGY_H
+#define WAIT_STRATEGY_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+
+#if defined(__linux__)
+#include <climits>
+#include <ctime>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#else
+#include <condition_variable>
+#include <mutex>
+#endif
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#include <immintrin.h>
+#endif
+
+// Tells the core we are in a spin loop (PAUSE on x86, YIELD on ARM), which
+// saves power and stops the loop from starving a hyperthread sibling.
+inline void cpuRelax() {
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+    _mm_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+    asm volatile("yield" ::: "memory");
+#endif
+}
+
+// Wait strategies decide what a blocking queue operation does between
+// attempts. Each one is a member of the queue it serves and provides:
+//
+//   template<typename Ready> void wait(Ready&& ready);
+//   template<typename Ready, typename Clock, typename Duration>
+//   bool waitUntil(Ready&& ready, const std::chrono::time_point<Clock, Duration>& deadline);
+//   void notify(size_t count);
+//
+// ready() performs the attempt itself (for a consumer: a dequeue) and returns
+// whether it succeeded. notify() is called by the other side after each
+// successful operation and is a no-op for the strategies that never sleep.
+
+// Spins on the core without ever giving it up: lowest latency, one core
+// pinned at 100% while idle.
+struct BusySpinWait {
+    template<typename Ready>
+    void wait(Ready&& ready) {
+        while (!ready()) {
+            cpuRelax();
+        }
+    }
+
+    template<typename Ready, typename Clock, typename Duration>
+    bool waitUntil(Ready&& ready, const std::chrono::time_point<Clock, Duration>& deadline) {
+        for (unsigned i = 1;; ++i) {
+            if (ready()) {
+                return true;
+            }
+            // Reading the clock costs more than a pause, so only check it
+            // every so often.
+            if ((i & 63) == 0 && Clock::now() >= deadline) {
+                return false;
+            }
+            cpuRelax();
+        }
+    }
+
+    void notify(size_t) {}
+};
+
+// Spins briefly, then yields the core to other runnable threads between
+// attempts. This is what the callers' hand-written yield loops did.
+struct SpinYieldWait {
+    static constexpr unsigned SpinCount = 128;
+
+    template<typename Ready>
+    void wait(Ready&& ready) {
+        for (unsigned i = 0; !ready(); ++i) {
+            if (i < SpinCount) {
+                cpuRelax();
+            } else {
+                std::this_thread::yield();
+            }
+        }
+    }
+
+    template<typename Ready, typename Clock, typename Duration>
+    bool waitUntil(Ready&& ready, const std::chrono::time_point<Clock, Duration>& deadline) {
+        for (unsigned i = 0;; ++i) {
+            if (ready()) {
+                return true;
+            }
+            if (i < SpinCount) {
+                cpuRelax();
+                continue;
+            }
+            if (Clock::now() >= deadline) {
+                return false;
+            }
+            std::this_thread::yield();
+        }
+    }
+
+    void notify(size_t) {}
+};
+
+// Spins, yields, and finally parks the thread in the kernel (a futex on
+// Linux, a condition variable elsewhere) until the other side notifies. The
+// notifying side only makes a system call when a waiter is actually asleep;
+// otherwise notify() costs a fence and one load of the sleeper count.
+class SpinParkWait {
+public:
+    static constexpr unsigned SpinCount = 128;
+    static constexpr unsigned YieldCount = 16;
+
+    template<typename Ready>
+    void wait(Ready&& ready) {
+        if (spin(ready)) {
+            return;
+        }
+        while (true) {
+            const std::uint32_t observed = prepare();
+            if (ready()) {
+                finish();
+                return;
+            }
+            sleep(observed, nullptr);
+            finish();
+            if (ready()) {
+                return;
+            }
+        }
+    }
+
+    template<typename Ready, typename Clock, typename Duration>
+    bool waitUntil(Ready&& ready, const std::chrono::time_point<Clock, Duration>& deadline) {
+        if (spin(ready)) {
+            return true;
+        }
+        while (true) {
+            const auto now = Clock::now();
+            if (now >= deadline) {
+                return ready();
+            }
+            const auto remaining = std::chrono::duration_cast<std::chrono::nanoseconds>(deadline - now);
+            const std::uint32_t observed = prepare();
+            if (ready()) {
+                finish();
+                return true;
+            }
+            sleep(observed, &remaining);
+            finish();
+            if (ready()) {
+                return true;
+            }
+        }
+    }
+
+    void notify(size_t count) {
+        // Pairs with the fence in prepare(): either the waiter
+        // sees what we published, or we see the waiter.
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (sleepers.load(std::memory_order_relaxed) == 0) {
+            return;
+        }
+        epoch.fetch_add(1, std::memory_order_release);
+        wake(count);
+    }
+
+private:
+    template<typename Ready>
+    static bool spin(Ready& ready) {
+        for (unsigned i = 0; i < SpinCount + YieldCount; ++i) {
+            if (ready()) {
+                return true;
+            }
+            if (i < SpinCount) {
+                cpuRelax();
+            } else {
+                std::this_thread::yield();
+            }
+        }
+        return false;
+    }
+
+    std::uint32_t prepare() {
+        sleepers.fetch_add(1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        return epoch.load(std::memory_order_acquire);
+    }
+
+    void finish() {
+        sleepers.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+#if defined(__linux__)
+    // Returns once epoch moves past observed, on timeout or spuriously;
+    // every caller re-checks its condition afterwards.
+    void sleep(std::uint32_t observed, const std::chrono::nanoseconds* timeout) {
+        timespec ts;
+        timespec* tsp = nullptr;
+        if (timeout != nullptr) {
+            ts.tv_sec = static_cast<time_t>(timeout->count() / 1000000000);
+            ts.tv_nsec = static_cast<long>(timeout->count() % 1000000000);
+            tsp = &ts;
+        }
+        syscall(SYS_futex, reinterpret_cast<std::uint32_t*>(&epoch), FUTEX_WAIT_PRIVATE, observed, tsp, nullptr, 0);
+    }
+
+    void wake(size_t count) {
+        const int n = count > static_cast<size_t>(INT_MAX) ? INT_MAX : static_cast<int>(count);
+        syscall(SYS_futex, reinterpret_cast<std::uint32_t*>(&epoch), FUTEX_WAKE_PRIVATE, n, nullptr, nullptr, 0);
+    }
+#else
+    void sleep(std::uint32_t observed, const std::chrono::nanoseconds* timeout) {
+        std::unique_lock<std::mutex> lock(mutex);
+        auto changed = [&] { return epoch.load(std::memory_order_acquire) != observed; };
+        if (timeout != nullptr) {
+            condition.wait_for(lock, *timeout, changed);
+        } else {
+            condition.wait(lock, changed);
+        }
+    }
+
+    void wake(size_t count) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (count == 1) {
+            condition.notify_one();
+        } else {
+            condition.notify_all();
+        }
+    }
+
+    std::mutex mutex;
+    std::condition_variable condition;
+#endif
+
+    static_assert(sizeof(std::atomic<std::uint32_t>) == sizeof(std::uint32_t), "futex word must be a plain 32-bit integer");
+
+    std::atomic<std::uint32_t> epoch{0};
+    std::atomic<std::uint32_t> sleepers{0};
+};
+
+#endif // WAIT_STRATEGY_H
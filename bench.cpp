@@ -0,0 +1,705 @@
+// Queue benchmarks: throughput at 1..N producers/consumers and batch sizes
+// 1..256 for several payload sizes, plus ping-pong round-trip latency, each
+// next to a std::mutex + std::deque baseline; and StringPool intern latency,
+// intern throughput at 1..N threads over realistic key sets with memory per
+// string, literal and StringRef copy costs, and create/destroy churn.
+// Latencies are TSC-timed into LatencyHistograms and reported as
+// percentiles, since the mean hides the tail stalls.
+//
+//   cpputils_bench [--ops=N] [--threads=N] [--cores=0,2,4|smt|llc|cross] [--filter=SPSC]
+//
+// --cores pins the benchmark threads to the listed cores in the order they
+// are started (producers first); without it threads are left unpinned.
+// smt, llc and cross pick the cores from CpuTopology so the endpoints share
+// a physical core, share a last-level cache, or sit on different LLCs.
+
+#include "LatencyHistogram.h"
+#include "Queue.h"
+#include "StringIntern.h"
+#include "Topology.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#if defined(__GLIBC__)
+#include <malloc.h>
+#endif
+
+namespace {
+
+using bench_clock = std::chrono::steady_clock;
+
+struct Options {
+    size_t ops = size_t(1) << 20;
+    size_t threads = std::max<size_t>(1, std::min<size_t>(4, std::thread::hardware_concurrency() / 2));
+    std::vector<int> cores;
+    std::string filter;
+};
+
+Options options;
+
+void pinThread(size_t slot) {
+    if (!options.cores.empty()) {
+        pin_current_thread(options.cores[slot % options.cores.size()]);
+    }
+}
+
+// Core lists for the named placements; falls back to whatever the machine
+// has when it lacks the requested kind of pair.
+std::vector<int> placementCores(const std::string& placement) {
+    const CpuTopology& topology = CpuTopology::instance();
+    std::vector<int> cores;
+    if (placement == "smt") {
+        for (const auto& core : topology.cores()) {
+            if (core.size() > 1) {
+                return core;
+            }
+        }
+    } else if (placement == "llc") {
+        // One CPU per physical core, all behind the first LLC.
+        for (const int cpu : topology.llc_groups().front()) {
+            if (topology.smt_siblings(cpu).front() == cpu) {
+                cores.push_back(cpu);
+            }
+        }
+    } else if (placement == "cross") {
+        for (const auto& llc : topology.llc_groups()) {
+            cores.push_back(llc.front());
+        }
+    }
+    if (cores.size() < 2) {
+        cores.clear();
+        for (const CpuInfo& info : topology.cpus()) {
+            cores.push_back(info.cpu);
+        }
+    }
+    return cores;
+}
+
+template<size_t Size>
+struct Payload {
+    static_assert(Size >= sizeof(std::uint64_t), "Payload carries a sequence number.");
+    std::uint64_t sequence = 0;
+    char padding[Size - sizeof(std::uint64_t)];
+};
+
+// The baseline every lock-free ring has to beat.
+template<typename T>
+class MutexQueue {
+public:
+    explicit MutexQueue(size_t capacity) : limit(capacity) {}
+
+    bool enqueue(const T& value) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (items.size() == limit) {
+            return false;
+        }
+        items.push_back(value);
+        return true;
+    }
+
+    bool dequeue(T& result) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (items.empty()) {
+            return false;
+        }
+        result = items.front();
+        items.pop_front();
+        return true;
+    }
+
+    template<typename ForwardIt>
+    size_t enqueue_bulk(ForwardIt first, size_t n) {
+        std::lock_guard<std::mutex> lock(mutex);
+        n = std::min(n, limit - items.size());
+        items.insert(items.end(), first, first + n);
+        return n;
+    }
+
+    template<typename OutputIt>
+    size_t dequeue_bulk(OutputIt out, size_t max) {
+        std::lock_guard<std::mutex> lock(mutex);
+        const size_t n = std::min(max, items.size());
+        std::copy(items.begin(), items.begin() + n, out);
+        items.erase(items.begin(), items.begin() + n);
+        return n;
+    }
+
+private:
+    std::mutex mutex;
+    std::deque<T> items;
+    size_t limit;
+};
+
+// Queues without bulk operations (MPMCQueue) fall back to element loops.
+template<typename Q, typename = void>
+struct HasBulk : std::false_type {};
+
+template<typename Q>
+struct HasBulk<Q, decltype(void(std::declval<Q&>().dequeue_bulk(static_cast<int*>(nullptr), 0)))> : std::true_type {};
+
+template<typename Q, typename T>
+size_t pushBatch(Q& queue, const T* items, size_t n) {
+    if (n == 1) {
+        return queue.enqueue(items[0]) ? 1 : 0;
+    }
+    if constexpr (HasBulk<Q>::value) {
+        return queue.enqueue_bulk(items, n);
+    } else {
+        size_t done = 0;
+        while (done < n && queue.enqueue(items[done])) {
+            ++done;
+        }
+        return done;
+    }
+}
+
+template<typename Q, typename T>
+size_t popBatch(Q& queue, T* out, size_t max) {
+    if (max == 1) {
+        return queue.dequeue(out[0]) ? 1 : 0;
+    }
+    if constexpr (HasBulk<Q>::value) {
+        return queue.dequeue_bulk(out, max);
+    } else {
+        size_t done = 0;
+        while (done < max && queue.dequeue(out[done])) {
+            ++done;
+        }
+        return done;
+    }
+}
+
+bool selected(const std::string& name) {
+    return options.filter.empty() || name.find(options.filter) != std::string::npos;
+}
+
+// Moves options.ops elements per producer through one queue and reports the
+// aggregate rate.
+template<typename Q, typename T>
+void throughput(const char* name, size_t producers, size_t consumers, size_t batch) {
+    constexpr size_t capacity = 4096;
+    Q queue(capacity);
+    const size_t total = options.ops * producers;
+    std::atomic<size_t> consumed{0};
+    std::atomic<bool> go{false};
+    std::vector<std::thread> threads;
+
+    for (size_t p = 0; p < producers; ++p) {
+        threads.emplace_back([&, p] {
+            pinThread(p);
+            std::vector<T> items(batch);
+            while (!go.load(std::memory_order_acquire)) {
+                std::this_thread::yield();
+            }
+            for (size_t sent = 0; sent < options.ops;) {
+                const size_t want = std::min(batch, options.ops - sent);
+                for (size_t i = 0; i < want; ++i) {
+                    items[i].sequence = sent + i;
+                }
+                size_t done = 0;
+                while (done < want) {
+                    const size_t n = pushBatch(queue, items.data() + done, want - done);
+                    if (n == 0) {
+                        std::this_thread::yield();
+                    }
+                    done += n;
+                }
+                sent += want;
+            }
+        });
+    }
+    for (size_t c = 0; c < consumers; ++c) {
+        threads.emplace_back([&, c] {
+            pinThread(producers + c);
+            std::vector<T> items(batch);
+            while (consumed.load(std::memory_order_relaxed) < total) {
+                const size_t n = popBatch(queue, items.data(), batch);
+                if (n == 0) {
+                    std::this_thread::yield();
+                    continue;
+                }
+                consumed.fetch_add(n, std::memory_order_relaxed);
+            }
+        });
+    }
+
+    const auto start = bench_clock::now();
+    go.store(true, std::memory_order_release);
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    const double seconds = std::chrono::duration<double>(bench_clock::now() - start).count();
+    std::printf("%-28s %4zuB  %2zuP/%-2zuC  batch %3zu  %12.0f ops/s\n", name, sizeof(T), producers, consumers, batch,
+                static_cast<double>(total) / seconds);
+}
+
+using Histogram = LatencyHistogram<>;
+
+// Histograms hold TSC ticks; convert only when printing.
+void printLatency(const char* name, size_t bytes, const char* what, const Histogram& histogram) {
+    const std::string size = bytes == 0 ? std::string() : std::to_string(bytes) + "B";
+    std::printf("%-28s %5s  %-10s p50 %7.0f  p99 %7.0f  p99.9 %7.0f  max %8.0f ns\n", name, size.c_str(), what,
+                TscClock::nanoseconds(histogram.percentile(50)), TscClock::nanoseconds(histogram.percentile(99)),
+                TscClock::nanoseconds(histogram.percentile(99.9)), TscClock::nanoseconds(histogram.max()));
+}
+
+// One element bounces between two queues; reports round-trip percentiles.
+template<typename Q, typename T>
+void pingPong(const char* name) {
+    const size_t rounds = std::max<size_t>(1000, options.ops / 16);
+    Q ping(64);
+    Q pong(64);
+    std::thread echo([&] {
+        pinThread(1);
+        T value;
+        for (size_t i = 0; i < rounds; ++i) {
+            while (!ping.dequeue(value)) {
+                std::this_thread::yield();
+            }
+            while (!pong.enqueue(value)) {
+                std::this_thread::yield();
+            }
+        }
+    });
+
+    pinThread(0);
+    Histogram histogram;
+    T value;
+    for (size_t i = 0; i < rounds; ++i) {
+        const std::uint64_t start = TscClock::ticks();
+        value.sequence = i;
+        while (!ping.enqueue(value)) {
+            std::this_thread::yield();
+        }
+        while (!pong.dequeue(value)) {
+            std::this_thread::yield();
+        }
+        histogram.record(TscClock::ticks() - start);
+    }
+    echo.join();
+    printLatency(name, sizeof(T), "round trip", histogram);
+}
+
+// Every thread interns the same key set; the first pass mostly inserts, the
+// second only hits. Per-thread histograms are merged for the report.
+void internLatency() {
+    if (!selected("StringPool")) {
+        return;
+    }
+    const size_t keys = std::max<size_t>(1000, options.ops / 64);
+    std::vector<std::string> names;
+    for (size_t i = 0; i < keys; ++i) {
+        names.push_back("session-" + std::to_string(i * 2654435761u));
+    }
+    std::vector<Histogram> first(options.threads);
+    std::vector<Histogram> second(options.threads);
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < options.threads; ++t) {
+        threads.emplace_back([&, t] {
+            pinThread(t);
+            // Held so the second pass finds the strings still interned.
+            std::vector<StringPtr> held;
+            held.reserve(keys);
+            for (const std::string& name : names) {
+                const std::uint64_t start = TscClock::ticks();
+                held.push_back(StringPool::try_emplace(name));
+                first[t].record(TscClock::ticks() - start);
+            }
+            for (const std::string& name : names) {
+                const std::uint64_t start = TscClock::ticks();
+                StringPtr hit = StringPool::try_emplace(name);
+                second[t].record(TscClock::ticks() - start);
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    for (size_t t = 1; t < options.threads; ++t) {
+        first[0].merge(first[t]);
+        second[0].merge(second[t]);
+    }
+    printLatency("StringPool::try_emplace", 0, "insert", first[0]);
+    printLatency("StringPool::try_emplace", 0, "hit", second[0]);
+}
+
+// Key sets for the StringPool suite, shaped like real traffic: Zipfian
+// ticker-like symbols (a few very hot), long REST-style URLs, and short tags.
+struct KeySet {
+    const char* name;
+    std::vector<std::string> keys;
+};
+
+std::vector<KeySet> stringKeySets(size_t count) {
+    std::vector<KeySet> sets;
+
+    // Ranks drawn from Zipf(1) over a universe of symbols through the
+    // inverse CDF; duplicates are kept, since hot keys repeat.
+    const size_t universe = std::max<size_t>(64, count / 4);
+    std::vector<double> cdf(universe);
+    double total = 0;
+    for (size_t rank = 0; rank < universe; ++rank) {
+        total += 1.0 / static_cast<double>(rank + 1);
+        cdf[rank] = total;
+    }
+    std::uint64_t state = 0x2545F4914F6CDD1Dull;
+    KeySet zipf{"zipf symbols", {}};
+    for (size_t i = 0; i < count; ++i) {
+        state = state * 6364136223846793005ull + 1442695040888963407ull;
+        const double u = static_cast<double>(state >> 11) / 9007199254740992.0 * total;
+        const size_t rank = static_cast<size_t>(std::lower_bound(cdf.begin(), cdf.end(), u) - cdf.begin());
+        zipf.keys.push_back("SYM" + std::to_string(rank * 7919 % 100000));
+    }
+    sets.push_back(std::move(zipf));
+
+    KeySet urls{"long urls", {}};
+    for (size_t i = 0; i < count; ++i) {
+        urls.keys.push_back("https://api.example.com/v2/accounts/" + std::to_string(i * 2654435761u % 1000003) +
+                            "/orders/" + std::to_string(i) + "?page=" + std::to_string(i % 17) + "&sort=desc");
+    }
+    sets.push_back(std::move(urls));
+
+    KeySet tags{"short tags", {}};
+    for (size_t i = 0; i < count; ++i) {
+        tags.keys.push_back("t" + std::to_string(i));
+    }
+    sets.push_back(std::move(tags));
+    return sets;
+}
+
+// 1, 2, 4, ... up to --threads.
+std::vector<size_t> threadCounts() {
+    std::vector<size_t> counts;
+    for (size_t n = 1; n < options.threads; n *= 2) {
+        counts.push_back(n);
+    }
+    counts.push_back(options.threads);
+    return counts;
+}
+
+// Starts threads copies of body(t) together and returns the wall time until
+// the last one finishes.
+template<typename F>
+double timeThreads(size_t threads, F&& body) {
+    std::atomic<bool> go{false};
+    std::vector<std::thread> workers;
+    for (size_t t = 0; t < threads; ++t) {
+        workers.emplace_back([&, t] {
+            pinThread(t);
+            while (!go.load(std::memory_order_acquire)) {
+                std::this_thread::yield();
+            }
+            body(t);
+        });
+    }
+    const auto start = bench_clock::now();
+    go.store(true, std::memory_order_release);
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    return std::chrono::duration<double>(bench_clock::now() - start).count();
+}
+
+// Heap bytes in use, where the C library can say.
+size_t heapInUse() {
+#if defined(__GLIBC__) && defined(__GLIBC_PREREQ)
+#if __GLIBC_PREREQ(2, 33)
+    return mallinfo2().uordblks;
+#else
+    return 0;
+#endif
+#else
+    return 0;
+#endif
+}
+
+std::atomic<std::uintptr_t> benchSink{0};
+
+// Intern throughput per key set and thread count, on a fresh pool each time.
+// The miss pass splits the keys between threads, so every distinct key is
+// inserted once; the hit pass has every thread intern every key. Memory is
+// the heap growth over the miss pass per distinct string, tables included.
+void internThroughput() {
+    if (!selected("StringPool")) {
+        return;
+    }
+    const size_t count = std::max<size_t>(1000, options.ops / 16);
+    for (const KeySet& set : stringKeySets(count)) {
+        for (const size_t threads : threadCounts()) {
+            StringPool pool;
+            std::vector<std::vector<StringPtr>> held(threads);
+            const size_t heapBefore = heapInUse();
+            const double missSeconds = timeThreads(threads, [&](size_t t) {
+                for (size_t i = t; i < set.keys.size(); i += threads) {
+                    held[t].push_back(pool.intern(set.keys[i]));
+                }
+            });
+            const size_t heapAfter = heapInUse();
+            const double hitSeconds = timeThreads(threads, [&](size_t) {
+                std::uintptr_t sum = 0;
+                for (const std::string& key : set.keys) {
+                    sum += reinterpret_cast<std::uintptr_t>(pool.intern(key).get());
+                }
+                benchSink.fetch_add(sum, std::memory_order_relaxed);
+            });
+            const StringPoolStatsSnapshot stats = pool.stats();
+            const size_t distinct = static_cast<size_t>(stats.liveStrings);
+            std::printf("StringPool %-12s %2zu threads  miss %11.0f ops/s  hit %11.0f ops/s", set.name, threads,
+                        static_cast<double>(set.keys.size()) / missSeconds,
+                        static_cast<double>(set.keys.size() * threads) / hitSeconds);
+            if (heapAfter > heapBefore && distinct != 0) {
+                std::printf("  %6.1f B/string (avg len %.1f)\n",
+                            static_cast<double>(heapAfter - heapBefore) / static_cast<double>(distinct),
+                            stats.averageLength());
+            } else {
+                std::printf("\n");
+            }
+        }
+    }
+}
+
+// Cost per evaluation of the ways to name a literal. The string is held
+// throughout, as a map keyed by it would, so these are steady-state hits;
+// churnStorm() covers strings that die between uses.
+void literalCost() {
+    if (!selected("StringPool")) {
+        return;
+    }
+    const StringRef held(StringPool::try_emplace("bench-literal"));
+    const size_t rounds = options.ops;
+    const auto measure = [&](const char* name, auto&& body) {
+        std::uintptr_t sum = 0;
+        const auto start = bench_clock::now();
+        for (size_t i = 0; i < rounds; ++i) {
+            sum += body();
+        }
+        const double seconds = std::chrono::duration<double>(bench_clock::now() - start).count();
+        benchSink.fetch_add(sum, std::memory_order_relaxed);
+        std::printf("%-28s %8.1f ns/op\n", name, seconds * 1e9 / static_cast<double>(rounds));
+    };
+    measure("StringPool _hs", [] { return reinterpret_cast<std::uintptr_t>(("bench-literal"_hs).get()); });
+    measure("StringPool CPPUTILS_INTERN", [] { return reinterpret_cast<std::uintptr_t>(CPPUTILS_INTERN("bench-literal").get()); });
+    measure("StringPool try_emplace", [] {
+        return reinterpret_cast<std::uintptr_t>(StringPool::try_emplace("bench-literal").get());
+    });
+}
+
+// Copy-and-destroy of one shared reference from every thread: the counted
+// StringRef bounces its control block's line between cores, the immortal one
+// and the StringHandle never write shared memory.
+void refCopyCost() {
+    if (!selected("StringPool")) {
+        return;
+    }
+    const StringRef counted(StringPool::try_emplace("bench-shared-counted"));
+    const StringRef immortal(StringPool::try_emplace_immortal("bench-shared-immortal"));
+    const StringHandle handle("bench-shared-handle");
+    const auto run = [&](const char* name, auto&& copyOnce) {
+        for (const size_t threads : threadCounts()) {
+            const double seconds = timeThreads(threads, [&](size_t) {
+                std::uintptr_t sum = 0;
+                for (size_t i = 0; i < options.ops; ++i) {
+                    sum += copyOnce();
+                }
+                benchSink.fetch_add(sum, std::memory_order_relaxed);
+            });
+            std::printf("%-28s %2zu threads  %12.0f copies/s\n", name, threads,
+                        static_cast<double>(options.ops * threads) / seconds);
+        }
+    };
+    run("StringRef copy counted", [&] {
+        const StringRef copy(counted);
+        return reinterpret_cast<std::uintptr_t>(copy.getRawPointer());
+    });
+    run("StringRef copy immortal", [&] {
+        const StringRef copy(immortal);
+        return reinterpret_cast<std::uintptr_t>(copy.getRawPointer());
+    });
+    run("StringHandle copy", [&] {
+        const StringHandle copy(handle);
+        return static_cast<std::uintptr_t>(copy.id());
+    });
+}
+
+// Create/destroy storms: each iteration interns a key nobody else holds and
+// drops it at once, so every one is an insert and a release through the
+// deleter. Threads share a small key set, so they race on the same entries.
+void churnStorm() {
+    if (!selected("StringPool")) {
+        return;
+    }
+    std::vector<std::string> keys;
+    for (size_t i = 0; i < 256; ++i) {
+        keys.push_back("churn-" + std::to_string(i));
+    }
+    for (const size_t threads : threadCounts()) {
+        StringPool pool;
+        const double seconds = timeThreads(threads, [&](size_t t) {
+            for (size_t i = 0; i < options.ops / 4; ++i) {
+                const StringPtr string = pool.intern(keys[(i + t * 37) % keys.size()]);
+                benchSink.fetch_add(string->size(), std::memory_order_relaxed);
+            }
+        });
+        const StringPoolStatsSnapshot stats = pool.stats();
+        std::printf("StringPool churn            %2zu threads  %12.0f ops/s  (%llu releases, %llu contended locks)\n",
+                    threads, static_cast<double>(options.ops / 4 * threads) / seconds,
+                    static_cast<unsigned long long>(stats.releases),
+                    static_cast<unsigned long long>(stats.lockContended));
+    }
+}
+
+const size_t batchSizes[] = {1, 4, 16, 64, 256};
+
+// SPSC rings only get one producer and one consumer; SPMC rings one producer.
+template<template<typename> class Q, typename T>
+void throughputSweep(const char* name, size_t maxProducers, size_t maxConsumers) {
+    if (!selected(name)) {
+        return;
+    }
+    for (size_t producers = 1; producers <= maxProducers; ++producers) {
+        for (size_t consumers = 1; consumers <= maxConsumers; ++consumers) {
+            for (const size_t batch : batchSizes) {
+                throughput<Q<T>, T>(name, producers, consumers, batch);
+            }
+        }
+    }
+}
+
+template<typename T>
+using SPSC = SPSCQueue<T>;
+template<typename T>
+using SPMC = SPMCQueue<T>;
+template<typename T>
+using MPMC = MPMCQueue<T>;
+
+struct ExponentialBackoffTraits : QueueTraits { using backoff = ExponentialBackoff; };
+template<typename T>
+using SPMCBackoff = SPMCQueue<T, DynamicCapacity, ExponentialBackoffTraits>;
+template<typename T>
+using Mutex = MutexQueue<T>;
+
+template<typename T>
+void runPayload() {
+    const size_t n = options.threads;
+    throughputSweep<SPSC, T>("SPSCQueue", 1, 1);
+    throughputSweep<SPMC, T>("SPMCQueue", 1, n);
+    throughputSweep<SPMCBackoff, T>("SPMCQueue exp. backoff", 1, n);
+    throughputSweep<MPMC, T>("MPMCQueue", n, n);
+    throughputSweep<Mutex, T>("std::mutex + std::deque", n, n);
+
+    if (selected("SPSCQueue")) {
+        pingPong<SPSC<T>, T>("SPSCQueue");
+    }
+    if (selected("SPMCQueue")) {
+        pingPong<SPMC<T>, T>("SPMCQueue");
+    }
+    if (selected("MPMCQueue")) {
+        pingPong<MPMC<T>, T>("MPMCQueue");
+    }
+    if (selected("std::mutex + std::deque")) {
+        pingPong<Mutex<T>, T>("std::mutex + std::deque");
+    }
+}
+
+// Producer and consumer on one thread, as in a deterministic replay: the
+// cost the atomics add when nothing else touches the ring.
+template<typename Traits>
+void replay(const char* name) {
+    if (!selected(name)) {
+        return;
+    }
+    SPSCQueue<Payload<8>, 1024, Traits> queue;
+    Payload<8> items[64];
+    std::uint64_t checksum = 0;
+    const size_t rounds = options.ops * 16;
+    const auto start = bench_clock::now();
+    for (size_t i = 0; i < rounds; ++i) {
+        Payload<8> item;
+        item.sequence = i;
+        queue.enqueue(item);
+        if ((i & 63) == 63) {
+            const size_t n = queue.dequeue_bulk(items, 64);
+            for (size_t j = 0; j < n; ++j) {
+                checksum += items[j].sequence;
+            }
+        }
+    }
+    const double seconds = std::chrono::duration<double>(bench_clock::now() - start).count();
+    std::printf("%-28s %4zuB  same thread  %12.0f ops/s  (checksum %llu)\n", name, sizeof(Payload<8>),
+                static_cast<double>(rounds) / seconds, static_cast<unsigned long long>(checksum));
+}
+
+bool parseArguments(int argc, char** argv) {
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        const auto value = [&](const char* prefix) -> const char* {
+            const size_t length = std::strlen(prefix);
+            return arg.compare(0, length, prefix) == 0 ? argv[i] + length : nullptr;
+        };
+        if (const char* v = value("--ops=")) {
+            options.ops = std::max<size_t>(1, std::strtoull(v, nullptr, 10));
+        } else if (const char* v = value("--threads=")) {
+            options.threads = std::max<size_t>(1, std::strtoull(v, nullptr, 10));
+        } else if (const char* v = value("--filter=")) {
+            options.filter = v;
+        } else if (const char* v = value("--cores=")) {
+            options.cores.clear();
+            if (*v < '0' || *v > '9') {
+                options.cores = placementCores(v);
+                continue;
+            }
+            for (const char* p = v; *p != '\0';) {
+                char* end = nullptr;
+                options.cores.push_back(static_cast<int>(std::strtol(p, &end, 10)));
+                if (end == p) {
+                    return false;
+                }
+                p = *end == ',' ? end + 1 : end;
+            }
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    if (!parseArguments(argc, argv)) {
+        std::fprintf(stderr, "usage: %s [--ops=N] [--threads=N] [--cores=0,2,4|smt|llc|cross] [--filter=NAME]\n",
+                     argv[0]);
+        return 2;
+    }
+    const CpuTopology& topology = CpuTopology::instance();
+    std::printf("%zu cpus, %zu cores, %zu LLCs, %zu NUMA nodes; pinned to", topology.cpus().size(),
+                topology.cores().size(), topology.llc_groups().size(), topology.nodes().size());
+    for (const int cpu : options.cores) {
+        std::printf(" %d", cpu);
+    }
+    std::printf(options.cores.empty() ? " nothing\n" : "\n");
+    runPayload<Payload<8>>();
+    runPayload<Payload<64>>();
+    runPayload<Payload<256>>();
+    replay<QueueTraits>("SPSCQueue replay");
+    replay<SingleThreadedTraits>("SPSCQueue replay plain");
+    replay<InlineQueueTraits>("SPSCQueue replay inline");
+    internLatency();
+    internThroughput();
+    literalCost();
+    refCopyCost();
+    churnStorm();
+    return 0;
+}
@@ -899,6 +899,9 @@ struct ContextOptions //!OCLINT too many fields
 
     // == parameters from the command line
     String   out;       // output filename
+    String   benchmark_out;  // JSON file for the benchmark reporter
+    String   baseline;       // benchmark results to compare against
+    String   max_regression; // how much slower than the baseline a benchmark may get
     String   order_by;  // how tests should be ordered
     unsigned rand_seed; // the seed for rand ordering
 
@@ -906,6 +909,7 @@ struct ContextOptions //!OCLINT too many fields
     unsigned last;  // the last (matching) test to be executed
 
     int abort_after;           // stop tests after this many failed assertions
+    int jobs;                  // worker processes to run test cases in (1 runs them in-process)
     int subcase_filter_levels; // apply the subcase filters for the first N levels
 
     bool success;              // include successful assertions in output
@@ -3222,6 +3226,14 @@ DOCTEST_MAKE_STD_HEADERS_CLEAN_FROM_WARNINGS_ON_WALL_BEGIN
 
 #endif // DOCTEST_PLATFORM_WINDOWS
 
+// --jobs forks worker processes, so it needs POSIX
+#if defined(DOCTEST_PLATFORM_LINUX) || defined(DOCTEST_PLATFORM_MAC)
+#define DOCTEST_JOBS_SUPPORTED
+#include <cerrno>
+#include <poll.h>
+#include <sys/wait.h>
+#endif // DOCTEST_PLATFORM_LINUX || DOCTEST_PLATFORM_MAC
+
 // this is a fix for https://github.com/doctest/doctest/issues/348
 // https://mail.gnome.org/archives/xml/2012-January/msg00000.html
 #if !defined(HAVE_UNISTD_H) && !defined(STDOUT_FILENO)
@@ -6130,6 +6142,13 @@ namespace {
               << Whitespace(sizePrefixDisplay*1) << "reporters to use (console is default)\n";
             s << " -" DOCTEST_OPTIONS_PREFIX_DISPLAY "o,   --" DOCTEST_OPTIONS_PREFIX_DISPLAY "out=<string>                  "
               << Whitespace(sizePrefixDisplay*1) << "output filename\n";
+            s << " -" DOCTEST_OPTIONS_PREFIX_DISPLAY "bo,  --" DOCTEST_OPTIONS_PREFIX_DISPLAY "benchmark-out=<string>        "
+              << Whitespace(sizePrefixDisplay*1) << "JSON file for the benchmark reporter\n";
+            s << " -" DOCTEST_OPTIONS_PREFIX_DISPLAY "bl,  --" DOCTEST_OPTIONS_PREFIX_DISPLAY "baseline=<string>             "
+              << Whitespace(sizePrefixDisplay*1) << "benchmark JSON to compare results to\n";
+            s << " -" DOCTEST_OPTIONS_PREFIX_DISPLAY "mr,  --" DOCTEST_OPTIONS_PREFIX_DISPLAY "max-regression=<string>       "
+              << Whitespace(sizePrefixDisplay*1) << "slowdown over the baseline that fails\n";
+            s << Whitespace(sizePrefixDisplay*3) << "                                       a benchmark, e.g. 5% (the default)\n";
             s << " -" DOCTEST_OPTIONS_PREFIX_DISPLAY "ob,  --" DOCTEST_OPTIONS_PREFIX_DISPLAY "order-by=<string>             "
               << Whitespace(sizePrefixDisplay*1) << "how the tests should be ordered\n";
             s << Whitespace(sizePrefixDisplay*3) << "                                       <string> - [file/suite/name/rand/none]\n";
@@ -6143,6 +6162,10 @@ namespace {
             s << Whitespace(sizePrefixDisplay*3) << "                                       execute - for range-based execution\n";
             s << " -" DOCTEST_OPTIONS_PREFIX_DISPLAY "aa,  --" DOCTEST_OPTIONS_PREFIX_DISPLAY "abort-after=<int>             "
               << Whitespace(sizePrefixDisplay*1) << "stop after <int> failed assertions\n";
+            s << " -" DOCTEST_OPTIONS_PREFIX_DISPLAY "j,   --" DOCTEST_OPTIONS_PREFIX_DISPLAY "jobs=<int>                    "
+              << Whitespace(sizePrefixDisplay*1) << "run test cases in <int> worker processes\n";
+            s << Whitespace(sizePrefixDisplay*3) << "                                       (console reporter only; test cases\n";
+            s << Whitespace(sizePrefixDisplay*3) << "                                       must not share state across cases)\n";
             s << " -" DOCTEST_OPTIONS_PREFIX_DISPLAY "scfl,--" DOCTEST_OPTIONS_PREFIX_DISPLAY "subcase-filter-levels=<int>   "
               << Whitespace(sizePrefixDisplay*1) << "apply filters for the first <int> levels\n";
             s << Color::Cyan << "\n[doctest] " << Color::None;
@@ -6659,6 +6682,9 @@ void Context::parseArgs(int argc, const char* const* argv, bool withDefaults) {
 
     // clang-format off
     DOCTEST_PARSE_STR_OPTION("out", "o", out, "");
+    DOCTEST_PARSE_STR_OPTION("benchmark-out", "bo", benchmark_out, "");
+    DOCTEST_PARSE_STR_OPTION("baseline", "bl", baseline, "");
+    DOCTEST_PARSE_STR_OPTION("max-regression", "mr", max_regression, "5%");
     DOCTEST_PARSE_STR_OPTION("order-by", "ob", order_by, "file");
     DOCTEST_PARSE_INT_OPTION("rand-seed", "rs", rand_seed, 0);
 
@@ -6666,6 +6692,7 @@ void Context::parseArgs(int argc, const char* const* argv, bool withDefaults) {
     DOCTEST_PARSE_INT_OPTION("last", "l", last, UINT_MAX);
 
     DOCTEST_PARSE_INT_OPTION("abort-after", "aa", abort_after, 0);
+    DOCTEST_PARSE_INT_OPTION("jobs", "j", jobs, 1);
     DOCTEST_PARSE_INT_OPTION("subcase-filter-levels", "scfl", subcase_filter_levels, INT_MAX);
 
     DOCTEST_PARSE_AS_BOOL_OR_FLAG("success", "s", success, false);
@@ -6791,6 +6818,284 @@ public:
 } discardOut;
 
 // the main function that does all the filtering and test running
+#ifdef DOCTEST_JOBS_SUPPORTED
+namespace detail {
+namespace {
+    // --jobs: the parent hands the indices of the selected test cases to
+    // forked workers one at a time over a pipe. Each worker runs a case with
+    // its reporters writing to a buffer, then sends back the buffer and the
+    // case's counters. The parent prints the buffers in test-case order and
+    // adds up the counters, so the output matches a serial run, only
+    // faster. A worker that dies takes one test case down with it, which is
+    // reported as failed, and it is replaced.
+    struct JobHeader
+    {
+        uint32_t index;
+        int32_t  asserts;
+        int32_t  assertsFailed;
+        uint32_t testCasesFailed;
+        uint32_t outputSize;
+    };
+
+    bool writeAll(int fd, const void* data, size_t size) {
+        const char* p = static_cast<const char*>(data);
+        while(size != 0) {
+            const ssize_t n = ::write(fd, p, size);
+            if(n < 0 && errno == EINTR)
+                continue;
+            if(n <= 0)
+                return false;
+            p += n;
+            size -= size_t(n);
+        }
+        return true;
+    }
+
+    bool readAll(int fd, void* data, size_t size) {
+        char* p = static_cast<char*>(data);
+        while(size != 0) {
+            const ssize_t n = ::read(fd, p, size);
+            if(n < 0 && errno == EINTR)
+                continue;
+            if(n <= 0)
+                return false;
+            p += n;
+            size -= size_t(n);
+        }
+        return true;
+    }
+
+    struct JobWorker
+    {
+        pid_t pid     = -1;
+        int   task    = -1; // parent writes indices here
+        int   result  = -1; // and reads results here
+        long  running = -1; // index in flight
+        std::string inbox;
+    };
+
+    struct JobResult
+    {
+        bool        done = false;
+        JobHeader   header{};
+        std::string output;
+    };
+
+    template <typename RunOne, typename MakeReporters>
+    void runInWorker(ContextState* p, const std::vector<const TestCase*>& tests, int task, int result,
+                     RunOne& runOne, MakeReporters& makeReporters) {
+        std::ostringstream buffer;
+        for(auto& curr : p->reporters_currently_used)
+            delete curr;
+        p->reporters_currently_used.clear();
+        p->cout = &buffer;
+        makeReporters();
+        uint32_t index = 0;
+        while(readAll(task, &index, sizeof(index)) && index < tests.size()) {
+            const int      asserts         = p->numAsserts;
+            const int      assertsFailed   = p->numAssertsFailed;
+            const unsigned testCasesFailed = p->numTestCasesFailed;
+            runOne(*tests[index]);
+            const std::string output = buffer.str();
+            buffer.str(std::string());
+            buffer.clear();
+            const JobHeader header{index, p->numAsserts - asserts, p->numAssertsFailed - assertsFailed,
+                                   p->numTestCasesFailed - testCasesFailed, uint32_t(output.size())};
+            if(!writeAll(result, &header, sizeof(header)) ||
+               !writeAll(result, output.data(), output.size()))
+                break;
+        }
+        // skip the static destructors and atexit handlers the parent will run
+        _exit(0);
+    }
+
+    template <typename RunOne, typename MakeReporters>
+    void runJobs(ContextState* p, const std::vector<const TestCase*>& tests, RunOne& runOne,
+                 MakeReporters& makeReporters) {
+        const size_t count = tests.size();
+        const size_t jobs  = std::min(size_t(p->jobs), count);
+        std::vector<JobResult> results(count);
+        std::vector<JobWorker> workers(jobs);
+        size_t next    = 0;
+        size_t emitted = 0;
+
+        // a worker that died must not take the parent with it through SIGPIPE
+        void (*oldPipeHandler)(int) = std::signal(SIGPIPE, SIG_IGN);
+        p->cout->flush();
+        std::cout.flush();
+        std::cerr.flush();
+
+        auto closeTask = [](JobWorker& w) {
+            if(w.task != -1)
+                ::close(w.task);
+            w.task = -1;
+        };
+
+        auto assign = [&](JobWorker& w) {
+            const bool aborting = p->abort_after > 0 && p->numAssertsFailed >= p->abort_after;
+            if(next < count && !aborting) {
+                const uint32_t index = uint32_t(next);
+                if(writeAll(w.task, &index, sizeof(index))) {
+                    w.running = long(next++);
+                    return;
+                }
+            }
+            closeTask(w);
+        };
+
+        auto spawn = [&](JobWorker& w) {
+            int task[2];
+            int result[2];
+            if(::pipe(task) != 0)
+                return false;
+            if(::pipe(result) != 0) {
+                ::close(task[0]);
+                ::close(task[1]);
+                return false;
+            }
+            const pid_t pid = ::fork();
+            if(pid < 0) {
+                ::close(task[0]);
+                ::close(task[1]);
+                ::close(result[0]);
+                ::close(result[1]);
+                return false;
+            }
+            if(pid == 0) {
+                ::close(task[1]);
+                ::close(result[0]);
+                // other workers' pipes, so their EOFs are not held up by this one
+                for(auto& other : workers) {
+                    if(other.task != -1)
+                        ::close(other.task);
+                    if(other.result != -1)
+                        ::close(other.result);
+                }
+                runInWorker(p, tests, task[0], result[1], runOne, makeReporters);
+            }
+            ::close(task[0]);
+            ::close(result[1]);
+            w.pid     = pid;
+            w.task    = task[1];
+            w.result  = result[0];
+            w.running = -1;
+            w.inbox.clear();
+            assign(w);
+            return true;
+        };
+
+        // test cases that no worker will run (after a failed fork or an
+        // abort) count as skipped, as they would serially
+        auto abandonUnassigned = [&]() {
+            for(; next < count; ++next) {
+                results[next].done = true;
+                p->numTestCasesPassingFilters--;
+            }
+        };
+
+        auto emit = [&]() {
+            while(emitted < count && results[emitted].done) {
+                const JobResult& r = results[emitted++];
+                *p->cout << r.output;
+                p->numAsserts += r.header.asserts;
+                p->numAssertsFailed += r.header.assertsFailed;
+                p->numTestCasesFailed += r.header.testCasesFailed;
+            }
+            p->cout->flush();
+        };
+
+        for(auto& w : workers)
+            if(!spawn(w))
+                break;
+        if(std::none_of(workers.begin(), workers.end(), [](const JobWorker& w) { return w.pid > 0; }))
+            abandonUnassigned();
+
+        while(emitted < count) {
+            std::vector<pollfd> fds;
+            std::vector<JobWorker*> owners;
+            for(auto& w : workers) {
+                if(w.result != -1) {
+                    fds.push_back(pollfd{w.result, POLLIN, 0});
+                    owners.push_back(&w);
+                }
+            }
+            if(fds.empty()) {
+                abandonUnassigned();
+                emit();
+                break;
+            }
+            if(::poll(fds.data(), nfds_t(fds.size()), -1) < 0) {
+                if(errno == EINTR)
+                    continue;
+                break;
+            }
+            for(size_t i = 0; i < fds.size(); ++i) {
+                if(fds[i].revents == 0)
+                    continue;
+                JobWorker& w = *owners[i];
+                char chunk[65536];
+                const ssize_t n = ::read(w.result, chunk, sizeof(chunk));
+                if(n < 0 && errno == EINTR)
+                    continue;
+                if(n > 0) {
+                    w.inbox.append(chunk, size_t(n));
+                    while(w.inbox.size() >= sizeof(JobHeader)) {
+                        JobHeader header;
+                        std::memcpy(&header, w.inbox.data(), sizeof(header));
+                        if(w.inbox.size() < sizeof(header) + header.outputSize)
+                            break;
+                        JobResult& r = results[header.index];
+                        r.header     = header;
+                        r.output     = w.inbox.substr(sizeof(header), header.outputSize);
+                        r.done       = true;
+                        w.inbox.erase(0, sizeof(header) + header.outputSize);
+                        w.running = -1;
+                        emit();
+                        assign(w);
+                    }
+                    continue;
+                }
+                // the worker is gone: reap it and fail what it was running
+                ::close(w.result);
+                w.result = -1;
+                closeTask(w);
+                int status = 0;
+                ::waitpid(w.pid, &status, 0);
+                w.pid = -1;
+                if(w.running != -1) {
+                    JobResult& r = results[size_t(w.running)];
+                    std::ostringstream message;
+                    message << Color::Red << "[doctest] " << Color::None << "test case \""
+                            << tests[size_t(w.running)]->m_name << "\" killed its --jobs worker";
+                    if(WIFSIGNALED(status))
+                        message << " (signal " << WTERMSIG(status) << ")";
+                    else if(WIFEXITED(status))
+                        message << " (exit code " << WEXITSTATUS(status) << ")";
+                    message << "\n";
+                    r.output                 = message.str();
+                    r.header.testCasesFailed = 1;
+                    r.done                   = true;
+                    w.running                = -1;
+                    emit();
+                    if(next < count)
+                        spawn(w);
+                }
+            }
+        }
+
+        for(auto& w : workers) {
+            closeTask(w);
+            if(w.result != -1)
+                ::close(w.result);
+            if(w.pid > 0)
+                ::waitpid(w.pid, nullptr, 0);
+        }
+        std::signal(SIGPIPE, oldPipeHandler);
+    }
+} // namespace
+} // namespace detail
+#endif // DOCTEST_JOBS_SUPPORTED
+
 int Context::run() {
     using namespace detail;
 
@@ -6847,22 +7152,25 @@ int Context::run() {
     if(p->filters[8].empty())
         p->filters[8].push_back("console");
 
-    // check to see if any of the registered reporters has been selected
-    for(auto& curr : getReporters()) {
-        if(matchesAny(curr.first.second.c_str(), p->filters[8], false, p->case_sensitive))
-            p->reporters_currently_used.push_back(curr.second(*g_cs));
-    }
+    auto makeReporters = [&]() {
+        // check to see if any of the registered reporters has been selected
+        for(auto& curr : getReporters()) {
+            if(matchesAny(curr.first.second.c_str(), p->filters[8], false, p->case_sensitive))
+                p->reporters_currently_used.push_back(curr.second(*g_cs));
+        }
 
-    // TODO: check if there is nothing in reporters_currently_used
+        // TODO: check if there is nothing in reporters_currently_used
 
-    // prepend all listeners
-    for(auto& curr : getListeners())
-        p->reporters_currently_used.insert(p->reporters_currently_used.begin(), curr.second(*g_cs));
+        // prepend all listeners
+        for(auto& curr : getListeners())
+            p->reporters_currently_used.insert(p->reporters_currently_used.begin(), curr.second(*g_cs));
 
 #ifdef DOCTEST_PLATFORM_WINDOWS
-    if(isDebuggerActive() && p->no_debug_output == false)
-        p->reporters_currently_used.push_back(new DebugOutputWindowReporter(*g_cs));
+        if(isDebuggerActive() && p->no_debug_output == false)
+            p->reporters_currently_used.push_back(new DebugOutputWindowReporter(*g_cs));
 #endif // DOCTEST_PLATFORM_WINDOWS
+    };
+    makeReporters();
 
     // handle version, help and no_run
     if(p->no_run || p->version || p->help || p->list_reporters) {
@@ -6908,6 +7216,85 @@ int Context::run() {
     bool                             query_mode = p->count || p->list_test_cases || p->list_test_suites;
     std::vector<const TestCaseData*> queryResults;
 
+    // only the console reporter writes per test case, so only its output
+    // can be stitched back together from the workers
+    bool parallel = false;
+#ifdef DOCTEST_JOBS_SUPPORTED
+    parallel = p->jobs > 1 && !query_mode && getListeners().empty() && p->filters[8].size() == 1 &&
+               p->filters[8][0].compare("console", true) == 0;
+#endif // DOCTEST_JOBS_SUPPORTED
+    std::vector<const TestCase*> parallelTests;
+
+    auto runTestCase = [&](const TestCase& tc) {
+        p->currentTest = &tc;
+
+        p->failure_flags = TestCaseFailureReason::None;
+        p->seconds       = 0;
+
+        // reset atomic counters
+        p->numAssertsFailedCurrentTest_atomic = 0;
+        p->numAssertsCurrentTest_atomic       = 0;
+
+        p->fullyTraversedSubcases.clear();
+
+        DOCTEST_ITERATE_THROUGH_REPORTERS(test_case_start, tc);
+
+        p->timer.start();
+
+        bool run_test = true;
+
+        do {
+            // reset some of the fields for subcases (except for the set of fully passed ones)
+            p->reachedLeaf = false;
+            // May not be empty if previous subcase exited via exception.
+            p->subcaseStack.clear();
+            p->currentSubcaseDepth = 0;
+
+            p->shouldLogCurrentException = true;
+
+            // reset stuff for logging with INFO()
+            p->stringifiedContexts.clear();
+
+#ifndef DOCTEST_CONFIG_NO_EXCEPTIONS
+            try {
+#endif // DOCTEST_CONFIG_NO_EXCEPTIONS
+// MSVC 2015 diagnoses fatalConditionHandler as unused (because reset() is a static method)
+DOCTEST_MSVC_SUPPRESS_WARNING_WITH_PUSH(4101) // unreferenced local variable
+                FatalConditionHandler fatalConditionHandler; // Handle signals
+                // execute the test
+                tc.m_test();
+                fatalConditionHandler.reset();
+DOCTEST_MSVC_SUPPRESS_WARNING_POP
+#ifndef DOCTEST_CONFIG_NO_EXCEPTIONS
+            } catch(const TestFailureException&) {
+                p->failure_flags |= TestCaseFailureReason::AssertFailure;
+            } catch(...) {
+                DOCTEST_ITERATE_THROUGH_REPORTERS(test_case_exception,
+                                                  {translateActiveException(), false});
+                p->failure_flags |= TestCaseFailureReason::Exception;
+            }
+#endif // DOCTEST_CONFIG_NO_EXCEPTIONS
+
+            // exit this loop if enough assertions have failed - even if there are more subcases
+            if(p->abort_after > 0 &&
+               p->numAssertsFailed + p->numAssertsFailedCurrentTest_atomic >= p->abort_after) {
+                run_test = false;
+                p->failure_flags |= TestCaseFailureReason::TooManyFailedAsserts;
+            }
+
+            if(!p->nextSubcaseStack.empty() && run_test)
+                DOCTEST_ITERATE_THROUGH_REPORTERS(test_case_reenter, tc);
+            if(p->nextSubcaseStack.empty())
+                run_test = false;
+        } while(run_test);
+
+        p->finalizeTestCaseData();
+
+        DOCTEST_ITERATE_THROUGH_REPORTERS(test_case_end, *g_cs);
+
+        p->currentTest = nullptr;
+    };
+
     if(!query_mode)
         DOCTEST_ITERATE_THROUGH_REPORTERS(test_run_start, DOCTEST_EMPTY);
 
@@ -6966,82 +7353,25 @@ int Context::run() {
             continue;
         }
 
-        // execute the test if it passes all the filtering
-        {
-            p->currentTest = &tc;
-
-            p->failure_flags = TestCaseFailureReason::None;
-            p->seconds       = 0;
-
-            // reset atomic counters
-            p->numAssertsFailedCurrentTest_atomic = 0;
-            p->numAssertsCurrentTest_atomic       = 0;
-
-            p->fullyTraversedSubcases.clear();
-
-            DOCTEST_ITERATE_THROUGH_REPORTERS(test_case_start, tc);
-
-            p->timer.start();
-
-            bool run_test = true;
-
-            do {
-                // reset some of the fields for subcases (except for the set of fully passed ones)
-                p->reachedLeaf = false;
-                // May not be empty if previous subcase exited via exception.
-                p->subcaseStack.clear();
-                p->currentSubcaseDepth = 0;
-
-                p->shouldLogCurrentException = true;
-
-                // reset stuff for logging with INFO()
-                p->stringifiedContexts.clear();
-
-#ifndef DOCTEST_CONFIG_NO_EXCEPTIONS
-                try {
-#endif // DOCTEST_CONFIG_NO_EXCEPTIONS
-// MSVC 2015 diagnoses fatalConditionHandler as unused (because reset() is a static method)
-DOCTEST_MSVC_SUPPRESS_WARNING_WITH_PUSH(4101) // unreferenced local variable
-                    FatalConditionHandler fatalConditionHandler; // Handle signals
-                    // execute the test
-                    tc.m_test();
-                    fatalConditionHandler.reset();
-DOCTEST_MSVC_SUPPRESS_WARNING_POP
-#ifndef DOCTEST_CONFIG_NO_EXCEPTIONS
-                } catch(const TestFailureException&) {
-                    p->failure_flags |= TestCaseFailureReason::AssertFailure;
-                } catch(...) {
-                    DOCTEST_ITERATE_THROUGH_REPORTERS(test_case_exception,
-                                                      {translateActiveException(), false});
-                    p->failure_flags |= TestCaseFailureReason::Exception;
-                }
-#endif // DOCTEST_CONFIG_NO_EXCEPTIONS
-
-                // exit this loop if enough assertions have failed - even if there are more subcases
-                if(p->abort_after > 0 &&
-                   p->numAssertsFailed + p->numAssertsFailedCurrentTest_atomic >= p->abort_after) {
-                    run_test = false;
-                    p->failure_flags |= TestCaseFailureReason::TooManyFailedAsserts;
-                }
-
-                if(!p->nextSubcaseStack.empty() && run_test)
-                    DOCTEST_ITERATE_THROUGH_REPORTERS(test_case_reenter, tc);
-                if(p->nextSubcaseStack.empty())
-                    run_test = false;
-            } while(run_test);
-
-            p->finalizeTestCaseData();
-
-            DOCTEST_ITERATE_THROUGH_REPORTERS(test_case_end, *g_cs);
+        // handed to the workers once the filtering is done
+        if(parallel) {
+            parallelTests.push_back(&tc);
+            continue;
+        }
 
-            p->currentTest = nullptr;
+        // execute the test if it passes all the filtering
+        runTestCase(tc);
 
-            // stop executing tests if enough assertions have failed
-            if(p->abort_after > 0 && p->numAssertsFailed >= p->abort_after)
-                break;
-        }
+        // stop executing tests if enough assertions have failed
+        if(p->abort_after > 0 && p->numAssertsFailed >= p->abort_after)
+            break;
     }
 
+#ifdef DOCTEST_JOBS_SUPPORTED
+    if(parallel && !parallelTests.empty())
+        runJobs(p, parallelTests, runTestCase, makeReporters);
+#endif // DOCTEST_JOBS_SUPPORTED
+
     if(!query_mode) {
         DOCTEST_ITERATE_THROUGH_REPORTERS(test_run_end, *g_cs);
     } else {
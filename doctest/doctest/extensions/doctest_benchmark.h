@@ -0,0 +1,755 @@
+//
+// doctest_benchmark.h - microbenchmarks inside doctest test cases
+//
+// Distributed under the MIT Software License
+// See accompanying file LICENSE.txt or copy at
+// https://opensource.org/licenses/MIT
+//
+// Usage:
+//
+//   TEST_CASE("queue") {
+//       SPSCQueue<int, 1024> q;
+//       BENCHMARK("enqueue + dequeue") {
+//           q.enqueue(1);
+//           int v;
+//           q.dequeue(v);
+//           doctest::bench::keep(v);
+//       }
+//       CHECK(doctest::bench::last().median < 50.0);
+//   }
+//
+// The body is the loop body of the benchmark. It first runs during a warmup
+// that also calibrates how many iterations one sample needs. After that, a
+// fixed number of samples is timed. Each sample is converted to ns/op.
+// Samples outside the Tukey fences (1.5 IQR beyond the quartiles) are dropped
+// as outliers, and a line with the median, mean, percentiles and spread of
+// the rest is printed. Benchmarks run wherever their test case runs, so -tc and
+// -sc select them like any other code in a test.
+//
+// DOCTEST_BENCHMARK_SAMPLES and DOCTEST_BENCHMARK_WARMUP_MS override the
+// defaults from the environment. With 0 samples each body runs once,
+// untimed, which keeps sanitizer and debug runs quick.
+//
+// Machine-readable results and regression gating:
+//
+//   -r=benchmark [--benchmark-out=now.json]
+//       Writes every benchmark of the run as JSON: ns/op percentiles,
+//       throughput, and the CPU model, compiler and commit they were measured
+//       with. Without --benchmark-out the JSON goes to the regular output
+//       (stdout or --out) and the per-benchmark lines are left out; use
+//       -r=console,benchmark --benchmark-out=... to get both.
+//
+//   --baseline=before.json [--max-regression=5%]
+//       Compares each benchmark with the entry of the same test case and name
+//       in a file written as above, and fails the test case when the median
+//       is more than max-regression slower. Benchmarks missing from the
+//       baseline are not checked, so the baseline file decides which paths
+//       are gated.
+//
+// The commit id is DOCTEST_BENCHMARK_COMMIT when the build defines it, else
+// the GIT_COMMIT environment variable.
+//
+
+#ifndef DOCTEST_BENCHMARK_H
+#define DOCTEST_BENCHMARK_H
+
+#ifndef DOCTEST_LIBRARY_INCLUDED
+#include "../doctest.h"
+#endif
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace doctest {
+namespace bench {
+
+    struct Options {
+        // Warmup and calibration time per benchmark.
+        double warmup_ms = 20.0;
+        // Target duration of one timed sample.
+        double sample_ms = 2.0;
+        // Timed samples per benchmark; 0 runs each body once, untimed.
+        unsigned samples = 30;
+    };
+
+    namespace detail {
+        inline double envNumber(const char* name, double fallback) {
+            const char* value = std::getenv(name);
+            if(value == nullptr || *value == '\0')
+                return fallback;
+            char*        end    = nullptr;
+            const double parsed = std::strtod(value, &end);
+            return (*end == '\0' && parsed >= 0.0) ? parsed : fallback;
+        }
+
+        inline Options fromEnvironment() {
+            Options options;
+            options.samples = static_cast<unsigned>(
+                    envNumber("DOCTEST_BENCHMARK_SAMPLES", options.samples));
+            options.warmup_ms = envNumber("DOCTEST_BENCHMARK_WARMUP_MS", options.warmup_ms);
+            return options;
+        }
+
+        // Linear interpolation between the closest ranks of sorted values.
+        inline double percentile(const std::vector<double>& sorted, double p) {
+            if(sorted.empty())
+                return 0.0;
+            const double rank  = p * static_cast<double>(sorted.size() - 1);
+            const size_t lower = static_cast<size_t>(rank);
+            const size_t upper = std::min(lower + 1, sorted.size() - 1);
+            return sorted[lower] + (sorted[upper] - sorted[lower]) * (rank - static_cast<double>(lower));
+        }
+    } // namespace detail
+
+    // Defaults, adjustable before or between benchmarks.
+    inline Options& options() {
+        static Options instance = detail::fromEnvironment();
+        return instance;
+    }
+
+    // One finished benchmark. Times are ns per iteration over the samples that were kept.
+    struct Result {
+        std::string   test_case;
+        std::string   name;
+        const char*   file       = "";
+        int           line       = 0;
+        std::uint64_t iterations = 0; // per sample
+        unsigned      samples    = 0; // kept
+        unsigned      outliers   = 0; // dropped
+        double        mean       = 0.0;
+        double        median     = 0.0;
+        double        p90        = 0.0;
+        double        p99        = 0.0;
+        double        min        = 0.0;
+        double        max        = 0.0;
+        double        stddev     = 0.0;
+
+        // Iterations per second at the median.
+        double throughput() const { return median > 0.0 ? 1e9 / median : 0.0; }
+    };
+
+    // Rejects outliers from ns-per-iteration samples and summarises the rest.
+    inline Result summarize(std::string name, std::vector<double> samples, std::uint64_t iterations) {
+        Result result;
+        result.name       = std::move(name);
+        result.iterations = iterations;
+        if(samples.empty())
+            return result;
+        std::sort(samples.begin(), samples.end());
+        const double q1    = detail::percentile(samples, 0.25);
+        const double q3    = detail::percentile(samples, 0.75);
+        const double fence = 1.5 * (q3 - q1);
+        std::vector<double> kept;
+        for(double sample : samples)
+            if(sample >= q1 - fence && sample <= q3 + fence)
+                kept.push_back(sample);
+        result.samples  = static_cast<unsigned>(kept.size());
+        result.outliers = static_cast<unsigned>(samples.size() - kept.size());
+
+        double sum = 0.0;
+        for(double sample : kept)
+            sum += sample;
+        result.mean = sum / static_cast<double>(kept.size());
+        double squares = 0.0;
+        for(double sample : kept)
+            squares += (sample - result.mean) * (sample - result.mean);
+        result.stddev = kept.size() > 1 ? std::sqrt(squares / static_cast<double>(kept.size() - 1)) : 0.0;
+        result.median = detail::percentile(kept, 0.5);
+        result.p90    = detail::percentile(kept, 0.9);
+        result.p99    = detail::percentile(kept, 0.99);
+        result.min    = kept.front();
+        result.max    = kept.back();
+        return result;
+    }
+
+    // Every benchmark finished in this process so far, in order.
+    inline std::vector<Result>& results() {
+        static std::vector<Result> all;
+        return all;
+    }
+
+    inline std::mutex& resultsMutex() {
+        static std::mutex mutex;
+        return mutex;
+    }
+
+    // The most recently finished benchmark; empty before the first.
+    inline Result last() {
+        std::lock_guard<std::mutex> lock(resultsMutex());
+        return results().empty() ? Result() : results().back();
+    }
+
+    namespace detail {
+        inline void writeString(std::ostream& out, const std::string& text) {
+            out << '"';
+            for(unsigned char c : text) {
+                if(c == '"' || c == '\\') {
+                    out << '\\' << c;
+                } else if(c < 0x20) {
+                    char escaped[8];
+                    std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+                    out << escaped;
+                } else {
+                    out << c;
+                }
+            }
+            out << '"';
+        }
+
+        inline void writeNumber(std::ostream& out, double value) {
+            char text[32];
+            std::snprintf(text, sizeof(text), "%.6g", std::isfinite(value) ? value : 0.0);
+            out << text;
+        }
+
+        // Just enough JSON to read back what writeReport() produces: objects,
+        // arrays, strings and numbers; true, false and null are skipped.
+        class JsonReader
+        {
+        public:
+            explicit JsonReader(std::string text)
+                    : m_text(std::move(text)) {}
+
+            // Reads each object of the top-level "benchmarks" array into
+            // out. False if the text is not JSON of that shape.
+            bool benchmarks(std::vector<Result>& out) {
+                if(!consume('{'))
+                    return false;
+                if(consume('}'))
+                    return false;
+                bool found = false;
+                do {
+                    std::string key;
+                    if(!string(key) || !consume(':'))
+                        return false;
+                    if(key == "benchmarks") {
+                        if(!array(out))
+                            return false;
+                        found = true;
+                    } else if(!skip()) {
+                        return false;
+                    }
+                } while(consume(','));
+                return consume('}') && found;
+            }
+
+        private:
+            bool array(std::vector<Result>& out) {
+                if(!consume('['))
+                    return false;
+                if(consume(']'))
+                    return true;
+                do {
+                    Result result;
+                    if(!object(result))
+                        return false;
+                    out.push_back(std::move(result));
+                } while(consume(','));
+                return consume(']');
+            }
+
+            bool object(Result& result) {
+                if(!consume('{'))
+                    return false;
+                if(consume('}'))
+                    return true;
+                do {
+                    std::string key;
+                    if(!string(key) || !consume(':'))
+                        return false;
+                    bool ok = true;
+                    if(key == "test_case")
+                        ok = string(result.test_case);
+                    else if(key == "name")
+                        ok = string(result.name);
+                    else if(key == "median_ns")
+                        ok = number(result.median);
+                    else if(key == "mean_ns")
+                        ok = number(result.mean);
+                    else if(key == "p90_ns")
+                        ok = number(result.p90);
+                    else if(key == "p99_ns")
+                        ok = number(result.p99);
+                    else if(key == "min_ns")
+                        ok = number(result.min);
+                    else if(key == "max_ns")
+                        ok = number(result.max);
+                    else if(key == "stddev_ns")
+                        ok = number(result.stddev);
+                    else
+                        ok = skip();
+                    if(!ok)
+                        return false;
+                } while(consume(','));
+                return consume('}');
+            }
+
+            bool skip() {
+                whitespace();
+                if(m_at == m_text.size())
+                    return false;
+                const char c = m_text[m_at];
+                if(c == '"') {
+                    std::string ignored;
+                    return string(ignored);
+                }
+                if(c == '{' || c == '[') {
+                    const char close = c == '{' ? '}' : ']';
+                    ++m_at;
+                    if(consume(close))
+                        return true;
+                    do {
+                        if(c == '{') {
+                            std::string key;
+                            if(!string(key) || !consume(':'))
+                                return false;
+                        }
+                        if(!skip())
+                            return false;
+                    } while(consume(','));
+                    return consume(close);
+                }
+                for(const char* word : {"true", "false", "null"}) {
+                    const size_t length = std::strlen(word);
+                    if(m_text.compare(m_at, length, word) == 0) {
+                        m_at += length;
+                        return true;
+                    }
+                }
+                double ignored;
+                return number(ignored);
+            }
+
+            bool string(std::string& out) {
+                if(!consume('"'))
+                    return false;
+                out.clear();
+                while(m_at < m_text.size()) {
+                    const char c = m_text[m_at++];
+                    if(c == '"')
+                        return true;
+                    if(c != '\\') {
+                        out += c;
+                        continue;
+                    }
+                    if(m_at == m_text.size())
+                        return false;
+                    const char escaped = m_text[m_at++];
+                    switch(escaped) {
+                        case 'n': out += '\n'; break;
+                        case 't': out += '\t'; break;
+                        case 'r': out += '\r'; break;
+                        case 'b': out += '\b'; break;
+                        case 'f': out += '\f'; break;
+                        case 'u': {
+                            // Only the control characters writeString() escapes.
+                            if(m_at + 4 > m_text.size())
+                                return false;
+                            out += static_cast<char>(std::strtol(m_text.substr(m_at, 4).c_str(), nullptr, 16));
+                            m_at += 4;
+                            break;
+                        }
+                        default: out += escaped; break;
+                    }
+                }
+                return false;
+            }
+
+            bool number(double& out) {
+                whitespace();
+                const char* begin = m_text.c_str() + m_at;
+                char*       end   = nullptr;
+                out               = std::strtod(begin, &end);
+                if(end == begin)
+                    return false;
+                m_at += static_cast<size_t>(end - begin);
+                return true;
+            }
+
+            bool consume(char c) {
+                whitespace();
+                if(m_at < m_text.size() && m_text[m_at] == c) {
+                    ++m_at;
+                    return true;
+                }
+                return false;
+            }
+
+            void whitespace() {
+                while(m_at < m_text.size() && (m_text[m_at] == ' ' || m_text[m_at] == '\t' ||
+                                               m_text[m_at] == '\r' || m_text[m_at] == '\n'))
+                    ++m_at;
+            }
+
+            std::string m_text;
+            size_t      m_at = 0;
+        };
+
+        inline std::string cpuModel() {
+            std::ifstream cpuinfo("/proc/cpuinfo");
+            std::string   line;
+            while(std::getline(cpuinfo, line)) {
+                if(line.compare(0, 10, "model name") == 0) {
+                    const size_t colon = line.find(':');
+                    const size_t start = line.find_first_not_of(' ', colon + 1);
+                    if(colon != std::string::npos && start != std::string::npos)
+                        return line.substr(start);
+                }
+            }
+            return "unknown";
+        }
+
+        inline std::string commit() {
+#if defined(DOCTEST_BENCHMARK_COMMIT)
+            return DOCTEST_BENCHMARK_COMMIT;
+#else
+            const char* fromEnvironment = std::getenv("GIT_COMMIT");
+            return fromEnvironment != nullptr && *fromEnvironment != '\0' ? fromEnvironment : "unknown";
+#endif
+        }
+
+        inline std::string compiler() {
+#if defined(__clang__)
+            return "clang " __clang_version__;
+#elif defined(__GNUC__)
+            return "gcc " __VERSION__;
+#elif defined(_MSC_VER)
+            return "msvc " + std::to_string(_MSC_FULL_VER);
+#else
+            return "unknown";
+#endif
+        }
+
+        // Set by the benchmark reporter when the JSON shares the regular
+        // output, so that the per-benchmark lines stay out of it.
+        inline bool& quiet() {
+            static bool instance = false;
+            return instance;
+        }
+    } // namespace detail
+
+    // Writes results with the machine they were measured on as one JSON document.
+    inline void writeReport(std::ostream& out, const std::vector<Result>& results) {
+        char              timestamp[32] = "";
+        const std::time_t now           = std::time(nullptr);
+        std::tm           utc{};
+#if defined(_WIN32)
+        gmtime_s(&utc, &now);
+#else
+        gmtime_r(&now, &utc);
+#endif
+        std::strftime(timestamp, sizeof(timestamp), "%Y-%m-%dT%H:%M:%SZ", &utc);
+
+        out << "{\n  \"context\": {\n    \"cpu\": ";
+        detail::writeString(out, detail::cpuModel());
+        out << ",\n    \"commit\": ";
+        detail::writeString(out, detail::commit());
+        out << ",\n    \"compiler\": ";
+        detail::writeString(out, detail::compiler());
+        out << ",\n    \"doctest\": \"" DOCTEST_VERSION_STR "\",\n    \"timestamp\": \"" << timestamp
+            << "\"\n  },\n  \"benchmarks\": [";
+        for(size_t i = 0; i < results.size(); ++i) {
+            const Result& result = results[i];
+            out << (i == 0 ? "\n" : ",\n") << "    {\"test_case\": ";
+            detail::writeString(out, result.test_case);
+            out << ", \"name\": ";
+            detail::writeString(out, result.name);
+            const std::pair<const char*, double> fields[] = {
+                    {"median_ns", result.median}, {"mean_ns", result.mean},
+                    {"p90_ns", result.p90},       {"p99_ns", result.p99},
+                    {"min_ns", result.min},       {"max_ns", result.max},
+                    {"stddev_ns", result.stddev}, {"ops_per_second", result.throughput()}};
+            for(const auto& field : fields) {
+                out << ", \"" << field.first << "\": ";
+                detail::writeNumber(out, field.second);
+            }
+            out << ", \"iterations\": " << result.iterations << ", \"samples\": " << result.samples
+                << ", \"outliers\": " << result.outliers << "}";
+        }
+        out << (results.empty() ? "]\n}\n" : "\n  ]\n}\n");
+    }
+
+    // Reads the benchmarks of a writeReport() document. False if it is not one.
+    inline bool readReport(std::istream& in, std::vector<Result>& out) {
+        std::stringstream text;
+        text << in.rdbuf();
+        std::vector<Result> parsed;
+        if(!detail::JsonReader(text.str()).benchmarks(parsed))
+            return false;
+        out = std::move(parsed);
+        return true;
+    }
+
+    // "5%" or "5" -> 5.0; negative for anything else.
+    inline double parseRegression(const char* text) {
+        if(text == nullptr || *text == '\0')
+            return -1.0;
+        char*        end   = nullptr;
+        const double limit = std::strtod(text, &end);
+        if(end == text || !(limit >= 0.0))
+            return -1.0;
+        if(*end == '%')
+            ++end;
+        return *end == '\0' ? limit : -1.0;
+    }
+
+    // True if current's median is more than maxPercent slower than baseline's.
+    inline bool regressed(const Result& current, const Result& baseline, double maxPercent) {
+        return baseline.median > 0.0 && current.median > baseline.median * (1.0 + maxPercent / 100.0);
+    }
+
+    namespace detail {
+        struct Baseline {
+            bool                ok = false;
+            std::string         error;
+            std::vector<Result> results;
+        };
+
+        // Loaded once per process, on the first benchmark that needs it.
+        inline const Baseline& baseline(const char* path) {
+            static const Baseline loaded = [path] {
+                Baseline      result;
+                std::ifstream in(path);
+                if(!in)
+                    result.error = std::string("cannot open baseline ") + path;
+                else if(!readReport(in, result.results))
+                    result.error = std::string("baseline ") + path + " is not benchmark JSON";
+                else
+                    result.ok = true;
+                return result;
+            }();
+            return loaded;
+        }
+    } // namespace detail
+
+    // Makes value count as used, so the compiler cannot drop the code that
+    // computed it.
+    template <typename T>
+    inline void keep(const T& value) {
+#if defined(__GNUC__) || defined(__clang__)
+        asm volatile("" : : "r,m"(value) : "memory");
+#else
+        static const volatile void* sink;
+        sink = &value;
+#endif
+    }
+
+    // Drives a BENCHMARK body: running() is the loop condition, and reads the
+    // clock only when a batch of iterations has finished, so the cost per
+    // iteration is a decrement and a branch.
+    class Benchmark
+    {
+    public:
+        explicit Benchmark(const char* name, const char* file = "", int line = 0)
+                : m_name(name)
+                , m_file(file)
+                , m_line(line)
+                , m_options(options()) {}
+
+        bool running() {
+            if(m_left != 0) {
+                --m_left;
+                return true;
+            }
+            return nextBatch();
+        }
+
+    private:
+        using clock = std::chrono::steady_clock;
+
+        enum class Phase
+        {
+            Start,
+            Warmup,
+            Measure,
+            Done
+        };
+
+        bool nextBatch() {
+            const clock::time_point now = clock::now();
+            const double elapsed = std::chrono::duration<double, std::nano>(now - m_batchStart).count();
+            switch(m_phase) {
+                case Phase::Start:
+                    if(m_options.samples == 0) {
+                        m_phase = Phase::Done;
+                        return true;
+                    }
+                    m_phase      = Phase::Warmup;
+                    m_warmupEnd  = now + toDuration(m_options.warmup_ms);
+                    m_batch      = 1;
+                    break;
+                case Phase::Warmup:
+                    // Doubles the batch until one takes a sample's length, and
+                    // keeps running until the warmup time is also up.
+                    if(elapsed < m_options.sample_ms * 1e6) {
+                        m_batch *= 2;
+                    } else if(now >= m_warmupEnd) {
+                        const double perIteration = elapsed / static_cast<double>(m_batch);
+                        m_batch = std::max<std::uint64_t>(
+                                1, static_cast<std::uint64_t>(m_options.sample_ms * 1e6 / perIteration));
+                        m_phase = Phase::Measure;
+                        m_samples.reserve(m_options.samples);
+                    }
+                    break;
+                case Phase::Measure:
+                    m_samples.push_back(elapsed / static_cast<double>(m_batch));
+                    if(m_samples.size() == m_options.samples) {
+                        finish();
+                        m_phase = Phase::Done;
+                        return false;
+                    }
+                    break;
+                case Phase::Done:
+                    return false;
+            }
+            m_left       = m_batch - 1;
+            m_batchStart = clock::now();
+            return true;
+        }
+
+        void finish() {
+            Result result = summarize(m_name, std::move(m_samples), m_batch);
+            result.file   = m_file;
+            result.line   = m_line;
+            const ContextOptions* context = getContextOptions();
+            if(context != nullptr && context->currentTest != nullptr)
+                result.test_case = context->currentTest->m_name;
+            if(!detail::quiet()) {
+                char line[256];
+                std::snprintf(line, sizeof(line),
+                              "%9.2f ns/op median  (mean %.2f, p90 %.2f, p99 %.2f, min %.2f; %u samples x %llu, "
+                              "%u outliers)",
+                              result.median, result.mean, result.p90, result.p99, result.min, result.samples,
+                              static_cast<unsigned long long>(result.iterations), result.outliers);
+                std::ostream& out = context != nullptr && context->cout != nullptr ? *context->cout : std::cout;
+                out << "[doctest] BENCHMARK " << result.name << ": " << line << std::endl;
+            }
+            if(context != nullptr && context->baseline.size() != 0)
+                compare(result, *context);
+            std::lock_guard<std::mutex> lock(resultsMutex());
+            results().push_back(std::move(result));
+        }
+
+        static void compare(const Result& result, const ContextOptions& context) {
+            const detail::Baseline& baseline = detail::baseline(context.baseline.c_str());
+            const double limit = parseRegression(context.max_regression.c_str());
+            if(!baseline.ok) {
+                DOCTEST_ADD_FAIL_CHECK_AT(result.file, result.line, baseline.error);
+                return;
+            }
+            if(limit < 0.0) {
+                DOCTEST_ADD_FAIL_CHECK_AT(result.file, result.line,
+                                          "invalid --max-regression " << context.max_regression);
+                return;
+            }
+            for(const Result& before : baseline.results) {
+                if(before.test_case != result.test_case || before.name != result.name)
+                    continue;
+                if(regressed(result, before, limit)) {
+                    char message[160];
+                    std::snprintf(message, sizeof(message),
+                                  "%.2f ns/op median, %.1f%% slower than the baseline's %.2f (limit %g%%)",
+                                  result.median, (result.median / before.median - 1.0) * 100.0,
+                                  before.median, limit);
+                    DOCTEST_ADD_FAIL_CHECK_AT(result.file, result.line,
+                                              "BENCHMARK " << result.name << " regressed: " << message);
+                }
+                return;
+            }
+        }
+
+        static clock::duration toDuration(double ms) {
+            return std::chrono::duration_cast<clock::duration>(std::chrono::duration<double, std::milli>(ms));
+        }
+
+        std::string         m_name;
+        const char*         m_file;
+        int                 m_line;
+        Options             m_options;
+        Phase               m_phase = Phase::Start;
+        std::uint64_t       m_left  = 0;
+        std::uint64_t       m_batch = 1;
+        clock::time_point   m_batchStart;
+        clock::time_point   m_warmupEnd;
+        std::vector<double> m_samples;
+    };
+
+    // -r=benchmark: the JSON of writeReport() for the whole run.
+    struct BenchmarkReporter : public IReporter
+    {
+        const ContextOptions& opt;
+
+        BenchmarkReporter(const ContextOptions& co)
+                : opt(co) {
+            detail::quiet() = co.benchmark_out.size() == 0;
+        }
+
+        void report_query(const QueryData&) override {}
+
+        void test_run_start() override {}
+
+        void test_run_end(const TestRunStats&) override {
+            std::vector<Result> all;
+            {
+                std::lock_guard<std::mutex> lock(resultsMutex());
+                all = results();
+            }
+            if(opt.benchmark_out.size() == 0) {
+                writeReport(*opt.cout, all);
+                return;
+            }
+            std::ofstream file(opt.benchmark_out.c_str());
+            writeReport(file, all);
+            if(!file)
+                *opt.cout << "[doctest] cannot write benchmark results to " << opt.benchmark_out << std::endl;
+        }
+
+        void test_case_start(const TestCaseData&) override {}
+
+        void test_case_reenter(const TestCaseData&) override {}
+
+        void test_case_end(const CurrentTestCaseStats&) override {}
+
+        void test_case_exception(const TestCaseException&) override {}
+
+        void subcase_start(const SubcaseSignature&) override {}
+
+        void subcase_end() override {}
+
+        void log_assert(const AssertData&) override {}
+
+        void log_message(const MessageData&) override {}
+
+        void test_case_skipped(const TestCaseData&) override {}
+    };
+
+} // namespace bench
+} // namespace doctest
+
+#ifndef DOCTEST_CONFIG_DISABLE
+DOCTEST_REGISTER_REPORTER("benchmark", 0, doctest::bench::BenchmarkReporter);
+
+#define DOCTEST_BENCHMARK(name)                                                                    \
+    for(::doctest::bench::Benchmark doctest_benchmark_(name, __FILE__, __LINE__);                   \
+        doctest_benchmark_.running();)
+#else
+#define DOCTEST_BENCHMARK(name) for(; false;)
+#endif
+
+#ifndef DOCTEST_CONFIG_NO_SHORT_MACRO_NAMES
+#define BENCHMARK(name) DOCTEST_BENCHMARK(name)
+#endif
+
+#endif // DOCTEST_BENCHMARK_H
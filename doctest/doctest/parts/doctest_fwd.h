@@ -896,6 +896,9 @@ struct ContextOptions //!OCLINT too many fields
 
     // == parameters from the command line
     String   out;       // output filename
+    String   benchmark_out;  // JSON file for the benchmark reporter
+    String   baseline;       // benchmark results to compare against
+    String   max_regression; // how much slower than the baseline a benchmark may get
     String   order_by;  // how tests should be ordered
     unsigned rand_seed; // the seed for rand ordering
 
@@ -903,6 +906,7 @@ struct ContextOptions //!OCLINT too many fields
     unsigned last;  // the last (matching) test to be executed
 
     int abort_after;           // stop tests after this many failed assertions
+    int jobs;                  // worker processes to run test cases in (1 runs them in-process)
     int subcase_filter_levels; // apply the subcase filters for the first N levels
 
     bool success;              // include successful assertions in output
@@ -1,9 +1,52 @@
-#include "String.h"
+#include "StringIntern.h"
 #include "Queue.h"  // 假设你有一个 Queue 类的头文件
+#include "ThreadPool.h"
+#include "UnboundedQueue.h"
+#include "SharedQueue.h"
+#include "BipBuffer.h"
+#include "BroadcastRing.h"
+#include "MultiQueue.h"
+#include "QueueSet.h"
+#include "AwaitableQueue.h"
+#include "ShardedDispatcher.h"
+#include "TimerWheel.h"
+#include "LatencyHistogram.h"
+#include "Topology.h"
+#include "ObjectPool.h"
+#include "Pipeline.h"
+#include "StringRefMap.h"
+#include "StringLoader.h"
+#include "StringPath.h"
+#include "ShardedCounter.h"
+#include "Reclaim.h"
+#include "SlabAllocator.h"
+#include "Tracer.h"
+#include "AsyncLogger.h"
+#include "MessageBus.h"
+#include "SeqLock.h"
+#include "ConcurrentHashMap.h"
+#include "AdaptiveBatcher.h"
+#include "RingBridge.h"
 #define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
 #include <doctest/doctest.h>
+#include <doctest/extensions/doctest_benchmark.h>
 #include <thread>
 #include <vector>
+#include <memory>
+#include <chrono>
+#include <cstring>
+#include <string>
+#include <sys/wait.h>
+#include <sys/mman.h>
+#include <poll.h>
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <unordered_set>
+#include <set>
+#include <map>
+#include <unordered_map>
 //#include "doctest.h"
 
 
@@ -46,6 +89,69 @@ TEST_CASE("SPSCQueue Tests") {
         REQUIRE(q.empty());
     }
 
+    SUBCASE("Full Queue") {
+        int count = 0;
+        while (q.enqueue(count)) {
+            ++count;
+        }
+        REQUIRE(count == static_cast<int>(capacity));
+        REQUIRE(q.full());
+
+        int value;
+        REQUIRE(q.dequeue(value));
+        REQUIRE(value == 0);
+        REQUIRE(q.enqueue(count));
+        REQUIRE(!q.enqueue(count + 1));
+    }
+
+    SUBCASE("Concurrent Wrap Around") {
+        const int total = 100000;
+        std::thread producer([&q] {
+            for (int i = 0; i < total; ++i) {
+                while (!q.enqueue(i)) {
+                    std::this_thread::yield();
+                }
+            }
+        });
+
+        bool ordered = true;
+        for (int i = 0; i < total; ++i) {
+            int value;
+            while (!q.dequeue(value)) {
+                std::this_thread::yield();
+            }
+            ordered = ordered && value == i;
+        }
+        producer.join();
+        REQUIRE(ordered);
+        REQUIRE(q.empty());
+    }
+
+    SUBCASE("Bulk Operations") {
+        int value;
+        for (int i = 0; i < 10; ++i) {
+            REQUIRE(q.enqueue(i));
+            REQUIRE(q.dequeue(value));
+        }
+
+        std::vector<int> in(20);
+        for (int i = 0; i < 20; ++i) {
+            in[i] = i;
+        }
+        REQUIRE(q.enqueue_bulk(in.data(), 12) == 12);
+        REQUIRE(q.enqueue_bulk(in.begin() + 12, in.end()) == capacity - 12);
+        REQUIRE(q.full());
+
+        int out[capacity] = {};
+        REQUIRE(q.dequeue_bulk(out, 8) == 8);
+        REQUIRE(q.dequeue_bulk(out + 8, capacity) == capacity - 8);
+        for (size_t i = 0; i < capacity; ++i) {
+            REQUIRE(out[i] == static_cast<int>(i));
+        }
+        REQUIRE(q.empty());
+        REQUIRE(q.dequeue_bulk(out, capacity) == 0);
+    }
+
     SUBCASE("Concurrent Enqueue and Dequeue") {
         std::thread producer([&q] {
             for (int i = 0; i < 100; ++i) {
@@ -58,9 +164,7 @@ TEST_CASE("SPSCQueue Tests") {
         std::thread consumer([&q] {
             for (int i = 0; i < 100; ++i) {
                 int value;
-                while (!q.dequeue(value)) {
-                    std::this_thread::yield();
-                }
+                q.pop(value);
                 REQUIRE(value == i);
             }
         });
@@ -70,6 +174,54 @@ TEST_CASE("SPSCQueue Tests") {
     }
 }
 
+TEST_CASE("SPSCQueue Reserve/Commit and Peek/Release") {
+    struct Frame {
+        size_t length;
+        char bytes[64];
+    };
+    SPSCQueue<Frame, 8> q;
+
+    // Move the indices so the next run crosses the wrap point.
+    for (int i = 0; i < 5; ++i) {
+        REQUIRE(q.enqueue(Frame{0, {}}));
+        Frame f;
+        REQUIRE(q.dequeue(f));
+    }
+
+    size_t n = 6;
+    Frame* slots = q.reserve(n);
+    REQUIRE(slots != nullptr);
+    REQUIRE(n == 3);
+    for (size_t i = 0; i < n; ++i) {
+        slots[i].length = i;
+    }
+    q.commit(n);
+
+    n = 6;
+    slots = q.reserve(n);
+    REQUIRE(n == 5);
+    for (size_t i = 0; i < n; ++i) {
+        slots[i].length = 3 + i;
+    }
+    q.commit(2);
+    REQUIRE(q.size() == 5);
+
+    size_t seen = 0;
+    while (true) {
+        size_t m = 8;
+        Frame* ready = q.peek(m);
+        if (ready == nullptr) {
+            break;
+        }
+        for (size_t i = 0; i < m; ++i) {
+            REQUIRE(ready[i].length == seen++);
+        }
+        q.release(m);
+    }
+    REQUIRE(seen == 5);
+    REQUIRE(q.empty());
+}
+
 TEST_CASE("SPMCQueue Tests") {
     const size_t capacity = 16;
     SPMCQueue<int, capacity> q;
@@ -109,6 +261,31 @@ TEST_CASE("SPMCQueue Tests") {
         REQUIRE(q.empty());
     }
 
+    SUBCASE("Bulk Operations") {
+        int value;
+        for (int i = 0; i < 10; ++i) {
+            REQUIRE(q.enqueue(i));
+            REQUIRE(q.dequeue(value));
+        }
+
+        std::vector<int> in(20);
+        for (int i = 0; i < 20; ++i) {
+            in[i] = i;
+        }
+        REQUIRE(q.enqueue_bulk(in.data(), 12) == 12);
+        REQUIRE(q.enqueue_bulk(in.begin() + 12, in.end()) == capacity - 12);
+        REQUIRE(q.full());
+
+        int out[capacity] = {};
+        REQUIRE(q.dequeue_bulk(out, 8) == 8);
+        REQUIRE(q.dequeue_bulk(out + 8, capacity) == capacity - 8);
+        for (size_t i = 0; i < capacity; ++i) {
+            REQUIRE(out[i] == static_cast<int>(i));
+        }
+        REQUIRE(q.empty());
+        REQUIRE(q.dequeue_bulk(out, capacity) == 0);
+    }
+
     SUBCASE("Concurrent Enqueue and Dequeue with Multiple Consumers") {
         std::thread producer([&q] {
             for (int i = 0; i < 100; ++i) {
@@ -123,9 +300,7 @@ TEST_CASE("SPMCQueue Tests") {
             consumers.emplace_back([&q] {
                 for (int j = 0; j < 20; ++j) {
                     int value;
-                    while (!q.dequeue(value)) {
-                        std::this_thread::yield();
-                    }
+                    q.pop(value);
                     REQUIRE(value >= 0);
                     REQUIRE(value < 100);
                 }
@@ -139,66 +314,4117 @@ TEST_CASE("SPMCQueue Tests") {
     }
 }
 
-TEST_CASE("Test StringPool") {
-    auto pool = StringPool::getInstance();
+TEST_CASE("MPMCQueue Tests") {
+    const size_t capacity = 16;
+    MPMCQueue<int, capacity> q;
 
-    SUBCASE("Test intern and try_emplace") {
-        auto s1 = StringPool::try_emplace("hello");
-        auto s2 = StringPool::try_emplace("hello");
-        auto s3 = StringPool::try_emplace("world");
+    SUBCASE("Basic Operations") {
+        REQUIRE(q.enqueue(1));
+        REQUIRE(q.enqueue(2));
+        REQUIRE(q.emplace(3));
 
-        CHECK(s1.get() == s2.get());
-        CHECK(s1.get() != s3.get());
-        CHECK(s1->data == "hello");
-        CHECK(s3->data == "world");
+        int value;
+        REQUIRE(q.dequeue(value));
+        REQUIRE(value == 1);
+        REQUIRE(q.dequeue(value));
+        REQUIRE(value == 2);
+        REQUIRE(q.try_pop() == 3);
+        REQUIRE(q.empty());
+        REQUIRE(!q.dequeue(value));
     }
 
-    SUBCASE("Test isStringIntern") {
-        auto s1 = StringPool::try_emplace("hello");
-        CHECK(pool->isStringIntern("hello"));
-        CHECK_FALSE(pool->isStringIntern("goodbye"));
+    SUBCASE("Full Queue") {
+        for (size_t i = 0; i < capacity; ++i) {
+            REQUIRE(q.enqueue(static_cast<int>(i)));
+        }
+        REQUIRE(q.full());
+        REQUIRE(!q.enqueue(-1));
+
+        int value;
+        REQUIRE(q.dequeue(value));
+        REQUIRE(value == 0);
+        REQUIRE(q.enqueue(-1));
+        REQUIRE(q.size() == capacity);
     }
 
-    SUBCASE("Test getStringByHash") {
-        auto s1 = StringPool::try_emplace("hello");
-        auto s2 = pool->getStringByHash(fnv1a_runtime("hello", 5));
-        CHECK(s1.get() == s2.get());
+    SUBCASE("Concurrent Producers and Consumers") {
+        const int perProducer = 10000;
+        const int producers = 4;
+        const int consumers = 4;
+        std::atomic<long long> sum{0};
+        std::atomic<int> received{0};
 
-        auto s3 = pool->getStringByHash(fnv1a_runtime("world", 5));
-        CHECK(s3 == nullptr);
+        std::vector<std::thread> threads;
+        for (int p = 0; p < producers; ++p) {
+            threads.emplace_back([&q, p] {
+                for (int i = 0; i < perProducer; ++i) {
+                    while (!q.enqueue(p * perProducer + i)) {
+                        std::this_thread::yield();
+                    }
+                }
+            });
+        }
+        for (int c = 0; c < consumers; ++c) {
+            threads.emplace_back([&] {
+                int value;
+                while (received.load() < producers * perProducer) {
+                    if (q.dequeue(value)) {
+                        sum += value;
+                        ++received;
+                    } else {
+                        std::this_thread::yield();
+                    }
+                }
+            });
+        }
+        for (auto& t : threads) {
+            t.join();
+        }
+
+        const long long n = producers * perProducer;
+        REQUIRE(received.load() == n);
+        REQUIRE(sum.load() == n * (n - 1) / 2);
+        REQUIRE(q.empty());
     }
+}
 
-    SUBCASE("Test StringRef") {
-        auto s1 = StringPool::try_emplace("hello");
-        StringRef ref1(s1);
-        StringRef ref2("hello");
-        StringRef ref3("world");
+TEST_CASE("WorkStealingDeque Tests") {
+    WorkStealingDeque<int> d(4);
 
-        CHECK(ref1 == ref2);
-        CHECK(ref1 != ref3);
-        CHECK(ref1->data == "hello");
-        CHECK(ref3->data == "world");
+    SUBCASE("Owner LIFO, Thief FIFO") {
+        for (int i = 0; i < 4; ++i) {
+            d.push(i);
+        }
+        int value;
+        REQUIRE(d.pop(value));
+        REQUIRE(value == 3);
+        REQUIRE(d.steal(value));
+        REQUIRE(value == 0);
+        REQUIRE(d.size() == 2);
+        REQUIRE(d.pop(value));
+        REQUIRE(value == 2);
+        REQUIRE(d.pop(value));
+        REQUIRE(value == 1);
+        REQUIRE(!d.pop(value));
+        REQUIRE(!d.steal(value));
+        REQUIRE(d.empty());
+    }
 
-        CHECK(ref1.length() == 5);
-        CHECK(ref1[0] == 'h');
-        CHECK(ref1.at(4) == 'o');
-        CHECK(ref1.find("ll", 0) == 2);
-        CHECK(ref1.rfind("l", 4) == 3);
-        CHECK(ref1.substr(1, 3) == "ell");
+    SUBCASE("Growth") {
+        for (int i = 0; i < 100; ++i) {
+            d.push(i);
+        }
+        REQUIRE(d.capacity() >= 100);
+        REQUIRE(d.size() == 100);
+        int value;
+        for (int i = 99; i >= 0; --i) {
+            REQUIRE(d.pop(value));
+            REQUIRE(value == i);
+        }
     }
 
-    SUBCASE("Test operator\"\"_hs") {
-        auto s1 = "hello"_hs;
-        auto s2 = "hello"_hs;
-        auto s3 = "world"_hs;
+    SUBCASE("Concurrent Owner and Thieves") {
+        const int total = 20000;
+        std::vector<std::atomic<int>> seen(total);
+        for (auto& s : seen) {
+            s.store(0);
+        }
+        std::atomic<bool> done{false};
 
-        CHECK(s1.get() == s2.get());
-        CHECK(s1.get() != s3.get());
-        CHECK(s1->data == "hello");
-        CHECK(s3->data == "world");
+        std::vector<std::thread> thieves;
+        for (int i = 0; i < 3; ++i) {
+            thieves.emplace_back([&] {
+                int value;
+                while (!done.load()) {
+                    if (d.steal(value)) {
+                        ++seen[value];
+                    } else {
+                        std::this_thread::yield();
+                    }
+                }
+            });
+        }
+
+        int value;
+        for (int i = 0; i < total; ++i) {
+            d.push(i);
+            if (i % 3 == 0 && d.pop(value)) {
+                ++seen[value];
+            }
+        }
+        while (d.pop(value)) {
+            ++seen[value];
+        }
+        done.store(true);
+        for (auto& t : thieves) {
+            t.join();
+        }
+
+        bool once = true;
+        for (auto& s : seen) {
+            once = once && s.load() == 1;
+        }
+        REQUIRE(once);
+    }
+}
+
+TEST_CASE("ThreadPool Tests") {
+    ThreadPool pool(4);
+
+    SUBCASE("Submit and Wait") {
+        WaitGroup group;
+        std::atomic<int> counter{0};
+        for (int i = 0; i < 1000; ++i) {
+            pool.submit(group, [&counter] { ++counter; });
+        }
+        pool.wait(group);
+        REQUIRE(counter.load() == 1000);
+    }
+
+    SUBCASE("Parallel For") {
+        std::vector<int> values(100000, 0);
+        pool.parallel_for(0, values.size(), [&values](size_t i) { values[i] = static_cast<int>(i) * 2; }, 256);
+        bool correct = true;
+        for (size_t i = 0; i < values.size(); ++i) {
+            correct = correct && values[i] == static_cast<int>(i) * 2;
+        }
+        REQUIRE(correct);
+    }
+
+    SUBCASE("Nested Parallel For") {
+        std::atomic<long long> sum{0};
+        pool.parallel_for(0, 16, [&](size_t outer) {
+            pool.parallel_for(0, 1000, [&](size_t inner) { sum += static_cast<long long>(outer * 1000 + inner); }, 64);
+        });
+        const long long n = 16 * 1000;
+        REQUIRE(sum.load() == n * (n - 1) / 2);
+    }
+}
+
+namespace {
+struct BusySpinTraits : QueueTraits { using wait_strategy = BusySpinWait; };
+struct ParkingTraits : QueueTraits { using wait_strategy = SpinParkWait; };
+}
+
+TEST_CASE_TEMPLATE("Queue Blocking Pop", Q,
+                   SPSCQueue<int, 16, BusySpinTraits>, SPSCQueue<int, 16>, SPSCQueue<int, 16, ParkingTraits>,
+                   SPMCQueue<int, 16, ParkingTraits>, MPMCQueue<int, 16, ParkingTraits>) {
+    Q q;
+
+    int value = -1;
+    REQUIRE(!q.try_pop_for(value, std::chrono::milliseconds(5)));
+    REQUIRE(q.enqueue(7));
+    REQUIRE(q.try_pop_for(value, std::chrono::milliseconds(5)));
+    REQUIRE(value == 7);
+
+    // The producer pauses now and then so a parking consumer really sleeps.
+    const int total = 2000;
+    std::thread producer([&q] {
+        for (int i = 0; i < total; ++i) {
+            while (!q.enqueue(i)) {
+                std::this_thread::yield();
+            }
+            if (i % 500 == 0) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(2));
+            }
+        }
+    });
+
+    bool ordered = true;
+    for (int i = 0; i < total; ++i) {
+        q.pop(value);
+        ordered = ordered && value == i;
+    }
+    producer.join();
+    REQUIRE(ordered);
+}
+
+namespace {
+struct HugePageTraits : QueueTraits { using allocator = MappedSlotAllocator; };
+}
+
+TEST_CASE_TEMPLATE("Runtime-Sized Queues", Q, SPSCQueue<int>, SPMCQueue<int>, MPMCQueue<int>, SPSCQueue<int, DynamicCapacity, HugePageTraits>) {
+    Q q(1024);
+    REQUIRE(q.capacity() == 1024);
+
+    for (int i = 0; i < 1000; ++i) {
+        REQUIRE(q.enqueue(i));
+    }
+    bool ordered = true;
+    for (int i = 0; i < 1000; ++i) {
+        int value;
+        ordered = ordered && q.dequeue(value) && value == i;
+    }
+    REQUIRE(ordered);
+    REQUIRE(q.empty());
+
+    CHECK_THROWS_AS(Q(1000), std::invalid_argument);
+    CHECK_THROWS_AS(Q(0), std::invalid_argument);
+}
+
+TEST_CASE("Fixed Capacity Mismatch") {
+    CHECK_THROWS_AS((SPSCQueue<int, 16>(32)), std::invalid_argument);
+    CHECK_NOTHROW((SPSCQueue<int, 16>(16)));
+}
+
+TEST_CASE_TEMPLATE("Queue Sequence Numbers", Q, SPSCQueue<int, 4>, SPMCQueue<int, 4>) {
+    Q q;
+    REQUIRE(q.write_sequence() == 0);
+    for (int round = 0; round < 3; ++round) {
+        for (int i = 0; i < 4; ++i) {
+            REQUIRE(q.enqueue(i));
+            REQUIRE(q.size() == static_cast<size_t>(i + 1));
+        }
+        REQUIRE(q.full());
+        REQUIRE(q.write_sequence() == static_cast<std::uint64_t>(4 * (round + 1)));
+        int value;
+        REQUIRE(q.dequeue(value));
+        REQUIRE(q.read_sequence() == static_cast<std::uint64_t>(4 * round + 1));
+        REQUIRE(q.size() == 3);
+        while (q.dequeue(value)) {
+        }
+        REQUIRE(q.read_sequence() == q.write_sequence());
+    }
+}
+
+namespace {
+struct StatsTraits : QueueTraits { using stats = QueueStats; };
+}
+
+TEST_CASE_TEMPLATE("Queue Statistics", Q, SPSCQueue<int, 8, StatsTraits>, SPMCQueue<int, 8, StatsTraits>) {
+    Q q;
+    for (int i = 0; i < 8; ++i) {
+        REQUIRE(q.enqueue(i));
+    }
+    REQUIRE(!q.enqueue(8));
+    int values[4];
+    REQUIRE(q.dequeue_bulk(values, 4) == 4);
+    for (int i = 0; i < 4; ++i) {
+        REQUIRE(q.try_pop());
+    }
+    REQUIRE(!q.try_pop());
+
+    QueueStatsSnapshot stats = q.stats().snapshot();
+    REQUIRE(stats.enqueued == 8);
+    REQUIRE(stats.dequeued == 8);
+    REQUIRE(stats.enqueueFull == 1);
+    REQUIRE(stats.dequeueEmpty == 1);
+    REQUIRE(stats.highWater == 8);
+
+    SUBCASE("Concurrent Consumers") {
+        const int total = 20000;
+        std::atomic<int> received{0};
+        std::vector<std::thread> consumers;
+        const int consumerCount = std::is_same<Q, SPSCQueue<int, 8, StatsTraits>>::value ? 1 : 3;
+        for (int c = 0; c < consumerCount; ++c) {
+            consumers.emplace_back([&q, &received] {
+                int value;
+                while (received.load() < total) {
+                    if (q.dequeue(value)) {
+                        ++received;
+                    } else {
+                        std::this_thread::yield();
+                    }
+                }
+            });
+        }
+        for (int i = 0; i < total; ++i) {
+            while (!q.enqueue(i)) {
+                std::this_thread::yield();
+            }
+        }
+        for (auto& t : consumers) {
+            t.join();
+        }
+        stats = q.stats().snapshot();
+        REQUIRE(stats.enqueued == 8 + total);
+        REQUIRE(stats.dequeued == 8 + total);
+        REQUIRE(stats.highWater <= q.capacity());
+    }
+}
+
+namespace {
+struct SpinBackoffTraits : QueueTraits { using backoff = SpinBackoff; };
+struct ExponentialBackoffTraits : QueueTraits { using backoff = BasicExponentialBackoff<1, 64>; };
+struct YieldBackoffTraits : QueueTraits { using backoff = YieldBackoff; };
+}
+
+TEST_CASE_TEMPLATE("Queue Backoff Policies", Q, SPMCQueue<int, 64, SpinBackoffTraits>,
+                   SPMCQueue<int, 64, ExponentialBackoffTraits>, MPMCQueue<int, 64, ExponentialBackoffTraits>,
+                   MPMCQueue<int, 64, YieldBackoffTraits>) {
+    // Four consumers contend on head; every element must come out once.
+    Q q;
+    const int total = 20000;
+    std::atomic<int> taken{0};
+    std::atomic<long long> sum{0};
+    std::vector<std::thread> consumers;
+    for (int c = 0; c < 4; ++c) {
+        consumers.emplace_back([&] {
+            int value = 0;
+            while (taken.load() < total) {
+                if (q.dequeue(value)) {
+                    sum += value;
+                    ++taken;
+                } else {
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+    for (int i = 0; i < total; ++i) {
+        while (!q.enqueue(i)) {
+            std::this_thread::yield();
+        }
+    }
+    for (auto& consumer : consumers) {
+        consumer.join();
+    }
+    REQUIRE(sum.load() == static_cast<long long>(total) * (total - 1) / 2);
+
+    BasicExponentialBackoff<2, 16> backoff;
+    for (int i = 0; i < 5; ++i) {
+        backoff.pause();
+    }
+    REQUIRE(backoff.spins == 16);
+}
+
+TEST_CASE_TEMPLATE("Single-Threaded Queues", Q, SPSCQueue<int, 8, SingleThreadedTraits>,
+                   SPMCQueue<int, 8, SingleThreadedTraits>, MPMCQueue<int, 8, SingleThreadedTraits>) {
+    static_assert(std::is_same<typename Q::template atomic_type<size_t>, PlainAtomic<size_t>>::value,
+                  "SingleThreadedTraits must not use std::atomic.");
+    Q q;
+    int value = 0;
+    for (int round = 0; round < 5; ++round) {
+        for (int i = 0; i < 8; ++i) {
+            REQUIRE(q.enqueue(round * 8 + i));
+        }
+        REQUIRE_FALSE(q.enqueue(-1));
+        REQUIRE(q.full());
+        for (int i = 0; i < 8; ++i) {
+            REQUIRE(q.dequeue(value));
+            REQUIRE(value == round * 8 + i);
+        }
+        REQUIRE_FALSE(q.dequeue(value));
+        REQUIRE(q.empty());
     }
+    REQUIRE(q.enqueue(7));
+    REQUIRE(q.try_pop() == std::optional<int>(7));
 }
 
+TEST_CASE("MultiQueue Tests") {
+    SUBCASE("Single Heap Is Exact") {
+        MultiQueue<int, int> q(1, 1);
+        REQUIRE(q.empty());
+        for (int i = 0; i < 100; ++i) {
+            q.push((i * 37) % 100, i);
+        }
+        int key, value;
+        for (int i = 0; i < 100; ++i) {
+            REQUIRE(q.try_pop(key, value));
+            REQUIRE(key == i);
+            REQUIRE((value * 37) % 100 == i);
+        }
+        REQUIRE(!q.try_pop(key, value));
+    }
+
+    SUBCASE("Relaxed Order") {
+        MultiQueue<std::uint64_t, int> q(4, 2);
+        REQUIRE(q.heap_count() == 8);
+        const int total = 4000;
+        for (int i = 0; i < total; ++i) {
+            q.push(static_cast<std::uint64_t>((i * 7919) % total), i);
+        }
+        // Every element comes back exactly once, and the early pops are
+        // drawn from the low end of the key range.
+        std::vector<bool> seen(total);
+        std::uint64_t key;
+        int value;
+        std::uint64_t firstKeys = 0;
+        for (int i = 0; i < total; ++i) {
+            REQUIRE(q.try_pop(key, value));
+            REQUIRE(!seen[value]);
+            seen[value] = true;
+            if (i < 100) {
+                firstKeys += key;
+            }
+        }
+        REQUIRE(!q.try_pop(key, value));
+        REQUIRE(q.empty());
+        REQUIRE(firstKeys / 100 < total / 4);
+    }
+
+    SUBCASE("Concurrent Push and Pop") {
+        MultiQueue<int, int> q(4);
+        const int perThread = 5000;
+        std::atomic<long long> popped{0};
+        std::atomic<int> count{0};
+        std::vector<std::thread> threads;
+        for (int t = 0; t < 4; ++t) {
+            threads.emplace_back([&q, &popped, &count, t] {
+                int key, value;
+                for (int i = 0; i < perThread; ++i) {
+                    q.push(i, t * perThread + i);
+                    if (q.try_pop(key, value)) {
+                        popped += value;
+                        ++count;
+                    }
+                }
+            });
+        }
+        for (auto& t : threads) {
+            t.join();
+        }
+        int key, value;
+        while (q.try_pop(key, value)) {
+            popped += value;
+            ++count;
+        }
+        const long long n = 4 * perThread;
+        REQUIRE(count == n);
+        REQUIRE(popped == n * (n - 1) / 2);
+    }
+}
+
+TEST_CASE("QueueSet Tests") {
+    SUBCASE("Only Ready Queues Are Drained") {
+        QueueSet<int, 16> set(40);
+        REQUIRE(set.size() == 40);
+        REQUIRE(set.event_fd() == -1);
+        std::vector<size_t> visited;
+        auto record = [&visited](size_t index, int&) { visited.push_back(index); };
+        REQUIRE(set.drain(record) == 0);
+
+        REQUIRE(set.enqueue(3, 30));
+        REQUIRE(set.enqueue(39, 390));
+        REQUIRE(set.enqueue(3, 31));
+        REQUIRE(set.drain(record) == 3);
+        std::sort(visited.begin(), visited.end());
+        REQUIRE(visited == std::vector<size_t>{3, 3, 39});
+        REQUIRE(set.drain(record) == 0);
+    }
+
+    SUBCASE("Batches Are Fair") {
+        QueueSet<int, 64> set(2);
+        for (int i = 0; i < 40; ++i) {
+            REQUIRE(set.enqueue(0, i));
+        }
+        REQUIRE(set.enqueue(1, 100));
+        std::vector<int> seen;
+        REQUIRE(set.drain([&seen](size_t, int& v) { seen.push_back(v); }, 8) == 9);
+        REQUIRE(std::count(seen.begin(), seen.end(), 100) == 1);
+        size_t total = seen.size();
+        while (size_t n = set.drain([](size_t, int&) {}, 8)) {
+            total += n;
+        }
+        REQUIRE(total == 41);
+    }
+
+    SUBCASE("Concurrent Producers") {
+        const size_t queues = 40;
+        const int perQueue = 2000;
+        QueueSet<int, 64> set(queues, 64, true);
+        REQUIRE(set.event_fd() >= 0);
+        std::vector<std::thread> producers;
+        for (size_t p = 0; p < 4; ++p) {
+            producers.emplace_back([&set, p] {
+                for (int i = 0; i < perQueue; ++i) {
+                    for (size_t q = p; q < queues; q += 4) {
+                        while (!set.enqueue(q, i)) {
+                            std::this_thread::yield();
+                        }
+                    }
+                }
+            });
+        }
+        std::vector<int> next(queues, 0);
+        bool ordered = true;
+        size_t received = 0;
+        while (received < queues * perQueue) {
+            const size_t n = set.drain([&](size_t index, int& value) { ordered = ordered && value == next[index]++; });
+            if (n == 0) {
+                pollfd pfd{set.event_fd(), POLLIN, 0};
+                poll(&pfd, 1, 10);
+            }
+            received += n;
+        }
+        for (auto& t : producers) {
+            t.join();
+        }
+        REQUIRE(ordered);
+        REQUIRE(set.drain([](size_t, int&) {}) == 0);
+    }
+}
+
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+namespace {
+// Starts eagerly and frees its own frame when it finishes.
+struct DetachedTask {
+    struct promise_type {
+        DetachedTask get_return_object() { return {}; }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { std::terminate(); }
+    };
+};
+
+DetachedTask consume(AwaitableSPSCQueue<int, 4>& q, int count, std::vector<int>& out) {
+    for (int i = 0; i < count; ++i) {
+        out.push_back(co_await q.pop());
+    }
+}
+
+DetachedTask produce(AwaitableSPSCQueue<int, 4>& q, int count, int& pushed) {
+    for (int i = 0; i < count; ++i) {
+        co_await q.push(i);
+        ++pushed;
+    }
+}
+}
+
+TEST_CASE("AwaitableSPSCQueue Tests") {
+    AwaitableSPSCQueue<int, 4> q;
+    std::vector<int> out;
+    int pushed = 0;
+    std::vector<int> expected(20);
+    for (int i = 0; i < 20; ++i) {
+        expected[i] = i;
+    }
+
+    SUBCASE("Consumer Waits For Producer") {
+        consume(q, 20, out);
+        REQUIRE(out.empty());
+        produce(q, 20, pushed);
+        REQUIRE(pushed == 20);
+        REQUIRE(out == expected);
+    }
+
+    SUBCASE("Producer Waits For Space") {
+        produce(q, 20, pushed);
+        REQUIRE(pushed == 4);
+        consume(q, 20, out);
+        REQUIRE(pushed == 20);
+        REQUIRE(out == expected);
+        REQUIRE(q.empty());
+    }
+
+    SUBCASE("Plain Thread Producer") {
+        const int total = 20000;
+        std::vector<int> received;
+        consume(q, total, received);
+        std::thread producer([&q] {
+            for (int i = 0; i < total; ++i) {
+                while (!q.try_push(i)) {
+                    std::this_thread::yield();
+                }
+            }
+        });
+        producer.join();
+        REQUIRE(received.size() == static_cast<size_t>(total));
+        bool ordered = true;
+        for (int i = 0; i < total; ++i) {
+            ordered = ordered && received[i] == i;
+        }
+        REQUIRE(ordered);
+    }
+}
+#endif
+
+TEST_CASE("ShardedDispatcher Tests") {
+    struct Order {
+        int account;
+        int sequence;
+    };
+    const int accounts = 37;
+    const int perAccount = 500;
+    // Every account maps to exactly one shard, so each slot is only touched
+    // by one worker.
+    std::vector<int> next(accounts, 0);
+    std::vector<char> ordered(accounts, 1);
+    std::atomic<int> handled{0};
+    auto handler = [&](Order& order) {
+        ordered[order.account] = ordered[order.account] && order.sequence == next[order.account];
+        ++next[order.account];
+        ++handled;
+    };
+
+    SUBCASE("Per-Key Order") {
+        {
+            ShardedDispatcher<int, Order> dispatcher(4, 64, handler);
+            REQUIRE(dispatcher.shards() == 4);
+            for (int s = 0; s < perAccount; ++s) {
+                for (int a = 0; a < accounts; ++a) {
+                    dispatcher.dispatch(a, Order{a, s});
+                }
+            }
+        }
+        REQUIRE(handled == accounts * perAccount);
+    }
+
+    SUBCASE("Bulk Dispatch") {
+        {
+            ShardedDispatcher<int, Order> dispatcher(3, 32, handler);
+            std::vector<Order> batch;
+            for (int s = 0; s < perAccount; ++s) {
+                for (int a = 0; a < accounts; ++a) {
+                    batch.push_back(Order{a, s});
+                }
+                if (batch.size() >= 200) {
+                    dispatcher.dispatch_bulk(batch.begin(), batch.end(), [](const Order& o) { return o.account; });
+                    batch.clear();
+                }
+            }
+            dispatcher.dispatch_bulk(batch.begin(), batch.end(), [](const Order& o) { return o.account; });
+        }
+        REQUIRE(handled == accounts * perAccount);
+    }
+
+    for (int a = 0; a < accounts; ++a) {
+        REQUIRE(ordered[a]);
+        REQUIRE(next[a] == perAccount);
+    }
+}
+
+TEST_CASE("TimerWheel Tests") {
+    TimerWheel<int> wheel(std::chrono::milliseconds(1));
+    std::vector<std::pair<std::uint64_t, int>> fired;
+    auto record = [&](int&& id) { fired.emplace_back(wheel.now(), id); };
+
+    SUBCASE("Fires On Its Tick Across Levels") {
+        // Delays on every level boundary, including ones that cascade twice.
+        const std::vector<std::uint64_t> delays = {0, 1, 255, 256, 257, 1000, 65535, 65536, 65537, 70000};
+        for (size_t i = 0; i < delays.size(); ++i) {
+            wheel.schedule(delays[i], static_cast<int>(i));
+        }
+        REQUIRE(wheel.size() == delays.size());
+        REQUIRE(wheel.advance(70000, record) == delays.size());
+        REQUIRE(wheel.size() == 0);
+        REQUIRE(fired.size() == delays.size());
+        for (const auto& f : fired) {
+            const std::uint64_t delay = delays[f.second];
+            REQUIRE(f.first == (delay == 0 ? 1 : delay));
+        }
+    }
+
+    SUBCASE("Starts Mid-Wheel") {
+        wheel.advance(300, record);
+        wheel.schedule(200, 1);   // crosses a level-0 wrap
+        wheel.schedule(65300, 2); // crosses a level-1 wrap
+        wheel.advance(65300, record);
+        REQUIRE(fired.size() == 2);
+        REQUIRE(fired[0] == std::make_pair(std::uint64_t(500), 1));
+        REQUIRE(fired[1] == std::make_pair(std::uint64_t(65600), 2));
+    }
+
+    SUBCASE("Cancel") {
+        const TimerId a = wheel.schedule(10, 1);
+        const TimerId b = wheel.schedule(300, 2);
+        const TimerId c = wheel.schedule(10, 3);
+        REQUIRE(wheel.cancel(b));
+        REQUIRE_FALSE(wheel.cancel(b));
+        REQUIRE(wheel.cancel(c));
+        REQUIRE(wheel.size() == 1);
+        wheel.advance(400, record);
+        REQUIRE(fired.size() == 1);
+        REQUIRE(fired[0].second == 1);
+        // Fired timers cannot be cancelled, and a recycled node gets a new id.
+        REQUIRE_FALSE(wheel.cancel(a));
+        const TimerId d = wheel.schedule(5, 4);
+        REQUIRE(d != a);
+        REQUIRE_FALSE(wheel.cancel(a));
+        REQUIRE(wheel.cancel(d));
+    }
+
+    SUBCASE("Sink May Reschedule") {
+        int remaining = 3;
+        wheel.schedule(2, 0);
+        wheel.advance(10, [&](int&& id) {
+            fired.emplace_back(wheel.now(), id);
+            if (--remaining > 0) {
+                wheel.schedule(3, id + 1);
+            }
+        });
+        REQUIRE(fired.size() == 3);
+        REQUIRE(fired[2] == std::make_pair(std::uint64_t(8), 2));
+    }
+
+    SUBCASE("Delivery Into SPSCQueue") {
+        SPSCQueue<int, 8> expired;
+        for (int i = 0; i < 20; ++i) {
+            wheel.schedule(5, i);
+        }
+        REQUIRE(wheel.advance(5, expired) == 8);
+        REQUIRE(wheel.pending() == 12);
+        int value = 0;
+        for (int i = 0; i < 8; ++i) {
+            REQUIRE(expired.dequeue(value));
+        }
+        // The backlog goes out first, in order, on the next advance.
+        REQUIRE(wheel.advance(0, expired) == 8);
+        REQUIRE(expired.dequeue(value));
+        REQUIRE(value == 8);
+    }
+
+    SUBCASE("Clock Driven") {
+        TimerWheel<int> clocked(std::chrono::milliseconds(1));
+        clocked.schedule_after(std::chrono::microseconds(2500), 7); // rounds up to 3 ticks
+        const auto later = TimerWheel<int>::clock::now() + std::chrono::milliseconds(10);
+        REQUIRE(clocked.advance_to(later, record) == 1);
+        REQUIRE(clocked.now() >= 10);
+        REQUIRE_THROWS_AS(TimerWheel<int>(std::chrono::nanoseconds(0)), std::invalid_argument);
+    }
+}
+
+TEST_CASE("LatencyHistogram Tests") {
+    LatencyHistogram<> histogram;
+    REQUIRE(histogram.count() == 0);
+    REQUIRE(histogram.percentile(99) == 0);
+
+    SUBCASE("Small Values Are Exact") {
+        for (std::uint64_t v = 1; v <= 100; ++v) {
+            histogram.record(v);
+        }
+        REQUIRE(histogram.count() == 100);
+        REQUIRE(histogram.min() == 1);
+        REQUIRE(histogram.max() == 100);
+        REQUIRE(histogram.percentile(50) == 50);
+        REQUIRE(histogram.percentile(99) == 99);
+        REQUIRE(histogram.percentile(100) == 100);
+        REQUIRE(histogram.mean() == doctest::Approx(50.5));
+    }
+
+    SUBCASE("Relative Precision") {
+        // 1..1e6 uniformly: every percentile within 1/128 of the true value.
+        for (std::uint64_t v = 1; v <= 1000000; ++v) {
+            histogram.record(v);
+        }
+        for (const double p : {50.0, 90.0, 99.0, 99.9}) {
+            const double exact = p / 100.0 * 1000000;
+            REQUIRE(static_cast<double>(histogram.percentile(p)) == doctest::Approx(exact).epsilon(1.0 / 128));
+        }
+        REQUIRE(histogram.max() == 1000000);
+    }
+
+    SUBCASE("Tail And Merge") {
+        LatencyHistogram<> other;
+        for (int i = 0; i < 9990; ++i) {
+            histogram.record(100);
+        }
+        for (int i = 0; i < 10; ++i) {
+            other.record(50000);
+        }
+        other.record(1, 0);
+        histogram.merge(other);
+        REQUIRE(histogram.count() == 10000);
+        REQUIRE(histogram.percentile(99) == 100);
+        REQUIRE(histogram.percentile(99.95) == doctest::Approx(50000).epsilon(1.0 / 128));
+        REQUIRE(histogram.max() == 50000);
+        histogram.reset();
+        REQUIRE(histogram.count() == 0);
+        REQUIRE(histogram.max() == 0);
+    }
+
+    SUBCASE("Clamps Huge Values") {
+        histogram.record(std::numeric_limits<std::uint64_t>::max());
+        REQUIRE(histogram.max() == LatencyHistogram<>::MaxValue);
+    }
+
+    SUBCASE("TSC Calibration") {
+        REQUIRE(TscClock::ticks_per_nanosecond() > 0);
+        const std::uint64_t start = TscClock::ticks();
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        REQUIRE(TscClock::nanoseconds(TscClock::ticks() - start) >= 1e6);
+    }
+}
+
+TEST_CASE("CpuTopology Tests") {
+    SUBCASE("Scan Sysfs Tree") {
+        // Two packages, two SMT cores each, one L3 per package; package 1 is
+        // NUMA node 1. CPUs n and n + 4 are siblings.
+        namespace fs = std::filesystem;
+        const fs::path root = fs::temp_directory_path() / ("cpputils-topology-" + std::to_string(getpid()));
+        auto put = [](const fs::path& path, const std::string& text) {
+            fs::create_directories(path.parent_path());
+            std::ofstream(path) << text << "\n";
+        };
+        put(root / "online", "0-7");
+        for (int cpu = 0; cpu < 8; ++cpu) {
+            const fs::path dir = root / ("cpu" + std::to_string(cpu));
+            const int package = (cpu % 4) / 2;
+            put(dir / "topology" / "physical_package_id", std::to_string(package));
+            put(dir / "topology" / "core_id", std::to_string(cpu % 2));
+            put(dir / "cache" / "index0" / "type", "Data");
+            put(dir / "cache" / "index0" / "level", "1");
+            put(dir / "cache" / "index0" / "shared_cpu_list", std::to_string(cpu % 4) + "," + std::to_string(cpu % 4 + 4));
+            put(dir / "cache" / "index1" / "type", "Instruction");
+            put(dir / "cache" / "index1" / "level", "1");
+            put(dir / "cache" / "index2" / "type", "Unified");
+            put(dir / "cache" / "index2" / "level", "3");
+            put(dir / "cache" / "index2" / "shared_cpu_list", package == 0 ? "0-1,4-5" : "2-3,6-7");
+            fs::create_directories(dir / ("node" + std::to_string(package)));
+        }
+
+        const CpuTopology topology = CpuTopology::scan(root.string());
+        fs::remove_all(root);
+        REQUIRE(topology.cpus().size() == 8);
+        REQUIRE(topology.cores().size() == 4);
+        REQUIRE(topology.llc_groups().size() == 2);
+        REQUIRE(topology.nodes().size() == 2);
+        REQUIRE(topology.smt_siblings(1) == std::vector<int>{1, 5});
+        REQUIRE(topology.llc_group(6) == std::vector<int>{2, 3, 6, 7});
+        REQUIRE(topology.shares_core(2, 6));
+        REQUIRE_FALSE(topology.shares_core(2, 3));
+        REQUIRE(topology.shares_llc(0, 5));
+        REQUIRE_FALSE(topology.shares_llc(0, 2));
+        REQUIRE(topology.numa_node(0) == 0);
+        REQUIRE(topology.numa_node(7) == 1);
+        REQUIRE(topology.allocator_near(3, false).node() == 1);
+        REQUIRE(topology.find(8) == nullptr);
+    }
+
+    SUBCASE("Pin Threads") {
+        const CpuTopology& topology = CpuTopology::instance();
+        REQUIRE_FALSE(topology.cpus().empty());
+        const int cpu = topology.cpus().front().cpu;
+        std::atomic<bool> pinned{false};
+        std::thread worker([&] { pinned = pin_current_thread(cpu); });
+        worker.join();
+        REQUIRE(pinned);
+        REQUIRE_FALSE(pin_current_thread(-1));
+
+        ThreadPool pool(2, {cpu});
+        std::atomic<int> ran{0};
+        pool.parallel_for(0, 100, [&](size_t) { ++ran; });
+        REQUIRE(ran == 100);
+    }
+}
+
+struct PooledMessage {
+    explicit PooledMessage(int id) : id(id) { ++live; }
+    ~PooledMessage() { --live; }
+    int id;
+    char body[60];
+    static std::atomic<int> live;
+};
+std::atomic<int> PooledMessage::live{0};
+
+TEST_CASE("ObjectPool Tests") {
+    using Message = PooledMessage;
+
+    SUBCASE("Exhaustion And Owner Recycle") {
+        ObjectPool<Message> pool(3);
+        REQUIRE(pool.capacity() == 3);
+        Message* a = pool.acquire(1);
+        Message* b = pool.acquire(2);
+        Message* c = pool.acquire(3);
+        REQUIRE(pool.acquire(4) == nullptr);
+        REQUIRE(Message::live == 3);
+        REQUIRE(pool.owns(a));
+        REQUIRE(pool.owns(c));
+        int outside = 0;
+        REQUIRE_FALSE(pool.owns(reinterpret_cast<Message*>(&outside)));
+        // The pool's objects are contiguous.
+        REQUIRE(b == a + 1);
+        REQUIRE(c == a + 2);
+
+        pool.recycle(b);
+        REQUIRE(pool.available() == 1);
+        REQUIRE(pool.acquire(5) == b);
+        pool.release(a);
+        pool.release(b);
+        pool.release(c);
+        REQUIRE(Message::live == 0);
+        REQUIRE(pool.available() == 3);
+    }
+
+    SUBCASE("Cross-Thread Return") {
+        ObjectPool<Message> pool(64);
+        SPSCQueue<Message*, 16> channel;
+        const int messages = 100000;
+        std::thread consumer([&] {
+            int expected = 0;
+            Message* message = nullptr;
+            while (expected < messages) {
+                if (!channel.dequeue(message)) {
+                    std::this_thread::yield();
+                    continue;
+                }
+                REQUIRE(message->id == expected++);
+                pool.release(message);
+            }
+        });
+        for (int i = 0; i < messages; ++i) {
+            Message* message = nullptr;
+            while ((message = pool.acquire(i)) == nullptr) {
+                std::this_thread::yield();
+            }
+            REQUIRE(pool.owns(message));
+            while (!channel.enqueue(message)) {
+                std::this_thread::yield();
+            }
+        }
+        consumer.join();
+        REQUIRE(Message::live == 0);
+        REQUIRE(pool.available() == 64);
+    }
+}
+
+TEST_CASE("Pipeline Tests") {
+    const int count = 20000;
+
+    SUBCASE("Source Map Filter Sink") {
+        PipelineOptions options;
+        options.capacity = 64;
+        options.batch = 16;
+        Pipeline pipeline(options);
+        int next = 0;
+        std::vector<long long> received;
+        pipeline.source<int>([&]() -> std::optional<int> {
+                    if (next == count) {
+                        return std::nullopt;
+                    }
+                    return next++;
+                })
+            .map([](int v) { return static_cast<long long>(v) * 3; })
+            .filter([](const long long& v) { return v % 2 == 0; })
+            .map([](long long v) { return std::to_string(v); }, Pipeline::fused)
+            .sink([&](std::string v) { received.push_back(std::stoll(v)); });
+        REQUIRE(pipeline.thread_count() == 4);
+        pipeline.start();
+        pipeline.wait();
+
+        // Order is preserved end to end.
+        REQUIRE(received.size() == count / 2);
+        for (size_t i = 0; i < received.size(); ++i) {
+            REQUIRE(received[i] == static_cast<long long>(i) * 6);
+        }
+        const auto stats = pipeline.stats();
+        REQUIRE(stats.size() == 5);
+        REQUIRE(stats[0].name == "0:source");
+        REQUIRE(stats[0].items == count);
+        REQUIRE(stats[1].items == count);
+        REQUIRE(stats[1].capacity == 64);
+        REQUIRE(stats[2].items == count);
+        REQUIRE(stats[3].items == count / 2);
+        REQUIRE(stats[3].capacity == 0); // fused onto the filter's thread
+        REQUIRE(stats[4].items == count / 2);
+        REQUIRE(stats[4].queued == 0);
+    }
+
+    SUBCASE("Backpressure And Stop") {
+        PipelineOptions options;
+        options.capacity = 8;
+        options.batch = 4;
+        Pipeline pipeline(options);
+        std::atomic<bool> release{false};
+        std::atomic<int> sunk{0};
+        std::atomic<int> produced{0};
+        pipeline.source<int>([&]() -> std::optional<int> { return produced++; })
+            .sink([&](int) {
+                while (!release.load()) {
+                    std::this_thread::yield();
+                }
+                ++sunk;
+            });
+        pipeline.start();
+        // With the sink stalled the source can run at most one ring, one
+        // batch in hand and its current element ahead.
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        REQUIRE(produced.load() <= 8 + 4 + 2 + 4);
+        pipeline.stop();
+        release = true;
+        pipeline.wait();
+        REQUIRE(sunk.load() == static_cast<int>(pipeline.stats()[0].items));
+    }
+
+    SUBCASE("Incomplete Pipeline") {
+        Pipeline pipeline;
+        REQUIRE_THROWS_AS(pipeline.start(), std::logic_error);
+        REQUIRE_THROWS_AS(Pipeline(PipelineOptions{100, 8}), std::invalid_argument);
+    }
+}
+
+TEST_CASE("UnboundedSPSCQueue Tests") {
+    UnboundedSPSCQueue<int, 4> q;
+
+    SUBCASE("Grows Across Segments") {
+        REQUIRE(q.empty());
+        for (int i = 0; i < 100; ++i) {
+            REQUIRE(q.enqueue(i));
+        }
+        for (int i = 0; i < 100; ++i) {
+            int value;
+            REQUIRE(q.dequeue(value));
+            REQUIRE(value == i);
+        }
+        REQUIRE(!q.try_pop());
+        REQUIRE(q.empty());
+    }
+
+    SUBCASE("Concurrent Enqueue and Dequeue") {
+        const int total = 100000;
+        std::thread producer([&q] {
+            for (int i = 0; i < total; ++i) {
+                q.enqueue(i);
+            }
+        });
+        bool ordered = true;
+        for (int i = 0; i < total; ++i) {
+            int value;
+            while (!q.dequeue(value)) {
+                std::this_thread::yield();
+            }
+            ordered = ordered && value == i;
+        }
+        producer.join();
+        REQUIRE(ordered);
+    }
+}
+
+TEST_CASE("UnboundedMPSCQueue Tests") {
+    UnboundedMPSCQueue<int, 32> q;
+
+    SUBCASE("Grows Across Segments") {
+        for (int i = 0; i < 100; ++i) {
+            REQUIRE(q.emplace(i));
+        }
+        for (int i = 0; i < 100; ++i) {
+            REQUIRE(q.try_pop() == i);
+        }
+        REQUIRE(q.empty());
+    }
+
+    SUBCASE("Concurrent Producers") {
+        const int producers = 4;
+        const int perProducer = 20000;
+        std::vector<std::thread> threads;
+        for (int p = 0; p < producers; ++p) {
+            threads.emplace_back([&q, p] {
+                for (int i = 0; i < perProducer; ++i) {
+                    q.enqueue(p * perProducer + i);
+                }
+            });
+        }
+
+        // Each producer's items must arrive in its own order.
+        std::vector<int> next(producers, 0);
+        bool ordered = true;
+        for (int received = 0; received < producers * perProducer;) {
+            int value;
+            if (!q.dequeue(value)) {
+                std::this_thread::yield();
+                continue;
+            }
+            const int p = value / perProducer;
+            ordered = ordered && value % perProducer == next[p]++;
+            ++received;
+        }
+        for (auto& t : threads) {
+            t.join();
+        }
+        REQUIRE(ordered);
+        REQUIRE(q.empty());
+    }
+}
+
+TEST_CASE("BroadcastRing Tests") {
+    SUBCASE("Every Reader Sees Every Element") {
+        BroadcastRing<int, 4> ring;
+        auto& first = ring.subscribe();
+        auto& second = ring.subscribe();
+        for (int i = 0; i < 4; ++i) {
+            REQUIRE(ring.try_publish(i));
+        }
+        REQUIRE(!ring.try_publish(4));
+
+        std::vector<int> seen;
+        REQUIRE(first.poll([&seen](const int& value) { seen.push_back(value); }) == 4);
+        REQUIRE(seen == std::vector<int>{0, 1, 2, 3});
+        // The second reader still holds the ring.
+        REQUIRE(!ring.try_publish(4));
+        int value;
+        REQUIRE(second.try_read(value));
+        REQUIRE(value == 0);
+        REQUIRE(ring.try_publish(4));
+        REQUIRE(second.poll([](const int&) {}, 2) == 2);
+        REQUIRE(second.position() == 3);
+    }
+
+    SUBCASE("Dependency Barrier") {
+        BroadcastRing<int, 8> ring;
+        auto& risk = ring.subscribe();
+        auto& persist = ring.subscribe({&risk});
+        REQUIRE(ring.try_publish(7));
+        int value;
+        REQUIRE(!persist.try_read(value));
+        REQUIRE(risk.try_read(value));
+        REQUIRE(persist.try_read(value));
+        REQUIRE(value == 7);
+    }
+
+    SUBCASE("Concurrent Chained Readers") {
+        const int total = 100000;
+        BroadcastRing<int, 256> ring;
+        std::vector<std::atomic<bool>> checked(total);
+        auto& risk = ring.subscribe();
+        auto& persist = ring.subscribe({&risk});
+        auto& log = ring.subscribe();
+
+        std::atomic<bool> riskOrdered{true}, persistOrdered{true}, logOrdered{true};
+        std::thread riskThread([&] {
+            for (int i = 0; i < total; ++i) {
+                int value;
+                risk.read(value);
+                riskOrdered = riskOrdered && value == i;
+                checked[value].store(true, std::memory_order_relaxed);
+            }
+        });
+        std::thread persistThread([&] {
+            for (int i = 0; i < total; ++i) {
+                int value;
+                persist.read(value);
+                persistOrdered = persistOrdered && value == i && checked[value].load(std::memory_order_relaxed);
+            }
+        });
+        std::thread logThread([&] {
+            int expected = 0;
+            while (expected < total) {
+                if (log.poll([&](const int& value) { logOrdered = logOrdered && value == expected++; }) == 0) {
+                    std::this_thread::yield();
+                }
+            }
+        });
+        for (int i = 0; i < total; ++i) {
+            ring.publish(i);
+        }
+        riskThread.join();
+        persistThread.join();
+        logThread.join();
+        REQUIRE(riskOrdered);
+        REQUIRE(persistOrdered);
+        REQUIRE(logOrdered);
+    }
+}
+
+TEST_CASE("BipBuffer Tests") {
+    BipBuffer<> ring(256);
+
+    SUBCASE("Records Stay Contiguous") {
+        REQUIRE(ring.empty());
+        REQUIRE(ring.write(0).empty());
+        REQUIRE(ring.write(ring.max_record() + 1).empty());
+        // 40-byte records take 48 bytes each; the sixth no longer fits
+        // before the end and has to start over at offset zero.
+        std::vector<std::byte*> starts;
+        for (int round = 0; round < 3; ++round) {
+            for (int i = 0; i < 5; ++i) {
+                ByteSpan span = ring.write(40);
+                REQUIRE(span.size() == 40);
+                std::memset(span.data(), round * 5 + i, span.size());
+                ring.commit();
+            }
+            for (int i = 0; i < 5; ++i) {
+                ByteSpan span = ring.read();
+                REQUIRE(span.size() == 40);
+                REQUIRE(std::to_integer<int>(span.data()[0]) == round * 5 + i);
+                REQUIRE(std::to_integer<int>(span.data()[39]) == round * 5 + i);
+                starts.push_back(span.data());
+                ring.consume();
+            }
+        }
+        REQUIRE(ring.read().empty());
+        REQUIRE(starts[5] == starts[0]);
+        REQUIRE(ring.empty());
+    }
+
+    SUBCASE("Full And Partial Commit") {
+        ByteSpan big = ring.write(200);
+        REQUIRE(!big.empty());
+        ring.commit(3);
+        REQUIRE(ring.size() == 16);
+        REQUIRE(ring.push("abcd", 4));
+        REQUIRE(ring.read().size() == 3);
+        ring.consume();
+        ByteSpan span = ring.read();
+        REQUIRE(span.size() == 4);
+        REQUIRE(std::memcmp(span.data(), "abcd", 4) == 0);
+        ring.consume();
+
+        while (ring.push("x", 1)) {
+        }
+        REQUIRE(ring.size() == ring.capacity());
+        REQUIRE(ring.write(1).empty());
+    }
+
+    SUBCASE("Concurrent Variable-Length Records") {
+        BipBuffer<> shared(4096);
+        const int total = 50000;
+        std::thread producer([&shared] {
+            for (int i = 0; i < total; ++i) {
+                const size_t len = 40 + static_cast<size_t>(i * 37) % 1000;
+                ByteSpan span;
+                while ((span = shared.write(len)).empty()) {
+                    std::this_thread::yield();
+                }
+                std::memset(span.data(), i & 0xff, len);
+                std::memcpy(span.data(), &i, sizeof(i));
+                shared.commit();
+            }
+        });
+        bool intact = true;
+        for (int i = 0; i < total; ++i) {
+            ByteSpan span;
+            while ((span = shared.read()).empty()) {
+                std::this_thread::yield();
+            }
+            int sequence;
+            std::memcpy(&sequence, span.data(), sizeof(sequence));
+            intact = intact && sequence == i && span.size() == 40 + static_cast<size_t>(i * 37) % 1000 &&
+                     std::to_integer<int>(span.data()[span.size() - 1]) == (i & 0xff);
+            shared.consume();
+        }
+        producer.join();
+        REQUIRE(intact);
+        REQUIRE(shared.empty());
+    }
+}
+
+TEST_CASE("SharedSPSCQueue Tests") {
+    struct Tick {
+        std::uint64_t sequence;
+        double price;
+    };
+    const std::string name = "/cpputils_test_" + std::to_string(getpid());
+    SharedSPSCQueue<Tick>::unlink(name);
+    auto producer = SharedSPSCQueue<Tick>::create(name, 8);
+
+    SUBCASE("Attach By Name") {
+        auto consumer = SharedSPSCQueue<Tick>::open(name);
+        REQUIRE(consumer.capacity() == 8);
+        for (std::uint64_t i = 0; i < 8; ++i) {
+            REQUIRE(producer.enqueue(Tick{i, i * 0.5}));
+        }
+        REQUIRE(producer.full());
+        REQUIRE(!producer.enqueue(Tick{8, 4.0}));
+        for (std::uint64_t i = 0; i < 8; ++i) {
+            Tick tick;
+            REQUIRE(consumer.dequeue(tick));
+            REQUIRE(tick.sequence == i);
+            REQUIRE(tick.price == i * 0.5);
+        }
+        REQUIRE(!consumer.try_pop());
+        REQUIRE(producer.empty());
+    }
+
+    SUBCASE("Layout Mismatch") {
+        CHECK_THROWS_AS(SharedSPSCQueue<std::uint32_t>::open(name), std::runtime_error);
+        CHECK_THROWS_AS(SharedSPSCQueue<Tick>::open("/cpputils_missing"), std::system_error);
+        CHECK_THROWS_AS(SharedSPSCQueue<Tick>::create(name, 6), std::invalid_argument);
+    }
+
+    SUBCASE("Across Processes") {
+        const std::uint64_t total = 100000;
+        const pid_t child = fork();
+        REQUIRE(child >= 0);
+        if (child == 0) {
+            // Never return into the test runner from the child.
+            try {
+                auto feed = SharedSPSCQueue<Tick>::open(name);
+                for (std::uint64_t i = 0; i < total; ++i) {
+                    while (!feed.enqueue(Tick{i, 1.0})) {
+                        std::this_thread::yield();
+                    }
+                }
+            } catch (...) {
+                _exit(1);
+            }
+            _exit(0);
+        }
+        bool ordered = true;
+        for (std::uint64_t i = 0; i < total; ++i) {
+            Tick tick;
+            while (!producer.dequeue(tick)) {
+                std::this_thread::yield();
+            }
+            ordered = ordered && tick.sequence == i;
+        }
+        int status = 0;
+        waitpid(child, &status, 0);
+        REQUIRE(ordered);
+        REQUIRE(WIFEXITED(status));
+        REQUIRE(WEXITSTATUS(status) == 0);
+    }
+
+    SharedSPSCQueue<Tick>::unlink(name);
+}
+
+namespace {
+// Counts live instances and copies; has no default constructor.
+struct Tracked {
+    static int live;
+    static int copies;
+    int value;
+
+    explicit Tracked(int v) : value(v) { ++live; }
+    Tracked(const Tracked& other) : value(other.value) { ++live; ++copies; }
+    Tracked& operator=(const Tracked& other) { value = other.value; ++copies; return *this; }
+    ~Tracked() { --live; }
+};
+int Tracked::live = 0;
+int Tracked::copies = 0;
+}
+
+TEST_CASE_TEMPLATE("Queue Slot Lifetime", Q, SPSCQueue<Tracked, 8>, SPMCQueue<Tracked, 8>, MPMCQueue<Tracked, 8>,
+                   UnboundedSPSCQueue<Tracked, 2>, UnboundedMPSCQueue<Tracked, 2>) {
+    Tracked::live = 0;
+    Tracked::copies = 0;
+    {
+        Q q;
+        REQUIRE(Tracked::live == 0);
+
+        REQUIRE(q.emplace(1));
+        REQUIRE(q.emplace(2));
+        REQUIRE(q.emplace(3));
+        REQUIRE(Tracked::live == 3);
+        REQUIRE(Tracked::copies == 0);
+
+        Tracked out(0);
+        REQUIRE(q.dequeue(out));
+        REQUIRE(out.value == 1);
+        REQUIRE(Tracked::live == 3);
+    }
+    // Remaining elements are destroyed along with the queue.
+    REQUIRE(Tracked::live == 0);
+}
+
+TEST_CASE_TEMPLATE("Queue Move-Only Payloads", Q, SPSCQueue<std::unique_ptr<int>, 8>, SPMCQueue<std::unique_ptr<int>, 8>) {
+    Q q;
+    REQUIRE(!q.try_pop());
+
+    auto p = std::make_unique<int>(1);
+    int* raw = p.get();
+    REQUIRE(q.enqueue(std::move(p)));
+    REQUIRE(q.emplace(new int(2)));
+
+    std::vector<std::unique_ptr<int>> batch;
+    batch.push_back(std::make_unique<int>(3));
+    batch.push_back(std::make_unique<int>(4));
+    REQUIRE(q.enqueue_bulk(std::make_move_iterator(batch.begin()), std::make_move_iterator(batch.end())) == 2);
+
+    std::unique_ptr<int> out;
+    REQUIRE(q.dequeue(out));
+    REQUIRE(out.get() == raw);
+
+    auto popped = q.try_pop();
+    REQUIRE(popped);
+    REQUIRE(**popped == 2);
+
+    std::unique_ptr<int> rest[2];
+    REQUIRE(q.dequeue_bulk(rest, 2) == 2);
+    REQUIRE(*rest[0] == 3);
+    REQUIRE(*rest[1] == 4);
+    REQUIRE(q.empty());
+}
+
+TEST_CASE("Test StringPool") {
+    auto pool = StringPool::getInstance();
+
+    SUBCASE("Test intern and try_emplace") {
+        auto s1 = StringPool::try_emplace("hello");
+        auto s2 = StringPool::try_emplace("hello");
+        auto s3 = StringPool::try_emplace("world");
+
+        CHECK(s1.get() == s2.get());
+        CHECK(s1.get() != s3.get());
+        CHECK(s1->data == "hello");
+        CHECK(s3->data == "world");
+    }
+
+    SUBCASE("Test isStringIntern") {
+        auto s1 = StringPool::try_emplace("hello");
+        CHECK(pool->isStringIntern("hello"));
+        CHECK_FALSE(pool->isStringIntern("goodbye"));
+    }
+
+    SUBCASE("Test getStringByHash") {
+        auto s1 = StringPool::try_emplace("hello");
+        auto s2 = pool->getStringByHash(hash64("hello", 5));
+        CHECK(s1.get() == s2.get());
+
+        auto s3 = pool->getStringByHash(hash64("world", 5));
+        CHECK(s3 == nullptr);
+    }
+
+    SUBCASE("Test StringRef") {
+        auto s1 = StringPool::try_emplace("hello");
+        StringRef ref1(s1);
+        StringRef ref2("hello");
+        StringRef ref3("world");
+
+        CHECK(ref1 == ref2);
+        CHECK(ref1 != ref3);
+        CHECK(ref1->data == "hello");
+        CHECK(ref3->data == "world");
+
+        CHECK(ref1.length() == 5);
+        CHECK(ref1[0] == 'h');
+        CHECK(ref1.at(4) == 'o');
+        CHECK(ref1.find("ll", 0) == 2);
+        CHECK(ref1.rfind("l", 4) == 3);
+        CHECK(ref1.substr(1, 3) == "ell");
+    }
+
+    SUBCASE("Test operator\"\"_hs") {
+        auto s1 = "hello"_hs;
+        auto s2 = "hello"_hs;
+        auto s3 = "world"_hs;
+
+        CHECK(s1.get() == s2.get());
+        CHECK(s1.get() != s3.get());
+        CHECK(s1->data == "hello");
+        CHECK(s3->data == "world");
+    }
+}
+
+
+TEST_CASE("StringPool Concurrent Intern") {
+    // Threads intern and drop overlapping names, so shards see hits, first
+    // inserts and last-reference releases racing with each other.
+    std::vector<std::string> names;
+    for (int i = 0; i < 256; ++i) {
+        names.push_back("symbol-" + std::to_string(i));
+    }
+    auto held = StringPool::try_emplace(names[0]);
+    std::atomic<int> mismatches{0};
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([&, t] {
+            for (int round = 0; round < 50; ++round) {
+                std::vector<StringPtr> local;
+                for (size_t i = static_cast<size_t>(t); i < names.size(); i += 2) {
+                    StringPtr s = StringPool::try_emplace(names[i]);
+                    if (s == nullptr || s->data != names[i]) {
+                        ++mismatches;
+                    }
+                    local.push_back(s);
+                }
+                if (StringPool::try_emplace(names[0]).get() != held.get()) {
+                    ++mismatches;
+                }
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    REQUIRE(mismatches.load() == 0);
+    // Released strings are gone; held ones survive.
+    CHECK_FALSE(StringPool::getInstance()->isStringIntern(names[1]));
+    CHECK(StringPool::getInstance()->isStringIntern(names[0]));
+}
+
+TEST_CASE("StringPool Lock-Free Lookup") {
+    // Enough names to grow every shard's table several times over while
+    // readers keep hitting a held set without taking the shard lock.
+    std::vector<StringPtr> held;
+    for (int i = 0; i < 64; ++i) {
+        held.push_back(StringPool::try_emplace("hot-" + std::to_string(i)));
+    }
+    std::atomic<bool> done{false};
+    std::atomic<int> mismatches{0};
+    std::vector<std::thread> readers;
+    for (int t = 0; t < 2; ++t) {
+        readers.emplace_back([&] {
+            while (!done.load(std::memory_order_relaxed)) {
+                for (int i = 0; i < 64; ++i) {
+                    if (StringPool::try_emplace("hot-" + std::to_string(i)).get() != held[i].get()) {
+                        ++mismatches;
+                    }
+                }
+                std::this_thread::yield();
+            }
+        });
+    }
+    std::vector<StringPtr> grown;
+    for (int round = 0; round < 4; ++round) {
+        for (int i = 0; i < 4000; ++i) {
+            grown.push_back(StringPool::try_emplace("cold-" + std::to_string(round) + "-" + std::to_string(i)));
+        }
+        // Drop them again so tombstones and retired entries pile up too.
+        grown.clear();
+    }
+    done = true;
+    for (auto& reader : readers) {
+        reader.join();
+    }
+    CHECK(mismatches.load() == 0);
+    CHECK(StringPool::getInstance()->isStringIntern("hot-63"));
+    CHECK_FALSE(StringPool::getInstance()->isStringIntern("cold-0-0"));
+    StringPtr again = StringPool::try_emplace(std::string("cold-0-0"));
+    CHECK(StringPool::getInstance()->isStringIntern("cold-0-0"));
+    CHECK(again->data == "cold-0-0");
+}
+
+TEST_CASE("StringPool Immortal Strings") {
+    auto pool = StringPool::getInstance();
+    const size_t arenaBefore = pool->arenaBytes();
+
+    SUBCASE("Immortal strings outlive their references") {
+        const String* raw = nullptr;
+        {
+            StringPtr s = StringPool::try_emplace_immortal("immortal-symbol");
+            REQUIRE(s != nullptr);
+            CHECK(s->data == "immortal-symbol");
+            CHECK(s.use_count() == 0);
+            raw = s.get();
+        }
+        CHECK(pool->isStringIntern("immortal-symbol"));
+        // A counted request finds the immortal string.
+        StringPtr again = StringPool::try_emplace("immortal-symbol");
+        CHECK(again.get() == raw);
+        CHECK(std::string(again->c_str()) == "immortal-symbol");
+        CHECK(pool->arenaBytes() > arenaBefore);
+    }
+
+    SUBCASE("A live counted string keeps its identity") {
+        StringPtr counted = StringPool::try_emplace("counted-first");
+        StringPtr immortal = StringPool::try_emplace_immortal("counted-first");
+        CHECK(immortal.get() == counted.get());
+        CHECK(counted.use_count() == 2);
+    }
+
+    SUBCASE("Default lifetime") {
+        pool->setDefaultLifetime(StringLifetime::Immortal);
+        std::vector<const String*> raws;
+        for (int i = 0; i < 1000; ++i) {
+            raws.push_back(StringRef("arena-" + std::to_string(i)).getRawPointer());
+        }
+        auto literal = "arena-literal"_hs;
+        pool->setDefaultLifetime(StringLifetime::Counted);
+        CHECK(literal.use_count() == 0);
+        for (int i = 0; i < 1000; ++i) {
+            StringPtr s = StringPool::try_emplace("arena-" + std::to_string(i));
+            CHECK(s.get() == raws[i]);
+            CHECK(s->data == "arena-" + std::to_string(i));
+        }
+    }
+}
+
+TEST_CASE("StringHandle") {
+    SUBCASE("Handles are 32-bit ids") {
+        StringHandle a("handle-alpha");
+        StringHandle b(std::string("handle-alpha"));
+        StringHandle c("handle-beta");
+        CHECK(a == b);
+        CHECK(a != c);
+        CHECK(a.id() != 0);
+        CHECK(a->data == "handle-alpha");
+        CHECK(StringHandle::fromId(c.id())->data == "handle-beta");
+        CHECK_FALSE(StringHandle());
+        CHECK(StringHandle().get() == nullptr);
+
+        std::unordered_set<StringHandle> set{a, b, c};
+        CHECK(set.size() == 2);
+    }
+
+    SUBCASE("A handle pins a counted string") {
+        const String* raw = nullptr;
+        StringHandle handle;
+        {
+            StringRef ref(std::string("handle-counted"));
+            raw = ref.getRawPointer();
+            handle = StringHandle(ref);
+            CHECK(handle.get() == raw);
+        }
+        // The last StringRef is gone but the handle still resolves.
+        CHECK(StringPool::getInstance()->isStringIntern("handle-counted"));
+        CHECK(handle.get() == raw);
+        CHECK(StringRef(std::string("handle-counted")).getRawPointer() == raw);
+    }
+
+    SUBCASE("Concurrent handle creation agrees") {
+        std::vector<std::uint32_t> ids[3];
+        std::vector<std::thread> threads;
+        for (int t = 0; t < 3; ++t) {
+            threads.emplace_back([&ids, t] {
+                for (int i = 0; i < 500; ++i) {
+                    ids[t].push_back(StringHandle("handle-race-" + std::to_string(i)).id());
+                }
+            });
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        CHECK(ids[0] == ids[1]);
+        CHECK(ids[1] == ids[2]);
+        CHECK(StringHandle::fromId(ids[0][499])->data == "handle-race-499");
+    }
+}
+
+TEST_CASE("StringPool 64-bit Hash") {
+    SUBCASE("Compile-time and runtime hashes agree") {
+        constexpr std::uint64_t literal = hash64("price", 5);
+        static_assert(literal != hash64("prices", 6), "hash64 should depend on every byte");
+        const std::string runtime = "price";
+        CHECK(hash64(runtime.c_str(), runtime.size()) == literal);
+    }
+
+    SUBCASE("Every length and byte position matters") {
+        std::string key;
+        std::unordered_set<std::uint64_t> seen;
+        for (int length = 0; length < 80; ++length) {
+            CHECK(seen.insert(hash64(key.c_str(), key.size())).second);
+            for (int i = 0; i < length; ++i) {
+                std::string flipped = key;
+                flipped[i] ^= 1;
+                CHECK(hash64(flipped.c_str(), flipped.size()) != hash64(key.c_str(), key.size()));
+            }
+            key.push_back(static_cast<char>('a' + length % 26));
+        }
+    }
+
+    SUBCASE("Colliding hashes are told apart") {
+        auto pool = StringPool::getInstance();
+        const std::uint64_t forced = 0x1234567890abcdefull;
+        StringPtr a = pool->intern("collide-a", forced);
+        StringPtr b = pool->intern("collide-b", forced);
+        REQUIRE(a != nullptr);
+        REQUIRE(b != nullptr);
+        CHECK(a.get() != b.get());
+        CHECK(a->data == "collide-a");
+        CHECK(b->data == "collide-b");
+        CHECK(pool->intern("collide-a", forced).get() == a.get());
+        CHECK(pool->intern("collide-b", forced).get() == b.get());
+        // Releasing one leaves the other in place.
+        const String* survivor = b.get();
+        a.reset();
+        CHECK(pool->intern("collide-b", forced).get() == survivor);
+    }
+}
+
+TEST_CASE("StringPool string_view Interning") {
+    // Tokens sliced out of one buffer, none of them NUL-terminated.
+    const std::string buffer = "bid,ask,bid,last,ask";
+    std::vector<StringPtr> tokens;
+    size_t start = 0;
+    while (start <= buffer.size()) {
+        size_t end = buffer.find(',', start);
+        if (end == std::string::npos) {
+            end = buffer.size();
+        }
+        tokens.push_back(StringPool::try_emplace(std::string_view(buffer).substr(start, end - start)));
+        start = end + 1;
+    }
+    REQUIRE(tokens.size() == 5);
+    CHECK(tokens[0].get() == tokens[2].get());
+    CHECK(tokens[1].get() == tokens[4].get());
+    CHECK(tokens[0]->data == "bid");
+    CHECK(std::strlen(tokens[3]->c_str()) == 4);
+    CHECK(tokens[0].get() == StringPool::try_emplace(std::string("bid")).get());
+    CHECK(tokens[1].get() == StringPool::try_emplace(buffer.data() + 4, 3).get());
+    CHECK(tokens[3].get() == StringRef(std::string_view("last")).getRawPointer());
+    CHECK(StringPool::getInstance()->isStringIntern(std::string_view(buffer).substr(0, 3)));
+    CHECK_FALSE(StringPool::getInstance()->isStringIntern(std::string_view(buffer).substr(0, 2)));
+    // Embedded NULs are part of the key.
+    const std::string withNul("a\0b", 3);
+    StringPtr nul = StringPool::try_emplace(std::string_view(withNul));
+    CHECK(nul->length() == 3);
+    CHECK(nul.get() != StringPool::try_emplace("a").get());
+}
+
+TEST_CASE("StringPool Static Literals") {
+    std::vector<const String*> seen;
+    std::vector<const StringPtr*> cached;
+    for (int i = 0; i < 3; ++i) {
+        const StringPtr& price = CPPUTILS_INTERN("static-price");
+        seen.push_back(price.get());
+        cached.push_back(&price);
+    }
+    CHECK(seen[0] != nullptr);
+    CHECK(seen[0] == seen[1]);
+    CHECK(seen[1] == seen[2]);
+    // Later evaluations return the same cached handle.
+    CHECK(cached[0] == cached[2]);
+    CHECK(seen[0]->data == "static-price");
+    CHECK(CPPUTILS_INTERN("static-price").get() == seen[0]);
+    CHECK(StringPool::try_emplace("static-price").get() == seen[0]);
+    CHECK(("static-price"_hs).get() == seen[0]);
+    CHECK(CPPUTILS_INTERN("static-price").use_count() == 0);
+#if defined(__cpp_nontype_template_args) && __cpp_nontype_template_args >= 201911L
+    CHECK(("static-price"_is).get() == seen[0]);
+    CHECK(&"static-qty"_is == &"static-qty"_is);
+#endif
+}
+
+TEST_CASE("StringCache") {
+    SUBCASE("Hits agree with the pool") {
+        StringCache<16> cache;
+        StringPtr a = cache.intern("cache-field");
+        StringPtr b = cache.intern(std::string("cache-field"));
+        CHECK(a.get() == b.get());
+        CHECK(a.get() == StringPool::try_emplace("cache-field").get());
+        CHECK(cache.hits() == 1);
+        CHECK(cache.misses() == 1);
+    }
+
+    SUBCASE("Released strings miss") {
+        StringCache<16> cache;
+        cache.intern("cache-transient");
+        // The cache alone does not keep the string alive.
+        CHECK_FALSE(StringPool::getInstance()->isStringIntern("cache-transient"));
+        StringPtr again = cache.intern("cache-transient");
+        CHECK(again->data == "cache-transient");
+        CHECK(cache.hits() == 0);
+        CHECK(cache.misses() == 2);
+    }
+
+    SUBCASE("Immortal hits carry no reference count") {
+        StringCache<16> cache;
+        StringPool::try_emplace_immortal("cache-immortal");
+        cache.intern("cache-immortal");
+        StringPtr hit = cache.intern("cache-immortal");
+        CHECK(hit.use_count() == 0);
+        CHECK(cache.hits() == 1);
+    }
+
+    SUBCASE("Evicted lines fall back to the pool") {
+        // With one line every key evicts the previous one.
+        StringCache<1> cache;
+        std::vector<StringPtr> held;
+        for (int round = 0; round < 2; ++round) {
+            for (int i = 0; i < 8; ++i) {
+                StringPtr s = cache.intern("cache-evict-" + std::to_string(i));
+                CHECK(s->data == "cache-evict-" + std::to_string(i));
+                held.push_back(s);
+            }
+        }
+        CHECK(cache.misses() == 16);
+        for (int i = 0; i < 8; ++i) {
+            CHECK(held[i].get() == held[i + 8].get());
+        }
+    }
+
+    SUBCASE("Each thread has its own cache") {
+        auto& mine = StringCache<>::local();
+        StringCache<>* theirs = nullptr;
+        std::thread([&theirs] { theirs = &StringCache<>::local(); }).join();
+        CHECK(theirs != &mine);
+    }
+}
+
+TEST_CASE("StringPool Batch Intern") {
+    auto pool = StringPool::getInstance();
+    StringPtr existing = StringPool::try_emplace("batch-7");
+
+    std::vector<std::string> storage;
+    for (int i = 0; i < 1000; ++i) {
+        storage.push_back("batch-" + std::to_string(i % 300));
+    }
+    std::vector<std::string_view> keys(storage.begin(), storage.end());
+    std::vector<StringPtr> out = pool->intern_batch(keys);
+
+    REQUIRE(out.size() == keys.size());
+    for (size_t i = 0; i < keys.size(); ++i) {
+        REQUIRE(out[i] != nullptr);
+        CHECK(out[i]->data == keys[i]);
+        // Duplicates within the batch resolve to one string.
+        CHECK(out[i].get() == out[i % 300].get());
+    }
+    CHECK(out[7].get() == existing.get());
+    CHECK(out[299].get() == StringPool::try_emplace("batch-299").get());
+
+    // Output slots are overwritten, and an empty batch is fine.
+    pool->intern_batch(keys.data(), 2, out.data() + 500, StringLifetime::Immortal);
+    CHECK(out[500].get() == out[0].get());
+    CHECK(out[501].get() == out[1].get());
+    pool->intern_batch(nullptr, 0, nullptr);
+}
+
+TEST_CASE("StringPool Snapshot") {
+    const std::string dir = std::filesystem::temp_directory_path().string();
+    const std::string path = dir + "/cpputils-snapshot-" + std::to_string(getpid()) + ".bin";
+    const std::string full = path + ".full";
+
+    SUBCASE("Saved strings can be reopened") {
+        StringPtr held = StringPool::try_emplace("snapshot-saved");
+        REQUIRE(StringPool::getInstance()->saveSnapshot(full));
+        auto table = StringSnapshot::open(full);
+        REQUIRE(table != nullptr);
+        const String* found = table->find("snapshot-saved", hash64("snapshot-saved", 14));
+        REQUIRE(found != nullptr);
+        CHECK(found->data == "snapshot-saved");
+        CHECK(std::strcmp(found->c_str(), "snapshot-saved") == 0);
+        CHECK(table->find("snapshot-absent", hash64("snapshot-absent", 15)) == nullptr);
+        std::filesystem::remove(full);
+    }
+
+    SUBCASE("Invalid files are rejected") {
+        CHECK(StringSnapshot::open(path + ".missing") == nullptr);
+        {
+            std::ofstream out(path + ".bad", std::ios::binary);
+            out << "definitely not a snapshot file";
+        }
+        CHECK(StringSnapshot::open(path + ".bad") == nullptr);
+        CHECK_FALSE(StringPool::getInstance()->loadSnapshot(path + ".bad"));
+        std::filesystem::remove(path + ".bad");
+    }
+
+    SUBCASE("Truncated and corrupt files are rejected") {
+        const std::vector<std::string> names{"snapshot-corrupt-a", "snapshot-corrupt-b", "snapshot-corrupt-c"};
+        std::vector<std::pair<std::uint64_t, std::string_view>> strings;
+        for (const std::string& name : names) {
+            strings.emplace_back(hash64(name.data(), name.size()), name);
+        }
+        REQUIRE(StringSnapshot::write(path, strings));
+        std::string bytes;
+        {
+            std::ifstream in(path, std::ios::binary);
+            bytes.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+        }
+        REQUIRE(StringSnapshot::open(path) != nullptr);
+        const auto opens = [&](const std::string& contents) {
+            {
+                std::ofstream out(path + ".bad", std::ios::binary | std::ios::trunc);
+                out.write(contents.data(), static_cast<std::streamsize>(contents.size()));
+            }
+            const bool opened = StringSnapshot::open(path + ".bad") != nullptr;
+            std::filesystem::remove(path + ".bad");
+            return opened;
+        };
+        CHECK(opens(bytes));
+        CHECK_FALSE(opens(bytes.substr(0, bytes.size() - 7)));
+        CHECK_FALSE(opens(bytes.substr(0, 40)));
+
+        // A 32-byte header, 16 index slots of 16 bytes, then 3 records of
+        // 16 bytes, then the characters.
+        const size_t records = 32 + 16 * 16;
+        const size_t characters = records + 3 * 16;
+        auto patched = [&](size_t at, std::uint64_t value) {
+            std::string copy = bytes;
+            std::memcpy(&copy[at], &value, sizeof(value));
+            return copy;
+        };
+        // A record offset far past the end, and one whose length runs over.
+        CHECK_FALSE(opens(patched(records, std::uint64_t(1) << 40)));
+        CHECK_FALSE(opens(patched(records + 8, 1000)));
+        // Characters that no longer match their hash.
+        std::string flipped = bytes;
+        flipped[characters + 3] ^= 1;
+        CHECK_FALSE(opens(flipped));
+        // An index slot naming a record that does not exist.
+        size_t slot = 32;
+        for (std::uint64_t record = 0; slot < records; slot += 16) {
+            std::memcpy(&record, &bytes[slot + 8], sizeof(record));
+            if (record != 0) {
+                break;
+            }
+        }
+        REQUIRE(slot < records);
+        CHECK_FALSE(opens(patched(slot + 8, 99)));
+        std::filesystem::remove(path);
+    }
+
+    SUBCASE("A loaded snapshot is the base layer") {
+        std::vector<std::string> names;
+        std::vector<std::pair<std::uint64_t, std::string_view>> strings;
+        for (int i = 0; i < 100; ++i) {
+            names.push_back("snapshot-base-" + std::to_string(i));
+        }
+        for (const std::string& name : names) {
+            strings.emplace_back(hash64(name.data(), name.size()), name);
+        }
+        REQUIRE(StringSnapshot::write(path, strings));
+        auto pool = StringPool::getInstance();
+        REQUIRE(pool->loadSnapshot(path));
+        CHECK_FALSE(pool->loadSnapshot(path));
+        REQUIRE(pool->snapshot() != nullptr);
+        CHECK(pool->snapshot()->size() == 100);
+
+        // Mapped strings need no reference to stay interned.
+        CHECK(pool->isStringIntern("snapshot-base-42"));
+        StringPtr a = StringPool::try_emplace("snapshot-base-42");
+        CHECK(a.use_count() == 0);
+        CHECK(a.get() == StringPool::try_emplace(std::string("snapshot-base-42")).get());
+        CHECK(a->data == "snapshot-base-42");
+        std::vector<std::string_view> batch{"snapshot-base-1", "snapshot-not-mapped"};
+        std::vector<StringPtr> out = pool->intern_batch(batch);
+        CHECK(out[0].get() == StringPool::try_emplace("snapshot-base-1").get());
+        CHECK(out[0].use_count() == 0);
+        CHECK(out[1]->data == "snapshot-not-mapped");
+        CHECK(out[1].use_count() == 1);
+        std::filesystem::remove(path);
+    }
+}
+
+TEST_CASE("StringPool Stats") {
+    auto pool = StringPool::getInstance();
+    pool->resetStats();
+    {
+        StringPtr a = StringPool::try_emplace("stats-alpha");
+        StringPtr b = StringPool::try_emplace("stats-alpha");
+        StringPtr c = StringPool::try_emplace("stats-gamma!");
+        StringPoolStatsSnapshot live = pool->stats();
+        CHECK(live.misses == 2);
+        CHECK(live.hits == 1);
+        CHECK(live.liveStrings == 2);
+        CHECK(live.liveBytes == 23);
+        CHECK(live.averageLength() == doctest::Approx(11.5));
+        CHECK(live.hitRate() == doctest::Approx(1.0 / 3.0));
+    }
+    StringPoolStatsSnapshot released = pool->stats();
+    CHECK(released.releases == 2);
+    CHECK(released.liveStrings == 0);
+    CHECK(released.liveBytes == 0);
+
+    const std::uint64_t forced = 0xfeedfacecafebeefull;
+    StringPtr x = pool->intern("stats-collide-x", forced);
+    StringPtr y = pool->intern("stats-collide-y", forced);
+    CHECK(pool->stats().collisions >= 1);
+
+    pool->resetStats();
+    StringPoolStatsSnapshot cleared = pool->stats();
+    CHECK(cleared.hits == 0);
+    CHECK(cleared.misses == 0);
+    CHECK(cleared.collisions == 0);
+    CHECK(StringPool::Stats::enabled);
+}
+
+TEST_CASE("StringPool Single-Block Layout") {
+    const std::string text(200, 'x');
+    StringPtr counted = StringPool::try_emplace(text);
+    StringPtr immortal = StringPool::try_emplace_immortal("layout-immortal");
+    for (const StringPtr& s : {counted, immortal}) {
+        const char* header = reinterpret_cast<const char*>(s.get());
+        // The characters follow the header in the same block.
+        CHECK(s->c_str() >= header + sizeof(String));
+        CHECK(s->c_str() < header + sizeof(String) + 64);
+        CHECK(s->c_str()[s->length()] == '\0');
+        CHECK(s->hash() == hash64(s->c_str(), s->length()));
+    }
+    CHECK(counted->data == text);
+    // The pool's entry does not keep the block's String alive.
+    std::weak_ptr<const String> weak = counted;
+    counted.reset();
+    CHECK(weak.expired());
+    CHECK_FALSE(StringPool::getInstance()->isStringIntern(text));
+}
+
+TEST_CASE("StringPool Deferred Reclamation") {
+    auto pool = StringPool::getInstance();
+    pool->collect();
+
+    SUBCASE("Released strings are swept in batches") {
+        {
+            std::vector<StringRef> refs;
+            for (int i = 0; i < 100; ++i) {
+                refs.emplace_back("reclaim-" + std::to_string(i));
+            }
+        }
+        // Dead entries are invisible before the sweep.
+        CHECK_FALSE(pool->isStringIntern("reclaim-5"));
+        StringPtr again = StringPool::try_emplace("reclaim-5");
+        CHECK(again->data == "reclaim-5");
+        CHECK(pool->collect() == 100);
+        CHECK(pool->collect() == 0);
+        CHECK(pool->isStringIntern("reclaim-5"));
+    }
+
+    SUBCASE("A full batch sweeps by itself") {
+        {
+            std::vector<StringPtr> strings;
+            for (int i = 0; i < 4096; ++i) {
+                strings.push_back(StringPool::try_emplace("reclaim-batch-" + std::to_string(i)));
+            }
+        }
+        // 16 shards each sweep every 256 releases, so little is left over.
+        CHECK(pool->collect() < 4096);
+    }
+
+    SUBCASE("Pinned strings survive their references") {
+        const String* raw = nullptr;
+        {
+            StringPtr hot = StringPool::try_emplace("reclaim-pinned");
+            raw = hot.get();
+            pool->pin(hot);
+        }
+        pool->collect();
+        CHECK(StringPool::try_emplace("reclaim-pinned").get() == raw);
+    }
+
+    SUBCASE("Concurrent teardown and interning") {
+        std::atomic<int> mismatches{0};
+        std::vector<std::thread> threads;
+        for (int t = 0; t < 3; ++t) {
+            threads.emplace_back([&mismatches] {
+                for (int round = 0; round < 20; ++round) {
+                    std::vector<StringRef> refs;
+                    for (int i = 0; i < 300; ++i) {
+                        refs.emplace_back("reclaim-churn-" + std::to_string(i));
+                        if (refs.back()->data != "reclaim-churn-" + std::to_string(i)) {
+                            ++mismatches;
+                        }
+                    }
+                }
+            });
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        CHECK(mismatches.load() == 0);
+        pool->collect();
+        CHECK_FALSE(pool->isStringIntern("reclaim-churn-0"));
+    }
+}
+
+TEST_CASE("StringRef Hash and Ordering") {
+    StringRef pear("order-pear");
+    StringRef apple("order-apple");
+    StringRef fig("order-fig");
+    CHECK(pear.hash() == hash64("order-pear", 10));
+    CHECK(std::hash<StringRef>{}(pear) == static_cast<size_t>(pear.hash()));
+    CHECK(StringRef(std::string("order-pear")).hash() == pear.hash());
+
+    // Address order is a strict weak order over distinct strings.
+    CHECK((pear < apple) != (apple < pear));
+    CHECK_FALSE(pear < pear);
+    std::set<StringRef> byAddress{pear, apple, fig, StringRef("order-fig")};
+    CHECK(byAddress.size() == 3);
+
+    std::map<StringRef, int, StringContentLess> byContent;
+    byContent.emplace(pear, 1);
+    byContent.emplace(apple, 2);
+    byContent.emplace(fig, 3);
+    std::vector<std::string> keys;
+    for (const auto& entry : byContent) {
+        keys.emplace_back(entry.first->data);
+    }
+    CHECK(keys == std::vector<std::string>{"order-apple", "order-fig", "order-pear"});
+}
+
+TEST_CASE("StringRefMap") {
+    StringRefMap<int> map;
+    CHECK(map.empty());
+    CHECK(map.find(StringRef("refmap-absent")) == map.end());
+
+    SUBCASE("Lookups never assign handles") {
+        StringRef probe("refmap-probe-only");
+        CHECK_FALSE(map.contains(probe));
+        CHECK_FALSE(map.erase(probe));
+        CHECK_FALSE(StringHandle::existing(probe.getRawPointer()));
+    }
+
+    SUBCASE("Keys of a scoped pool are refused, not lost") {
+        StringPool session;
+        StringRef key(session, "refmap-scoped-key");
+        CHECK_THROWS_AS(map[key], std::invalid_argument);
+        CHECK_THROWS_AS(map.try_emplace(key, 1), std::invalid_argument);
+        CHECK(map.empty());
+        CHECK(map.find(key) == map.end());
+        CHECK_FALSE(map.contains(key));
+        CHECK_FALSE(map.erase(key));
+        CHECK_FALSE(StringPool::instance().isStringIntern("refmap-scoped-key"));
+        // The same characters in the process-wide pool are a separate key.
+        map[StringRef("refmap-scoped-key")] = 7;
+        CHECK_FALSE(map.contains(key));
+        CHECK(map.find(StringRef("refmap-scoped-key"))->second == 7);
+    }
+
+    SUBCASE("Matches unordered_map under churn") {
+        std::vector<StringRef> keys;
+        for (int i = 0; i < 600; ++i) {
+            keys.emplace_back("refmap-key-" + std::to_string(i));
+        }
+        std::unordered_map<StringRef, int> reference;
+        std::uint64_t state = 12345;
+        for (int step = 0; step < 20000; ++step) {
+            state = state * 6364136223846793005ull + 1442695040888963407ull;
+            const StringRef& key = keys[(state >> 33) % keys.size()];
+            if ((state >> 20) % 3 == 0) {
+                CHECK(map.erase(key) == (reference.erase(key) == 1));
+            } else {
+                map[key] += step;
+                reference[key] += step;
+            }
+        }
+        REQUIRE(map.size() == reference.size());
+        for (const auto& entry : reference) {
+            auto it = map.find(entry.first);
+            REQUIRE(it != map.end());
+            CHECK(it->second == entry.second);
+            CHECK(it->first.get() == entry.first.getRawPointer());
+        }
+        size_t visited = 0;
+        for (const auto& entry : static_cast<const StringRefMap<int>&>(map)) {
+            CHECK(reference.count(StringRef(StringPtr(entry.first))) == 1);
+            ++visited;
+        }
+        CHECK(visited == reference.size());
+        // Tombstones are recycled instead of growing the table forever.
+        CHECK(map.capacity() <= 2048);
+    }
+
+    SUBCASE("Copy, move and clear") {
+        map.try_emplace(StringRef("refmap-a"), 1);
+        map.try_emplace(StringHandle("refmap-b"), 2);
+        CHECK_FALSE(map.try_emplace(StringRef("refmap-a"), 9).second);
+        StringRefMap<int> copy(map);
+        StringRefMap<int> moved(std::move(map));
+        CHECK(copy.size() == 2);
+        CHECK(moved.size() == 2);
+        CHECK(copy.find(StringHandle("refmap-b"))->second == 2);
+        CHECK(moved[StringRef("refmap-a")] == 1);
+        moved.clear();
+        CHECK(moved.empty());
+        CHECK(moved.begin() == moved.end());
+        CHECK(copy.contains(StringRef("refmap-a")));
+    }
+
+    SUBCASE("Owning values") {
+        StringRefMap<std::unique_ptr<std::string>> owners;
+        for (int i = 0; i < 100; ++i) {
+            owners.try_emplace(StringRef("refmap-owner-" + std::to_string(i)),
+                               std::make_unique<std::string>(std::to_string(i)));
+        }
+        CHECK(*owners.find(StringRef("refmap-owner-42"))->second == "42");
+        auto it = owners.find(StringRef("refmap-owner-7"));
+        owners.erase(it);
+        CHECK(owners.size() == 99);
+    }
+}
+
+TEST_CASE("StringPool Dense Symbol Ids") {
+    auto pool = StringPool::getInstance();
+    const std::uint32_t first = pool->symbolId("symbol-dense-first");
+    CHECK(pool->symbolId("symbol-dense-first") == first);
+    CHECK(pool->symbolView(first) == "symbol-dense-first");
+    CHECK(StringHandle("symbol-dense-first").id() == first + 1);
+
+    // Bulk ids: new strings get consecutive ids, repeats reuse theirs.
+    std::vector<std::string> names;
+    for (int i = 0; i < 150; ++i) {
+        names.push_back("symbol-dense-" + std::to_string(i));
+    }
+    std::vector<std::string_view> column;
+    for (int row = 0; row < 300; ++row) {
+        column.emplace_back(names[row % names.size()]);
+    }
+    column.emplace_back("symbol-dense-first");
+    const std::uint32_t before = pool->symbolCount();
+    const std::vector<std::uint32_t> ids = pool->ids_of(column);
+    CHECK(pool->symbolCount() == before + names.size());
+    std::set<std::uint32_t> distinct(ids.begin(), ids.end() - 1);
+    CHECK(distinct.size() == names.size());
+    CHECK(*distinct.begin() == before);
+    CHECK(*distinct.rbegin() == before + names.size() - 1);
+    CHECK(ids.back() == first);
+    for (size_t row = 0; row < column.size(); ++row) {
+        CHECK(pool->symbolView(ids[row]) == column[row]);
+    }
+
+    // Group-by on the encoded column is plain array work.
+    std::vector<int> counts(pool->symbolCount());
+    for (const std::uint32_t id : ids) {
+        ++counts[id];
+    }
+    CHECK(counts[pool->symbolId("symbol-dense-7")] == 2);
+}
+
+TEST_CASE("StringRef Zero-Copy Views") {
+    StringRef path("/api/v2/orders/recent");
+    const std::string_view chars = path.view();
+    CHECK(chars == "/api/v2/orders/recent");
+    CHECK(chars.data() == path->c_str());
+
+    const std::string_view tail = path.substr_view(8);
+    CHECK(tail == "orders/recent");
+    CHECK(tail.data() == path->c_str() + 8);
+    CHECK(path.substr_view(1, 3) == "api");
+    CHECK(path.substr(1, 3) == "api");
+
+    CHECK(path.starts_with("/api/"));
+    CHECK(path.starts_with('/'));
+    CHECK_FALSE(path.starts_with("/api/v3"));
+    CHECK(path.ends_with("recent"));
+    CHECK(path.ends_with('t'));
+    CHECK_FALSE(path.ends_with("/api/v2/orders/recent/"));
+    CHECK(StringRef("").starts_with(""));
+    CHECK_FALSE(StringRef("").ends_with('x'));
+
+    CHECK(path.find("orders") == 8);
+    CHECK(path.find('/', 1) == 4);
+    CHECK(path.rfind('/') == 14);
+    CHECK(path.rfind("/v2") == 4);
+    CHECK(path.find(std::string("recent")) == 15);
+    CHECK(path->find("missing") == std::string_view::npos);
+
+    // Implicit string_view interop.
+    auto length = [](std::string_view s) { return s.size(); };
+    CHECK(length(path) == path.size());
+    CHECK(length(*path) == path.size());
+    const std::string copy(path.view());
+    CHECK(copy == "/api/v2/orders/recent");
+}
+
+TEST_CASE("StringPool Scoped Instances") {
+    SUBCASE("Pools are independent") {
+        StringPool session;
+        StringRef local(session, "scoped-shared-name");
+        StringRef global("scoped-shared-name");
+        CHECK(local != global);
+        CHECK(local->data == global->data);
+        CHECK(local == StringRef(session, std::string("scoped-shared-name")));
+        CHECK(local.pool() == &session);
+        CHECK(global.pool() == StringPool::getInstance().get());
+        CHECK(session.isStringIntern("scoped-shared-name"));
+                StringRef other(session, "scoped-only-here");
+        CHECK_FALSE(StringPool::getInstance()->isStringIntern("scoped-only-here"));
+    }
+
+    SUBCASE("Arena-backed pool drops its strings wholesale") {
+        auto session = std::make_unique<StringPool>(StringLifetime::Immortal);
+        for (int i = 0; i < 5000; ++i) {
+            session->intern("scoped-arena-" + std::to_string(i));
+        }
+        {
+            StringRef name(*session, "scoped-arena-42");
+            CHECK(name.pool() == session.get());
+            CHECK(name == StringRef(session->lookup("scoped-arena-42")));
+        }
+        // 5000 strings and their entries live in a few arena blocks.
+        CHECK(session->arenaBytes() / StringArena::BlockSize < 20);
+        session.reset();
+    }
+
+    SUBCASE("Handles only name strings of the process-wide pool") {
+        StringPool session;
+        StringRef local(session, "scoped-handle-name");
+        CHECK_THROWS_AS(StringHandle{local}, std::invalid_argument);
+        // Refusing it left no copy behind in the process-wide pool.
+        CHECK_FALSE(StringPool::instance().isStringIntern("scoped-handle-name"));
+        // The scoped pool's own id is not mistaken for a handle.
+        const std::uint32_t id = session.symbolId("scoped-handle-name");
+        CHECK(session.symbolView(id) == "scoped-handle-name");
+        CHECK(session.lookupSymbol("scoped-handle-name") == id);
+        CHECK(session.lookupSymbol("scoped-handle-absent") == StringPool::NoSymbol);
+        CHECK_FALSE(StringHandle::existing(local.getRawPointer()));
+        CHECK(StringHandle(StringRef("scoped-handle-name"))->data == "scoped-handle-name");
+    }
+
+    SUBCASE("A pool carries no handle directory until it hands out an id") {
+        // The directory alone is 16384 page pointers.
+        CHECK(sizeof(StringPool) < 16384 * sizeof(void*));
+        StringPool session;
+        const std::uint32_t id = session.symbolId("scoped-directory");
+        CHECK(session.symbolView(id) == "scoped-directory");
+    }
+
+    SUBCASE("Counted strings may outlive their pool") {
+        StringPtr survivor;
+        {
+            StringPool session;
+            survivor = session.intern("scoped-survivor");
+            StringRef pinned(session, "scoped-pinned");
+            session.handleOf(pinned->data, pinned.hash());
+            StringPtr dropped = session.intern("scoped-dropped");
+        }
+        CHECK(survivor->data == "scoped-survivor");
+        CHECK(survivor->pool() == nullptr);
+        survivor.reset();
+    }
+}
+
+TEST_CASE("StringPool Instance Access") {
+    StringPool& pool = StringPool::instance();
+    CHECK(&pool == &StringPool::instance());
+    // The compatibility shared_ptr shares no control block.
+    const std::shared_ptr<StringPool> legacy = StringPool::getInstance();
+    CHECK(legacy.get() == &pool);
+    CHECK(legacy.use_count() == 0);
+    CHECK(StringRef("instance-access").pool() == &pool);
+}
+
+TEST_CASE("StringLoader") {
+    std::string text;
+    std::vector<std::string> expected;
+    for (int i = 0; i < 3000; ++i) {
+        const std::string token = "loader-" + std::to_string(i % 700);
+        expected.push_back(token);
+        text += token;
+        text += (i % 11 == 0) ? "\n\n" : (i % 3 == 0 ? "\t" : " ");
+    }
+    const std::string path = (std::filesystem::temp_directory_path() / "cpputils_loader_test.txt").string();
+    {
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        out << "  " << text;
+    }
+
+    ThreadPool threads(4);
+    StringPool pool;
+    TokenizeOptions options;
+    options.chunkBytes = 256;
+    options.batchSize = 50;
+    const StringLoader::Chunks chunks = StringLoader::internFile(path, threads, pool, options);
+    CHECK(chunks.size() > 10);
+
+    std::vector<std::uint32_t> ids;
+    for (const auto& chunk : chunks) {
+        ids.insert(ids.end(), chunk.begin(), chunk.end());
+    }
+    REQUIRE(ids.size() == expected.size());
+    for (size_t i = 0; i < ids.size(); ++i) {
+        CHECK(pool.symbolView(ids[i]) == expected[i]);
+    }
+    // 700 distinct tokens, numbered densely from zero.
+    CHECK(pool.symbolCount() == 700);
+    CHECK(*std::max_element(ids.begin(), ids.end()) == 699);
+    CHECK(StringHandle::fromId(ids[5] + 1).id() == pool.symbolId(expected[5]) + 1);
+
+    // Same tokens from memory, one chunk, same ids.
+    const StringLoader::Chunks whole = StringLoader::internText(text, threads, pool, TokenizeOptions());
+    REQUIRE(whole.size() == 1);
+    CHECK(whole[0] == ids);
+
+    CHECK(StringLoader::internText("", threads, pool).empty());
+    CHECK_THROWS_AS(StringLoader::internFile(path + ".missing", threads, pool), std::runtime_error);
+    std::filesystem::remove(path);
+}
+
+TEST_CASE("StringPool Freeze") {
+    StringPool pool;
+    std::vector<StringPtr> loaded;
+    for (int i = 0; i < 5000; ++i) {
+        loaded.push_back(pool.intern("frozen-" + std::to_string(i)));
+    }
+    const StringPtr immortal = pool.intern("frozen-immortal", hash64("frozen-immortal", 15), StringLifetime::Immortal);
+    CHECK(pool.frozen() == nullptr);
+
+    SUBCASE("Overlay") {
+        REQUIRE(pool.freeze());
+        CHECK_FALSE(pool.freeze());
+        const FrozenStringTable* table = pool.frozen();
+        REQUIRE(table != nullptr);
+        CHECK(table->size() == 5001);
+        CHECK(table->capacity() > table->size());
+        // About one byte of index per key.
+        CHECK(table->displacementBytes() == (5001 + 3) / 4 * sizeof(std::uint32_t));
+        for (size_t i = 0; i < loaded.size(); ++i) {
+            const std::string key = "frozen-" + std::to_string(i);
+            CHECK(table->find(key, hash64(key.data(), key.size())) == loaded[i].get());
+            CHECK(pool.intern(key) == loaded[i]);
+        }
+        CHECK(pool.lookup("frozen-immortal") == immortal);
+        CHECK(table->find("frozen-none", hash64("frozen-none", 11)) == nullptr);
+
+        // Frozen counted strings are pinned.
+        const String* first = loaded[0].get();
+        loaded.clear();
+        CHECK(pool.lookup("frozen-0").get() == first);
+
+        // New strings land in the overlay.
+        StringRef later(pool, "frozen-later");
+        CHECK(later == StringRef(pool, "frozen-later"));
+        CHECK(table->find("frozen-later", later.hash()) == nullptr);
+        CHECK_FALSE(pool.loadSnapshot("/nonexistent"));
+    }
+
+    SUBCASE("Sealed") {
+        REQUIRE(pool.freeze(FreezeMode::Sealed));
+        CHECK(pool.intern("frozen-17") == loaded[17]);
+        CHECK_THROWS_AS(pool.intern("frozen-unknown"), std::out_of_range);
+        CHECK(pool.lookup("frozen-unknown") == nullptr);
+    }
+
+    SUBCASE("Millions of keys") {
+        // Built directly from distinct hashes; placement never reads the strings.
+        const size_t count = size_t(1) << 21;
+        std::vector<std::pair<std::uint64_t, const String*>> keys(count);
+        for (size_t i = 0; i < count; ++i) {
+            std::uint64_t x = (i + 1) * 0x9E3779B97F4A7C15ull;
+            x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+            x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+            keys[i] = {x ^ (x >> 31), nullptr};
+        }
+        const auto table = FrozenStringTable::build(std::move(keys));
+        REQUIRE(table != nullptr);
+        CHECK(table->size() == count);
+        CHECK(table->capacity() > count);
+        CHECK(table->capacity() < count + count / 2);
+        CHECK(table->find("frozen-none", hash64("frozen-none", 11)) == nullptr);
+    }
+
+    SUBCASE("Empty pool") {
+        StringPool empty;
+        REQUIRE(empty.freeze());
+        CHECK(empty.frozen()->size() == 0);
+        CHECK(empty.intern("frozen-first") != nullptr);
+    }
+}
+
+TEST_CASE("hash64_batch") {
+    // Every length class, at every alignment of the characters.
+    std::string text;
+    for (int i = 0; i < 200; ++i) {
+        text += static_cast<char>('!' + (i * 37) % 90);
+    }
+    std::vector<std::string_view> keys;
+    for (size_t length = 0; length <= 80; ++length) {
+        for (size_t offset = 0; offset < 8; ++offset) {
+            keys.push_back(std::string_view(text).substr(offset, length));
+        }
+    }
+    std::vector<std::uint64_t> hashes(keys.size());
+    hash64_batch(keys.data(), keys.size(), hashes.data());
+    for (size_t i = 0; i < keys.size(); ++i) {
+        CHECK(hashes[i] == hash64(keys[i].data(), keys[i].size()));
+    }
+    // Runtime loads agree with the compile-time path.
+    constexpr std::uint64_t literal = hash64("ticker:AAPL.OQ", 14);
+    const std::string runtime = "ticker:AAPL.OQ";
+    std::uint64_t batched = 0;
+    const std::string_view view(runtime);
+    hash64_batch(&view, 1, &batched);
+    CHECK(batched == literal);
+    CHECK(hash64(runtime.data(), runtime.size()) == literal);
+}
+
+TEST_CASE("PathPool") {
+    StringPool strings(StringLifetime::Immortal);
+    PathPool paths('.', strings);
+    CHECK(paths.size() == 1);
+    CHECK(paths.intern("") == PathPool::Root);
+    CHECK(paths.str(PathPool::Root).empty());
+
+    const PathPool::Id bid = paths.intern("md.XNAS.AAPL.bid");
+    const PathPool::Id ask = paths.intern("md.XNAS.AAPL.ask");
+    CHECK(bid != ask);
+    CHECK(paths.size() == 6);
+    CHECK(paths.intern("md.XNAS.AAPL.bid") == bid);
+    CHECK(paths.depth(bid) == 4);
+    CHECK(paths.segment(bid) == "bid");
+    CHECK(paths.str(bid) == "md.XNAS.AAPL.bid");
+
+    // Shared prefix, and append() from a parent id.
+    const PathPool::Id aapl = paths.parent(bid);
+    CHECK(paths.parent(ask) == aapl);
+    CHECK(paths.str(aapl) == "md.XNAS.AAPL");
+    CHECK(paths.append(aapl, "bid") == bid);
+    CHECK(paths.parent(PathPool::Root) == PathPool::Root);
+    CHECK(paths.isPrefixOf(aapl, bid));
+    CHECK(paths.isPrefixOf(PathPool::Root, bid));
+    CHECK_FALSE(paths.isPrefixOf(bid, aapl));
+    CHECK_FALSE(paths.isPrefixOf(ask, bid));
+
+    const PathPool::Id last = paths.append(aapl, "last");
+    std::vector<std::string> children;
+    paths.forEachChild(aapl, [&](PathPool::Id child) {
+        CHECK(paths.parent(child) == aapl);
+        children.emplace_back(paths.segment(child));
+    });
+    std::sort(children.begin(), children.end());
+    CHECK(children == std::vector<std::string>{"ask", "bid", "last"});
+    CHECK(paths.str(last) == "md.XNAS.AAPL.last");
+
+    // Lookups never add.
+    const size_t before = paths.size();
+    CHECK(paths.lookup("md.XNAS.AAPL.ask") == ask);
+    CHECK(paths.lookup("md.XNAS.MSFT") == PathPool::NotFound);
+    CHECK(paths.lookup("md.XNAS.AAPL.bid.size") == PathPool::NotFound);
+    CHECK(paths.find(aapl, "last") == last);
+    CHECK(paths.find(bid, "ask") == PathPool::NotFound);
+    CHECK(paths.size() == before);
+
+    // Empty segments are kept; the same segment under two parents is two nodes.
+    const PathPool::Id empty = paths.intern("a..b");
+    CHECK(paths.depth(empty) == 3);
+    CHECK(paths.str(empty) == "a..b");
+    CHECK(paths.intern("x.bid") != bid);
+
+    // Enough nodes to page and to grow the child index.
+    std::vector<PathPool::Id> ids;
+    for (int i = 0; i < 10000; ++i) {
+        ids.push_back(paths.intern("md.XNAS." + std::to_string(i % 100) + ".q" + std::to_string(i)));
+    }
+    for (int i = 0; i < 10000; ++i) {
+        CHECK(paths.str(ids[i]) == "md.XNAS." + std::to_string(i % 100) + ".q" + std::to_string(i));
+    }
+    CHECK(paths.bytes() > 0);
+
+    SUBCASE("Concurrent interning") {
+        PathPool shared('/', strings);
+        std::vector<std::thread> threads;
+        std::vector<std::vector<PathPool::Id>> seen(4);
+        for (int t = 0; t < 4; ++t) {
+            threads.emplace_back([&, t] {
+                for (int i = 0; i < 500; ++i) {
+                    seen[t].push_back(shared.intern("/tick/" + std::to_string(i % 50) + "/" + std::to_string(i)));
+                }
+            });
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        for (int t = 1; t < 4; ++t) {
+            CHECK(seen[t] == seen[0]);
+        }
+        // Root, "", "tick", 50 buckets and 500 leaves.
+        CHECK(shared.size() == 1 + 1 + 1 + 50 + 500);
+        CHECK(shared.str(seen[0][7]) == "/tick/7/7");
+    }
+}
+
+#if defined(__cpp_lib_memory_resource)
+// Counts what passes through to upstream, so tests can see who allocated.
+class CountingResource : public std::pmr::memory_resource {
+public:
+    explicit CountingResource(std::pmr::memory_resource* upstream = std::pmr::new_delete_resource())
+        : upstream(upstream) {}
+
+    size_t live = 0;
+    size_t allocations = 0;
+
+private:
+    void* do_allocate(size_t bytes, size_t alignment) override {
+        void* p = upstream->allocate(bytes, alignment);
+        live += bytes;
+        ++allocations;
+        return p;
+    }
+
+    void do_deallocate(void* p, size_t bytes, size_t alignment) override {
+        live -= bytes;
+        upstream->deallocate(p, bytes, alignment);
+    }
+
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+        return this == &other;
+    }
+
+    std::pmr::memory_resource* upstream;
+};
+
+TEST_CASE("Memory Resources") {
+    SUBCASE("Queues") {
+        CountingResource resource;
+        {
+            SPSCQueue<int, DynamicCapacity, ResourceQueueTraits> spsc(1024, ResourceSlotAllocator(&resource));
+            SPMCQueue<int, 256, ResourceQueueTraits> spmc{ResourceSlotAllocator(&resource)};
+            CHECK(resource.live >= (1024 + 256) * sizeof(int));
+            const size_t allocations = resource.allocations;
+            for (int i = 0; i < 5000; ++i) {
+                CHECK(spsc.enqueue(i));
+                CHECK(spmc.enqueue(i));
+                int a = -1;
+                int b = -1;
+                CHECK(spsc.dequeue(a));
+                CHECK(spmc.dequeue(b));
+                CHECK(a == i);
+                CHECK(b == i);
+            }
+            CHECK(resource.allocations == allocations);
+        }
+        CHECK(resource.live == 0);
+        CHECK_THROWS_AS(ResourceSlotAllocator(nullptr), std::invalid_argument);
+    }
+
+    SUBCASE("StringPool") {
+        CountingResource resource;
+        StringPtr survivor;
+        {
+            StringPool pool(StringLifetime::Counted, &resource);
+            CHECK(pool.resource() == &resource);
+            const size_t empty = resource.live;
+            CHECK(empty > 0);
+            std::vector<StringPtr> counted;
+            for (int i = 0; i < 2000; ++i) {
+                counted.push_back(pool.intern("counted" + std::to_string(i)));
+            }
+            CHECK(resource.live > empty);
+            survivor = counted[7];
+            counted.clear();
+            pool.collect();
+            const size_t afterChurn = resource.live;
+            for (int i = 0; i < 2000; ++i) {
+                const std::string key = "immortal" + std::to_string(i);
+                pool.intern(key, hash64(key.data(), key.size()), StringLifetime::Immortal);
+                pool.symbolId("symbol" + std::to_string(i));
+            }
+            CHECK(resource.live > afterChurn);
+            CHECK(pool.symbolView(pool.symbolId("symbol5")) == "symbol5");
+        }
+        // A counted string may outlive its pool; its block goes back to the
+        // resource when it dies.
+        CHECK(survivor->view() == "counted7");
+        CHECK(resource.live > 0);
+        survivor.reset();
+        CHECK(resource.live == 0);
+        CHECK_THROWS_AS(StringPool(StringLifetime::Immortal, nullptr), std::invalid_argument);
+    }
+
+    SUBCASE("Fixed buffer") {
+        // Everything comes from one buffer; running past it would throw.
+        std::vector<char> buffer(size_t(16) << 20);
+        std::pmr::monotonic_buffer_resource arena(buffer.data(), buffer.size(), std::pmr::null_memory_resource());
+        StringPool pool(StringLifetime::Immortal, &arena);
+        std::vector<std::string> words;
+        for (int i = 0; i < 20000; ++i) {
+            words.push_back("w" + std::to_string(i));
+        }
+        std::vector<std::string_view> views(words.begin(), words.end());
+        std::vector<std::uint32_t> ids(views.size());
+        pool.ids_of(views.data(), views.size(), ids.data());
+        for (size_t i = 0; i < views.size(); i += 97) {
+            CHECK(pool.symbolView(ids[i]) == views[i]);
+        }
+        CHECK(pool.intern("w42")->view().data() == pool.symbolView(ids[42]).data());
+    }
+}
+#endif
+
+TEST_CASE("Inline Slot Storage") {
+    using Mailbox = SPSCQueue<int, 64, InlineQueueTraits>;
+    // The slots are inside the object, on lines of their own.
+    CHECK(sizeof(Mailbox) >= 64 * sizeof(int));
+    CHECK(alignof(Mailbox) >= CACHE_LINE_SIZE);
+
+    SUBCASE("Slots live in the object") {
+        Mailbox mailbox;
+        size_t n = 8;
+        const int* slots = mailbox.reserve(n);
+        REQUIRE(slots != nullptr);
+        const auto* begin = reinterpret_cast<const unsigned char*>(&mailbox);
+        const auto* at = reinterpret_cast<const unsigned char*>(slots);
+        CHECK(at >= begin);
+        CHECK(at + 64 * sizeof(int) <= begin + sizeof(Mailbox));
+        CHECK(reinterpret_cast<std::uintptr_t>(slots) % CACHE_LINE_SIZE == 0);
+        mailbox.commit(0);
+    }
+
+    SUBCASE("Every ring") {
+        static Mailbox mailbox;
+        SPMCQueue<std::string, 16, InlineQueueTraits> spmc;
+        MPMCQueue<std::unique_ptr<int>, 32, InlineQueueTraits> mpmc;
+        for (int lap = 0; lap < 10; ++lap) {
+            for (int i = 0; i < 64; ++i) {
+                CHECK(mailbox.enqueue(i));
+            }
+            CHECK_FALSE(mailbox.enqueue(64));
+            std::vector<int> out(64);
+            CHECK(mailbox.dequeue_bulk(out.begin(), 64) == 64);
+            CHECK(out[63] == 63);
+            for (int i = 0; i < 16; ++i) {
+                CHECK(spmc.enqueue(std::string(40, static_cast<char>('a' + i))));
+                CHECK(mpmc.enqueue(std::make_unique<int>(i)));
+            }
+            CHECK_FALSE(spmc.enqueue("full"));
+            std::string text;
+            std::unique_ptr<int> value;
+            for (int i = 0; i < 16; ++i) {
+                CHECK(spmc.dequeue(text));
+                CHECK(text[0] == 'a' + i);
+                CHECK(mpmc.dequeue(value));
+                CHECK(*value == i);
+            }
+        }
+        // Left for the destructor.
+        CHECK(spmc.enqueue("left over"));
+        CHECK(mpmc.enqueue(std::make_unique<int>(7)));
+        CHECK_THROWS_AS((SPSCQueue<int, 64, InlineQueueTraits>(32)), std::invalid_argument);
+    }
+
+    SUBCASE("Shared memory") {
+        // Placement-constructed in an anonymous shared mapping and used from
+        // a forked child as is, since the queue holds no pointers.
+        void* memory = mmap(nullptr, sizeof(Mailbox), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+        REQUIRE(memory != MAP_FAILED);
+        Mailbox* mailbox = new (memory) Mailbox();
+        const int total = 20000;
+        const pid_t child = fork();
+        REQUIRE(child >= 0);
+        if (child == 0) {
+            for (int i = 0; i < total; ++i) {
+                while (!mailbox->enqueue(i)) {
+                    std::this_thread::yield();
+                }
+            }
+            _exit(0);
+        }
+        bool ordered = true;
+        for (int i = 0; i < total; ++i) {
+            int value = -1;
+            while (!mailbox->dequeue(value)) {
+                std::this_thread::yield();
+            }
+            ordered = ordered && value == i;
+        }
+        int status = 0;
+        waitpid(child, &status, 0);
+        CHECK(ordered);
+        CHECK(WIFEXITED(status));
+        CHECK(WEXITSTATUS(status) == 0);
+        mailbox->~Mailbox();
+        munmap(memory, sizeof(Mailbox));
+    }
+}
+
+TEST_CASE("Benchmark Statistics") {
+    std::vector<double> samples;
+    for (int i = 0; i < 20; ++i) {
+        samples.push_back(10.0 + (i % 5) * 0.25);
+    }
+    samples.push_back(500.0);
+    samples.push_back(0.01);
+    const doctest::bench::Result result = doctest::bench::summarize("synthetic", samples, 1000);
+    CHECK(result.outliers == 2);
+    CHECK(result.samples == 20);
+    CHECK(result.iterations == 1000);
+    CHECK(result.min == doctest::Approx(10.0));
+    CHECK(result.max == doctest::Approx(11.0));
+    CHECK(result.median == doctest::Approx(10.5));
+    CHECK(result.mean == doctest::Approx(10.5));
+    CHECK(result.p90 <= result.p99);
+    CHECK(result.throughput() == doctest::Approx(1e9 / 10.5));
+    CHECK(doctest::bench::summarize("none", {}, 1).samples == 0);
+
+    // With no samples a body runs once, untimed.
+    const doctest::bench::Options saved = doctest::bench::options();
+    doctest::bench::options().samples = 0;
+    const size_t recorded = doctest::bench::results().size();
+    int runs = 0;
+    BENCHMARK("smoke only") {
+        ++runs;
+    }
+    CHECK(runs == 1);
+    CHECK(doctest::bench::results().size() == recorded);
+    doctest::bench::options() = saved;
+}
+
+TEST_CASE("Hot Path Benchmarks") {
+    // Bounds are loose; they catch a path that has become pathologically slow,
+    // not small regressions.
+    const bool timed = doctest::bench::options().samples != 0;
+
+    SPSCQueue<std::uint64_t, 1024> queue;
+    std::uint64_t value = 0;
+    BENCHMARK("SPSCQueue enqueue + dequeue") {
+        queue.enqueue(value);
+        queue.dequeue(value);
+        ++value;
+        doctest::bench::keep(value);
+    }
+    if (timed) {
+        CHECK(doctest::bench::last().name == "SPSCQueue enqueue + dequeue");
+        CHECK(doctest::bench::last().median < 1000.0);
+    }
+
+    StringPool pool;
+    const StringPtr held = pool.intern("bench:AAPL.OQ");
+    const std::string key = "bench:AAPL.OQ";
+    BENCHMARK("StringPool intern hit") {
+        doctest::bench::keep(pool.intern(key));
+    }
+    if (timed) {
+        CHECK(doctest::bench::last().median < 5000.0);
+    }
+
+    // Map keys are handles, which name strings of the process-wide pool.
+    StringRefMap<int> map;
+    std::vector<StringRef> keys;
+    for (int i = 0; i < 1000; ++i) {
+        keys.emplace_back("bench:" + std::to_string(i));
+        map[keys.back()] = i;
+    }
+    int hits = 0;
+    for (const StringRef& k : keys) {
+        hits += map.find(k) != map.end();
+    }
+    CHECK(hits == 1000);
+    size_t next = 0;
+    BENCHMARK("StringRefMap find") {
+        doctest::bench::keep(map.find(keys[next]));
+        next = (next + 1) % keys.size();
+    }
+    if (timed) {
+        CHECK(doctest::bench::last().median < 1000.0);
+    }
+
+    SlabAllocator slabs;
+    BENCHMARK("SlabAllocator allocate + free 64 B") {
+        void* p = slabs.allocate(64);
+        doctest::bench::keep(p);
+        slabs.deallocate(p, 64);
+    }
+    if (timed) {
+        CHECK(doctest::bench::last().median < 1000.0);
+    }
+
+    // A full ring drops, which costs about the same as an enqueue.
+    Tracer::instance().start();
+    BENCHMARK("Tracer record") {
+        CPPUTILS_TRACE_INSTANT("bench:record", 1);
+    }
+    Tracer::instance().stop();
+    if (timed) {
+        CHECK(doctest::bench::last().median < 1000.0);
+    }
+
+    AsyncLogger::instance().start([](const char*, size_t) {});
+    BENCHMARK("AsyncLogger log, two arguments") {
+        CPPUTILS_LOG_INFO("order {} filled at {}", 42, 101.25);
+    }
+    AsyncLogger::instance().stop();
+    if (timed) {
+        CHECK(doctest::bench::last().median < 1000.0);
+    }
+
+    MessageBus<int> bus;
+    const StringRef topic("bench:bus");
+    auto subscriber = bus.subscribe(topic);
+    BusMessage<int> message{};
+    int missed = 0;
+    BENCHMARK("MessageBus publish + receive") {
+        bus.publish(topic, 1);
+        missed += !subscriber->receive(message);
+        doctest::bench::keep(message.value);
+    }
+    CHECK(missed == 0);
+    if (timed) {
+        CHECK(doctest::bench::last().median < 1000.0);
+    }
+
+    SeqLock<std::array<std::uint64_t, 4>> seqLock;
+    BENCHMARK("SeqLock store + load, 32 B") {
+        seqLock.store({1, 2, 3, 4});
+        doctest::bench::keep(seqLock.load()[3]);
+    }
+    if (timed) {
+        CHECK(doctest::bench::last().median < 1000.0);
+    }
+
+    ConcurrentHashMap<std::uint64_t, std::uint64_t> orderMap;
+    for (std::uint64_t i = 0; i < 10000; ++i) {
+        orderMap.insert(i, i);
+    }
+    std::uint64_t orderId = 0;
+    BENCHMARK("ConcurrentHashMap find, 10k keys") {
+        std::uint64_t value = 0;
+        orderMap.find(orderId++ % 10000, value);
+        doctest::bench::keep(value);
+    }
+    if (timed) {
+        CHECK(doctest::bench::last().median < 1000.0);
+    }
+}
+
+TEST_CASE("Benchmark Report") {
+    doctest::bench::Result queue = doctest::bench::summarize("enqueue \"fast\"", {10.0, 11.0, 12.0}, 4096);
+    queue.test_case = "Queues\\SPSC";
+    doctest::bench::Result pool = doctest::bench::summarize("intern", {40.0, 41.0}, 128);
+    pool.test_case = "Strings";
+
+    std::stringstream json;
+    doctest::bench::writeReport(json, {queue, pool});
+    CHECK(json.str().find("\"cpu\": ") != std::string::npos);
+    CHECK(json.str().find("\"commit\": ") != std::string::npos);
+    CHECK(json.str().find("\"ops_per_second\": ") != std::string::npos);
+
+    std::vector<doctest::bench::Result> read;
+    REQUIRE(doctest::bench::readReport(json, read));
+    REQUIRE(read.size() == 2);
+    CHECK(read[0].test_case == "Queues\\SPSC");
+    CHECK(read[0].name == "enqueue \"fast\"");
+    CHECK(read[0].median == doctest::Approx(11.0));
+    CHECK(read[0].p99 == doctest::Approx(queue.p99));
+    CHECK(read[1].name == "intern");
+    CHECK(read[1].min == doctest::Approx(40.0));
+
+    // Unknown fields and values are skipped; anything else is rejected.
+    std::stringstream extra(R"({"version": [1, {"a": null}], "benchmarks": [{"name": "x", "tag": true, "median_ns": 2.5e1}]})");
+    REQUIRE(doctest::bench::readReport(extra, read));
+    REQUIRE(read.size() == 1);
+    CHECK(read[0].median == doctest::Approx(25.0));
+    std::stringstream truncated(R"({"benchmarks": [{"name": "x")");
+    CHECK_FALSE(doctest::bench::readReport(truncated, read));
+    std::stringstream empty("{}");
+    CHECK_FALSE(doctest::bench::readReport(empty, read));
+    CHECK(read.size() == 1);
+
+    CHECK(doctest::bench::parseRegression("5%") == doctest::Approx(5.0));
+    CHECK(doctest::bench::parseRegression("2.5") == doctest::Approx(2.5));
+    CHECK(doctest::bench::parseRegression("") < 0.0);
+    CHECK(doctest::bench::parseRegression("5 %") < 0.0);
+    CHECK(doctest::bench::parseRegression("-1%") < 0.0);
+
+    doctest::bench::Result now = queue;
+    now.median = 11.5;
+    CHECK_FALSE(doctest::bench::regressed(now, queue, 5.0));
+    now.median = 11.6;
+    CHECK(doctest::bench::regressed(now, queue, 5.0));
+    CHECK_FALSE(doctest::bench::regressed(now, queue, 10.0));
+}
+
+TEST_CASE("Sharded Counter") {
+    ShardedCounter<> requests;
+    ShardedCounters<std::uint64_t, 2, 4> pair;
+    ShardedMax<std::int64_t> largest;
+    ShardedMin<std::int64_t> smallest;
+    CHECK(largest.load() == std::numeric_limits<std::int64_t>::lowest());
+    CHECK(smallest.load() == std::numeric_limits<std::int64_t>::max());
+
+    const int threads = 8;
+    const int perThread = 10000;
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; ++t) {
+        workers.emplace_back([&, t] {
+            for (int i = 0; i < perThread; ++i) {
+                ++requests;
+                auto& lane = pair.lane();
+                lane.add(0, 1);
+                lane.add(1, 2);
+                largest.update(t * perThread + i);
+                smallest.update(-(t * perThread + i));
+            }
+        });
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    CHECK(requests.load() == std::uint64_t(threads) * perThread);
+    CHECK(std::uint64_t(requests) == requests.load());
+    const std::array<std::uint64_t, 2> sums = pair.snapshot();
+    CHECK(sums[0] == std::uint64_t(threads) * perThread);
+    CHECK(sums[1] == 2 * sums[0]);
+    CHECK(pair.load(1) == sums[1]);
+    CHECK(largest.load() == threads * perThread - 1);
+    CHECK(smallest.load() == -(threads * perThread - 1));
+
+    requests -= 5;
+    CHECK(requests.load() == std::uint64_t(threads) * perThread - 5);
+    requests.store(42);
+    ++requests;
+    CHECK(requests.load() == 43);
+    requests.reset();
+    pair.reset();
+    largest.reset();
+    CHECK(requests.load() == 0);
+    CHECK(pair.snapshot() == std::array<std::uint64_t, 2>{});
+    CHECK(largest.load() == ShardedMax<std::int64_t>::identity());
+
+    ShardedMax<double, 2> latency;
+    latency.update(1.5);
+    latency.update(0.5);
+    CHECK(latency.load() == 1.5);
+    static_assert(alignof(ShardedCounters<std::uint32_t, 3>::Lane) == 64, "one lane per cache line");
+}
+
+TEST_CASE("Epoch Reclamation") {
+    std::atomic<int> freed{0};
+    auto countFree = [&freed](int* p) {
+        delete p;
+        freed.fetch_add(1);
+    };
+
+    SUBCASE("an open guard holds back what was retired during it") {
+        EpochDomain domain(0);
+        std::atomic<bool> inside{false};
+        std::atomic<bool> leave{false};
+        std::thread reader([&] {
+            EpochDomain::Guard guard(domain);
+            REQUIRE(guard);
+            inside = true;
+            while (!leave) {
+                std::this_thread::yield();
+            }
+        });
+        while (!inside) {
+            std::this_thread::yield();
+        }
+        domain.retire(new int(1), countFree);
+        domain.retire(new int(2), countFree);
+        CHECK(domain.collect() == 0);
+        CHECK(domain.pending() == 2);
+        leave = true;
+        reader.join();
+        CHECK(domain.collect() == 2);
+        CHECK(freed == 2);
+        CHECK(domain.pending() == 0);
+    }
+
+    SUBCASE("collection is amortised across retires") {
+        EpochDomain domain(8);
+        for (int i = 0; i < 100; ++i) {
+            domain.retire(new int(i), countFree);
+        }
+        CHECK(domain.pending() < 8);
+        CHECK(freed + int(domain.pending()) == 100);
+    }
+
+    SUBCASE("a destroyed domain frees the rest") {
+        {
+            EpochDomain domain(0);
+            EpochDomain::Guard guard(domain);
+            domain.retire(new int(3), countFree);
+            // Nested guards share the outer announcement.
+            EpochDomain::Guard nested(domain);
+            CHECK(nested);
+        }
+        CHECK(freed == 1);
+    }
+
+    SUBCASE("a background thread collects") {
+        EpochDomain domain(0);
+        {
+            BackgroundReclaimer<EpochDomain> reclaimer(domain, std::chrono::milliseconds(1));
+            domain.retire(new int(4), countFree);
+            reclaimer.wake();
+            for (int i = 0; i < 1000 && domain.pending() != 0; ++i) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+        }
+        CHECK(freed == 1);
+        CHECK(domain.pending() == 0);
+    }
+
+    SUBCASE("readers never see a freed object") {
+        struct Box {
+            std::uint64_t value;
+        };
+        EpochDomain domain(16);
+        std::atomic<Box*> current{new Box{0}};
+        std::atomic<bool> done{false};
+        std::atomic<std::uint64_t> badReads{0};
+        std::vector<std::thread> readers;
+        for (int r = 0; r < 3; ++r) {
+            readers.emplace_back([&] {
+                while (!done) {
+                    EpochDomain::Guard guard(domain);
+                    const Box* box = current.load(std::memory_order_acquire);
+                    if (box->value == ~std::uint64_t(0)) {
+                        badReads.fetch_add(1);
+                    }
+                }
+            });
+        }
+        for (std::uint64_t i = 1; i <= 2000; ++i) {
+            Box* old = current.exchange(new Box{i}, std::memory_order_acq_rel);
+            domain.retire(old, [](Box* box) {
+                box->value = ~std::uint64_t(0);
+                delete box;
+            });
+        }
+        done = true;
+        for (auto& reader : readers) {
+            reader.join();
+        }
+        delete current.load();
+        CHECK(badReads == 0);
+    }
+
+    SUBCASE("stamps taken after a plain unlink hold back entering readers") {
+        // As a caller with its own retired list does it: unlink with a
+        // release store, stamp with retireEpoch(), free below safeBefore().
+        struct Box {
+            std::uint64_t value;
+        };
+        EpochDomain domain;
+        std::atomic<Box*> current{new Box{0}};
+        std::atomic<bool> done{false};
+        std::atomic<std::uint64_t> badReads{0};
+        std::vector<std::thread> readers;
+        for (int r = 0; r < 3; ++r) {
+            readers.emplace_back([&] {
+                while (!done) {
+                    // A fresh guard every read, so readers keep entering.
+                    EpochDomain::Guard guard(domain);
+                    const Box* box = current.load(std::memory_order_acquire);
+                    if (box->value == ~std::uint64_t(0)) {
+                        badReads.fetch_add(1);
+                    }
+                }
+            });
+        }
+        std::vector<std::pair<std::uint64_t, Box*>> retired;
+        auto sweep = [&](std::uint64_t safe) {
+            auto keep = retired.begin();
+            for (auto& entry : retired) {
+                if (entry.first < safe) {
+                    entry.second->value = ~std::uint64_t(0);
+                    delete entry.second;
+                } else {
+                    *keep++ = entry;
+                }
+            }
+            retired.erase(keep, retired.end());
+        };
+        for (std::uint64_t i = 1; i <= 5000; ++i) {
+            Box* old = current.load(std::memory_order_relaxed);
+            current.store(new Box{i}, std::memory_order_release);
+            retired.emplace_back(domain.retireEpoch(), old);
+            if (i % 8 == 0) {
+                sweep(domain.safeBefore());
+            }
+        }
+        done = true;
+        for (auto& reader : readers) {
+            reader.join();
+        }
+        sweep(~std::uint64_t(0));
+        delete current.load();
+        CHECK(badReads == 0);
+        CHECK(retired.empty());
+    }
+
+    SUBCASE("a thread's claims do not outlive their domains") {
+        for (int i = 0; i < 1000; ++i) {
+            EpochDomain domain;
+            EpochDomain::Guard guard(domain);
+            REQUIRE(guard);
+        }
+        CHECK(detail::ReclaimClaims::local().claims.size() <= 2);
+    }
+
+    SUBCASE("a reader finding every slot taken gets one once they are free") {
+        EpochDomain domain;
+        std::atomic<size_t> inside{0};
+        std::atomic<bool> leave{false};
+        std::vector<std::thread> readers;
+        for (size_t r = 0; r < EpochDomain::MaxReaders; ++r) {
+            readers.emplace_back([&] {
+                {
+                    EpochDomain::Guard guard(domain);
+                }
+                inside.fetch_add(1);
+                while (!leave) {
+                    std::this_thread::yield();
+                }
+            });
+        }
+        while (inside != EpochDomain::MaxReaders) {
+            std::this_thread::yield();
+        }
+        {
+            EpochDomain::Guard guard(domain);
+            CHECK_FALSE(guard);
+        }
+        leave = true;
+        for (auto& reader : readers) {
+            reader.join();
+        }
+        EpochDomain::Guard guard(domain);
+        CHECK(guard);
+    }
+}
+
+TEST_CASE("Hazard Reclamation") {
+    struct Node {
+        int value;
+    };
+    std::atomic<int> freed{0};
+    auto countFree = [&freed](Node* p) {
+        delete p;
+        freed.fetch_add(1);
+    };
+
+    SUBCASE("a published hazard holds back only its object") {
+        HazardDomain domain(0);
+        std::atomic<Node*> head{new Node{1}};
+        HazardDomain::Hazard hazard(domain);
+        REQUIRE(hazard);
+        Node* seen = hazard.protect(head);
+        CHECK(seen->value == 1);
+        head.store(new Node{2});
+        domain.retire(seen, countFree);
+        domain.retire(new Node{3}, countFree);
+        CHECK(domain.collect() == 1);
+        CHECK(seen->value == 1);
+        hazard.reset();
+        CHECK(domain.collect() == 1);
+        CHECK(freed == 2);
+        delete head.load();
+    }
+
+    SUBCASE("a thread's hazards are limited") {
+        HazardDomain domain;
+        std::vector<std::unique_ptr<HazardDomain::Hazard>> hazards;
+        for (size_t i = 0; i < HazardDomain::HazardsPerThread; ++i) {
+            hazards.push_back(std::make_unique<HazardDomain::Hazard>(domain));
+            CHECK(*hazards.back());
+        }
+        HazardDomain::Hazard extra(domain);
+        CHECK_FALSE(extra);
+        hazards.pop_back();
+        HazardDomain::Hazard reused(domain);
+        CHECK(reused);
+    }
+
+    SUBCASE("garbage stays bounded while readers run") {
+        HazardDomain domain(8);
+        std::atomic<Node*> current{new Node{0}};
+        std::atomic<bool> done{false};
+        std::atomic<int> badReads{0};
+        std::vector<std::thread> readers;
+        for (int r = 0; r < 3; ++r) {
+            readers.emplace_back([&] {
+                HazardDomain::Hazard hazard(domain);
+                while (!done) {
+                    if (hazard.protect(current)->value < 0) {
+                        badReads.fetch_add(1);
+                    }
+                }
+            });
+        }
+        size_t worst = 0;
+        for (int i = 1; i <= 2000; ++i) {
+            Node* old = current.exchange(new Node{i});
+            domain.retire(old, [](Node* node) {
+                node->value = -1;
+                delete node;
+            });
+            worst = std::max(worst, domain.pending());
+        }
+        done = true;
+        for (auto& reader : readers) {
+            reader.join();
+        }
+        delete current.load();
+        CHECK(badReads == 0);
+        CHECK(worst <= 8 + 3);
+    }
+}
+
+TEST_CASE("Slab Allocator") {
+    CHECK(SlabAllocator::classIndex(1, 1) == 0);
+    CHECK(SlabAllocator::classIndex(17, 8) == 1);
+    CHECK(SlabAllocator::classSize(SlabAllocator::classIndex(48, 32)) == 64);
+    CHECK(SlabAllocator::classSize(SlabAllocator::classIndex(129, 8)) == 192);
+    CHECK(SlabAllocator::classSize(SlabAllocator::classIndex(2048, 8)) == 2048);
+    CHECK(SlabAllocator::classIndex(2049, 8) == SlabAllocator::ClassCount);
+    CHECK(SlabAllocator::classIndex(64, 128) == SlabAllocator::ClassCount);
+
+    SUBCASE("objects are aligned, distinct and reused") {
+        SlabAllocator slabs;
+        std::vector<std::pair<void*, size_t>> live;
+        for (size_t i = 0; i < 3000; ++i) {
+            const size_t size = 1 + (i * 37) % 700;
+            const size_t alignment = size_t(1) << (i % 7);
+            void* p = slabs.allocate(size, alignment);
+            CHECK(reinterpret_cast<std::uintptr_t>(p) % alignment == 0);
+            std::memset(p, int(i), size);
+            live.emplace_back(p, size | (alignment << 32));
+        }
+        std::set<void*> distinct;
+        for (const auto& object : live) {
+            distinct.insert(object.first);
+        }
+        CHECK(distinct.size() == live.size());
+        SlabStats stats = slabs.stats();
+        CHECK(stats.inUseBytes > 0);
+        const size_t slabsBefore = stats.slabs;
+        for (const auto& object : live) {
+            slabs.deallocate(object.first, object.second & 0xffffffff, object.second >> 32);
+        }
+        CHECK(slabs.stats().inUseBytes == 0);
+        for (int round = 0; round < 3; ++round) {
+            for (auto& object : live) {
+                object.first = slabs.allocate(object.second & 0xffffffff, object.second >> 32);
+            }
+            for (const auto& object : live) {
+                slabs.deallocate(object.first, object.second & 0xffffffff, object.second >> 32);
+            }
+        }
+        stats = slabs.stats();
+        CHECK(stats.slabs == slabsBefore);
+        for (const SlabClassStats& cls : stats.classes) {
+            CHECK(cls.inUse == 0);
+            CHECK(cls.capacity * cls.objectSize <= cls.slabs * SlabAllocator::SlabSize);
+        }
+
+        void* large = slabs.allocate(100000, 8);
+        CHECK(slabs.stats().largeAllocations == 1);
+        CHECK(slabs.stats().largeBytes == 100000);
+        slabs.deallocate(large, 100000, 8);
+        CHECK(slabs.stats().largeAllocations == 0);
+    }
+
+    SUBCASE("frees from another thread go back to the owning slab") {
+        SlabAllocator slabs;
+        SPSCQueue<void*, 1024> handoff;
+        const int total = 200000;
+        int outOfOrder = 0;
+        std::thread consumer([&] {
+            for (int received = 0; received < total;) {
+                void* p;
+                if (handoff.dequeue(p)) {
+                    outOfOrder += *static_cast<int*>(p) != received;
+                    slabs.deallocate(p, 64);
+                    ++received;
+                }
+            }
+        });
+        for (int i = 0; i < total; ++i) {
+            void* p = slabs.allocate(64);
+            *static_cast<int*>(p) = i;
+            while (!handoff.enqueue(p)) {
+                std::this_thread::yield();
+            }
+        }
+        consumer.join();
+        CHECK(outOfOrder == 0);
+        const SlabClassStats stats = slabs.stats().classes[SlabAllocator::classIndex(64, 16)];
+        CHECK(stats.inUse == 0);
+        // The ring holds at most 1024 in flight, so slabs are recycled.
+        CHECK(stats.slabs <= 8);
+    }
+
+    SUBCASE("slabs of an exited thread are adopted") {
+        SlabAllocator slabs;
+        std::vector<void*> leftover;
+        std::thread worker([&] {
+            for (int i = 0; i < 5000; ++i) {
+                leftover.push_back(slabs.allocate(32));
+            }
+            for (int i = 0; i < 2500; ++i) {
+                slabs.deallocate(leftover.back(), 32);
+                leftover.pop_back();
+            }
+        });
+        worker.join();
+        const size_t slabsBefore = slabs.stats().slabs;
+        for (void* p : leftover) {
+            slabs.deallocate(p, 32);
+        }
+        for (int i = 0; i < 5000; ++i) {
+            leftover[i % leftover.size()] = slabs.allocate(32);
+        }
+        CHECK(slabs.stats().slabs == slabsBefore);
+        for (size_t i = 0; i < leftover.size(); ++i) {
+            slabs.deallocate(leftover[i], 32);
+        }
+        // The first pass over leftover overwrote 2500 objects unfreed.
+        CHECK(slabs.stats().classes[SlabAllocator::classIndex(32, 16)].inUse == 2500);
+    }
+
+    SUBCASE("a thread's caches do not outlive their allocators") {
+        std::thread worker([] {
+            for (int i = 0; i < 1000; ++i) {
+                SlabAllocator slabs;
+                slabs.deallocate(slabs.allocate(32), 32);
+            }
+            CHECK(detail::SlabThreadCache::local().entries.size() <= 2);
+        });
+        worker.join();
+    }
+
+    SUBCASE("thread-local destructors may allocate after the cache is gone") {
+        static SlabAllocator* target = nullptr;
+        static std::atomic<int> served{0};
+        // Constructed before the cache, so destroyed after it.
+        struct Late {
+            ~Late() {
+                target->deallocate(target->allocate(64), 64);
+                served.fetch_add(1);
+            }
+        };
+        SlabAllocator slabs;
+        target = &slabs;
+        served = 0;
+        std::thread worker([] {
+            static thread_local Late late;
+            target->deallocate(target->allocate(64), 64);
+        });
+        worker.join();
+        CHECK(served == 1);
+        CHECK(slabs.stats().classes[SlabAllocator::classIndex(64, 16)].inUse == 0);
+    }
+
+#if defined(__cpp_lib_memory_resource)
+    SUBCASE("as a memory resource") {
+        SlabResource resource;
+        {
+            StringPool pool(StringLifetime::Counted, &resource);
+            const StringPtr held = pool.intern("slab:AAPL.OQ");
+            for (int i = 0; i < 1000; ++i) {
+                pool.intern("slab:" + std::to_string(i));
+            }
+            CHECK(resource.stats().inUseBytes > 0);
+            std::pmr::vector<int> values(&resource);
+            values.assign(100, 7);
+            CHECK(values[99] == 7);
+        }
+        CHECK(resource.stats().inUseBytes == 0);
+        CHECK_THROWS_AS(SlabResource(nullptr), std::invalid_argument);
+    }
+#endif
+}
+
+TEST_CASE("Tracer") {
+    Tracer& tracer = Tracer::instance();
+    CHECK(Tracer::eventId("tracer:step") == Tracer::eventId(StringRef("tracer:step")));
+    CHECK_THROWS_AS(tracer.start(std::chrono::milliseconds(1), 1000), std::invalid_argument);
+
+    SUBCASE("records from several threads are collected in time order") {
+        tracer.start(std::chrono::milliseconds(1), 1024);
+        const int perThread = 5000;
+        std::vector<std::thread> threads;
+        for (int t = 0; t < 3; ++t) {
+            threads.emplace_back([t] {
+                for (int i = 0; i < perThread; ++i) {
+                    CPPUTILS_TRACE_SCOPE("tracer:step");
+                    CPPUTILS_TRACE_COUNTER("tracer:counter", static_cast<std::uint64_t>(t * perThread + i));
+                    if (i % 512 == 0) {
+                        // Leave the collector room to keep the ring from filling.
+                        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+                    }
+                }
+            });
+        }
+        CPPUTILS_TRACE_INSTANT("tracer:main", 7);
+        for (std::thread& thread : threads) {
+            thread.join();
+        }
+        const Trace trace = tracer.capture();
+        CHECK(!tracer.enabled());
+        CHECK(trace.events.size() + trace.dropped == 3 * perThread * 3 + 1);
+        CHECK(std::is_sorted(trace.events.begin(), trace.events.end(),
+                             [](const TraceEvent& a, const TraceEvent& b) { return a.ticks < b.ticks; }));
+        std::set<std::uint32_t> threadIds;
+        for (const TraceEvent& event : trace.events) {
+            threadIds.insert(event.thread);
+        }
+        CHECK(threadIds.size() == 4);
+        CHECK(trace.name(Tracer::eventId("tracer:step")) == "tracer:step");
+
+        std::ostringstream json;
+        trace.writeChromeJson(json);
+        CHECK(json.str().find("\"traceEvents\":[") != std::string::npos);
+        CHECK(json.str().find("{\"name\":\"tracer:main\",\"ph\":\"i\"") != std::string::npos);
+        CHECK(json.str().find("{\"name\":\"tracer:step\",\"ph\":\"B\"") != std::string::npos);
+        CHECK(json.str().find("\"ph\":\"C\"") != std::string::npos);
+
+        std::stringstream binary;
+        trace.writeBinary(binary);
+        Trace read;
+        REQUIRE(read.readBinary(binary));
+        CHECK(read.events.size() == trace.events.size());
+        CHECK(read.dropped == trace.dropped);
+        CHECK(read.names == trace.names);
+        CHECK(read.events.back().ticks == trace.events.back().ticks);
+        CHECK(read.events.back().phase == trace.events.back().phase);
+        std::stringstream garbage("CPTRACE0");
+        CHECK(!read.readBinary(garbage));
+        CHECK(read.events.size() == trace.events.size());
+    }
+
+    SUBCASE("a full ring drops and counts") {
+        tracer.start(std::chrono::milliseconds(1000), 16);
+        std::thread([] {
+            for (int i = 0; i < 100; ++i) {
+                CPPUTILS_TRACE_INSTANT("tracer:burst", i);
+            }
+        }).join();
+        const Trace trace = tracer.capture();
+        CHECK(trace.events.size() == 16);
+        CHECK(trace.dropped == 84);
+        CHECK(trace.events.front().arg == 0);
+    }
+
+    SUBCASE("nothing is recorded outside a session") {
+        CPPUTILS_TRACE_INSTANT("tracer:idle", 1);
+        tracer.start();
+        const Trace trace = tracer.capture();
+        CHECK(trace.events.empty());
+    }
+}
+
+TEST_CASE("Async Logger") {
+    AsyncLogger& logger = AsyncLogger::instance();
+    CHECK(detail::logPlaceholders("{} @ {} {x}") == 2);
+    CHECK_THROWS_AS(logger.start(nullptr), std::invalid_argument);
+    CHECK(!logger.enabled(LogLevel::Error));
+
+    std::mutex mutex;
+    std::string output;
+    size_t sinkCalls = 0;
+    const LogSink sink = [&](const char* data, size_t size) {
+        std::lock_guard<std::mutex> lock(mutex);
+        output.append(data, size);
+        ++sinkCalls;
+    };
+
+    SUBCASE("lines are formatted on the writer thread") {
+        LogOptions options;
+        options.level = LogLevel::Info;
+        logger.start(sink, options);
+        const StringPtr symbol = CPPUTILS_INTERN("logger:AAPL.OQ");
+        const StringHandle handle(StringRef("logger:MSFT.OQ"));
+        int evaluated = 0;
+        CPPUTILS_LOG_DEBUG("not {}", ++evaluated);
+        CPPUTILS_LOG_INFO("filled {} {} @ {} on {}", -25, symbol, 101.25, handle);
+        CPPUTILS_LOG_WARNING("flags {} {} {}", true, 'x', std::string("copied"));
+        CPPUTILS_LOG_ERROR("no arguments");
+        CHECK(evaluated == 0);
+        logger.stop();
+        CHECK(!logger.enabled(LogLevel::Error));
+
+        std::istringstream lines(output);
+        std::string line;
+        std::vector<std::string> messages;
+        while (std::getline(lines, line)) {
+            // "YYYY-MM-DD HH:MM:SS.nnnnnnnnn LEVEL [thread] message"
+            REQUIRE(line.size() > 30);
+            CHECK(line[4] == '-');
+            CHECK(line[19] == '.');
+            messages.push_back(line.substr(30));
+        }
+        REQUIRE(messages.size() == 3);
+        CHECK(messages[0].find("INFO [") == 0);
+        CHECK(messages[0].find("] filled -25 logger:AAPL.OQ @ 101.25 on logger:MSFT.OQ") != std::string::npos);
+        CHECK(messages[1].find("] flags true x copied") != std::string::npos);
+        CHECK(messages[2].find("ERROR [") == 0);
+        CHECK(messages[2].find("] no arguments") != std::string::npos);
+    }
+
+    SUBCASE("threads are merged in time order and batched") {
+        LogOptions options;
+        options.overflow = LogOverflow::Block;
+        options.ringCapacity = 1024;
+        logger.start(sink, options);
+        const int perThread = 2000;
+        std::vector<std::thread> threads;
+        for (int t = 0; t < 3; ++t) {
+            threads.emplace_back([t] {
+                for (int i = 0; i < perThread; ++i) {
+                    CPPUTILS_LOG_INFO("thread {} line {}", t, i);
+                }
+            });
+        }
+        for (std::thread& thread : threads) {
+            thread.join();
+        }
+        logger.flush();
+        const LogStats stats = logger.stats();
+        logger.stop();
+        CHECK(stats.written == 3 * perThread);
+        CHECK(stats.dropped == 0);
+        CHECK(stats.batches == sinkCalls);
+        CHECK(sinkCalls < stats.written);
+
+        std::istringstream lines(output);
+        std::string line;
+        std::string previous;
+        int next[3] = {0, 0, 0};
+        int outOfOrder = 0;
+        while (std::getline(lines, line)) {
+            // Timestamps sort as text.
+            outOfOrder += line.compare(0, 29, previous, 0, 29) < 0;
+            previous = line;
+            const size_t at = line.find("thread ");
+            if (at == std::string::npos) {
+                ++outOfOrder;
+                continue;
+            }
+            const int thread = std::stoi(line.substr(at + 7));
+            const int number = std::stoi(line.substr(line.find("line ") + 5));
+            outOfOrder += number != next[thread]++;
+        }
+        CHECK(outOfOrder == 0);
+        CHECK(next[0] + next[1] + next[2] == 3 * perThread);
+    }
+
+    SUBCASE("a full ring drops in drop mode") {
+        LogOptions options;
+        options.ringCapacity = 256;
+        options.flushPeriod = std::chrono::milliseconds(1000);
+        logger.start(sink, options);
+        std::thread([] {
+            for (int i = 0; i < 100; ++i) {
+                CPPUTILS_LOG_INFO("burst {}", i);
+            }
+        }).join();
+        logger.flush();
+        const LogStats stats = logger.stats();
+        logger.stop();
+        CHECK(stats.written > 0);
+        CHECK(stats.written + stats.dropped == 100);
+        CHECK(output.find("burst 0\n") != std::string::npos);
+    }
+}
+
+TEST_CASE("Message Bus") {
+    const StringRef quotes("bus:quotes");
+    const StringRef trades("bus:trades");
+
+    SUBCASE("messages reach the subscribers of their topic") {
+        MessageBus<int> bus;
+        CHECK(bus.publish(quotes, 1) == 0);
+        auto a = bus.subscribe(quotes);
+        auto b = bus.subscribe(quotes, 4);
+        CHECK(bus.subscribe(b, trades));
+        CHECK(!bus.subscribe(b, trades));
+        CHECK(bus.subscribers(quotes) == 2);
+        CHECK(bus.topics() == 2);
+
+        CHECK(bus.publish(quotes, 10) == 2);
+        CHECK(bus.publish(trades, 20) == 1);
+        CHECK(bus.publish(StringRef("bus:unknown"), 30) == 0);
+
+        BusMessage<int> message{};
+        REQUIRE(a->receive(message));
+        CHECK(message.value == 10);
+        CHECK(StringRef(StringPtr(message.topic)) == quotes);
+        CHECK(!a->receive(message));
+        std::vector<int> values;
+        CHECK(b->drain([&](const BusMessage<int>& m) { values.push_back(m.value); }) == 2);
+        CHECK(values == std::vector<int>{10, 20});
+
+        for (int i = 0; i < 6; ++i) {
+            bus.publish(trades, i);
+        }
+        CHECK(b->size() == 4);
+        CHECK(b->dropped() == 2);
+
+        CHECK(bus.unsubscribe(b, quotes));
+        CHECK(!bus.unsubscribe(b, quotes));
+        CHECK(bus.publish(quotes, 11) == 1);
+        CHECK(bus.unsubscribe(b) == 1);
+        CHECK(bus.topics() == 1);
+        CHECK(bus.publish(trades, 21) == 0);
+        // Already queued messages stay with the subscriber.
+        CHECK(b->size() == 4);
+        CHECK_THROWS_AS(bus.subscribe(MessageBus<int>::SubscriberPtr(), quotes), std::invalid_argument);
+    }
+
+    SUBCASE("a topic of a scoped pool is refused and the routes stay as they were") {
+        // The copied routing table is freed on the throw; the leak checker
+        // of the sanitizer build catches it if not.
+        MessageBus<int> bus;
+        auto a = bus.subscribe(quotes);
+        StringPool session;
+        const StringRef scoped(session, "bus:scoped");
+        CHECK_THROWS_AS(bus.subscribe(a, scoped), std::invalid_argument);
+        CHECK_THROWS_AS(bus.subscribe(scoped), std::invalid_argument);
+        CHECK(bus.topics() == 1);
+        CHECK(!bus.unsubscribe(a, scoped));
+        CHECK(bus.publish(quotes, 1) == 1);
+    }
+
+    SUBCASE("subscriptions change under a running publisher") {
+        MessageBus<std::uint64_t, MPMCQueue> bus;
+        auto steady = bus.subscribe(quotes, 1 << 16);
+        std::atomic<bool> done{false};
+        std::vector<std::thread> publishers;
+        for (int t = 0; t < 2; ++t) {
+            publishers.emplace_back([&] {
+                for (std::uint64_t i = 0; i < 20000; ++i) {
+                    bus.publish(quotes, i);
+                }
+            });
+        }
+        std::thread churn([&] {
+            while (!done.load()) {
+                auto transient = bus.subscribe(quotes, 64);
+                bus.subscribe(transient, trades);
+                bus.unsubscribe(transient);
+            }
+        });
+        for (std::thread& publisher : publishers) {
+            publisher.join();
+        }
+        done = true;
+        churn.join();
+        CHECK(steady->size() + steady->dropped() == 40000);
+        CHECK(bus.subscribers(quotes) == 1);
+        CHECK(bus.subscribers(trades) == 0);
+    }
+}
+
+TEST_CASE("Seq Lock") {
+    struct Quote {
+        std::uint64_t bid;
+        std::uint64_t ask;
+        std::uint32_t size;
+    };
+    SeqLock<Quote> latest(Quote{1, 2, 0});
+    CHECK(latest.load().ask == 2);
+    CHECK(latest.version() == 0);
+    latest.store(Quote{3, 6, 3});
+    Quote quote{};
+    CHECK(latest.try_load(quote));
+    CHECK(quote.bid == 3);
+    CHECK(latest.version() == 1);
+
+    const std::uint32_t updates = 200000;
+    std::atomic<bool> done{false};
+    std::thread writer([&] {
+        for (std::uint32_t i = 2; i <= updates; ++i) {
+            latest.store(Quote{i, 2 * i, i});
+        }
+        done = true;
+    });
+    int torn = 0;
+    int backwards = 0;
+    std::uint64_t last = 0;
+    while (!done.load()) {
+        const Quote read = latest.load<YieldBackoff>();
+        torn += read.ask != 2 * read.bid || read.size != read.bid;
+        backwards += read.bid < last;
+        last = read.bid;
+    }
+    writer.join();
+    CHECK(torn == 0);
+    CHECK(backwards == 0);
+    CHECK(latest.load().bid == updates);
+    CHECK(latest.version() == updates);
+}
+
+TEST_CASE("Triple Buffer") {
+    TripleBuffer<std::vector<int>> buffer(std::vector<int>{0});
+    CHECK(!buffer.fresh());
+    CHECK(!buffer.update());
+    CHECK(buffer.front() == std::vector<int>{0});
+
+    buffer.back().assign(3, 1);
+    buffer.publish();
+    buffer.store(std::vector<int>(3, 2));
+    CHECK(buffer.fresh());
+    // Only the newest value is taken; the one before it is skipped.
+    CHECK(buffer.load() == std::vector<int>(3, 2));
+    CHECK(!buffer.update());
+
+    TripleBuffer<std::uint64_t> counter;
+    const std::uint64_t updates = 200000;
+    std::thread writer([&] {
+        for (std::uint64_t i = 1; i <= updates; ++i) {
+            counter.store(i);
+        }
+    });
+    int backwards = 0;
+    std::uint64_t last = 0;
+    while (last != updates) {
+        const std::uint64_t value = counter.load();
+        backwards += value < last;
+        last = value;
+    }
+    writer.join();
+    CHECK(backwards == 0);
+    CHECK(!counter.update());
+}
+
+TEST_CASE("Concurrent Hash Map") {
+    SUBCASE("single thread") {
+        ConcurrentHashMap<std::uint64_t, std::string> orders;
+        CHECK(orders.empty());
+        std::string value;
+        CHECK(!orders.find(1, value));
+        CHECK(orders.insert_or_assign(1, "AAPL"));
+        CHECK(!orders.insert_or_assign(1, "MSFT"));
+        CHECK(!orders.insert(1, "IBM"));
+        REQUIRE(orders.find(1, value));
+        CHECK(value == "MSFT");
+        CHECK(orders.size() == 1);
+
+        // Enough keys to grow every shard several times over.
+        for (std::uint64_t i = 2; i <= 20000; ++i) {
+            orders.insert(i, std::to_string(i));
+        }
+        CHECK(orders.size() == 20000);
+        int missing = 0;
+        for (std::uint64_t i = 2; i <= 20000; ++i) {
+            missing += !orders.find(i, value) || value != std::to_string(i);
+        }
+        CHECK(missing == 0);
+        CHECK(orders.erase(2));
+        CHECK(!orders.erase(2));
+        CHECK(!orders.contains(2));
+        CHECK(orders.erase_if([](std::uint64_t key, const std::string&) { return key % 2 == 0; }) == 9999);
+        CHECK(orders.size() == 10000);
+        size_t visited = 0;
+        orders.for_each([&](std::uint64_t key, const std::string&) { visited += key % 2 == 1; });
+        CHECK(visited == 10000);
+        CHECK(orders.visit(3, [](const std::string& v) { CHECK(v == "3"); }));
+        orders.clear();
+        CHECK(orders.empty());
+    }
+
+    SUBCASE("readers run through writes and resizes") {
+        ConcurrentHashMap<std::uint64_t, std::uint64_t, std::hash<std::uint64_t>, 4> map;
+        const std::uint64_t keys = 50000;
+        for (std::uint64_t i = 0; i < 1000; ++i) {
+            map.insert(i, i * 3);
+        }
+        std::atomic<bool> done{false};
+        std::atomic<int> wrong{0};
+        std::vector<std::thread> readers;
+        for (int r = 0; r < 3; ++r) {
+            readers.emplace_back([&] {
+                std::uint64_t value = 0;
+                for (std::uint64_t i = 0; !done.load(std::memory_order_relaxed); i = (i + 1) % 1000) {
+                    // The first thousand keys are never erased and always
+                    // map to a multiple of their key.
+                    if (!map.find(i, value) || value % (i == 0 ? 1 : i) != 0) {
+                        ++wrong;
+                    }
+                }
+            });
+        }
+        std::thread writer([&] {
+            for (std::uint64_t i = 1000; i < keys; ++i) {
+                map.insert_or_assign(i, i);
+                map.insert_or_assign(i % 1000, (i % 1000) * (i % 7 + 1));
+                if (i % 3 == 0) {
+                    map.erase(i - 1);
+                }
+            }
+            done = true;
+        });
+        writer.join();
+        for (std::thread& reader : readers) {
+            reader.join();
+        }
+        CHECK(wrong == 0);
+        size_t count = 0;
+        map.for_each([&](std::uint64_t, std::uint64_t) { ++count; });
+        CHECK(count == map.size());
+    }
+}
+
+TEST_CASE("Adaptive Batcher") {
+    SPSCQueue<int> queue(1024);
+    std::vector<int> received;
+    std::vector<size_t> batches;
+    const auto handler = [&](int* items, size_t count) {
+        received.insert(received.end(), items, items + count);
+        batches.push_back(count);
+    };
+
+    SUBCASE("a lone item goes out at once") {
+        AdaptiveBatcher<int> batcher(queue);
+        CHECK(batcher.poll(handler) == 0);
+        queue.enqueue(7);
+        CHECK(batcher.poll(handler) == 1);
+        CHECK(received == std::vector<int>{7});
+        CHECK(batcher.stats().idle == 1);
+    }
+
+    SUBCASE("a backlog goes out in full batches") {
+        AdaptiveBatchOptions options;
+        options.maxBatch = 256;
+        AdaptiveBatcher<int> batcher(queue, options);
+        for (int i = 0; i < 600; ++i) {
+            queue.enqueue(i);
+        }
+        CHECK(batcher.poll(handler) == 256);
+        CHECK(batcher.poll(handler) == 256);
+        batcher.poll(handler);
+        batcher.flush(handler);
+        CHECK(batcher.pending() == 0);
+        REQUIRE(received.size() == 600);
+        CHECK(received.back() == 599);
+        const AdaptiveBatchStats stats = batcher.stats();
+        CHECK(stats.full == 2);
+        CHECK(stats.items == 600);
+        CHECK(stats.batches == batches.size());
+        CHECK(batcher.sizes().max() == 256);
+        CHECK(batcher.sizes().min() == 600 - 512);
+        CHECK(batcher.sizes().count() == batches.size());
+    }
+
+    SUBCASE("an item out of budget is not held") {
+        struct Stamped {
+            std::uint64_t ticks;
+        };
+        struct Stamp {
+            std::uint64_t operator()(const Stamped& item, std::uint64_t) const {
+                return item.ticks;
+            }
+        };
+        SPSCQueue<Stamped> stamped(64);
+        AdaptiveBatchOptions options;
+        options.latencyBudget = std::chrono::milliseconds(1);
+        AdaptiveBatcher<Stamped, SPSCQueue<Stamped>, Stamp> batcher(stamped, options);
+        const std::uint64_t old = TscClock::ticks() - static_cast<std::uint64_t>(2e6 * TscClock::ticks_per_nanosecond());
+        stamped.enqueue(Stamped{old});
+        stamped.enqueue(Stamped{old});
+        CHECK(batcher.poll([](Stamped*, size_t) {}) == 2);
+        CHECK(batcher.stats().expired == 1);
+    }
+
+    SUBCASE("a burst is held for company") {
+        AdaptiveBatchOptions options;
+        options.latencyBudget = std::chrono::seconds(1);
+        AdaptiveBatcher<int> batcher(queue, options);
+        // Ten items in a fresh window already promise more within the budget.
+        for (int i = 0; i < 10; ++i) {
+            queue.enqueue(i);
+        }
+        CHECK(batcher.poll(handler) == 0);
+        CHECK(batcher.pending() == 10);
+        CHECK(batcher.stats().arrivalRate > 0);
+        for (int i = 10; i < 20; ++i) {
+            queue.enqueue(i);
+        }
+        CHECK(batcher.poll(handler) == 0);
+        CHECK(batcher.flush(handler) == 20);
+        CHECK(batches == std::vector<size_t>{20});
+        CHECK(batcher.stats().forced == 1);
+        CHECK(batcher.stats().items == 20);
+    }
+
+    SUBCASE("items from another thread arrive whole and in order") {
+        AdaptiveBatchOptions options;
+        options.maxBatch = 64;
+        options.latencyBudget = std::chrono::milliseconds(2);
+        AdaptiveBatcher<int> batcher(queue, options);
+        std::atomic<bool> done{false};
+        std::thread producer([&] {
+            for (int i = 0; i < 20000; ++i) {
+                while (!queue.enqueue(i)) {
+                    std::this_thread::yield();
+                }
+            }
+            done = true;
+        });
+        while (!done.load() || !queue.empty()) {
+            if (batcher.poll(handler) == 0) {
+                std::this_thread::yield();
+            }
+        }
+        producer.join();
+        batcher.flush(handler);
+        CHECK(received.size() == 20000);
+        int outOfOrder = 0;
+        for (size_t i = 0; i < received.size(); ++i) {
+            outOfOrder += received[i] != static_cast<int>(i);
+        }
+        CHECK(outOfOrder == 0);
+        const AdaptiveBatchStats stats = batcher.stats();
+        CHECK(stats.items == 20000);
+        CHECK(stats.batches == batches.size());
+        CHECK(stats.full + stats.expired + stats.backlogged + stats.idle + stats.forced == stats.batches);
+        CHECK(batcher.sizes().count() == stats.batches);
+        CHECK(stats.arrivalRate > 0);
+    }
+
+    CHECK_THROWS_AS(AdaptiveBatcher<int>(queue, AdaptiveBatchOptions{0}), std::invalid_argument);
+}
+
+TEST_CASE("Ring Bridge") {
+    struct Packet {
+        std::uint32_t sequence;
+        std::uint32_t words[2];
+    };
+    static_assert(sizeof(Packet) == 12, "packets should not be a multiple of the word size");
+
+    int fds[2];
+    REQUIRE(::socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+
+    SUBCASE("a slow remote consumer holds the sender back") {
+        SPSCQueue<Packet> local(1024);
+        SPSCQueue<Packet> remote(64);
+        RingBridgeOptions options;
+        options.maxBatch = 100;
+        RingBridgeSender<Packet> sender(local, fds[0], options);
+        RingBridgeReceiver<Packet> receiver(remote, fds[1], options);
+
+        const std::uint32_t total = 10000;
+        std::uint32_t produced = 0;
+        std::uint32_t consumed = 0;
+        int errors = 0;
+        while (consumed < total) {
+            while (produced < total && local.enqueue(Packet{produced, {produced * 3, ~produced}})) {
+                ++produced;
+            }
+            sender.pump();
+            receiver.pump();
+            // Takes a few items a round, so the remote ring fills up.
+            Packet packet;
+            for (int i = 0; i < 7 && remote.dequeue(packet); ++i) {
+                errors += packet.sequence != consumed || packet.words[0] != consumed * 3 || packet.words[1] != ~consumed;
+                ++consumed;
+            }
+        }
+        CHECK(errors == 0);
+        CHECK(local.empty());
+        CHECK(remote.empty());
+        CHECK(sender.stats().items == total);
+        CHECK(receiver.stats().items == total);
+        CHECK(sender.stats().frames == receiver.stats().frames);
+        CHECK(sender.stats().stalls > 0);
+        CHECK(sender.stats().credits == receiver.stats().credits);
+        CHECK(sender.credit() <= remote.capacity());
+    }
+
+    SUBCASE("items cross between threads in order") {
+        SPSCQueue<Packet> local(256);
+        SPSCQueue<Packet> remote(256);
+        const std::uint32_t total = 100000;
+        std::thread sending([&] {
+            RingBridgeSender<Packet> sender(local, fds[0]);
+            std::uint32_t produced = 0;
+            while (produced < total || !local.empty() || sender.busy()) {
+                while (produced < total && local.enqueue(Packet{produced, {produced, produced}})) {
+                    ++produced;
+                }
+                if (sender.pump() == 0) {
+                    std::this_thread::yield();
+                }
+            }
+        });
+        RingBridgeReceiver<Packet> receiver(remote, fds[1]);
+        std::uint32_t consumed = 0;
+        int errors = 0;
+        while (consumed < total) {
+            receiver.pump();
+            Packet packet;
+            bool any = false;
+            while (remote.dequeue(packet)) {
+                errors += packet.sequence != consumed || packet.words[1] != consumed;
+                ++consumed;
+                any = true;
+            }
+            if (!any) {
+                std::this_thread::yield();
+            }
+        }
+        sending.join();
+        CHECK(errors == 0);
+        CHECK(receiver.stats().items == total);
+        // Batching: far fewer frames than items.
+        CHECK(receiver.stats().frames < total / 4);
+    }
+
+    SUBCASE("a receiver of another item size rejects the stream") {
+        SPSCQueue<std::uint64_t> local(16);
+        SPSCQueue<std::uint32_t> remote(16);
+        RingBridgeSender<std::uint64_t> sender(local, fds[0]);
+        RingBridgeReceiver<std::uint32_t> receiver(remote, fds[1]);
+        local.enqueue(1);
+        receiver.pump();
+        CHECK(sender.pump() == 1);
+        CHECK_THROWS_AS(receiver.pump(), std::runtime_error);
+    }
+
+    SUBCASE("closing one end shows on the other") {
+        SPSCQueue<Packet> local(16);
+        SPSCQueue<Packet> remote(16);
+        RingBridgeSender<Packet> sender(local, fds[0]);
+        RingBridgeReceiver<Packet> receiver(remote, fds[1]);
+        receiver.pump();
+        sender.pump();
+        CHECK(sender.credit() == 16);
+        ::shutdown(fds[0], SHUT_WR);
+        receiver.pump();
+        CHECK(receiver.closed());
+        ::shutdown(fds[1], SHUT_WR);
+        sender.pump();
+        CHECK(sender.closed());
+    }
+
+    SPSCQueue<Packet> ring(16);
+    CHECK_THROWS_AS(RingBridgeSender<Packet>(ring, -1), std::invalid_argument);
+    CHECK_THROWS_AS(RingBridgeReceiver<Packet>(ring, fds[1], RingBridgeOptions{16, 32}), std::invalid_argument);
+    ::close(fds[0]);
+    ::close(fds[1]);
+}
 
 //int main(int argc, char** argv) {
     //doctest::Context context;